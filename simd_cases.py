@@ -0,0 +1,188 @@
+# Generates simd_cases.txt, the conformance cases of the SIMD kernels in
+# wasm_simd.h that wasm_simd_test checks both kernel tables against:
+#
+#     python3 simd_cases.py > simd_cases.txt
+#
+# Every instruction that lowers to a kernel (an `OP_V128_*` in
+# wasm_interpreter.h) is run by node's WebAssembly on the same operands, a
+# mix of random bytes, float specials, integer edges and shift counts past
+# the lane width, and its result is written next to the operands.
+
+import os
+import random
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+
+NUM_VECTORS = 20
+SHIFTS = [0, 1, 3, 7, 8, 15, 16, 31, 32, 33, 63, 64, 65, 127, -1, 200]
+OUT = 0x1000  # where a function leaves its result
+
+
+def uleb(n):
+    out = bytearray()
+    while True:
+        byte = n & 0x7F
+        n >>= 7
+        out.append(byte | (0x80 if n else 0))
+        if not n:
+            return bytes(out)
+
+
+def sleb(n):
+    out = bytearray()
+    while True:
+        byte = n & 0x7F
+        n >>= 7
+        done = (n == 0 and not byte & 0x40) or (n == -1 and byte & 0x40)
+        out.append(byte | (0 if done else 0x80))
+        if done:
+            return bytes(out)
+
+
+def section(id, contents):
+    return bytes([id]) + uleb(len(contents)) + contents
+
+
+def vec(items):
+    return uleb(len(items)) + b"".join(items)
+
+
+def name(s):
+    return uleb(len(s)) + s
+
+
+def vectors(rng):
+    f32 = [0.0, -0.0, 1.5, -2.5, float("inf"), float("-inf"), float("nan"), 3e38, -3e38, 2147483648.0,
+           -2147483904.0, 4294967296.0, 0.5, -0.5, 2.5, 1e-45]
+    f64 = [0.0, -0.0, 1.5, -2.5, float("inf"), float("-inf"), float("nan"), 1e300, 2147483647.5,
+           -2147483648.9, 4294967295.5, -1.0, 0.5, 2.5]
+    i32 = [0, 1, -1, 0x7F, 0x80, 0xFF, 0x7FFF, 0x8000, 0xFFFF, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF]
+    i16 = [0, 1, 0x7F, 0x80, 0xFF, 0x7FFF, 0x8000, 0xFFFF, 0x100, 0xFF80]
+    out = []
+    for i in range(NUM_VECTORS):
+        r = i % 5
+        if r == 0:
+            out.append(bytes(rng.getrandbits(8) for _ in range(16)))
+        elif r == 1:
+            out.append(b"".join(struct.pack("<f", rng.choice(f32)) for _ in range(4)))
+        elif r == 2:
+            out.append(b"".join(struct.pack("<d", rng.choice(f64)) for _ in range(2)))
+        elif r == 3:
+            out.append(b"".join(struct.pack("<I", rng.choice(i32) & 0xFFFFFFFF) for _ in range(4)))
+        else:
+            out.append(b"".join(struct.pack("<H", rng.choice(i16)) for _ in range(8)))
+    return out
+
+
+# (kind, num, name) of every instruction that runs as a kernel
+def kernels():
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "wasm_interpreter.h")
+    found = re.findall(r"void visit_(\w+)\(\) \{ emit\(OP_V128_(\w+), (\d+)\); \}", open(path).read())
+    return [(kind.lower(), int(num), name) for name, kind, num in found]
+
+
+# The lanes a result is compared by: float lanes equal any NaN where the
+# expected lane is a NaN, as WASM leaves the NaN bits to the engine
+def lanes(kind, name):
+    if kind == "test" or re.search(r"(Eq|Ne|Lt|Gt|Le|Ge)$", name):
+        return "int"
+    if name.startswith("F32x4"):
+        return "f32"
+    if name.startswith("F64x2"):
+        return "f64"
+    return "int"
+
+
+def body(kind, num, name):
+    def fd(n): return b"\xfd" + uleb(n)
+    def get(k): return b"\x20" + uleb(k)
+    load, store = fd(0) + b"\x00\x00", fd(11) + b"\x00\x00"
+    out = b"\x41" + sleb(OUT)
+    if kind == "unary" and 15 <= num <= 20:  # splats take the scalar at the start of the vector
+        scalar = {15: b"\x28\x02", 16: b"\x28\x02", 17: b"\x28\x02", 18: b"\x29\x03", 19: b"\x2a\x02", 20: b"\x2b\x03"}
+        return out + get(0) + scalar[num] + b"\x00" + fd(num) + store
+    if kind == "unary":
+        return out + get(0) + load + fd(num) + store
+    if kind == "binary":
+        return out + get(0) + load + get(1) + load + fd(num) + store
+    if kind == "ternary":
+        return out + get(0) + load + get(1) + load + get(2) + load + fd(num) + store
+    if kind == "test":
+        return out + get(0) + load + fd(num) + b"\x36\x02\x00"
+    if kind == "shift":
+        return out + get(0) + load + get(3) + b"\x28\x02\x00" + fd(num) + store
+    raise ValueError(kind)
+
+
+def module(funcs, data):
+    I32 = 0x7F
+    out = b"\0asm\x01\0\0\0"
+    out += section(1, vec([b"\x60" + vec([bytes([I32])] * 4) + b"\x00"]))
+    out += section(3, vec([b"\x00"] * len(funcs)))
+    out += section(5, vec([b"\x00\x01"]))
+    exports = [name(b"memory") + b"\x02\x00"] + [name(b"f%d" % i) + b"\x00" + uleb(i) for i in range(len(funcs))]
+    out += section(7, vec(exports))
+    codes = []
+    for f in funcs:
+        entry = b"\x00" + f + b"\x0b"
+        codes.append(uleb(len(entry)) + entry)
+    out += section(10, vec(codes))
+    out += section(11, vec([b"\x00\x41\x00\x0b" + uleb(len(data)) + data]))
+    return out
+
+
+RUN_JS = """
+const fs = require("fs");
+const [wasm, n, args] = process.argv.slice(2);
+const inst = new WebAssembly.Instance(new WebAssembly.Module(fs.readFileSync(wasm)), {});
+const mem = new Uint8Array(inst.exports.memory.buffer);
+const out = [];
+for (let i = 0; i < Number(n); i++) {
+    for (const a of JSON.parse(args)) {
+        mem.fill(0, %d, %d);
+        inst.exports["f" + i](...a);
+        out.push(Buffer.from(mem.slice(%d, %d)).toString("hex"));
+    }
+}
+console.log(out.join("\\n"));
+""" % (OUT, OUT + 16, OUT, OUT + 16)
+
+
+def main():
+    rng = random.Random(5)
+    vs = vectors(rng)
+    shift_base = 16 * len(vs)
+    data = b"".join(vs) + b"".join(struct.pack("<i", s) for s in SHIFTS)
+    ks = kernels()
+    # operands by index: vectors a, b, c and shift count k
+    cases = [(k, (7 * k + 3) % len(vs), (5 * k + 1) % len(vs), k % len(SHIFTS)) for k in range(len(vs))]
+    args = "[%s]" % ",".join("[%d,%d,%d,%d]" % (16 * a, 16 * b, 16 * c, shift_base + 4 * s) for a, b, c, s in cases)
+    with tempfile.TemporaryDirectory() as tmp:
+        wasm = os.path.join(tmp, "simd.wasm")
+        js = os.path.join(tmp, "run.js")
+        with open(wasm, "wb") as f:
+            f.write(module([body(*k) for k in ks], data))
+        with open(js, "w") as f:
+            f.write(RUN_JS)
+        results = subprocess.run(["node", js, wasm, str(len(ks)), args], capture_output=True, text=True,
+                                 check=True).stdout.split()
+    print("# Generated by simd_cases.py from node %s; checked by wasm_simd_test.cpp."
+          % subprocess.run(["node", "--version"], capture_output=True, text=True).stdout.strip())
+    print("# v <operand vector>, s <shift count>, then one case per line:")
+    print("# <kernel> <num> <name> <lanes> <a> <b> <c> <k> <expected result>")
+    for v in vs:
+        print("v", v.hex())
+    for s in SHIFTS:
+        print("s", s)
+    r = iter(results)
+    for kind, num, name in ks:
+        for a, b, c, s in cases:
+            print(kind, num, name, lanes(kind, name), a, b, c, s, next(r))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
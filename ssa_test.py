@@ -0,0 +1,222 @@
+# Differential test of `wasm_optimize --ssa`: every function must return the
+# same results through wasm_interpreter before and after the SSA round trip.
+#
+#     g++ -std=c++17 -O2 wasm_optimize.cpp -o wasm_optimize
+#     g++ -std=c++17 -O2 wasm_interpreter.cpp -o wasm_interpreter -lpthread
+#     python3 ssa_test.py [num_seeds]
+#
+# The modules are built here: a few hand-written loops that leave through a
+# `br_if` before they first read a local they go on to write, and random
+# structured functions of nested block, loop and if with branches to any
+# label, whose loops all draw on one counter so that they terminate.
+
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+I32 = 0x7F
+
+
+def uleb(n):
+    out = bytearray()
+    while True:
+        byte = n & 0x7F
+        n >>= 7
+        out.append(byte | (0x80 if n else 0))
+        if not n:
+            return bytes(out)
+
+
+def sleb(n):
+    out = bytearray()
+    while True:
+        byte = n & 0x7F
+        n >>= 7
+        done = (n == 0 and not byte & 0x40) or (n == -1 and byte & 0x40)
+        out.append(byte | (0 if done else 0x80))
+        if done:
+            return bytes(out)
+
+
+def section(id, contents):
+    return bytes([id]) + uleb(len(contents)) + contents
+
+
+def vec(items):
+    return uleb(len(items)) + b"".join(items)
+
+
+def name(s):
+    return uleb(len(s)) + s
+
+
+# A module of functions (num_params, num_locals, body) of i32 params and
+# locals returning one i32, exported as f0, f1, ...
+def module(funcs):
+    types = sorted({n for n, _, _ in funcs})
+    out = b"\0asm\x01\0\0\0"
+    out += section(1, vec([b"\x60" + vec([bytes([I32])] * n) + b"\x01" + bytes([I32]) for n in types]))
+    out += section(3, vec([uleb(types.index(n)) for n, _, _ in funcs]))
+    out += section(7, vec([name(b"f%d" % i) + b"\x00" + uleb(i) for i in range(len(funcs))]))
+    codes = []
+    for _, num_locals, body in funcs:
+        entry = (vec([uleb(num_locals) + bytes([I32])]) if num_locals else b"\x00") + body + b"\x0b"
+        codes.append(uleb(len(entry)) + entry)
+    out += section(10, vec(codes))
+    return out
+
+
+def local_get(k): return b"\x20" + uleb(k)
+def local_set(k): return b"\x21" + uleb(k)
+def local_tee(k): return b"\x22" + uleb(k)
+def i32_const(c): return b"\x41" + sleb(c)
+def br(label): return b"\x0c" + uleb(label)
+def br_if(label): return b"\x0d" + uleb(label)
+
+
+BLOCK, LOOP, IF, ELSE, END = b"\x02\x40", b"\x03\x40", b"\x04\x40", b"\x05", b"\x0b"
+ADD, SUB, MUL, AND, XOR = b"\x6a", b"\x6b", b"\x6c", b"\x71", b"\x73"
+GE_S, LE_S = b"\x4e", b"\x4c"
+
+
+# Sums 0..n-1; the exit comes before the sum is first read in the loop
+def loop_sum():
+    body = (BLOCK + LOOP +
+            local_get(1) + local_get(0) + GE_S + br_if(1) +
+            local_get(2) + local_get(1) + ADD + local_set(2) +
+            local_get(1) + i32_const(1) + ADD + local_set(1) +
+            br(0) + END + END +
+            local_get(2))
+    return (1, 2, body)
+
+
+# The same with the exit two loops deep, to a block around both
+def nested_exit():
+    body = (BLOCK + LOOP + LOOP +
+            local_get(1) + local_get(0) + GE_S + br_if(2) +
+            local_get(2) + local_get(1) + XOR + local_set(2) +
+            local_get(1) + i32_const(1) + ADD + local_set(1) +
+            local_get(1) + i32_const(3) + GE_S + br_if(1) +
+            br(0) + END +
+            local_get(2) + i32_const(5) + MUL + local_set(2) +
+            br(0) + END + END +
+            local_get(2) + local_get(1) + ADD)
+    return (1, 2, body)
+
+
+# A branch back to the outer loop from the inner one before the inner loop
+# first touches the local it then writes
+def outer_back_edge():
+    body = (BLOCK + LOOP +
+            local_get(0) + i32_const(1) + SUB + local_tee(0) + i32_const(0) + LE_S + br_if(1) +
+            LOOP +
+            local_get(0) + i32_const(1) + AND + br_if(1) +
+            local_get(1) + i32_const(7) + ADD + local_set(1) +
+            local_get(1) + i32_const(50) + GE_S + br_if(1) +
+            br(0) + END +
+            br(0) + END + END +
+            local_get(1))
+    return (1, 1, body)
+
+
+class RandomFunction:
+    NUM_PARAMS = 2
+    NUM_LOCALS = 4
+    FUEL = NUM_PARAMS + NUM_LOCALS  # the counter every loop draws on
+
+    def __init__(self, rng):
+        self.rng = rng
+        self.vars = self.NUM_PARAMS + self.NUM_LOCALS
+
+    def expr(self, depth):
+        r = self.rng.random()
+        if depth > 2 or r < 0.4:
+            return local_get(self.rng.randrange(self.vars))
+        if r < 0.55:
+            return i32_const(self.rng.randrange(-9, 10))
+        return self.expr(depth + 1) + self.expr(depth + 1) + self.rng.choice([ADD, SUB, MUL, XOR])
+
+    def cond(self):
+        return self.expr(1) + i32_const(self.rng.randrange(-5, 20)) + GE_S
+
+    # `labels` are the kinds of the enclosing frames, innermost last
+    def stmts(self, labels, depth):
+        out = b""
+        for _ in range(self.rng.randrange(1, 5)):
+            r = self.rng.random()
+            if depth > 3:
+                r = r * 0.5
+            if r < 0.35:
+                out += self.expr(0) + local_set(self.rng.randrange(self.vars))
+            elif r < 0.5 and labels:
+                out += self.cond() + br_if(self.rng.randrange(len(labels)))
+            elif r < 0.65:
+                out += BLOCK + self.stmts(labels + ["block"], depth + 1) + END
+            elif r < 0.8:
+                # leave the loop to the frame around it once the counter is spent
+                fuel = local_get(self.FUEL) + i32_const(1) + SUB + local_tee(self.FUEL)
+                guard = fuel + i32_const(0) + LE_S + br_if(1)
+                inner = labels + ["block", "loop"]
+                out += (BLOCK + LOOP + guard + self.stmts(inner, depth + 1) + self.cond() + br_if(0) +
+                        END + END)
+            else:
+                out += self.cond() + IF + self.stmts(labels + ["if"], depth + 1)
+                if self.rng.random() < 0.5:
+                    out += ELSE + self.stmts(labels + ["if"], depth + 1)
+                out += END
+        return out
+
+    def build(self):
+        body = i32_const(self.rng.randrange(5, 40)) + local_set(self.FUEL) + self.stmts(["block"], 0)
+        result = b""
+        for k in range(self.vars):
+            result += local_get(k) + (i32_const(31) + MUL + XOR if k else b"")
+        return (self.NUM_PARAMS, self.NUM_LOCALS + 1, BLOCK + body + END + result)
+
+
+def run(interpreter, path, index, args):
+    p = subprocess.run([interpreter, path, "f%d" % index] + [str(a) for a in args], capture_output=True, text=True)
+    return p.returncode, p.stdout.strip(), p.stderr.strip()
+
+
+def check(name, funcs, arg_sets, tmp):
+    original = os.path.join(tmp, name + ".wasm")
+    lowered = os.path.join(tmp, name + ".ssa.wasm")
+    with open(original, "wb") as f:
+        f.write(module(funcs))
+    p = subprocess.run(["./wasm_optimize", "--ssa", original, lowered], capture_output=True, text=True)
+    if p.returncode != 0:
+        print("%s: wasm_optimize failed: %s" % (name, p.stderr.strip()))
+        return False
+    ok = True
+    for i, (num_params, _, _) in enumerate(funcs):
+        for args in arg_sets:
+            expected = run("./wasm_interpreter", original, i, args[:num_params])
+            got = run("./wasm_interpreter", lowered, i, args[:num_params])
+            if expected != got:
+                print("%s: f%d%s returns %s, %s after --ssa" % (name, i, tuple(args[:num_params]), expected, got))
+                ok = False
+    return ok
+
+
+def main():
+    num_seeds = int(sys.argv[1]) if len(sys.argv) > 1 else 20
+    failed = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        arg_sets = [[n, 2 * n - 3] for n in range(-1, 8)]
+        if not check("loops", [loop_sum(), nested_exit(), outer_back_edge()], arg_sets, tmp):
+            failed += 1
+        for seed in range(num_seeds):
+            rng = random.Random(seed)
+            funcs = [RandomFunction(rng).build() for _ in range(8)]
+            args = [[rng.randrange(-20, 20), rng.randrange(-20, 20)] for _ in range(3)]
+            if not check("seed%d" % seed, funcs, args, tmp):
+                failed += 1
+    print("%d of %d modules differ" % (failed, num_seeds + 1))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
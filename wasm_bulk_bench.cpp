@@ -0,0 +1,158 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "wasm_assembler.h"
+#include "wasm_decoder.h"
+#include "wasm_interpreter.h"
+
+using namespace LFortran;
+
+static void emit_section(WASMAssembler& wasm, uint32_t id, const std::vector<uint8_t>& contents) {
+    wasm.emit_u32(id);
+    wasm.emit_u32(contents.size());
+    wasm.emit_bytes(contents.data(), contents.size());
+}
+
+// A function (dst, src_or_value, n, count) that runs `op` on its first three
+// arguments `count` times
+static std::vector<uint8_t> repeat_body(const std::vector<uint8_t>& op) {
+    WASMAssembler f;
+    f.emit_u32(0);     // no locals
+    f.emit_b8(0x02);   // block
+    f.emit_b8(0x40);
+    f.emit_b8(0x03);   // loop
+    f.emit_b8(0x40);
+    f.emit_get_local(3);
+    f.emit_b8(0x45);   // i32.eqz
+    f.emit_b8(0x0D);   // br_if 1
+    f.emit_u32(1);
+    f.emit_get_local(0);
+    f.emit_get_local(1);
+    f.emit_get_local(2);
+    f.emit_bytes(op.data(), op.size());
+    f.emit_get_local(3);
+    f.emit_i32_const(1);
+    f.emit_b8(0x6B);   // i32.sub
+    f.emit_set_local(3);
+    f.emit_b8(0x0C);   // br 0
+    f.emit_u32(0);
+    f.emit_end();
+    f.emit_end();
+    f.emit_end();
+    return f.code;
+}
+
+// A module with a memory of `pages` pages that exports fill and copy
+static std::vector<uint8_t> bench_module(uint32_t pages) {
+    WASMAssembler wasm;
+    wasm.emit_header();
+    emit_section(wasm, 1, {1, 0x60, 4, wasm.i32, wasm.i32, wasm.i32, wasm.i32, 0});
+    emit_section(wasm, 3, {2, 0, 0});
+    WASMAssembler memory;
+    memory.emit_u32(1);
+    memory.emit_b8(0x01);  // min and max
+    memory.emit_u32(pages);
+    memory.emit_u32(pages);
+    emit_section(wasm, 5, memory.code);
+    emit_section(wasm, 7, {2, 4, 'f', 'i', 'l', 'l', 0, 0, 4, 'c', 'o', 'p', 'y', 0, 1});
+    WASMAssembler code;
+    code.emit_u32(2);
+    for (const std::vector<uint8_t>& op : {std::vector<uint8_t>{0xFC, 11, 0}, std::vector<uint8_t>{0xFC, 10, 0, 0}}) {
+        std::vector<uint8_t> body = repeat_body(op);
+        code.emit_u32(body.size());
+        code.emit_bytes(body.data(), body.size());
+    }
+    emit_section(wasm, 10, code.code);
+    return wasm.code;
+}
+
+// Times memory.fill and memory.copy as the interpreter runs them, from 16 B
+// up to --max bytes (1 GiB by default) in steps of 4x, next to libc's
+// memset and memmove on the same guest memory. Every size repeats the
+// instruction until about --bytes (256 MiB) have been written, so the small
+// sizes measure the cost of the instruction and the large ones bandwidth;
+// the best of --runs runs is reported.
+int main(int argc, char** argv) {
+    uint64_t max_size = 1ULL << 30;
+    uint64_t budget = 256ULL << 20;
+    int runs = 3;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--max=", 0) == 0) {
+            max_size = std::stoull(arg.substr(6));
+        } else if (arg.rfind("--bytes=", 0) == 0) {
+            budget = std::stoull(arg.substr(8));
+        } else if (arg.rfind("--runs=", 0) == 0) {
+            runs = std::stoi(arg.substr(7));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--max=BYTES] [--bytes=BYTES] [--runs=N]" << std::endl;
+            return 1;
+        }
+    }
+    if (max_size < 16 || max_size > (1ULL << 31) - 65536) {
+        std::cerr << "--max must be between 16 and 2 GiB - 64 KiB" << std::endl;
+        return 1;
+    }
+    // the source of a copy right after its destination, both page aligned
+    uint64_t half = (max_size + 65535) & ~65535ULL;
+    wasm_bytes = bench_module((uint32_t)(2 * half / 65536));
+    decode_wasm();
+    Interpreter interp;
+    interp.compile_all();
+    uint32_t fill = Interpreter::find_export("fill"), copy = Interpreter::find_export("copy");
+    uint8_t* mem = interp.memory->base;
+
+    auto best_of = [&](auto body) {
+        double best = 1e300;
+        for (int run = 0; run < runs; run++) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+            best = std::min(best, took.count());
+        }
+        return best;
+    };
+    auto args = [](uint64_t a, uint64_t b, uint64_t n, uint64_t count) {
+        std::vector<Value> v(4);
+        v[0].i32 = (uint32_t)a;
+        v[1].i32 = (uint32_t)b;
+        v[2].i32 = (uint32_t)n;
+        v[3].i32 = (uint32_t)count;
+        return v;
+    };
+
+    // touch every page once, so that no run pays for faulting them in
+    std::memset(mem, 1, 2 * half);
+    std::cout << "      size  fill GB/s  memset GB/s  copy GB/s  memmove GB/s" << std::endl;
+    try {
+        for (uint64_t n = 16; n <= max_size; n *= 4) {
+            uint64_t count = std::max<uint64_t>(1, budget / n);
+            double bytes = (double)n * count;
+            double t_fill = best_of([&] { interp.invoke(fill, args(0, 0, n, count)); });
+            double t_memset = best_of([&] {
+                for (uint64_t i = 0; i < count; i++) {
+                    std::memset(mem, (int)i, n);
+                }
+            });
+            double t_copy = best_of([&] { interp.invoke(copy, args(0, half, n, count)); });
+            double t_memmove = best_of([&] {
+                for (uint64_t i = 0; i < count; i++) {
+                    std::memmove(mem, mem + half, n);
+                }
+            });
+            char line[100];
+            std::snprintf(line, sizeof(line), "%10llu %10.2f %12.2f %10.2f %13.2f", (unsigned long long)n,
+                          bytes / t_fill / 1e9, bytes / t_memset / 1e9, bytes / t_copy / 1e9,
+                          bytes / t_memmove / 1e9);
+            std::cout << line << std::endl;
+        }
+    } catch (const std::string& e) {
+        std::cerr << e << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef LFORTRAN_WASM_BULK_MEMORY_H
+#define LFORTRAN_WASM_BULK_MEMORY_H
+
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+
+// The AVX2 fill is only built for x86; elsewhere every fill is a memset
+#if defined(__x86_64__) || defined(__i386__)
+#define WASM_BULK_AVX2
+#include <immintrin.h>
+#endif
+
+// Kernels behind memory.copy, memory.fill and memory.init. The callers check
+// the bounds of the whole range once, the kernels never look at the memory
+// size.
+
+// Fills at least this many bytes with non-temporal stores: a fill that large
+// does not stay in the cache anyway, so writing around the cache avoids
+// evicting the working set and the read-for-ownership traffic. memset keeps
+// its lead up to about half the last level cache (wasm_bulk_bench.cpp), so
+// that is the threshold where the cache size is known.
+inline size_t bulk_non_temporal_threshold() {
+    static const size_t threshold = [] {
+        size_t fallback = 4U << 20;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+        long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        if (l3 > 0 && (size_t)l3 / 2 > fallback) {
+            return (size_t)l3 / 2;
+        }
+#endif
+        return fallback;
+    }();
+    return threshold;
+}
+
+#ifdef WASM_BULK_AVX2
+__attribute__((target("avx2"))) inline void bulk_fill_avx2(uint8_t* dst, uint8_t val, size_t n) {
+    __m256i v = _mm256_set1_epi8((char)val);
+    // align the destination to 32 bytes for the streaming stores
+    size_t head = (32 - ((uintptr_t)dst & 31)) & 31;
+    std::memset(dst, val, head);
+    dst += head;
+    n -= head;
+    for (; n >= 128; n -= 128, dst += 128) {
+        _mm256_stream_si256((__m256i*)dst, v);
+        _mm256_stream_si256((__m256i*)(dst + 32), v);
+        _mm256_stream_si256((__m256i*)(dst + 64), v);
+        _mm256_stream_si256((__m256i*)(dst + 96), v);
+    }
+    _mm_sfence();
+    std::memset(dst, val, n);
+}
+#endif
+
+inline void bulk_fill(uint8_t* dst, uint8_t val, size_t n) {
+#ifdef WASM_BULK_AVX2
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (n >= bulk_non_temporal_threshold() && has_avx2) {
+        bulk_fill_avx2(dst, val, n);
+        return;
+    }
+#endif
+    // libc's memset already dispatches to the widest vector stores
+    std::memset(dst, val, n);
+}
+
+// memmove handles overlapping ranges in either direction with vector loads
+// and stores and switches to non-temporal stores for copies beyond the cache
+// size by itself.
+inline void bulk_copy(uint8_t* dst, const uint8_t* src, size_t n) { std::memmove(dst, src, n); }
+
+#endif  // LFORTRAN_WASM_BULK_MEMORY_H
@@ -0,0 +1,145 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "wasm_assembler.h"
+#include "wasm_decoder.h"
+#include "wasm_interpreter.h"
+
+using namespace LFortran;
+
+static void emit_section(WASMAssembler& wasm, uint32_t id, const std::vector<uint8_t>& contents) {
+    wasm.emit_u32(id);
+    wasm.emit_u32(contents.size());
+    wasm.emit_bytes(contents.data(), contents.size());
+}
+
+// A function (n) that calls a function of the table `n` times, by `call`
+// with the argument and the table index on the stack, and returns the sum
+// of the results
+static std::vector<uint8_t> loop_body(const std::vector<uint8_t>& index, const std::vector<uint8_t>& call) {
+    WASMAssembler f;
+    f.emit_u32(1);     // one i32 local: the sum
+    f.emit_u32(1);
+    f.emit_b8(f.i32);
+    f.emit_b8(0x02);   // block
+    f.emit_b8(0x40);
+    f.emit_b8(0x03);   // loop
+    f.emit_b8(0x40);
+    f.emit_get_local(0);
+    f.emit_b8(0x45);   // i32.eqz
+    f.emit_b8(0x0D);   // br_if 1
+    f.emit_u32(1);
+    f.emit_get_local(1);
+    f.emit_bytes(index.data(), index.size());
+    f.emit_bytes(call.data(), call.size());
+    f.emit_set_local(1);
+    f.emit_get_local(0);
+    f.emit_i32_const(1);
+    f.emit_b8(0x6B);   // i32.sub
+    f.emit_set_local(0);
+    f.emit_b8(0x0C);   // br 0
+    f.emit_u32(0);
+    f.emit_end();
+    f.emit_end();
+    f.emit_get_local(1);
+    f.emit_end();
+    return f.code;
+}
+
+// f0(x) = x + 1 and f1(x) = x + 2, both in a table, and the loops that call
+// them: `direct` by call, `mono` by call_indirect on f0 alone and `poly` by
+// call_indirect on f0 and f1 in turn
+static std::vector<uint8_t> bench_module() {
+    WASMAssembler wasm;
+    wasm.emit_header();
+    emit_section(wasm, 1, {1, 0x60, 1, wasm.i32, 1, wasm.i32});
+    emit_section(wasm, 3, {5, 0, 0, 0, 0, 0});
+    emit_section(wasm, 4, {1, 0x70, 0x00, 2});
+    emit_section(wasm, 7, {3, 6, 'd', 'i', 'r', 'e', 'c', 't', 0, 2, 4, 'm', 'o', 'n', 'o', 0, 3,
+                           4, 'p', 'o', 'l', 'y', 0, 4});
+    emit_section(wasm, 9, {1, 0, 0x41, 0, 0x0B, 2, 0, 1});
+    WASMAssembler code;
+    code.emit_u32(5);
+    std::vector<std::vector<uint8_t>> bodies;
+    for (uint8_t k = 1; k <= 2; k++) {
+        WASMAssembler f;
+        f.emit_u32(0);
+        f.emit_get_local(0);
+        f.emit_i32_const(k);
+        f.emit_b8(0x6A);  // i32.add
+        f.emit_end();
+        bodies.push_back(f.code);
+    }
+    std::vector<uint8_t> call_indirect = {0x11, 0, 0};
+    bodies.push_back(loop_body({}, {0x10, 0}));
+    bodies.push_back(loop_body({0x41, 0}, call_indirect));
+    // local 0 & 1: the two targets alternate
+    bodies.push_back(loop_body({0x20, 0, 0x41, 1, 0x71}, call_indirect));
+    for (const std::vector<uint8_t>& body : bodies) {
+        code.emit_u32(body.size());
+        code.emit_bytes(body.data(), body.size());
+    }
+    emit_section(wasm, 10, code.code);
+    return wasm.code;
+}
+
+// Times call_indirect with the call caches of the interpreter and without
+// them, where every call compares the signatures, on a site that always
+// calls the same function and on one that alternates between two, next to
+// a direct call. Every loop makes --calls calls (10M by default); the best
+// of --runs runs is reported in nanoseconds per call, loop included.
+int main(int argc, char** argv) {
+    uint32_t calls = 10000000;
+    int runs = 5;
+    bool threaded = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--calls=", 0) == 0) {
+            calls = std::stoul(arg.substr(8));
+        } else if (arg.rfind("--runs=", 0) == 0) {
+            runs = std::stoi(arg.substr(7));
+        } else if (arg == "--threaded") {
+            threaded = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--calls=N] [--runs=N] [--threaded]" << std::endl;
+            return 1;
+        }
+    }
+    wasm_bytes = bench_module();
+    decode_wasm();
+
+    auto time_export = [&](bool caches, const char* name) {
+        Interpreter interp;
+        interp.use_threaded_dispatch(threaded);
+        interp.use_call_caches(caches);
+        interp.compile_all();
+        uint32_t func = Interpreter::find_export(name);
+        std::vector<Value> args(1);
+        args[0].i32 = calls;
+        double best = 1e300;
+        for (int run = 0; run < runs; run++) {
+            auto start = std::chrono::steady_clock::now();
+            interp.invoke(func, args);
+            std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+            best = std::min(best, took.count() / calls);
+        }
+        return best;
+    };
+
+    try {
+        std::cout << "site       cached ns  uncached ns" << std::endl;
+        for (const char* name : {"direct", "mono", "poly"}) {
+            char line[80];
+            std::snprintf(line, sizeof(line), "%-8s %11.2f %12.2f", name, time_export(true, name),
+                          time_export(false, name));
+            std::cout << line << std::endl;
+        }
+    } catch (const std::string& e) {
+        std::cerr << e << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,316 @@
+#ifndef LFORTRAN_WASM_COALESCE_H
+#define LFORTRAN_WASM_COALESCE_H
+
+#include <algorithm>
+#include "wasm_optimizer.h"
+
+namespace LFortran {
+
+struct CoalesceStats {
+    uint64_t locals_before = 0;  // declared ones, the params are never merged
+    uint64_t locals_after = 0;
+    uint64_t runs_before = 0;  // entries of the local declarations
+    uint64_t runs_after = 0;
+};
+
+// Merges the locals of a function that are never live at the same time and
+// have the same type, so that a body declaring one local per temporary gets
+// a frame of the size it needs.
+//
+// Liveness is solved over the basic blocks of the body, where every control
+// instruction is a block of its own and branches go to the `end` of their
+// block or to their loop. Two locals interfere if one is written while the
+// other is live. On entry the params hold the arguments and the declared
+// locals zero, so those of them that are live there interfere with each
+// other. The locals are then merged greedily in declaration order, into the
+// lowest slot of their type, params included, that holds nothing they
+// interfere with.
+class LocalCoalescer {
+   public:
+    LocalCoalescer(CoalesceStats& stats) : stats(stats) {}
+
+    // The body of codes[index] with its locals renumbered, without the final
+    // `end`; sets `new_locals` to their declarations
+    std::vector<uint8_t> coalesce(uint32_t index, std::vector<Local>& new_locals) {
+        BodySplitter s;
+        s.split(index);
+        insts = std::move(s.insts);
+        const FuncType& type = func_types[type_indices[index]];
+        params = type.param_types.size();
+        types = type.param_types;
+        for (const Local& l : codes[index].locals) {
+            types.insert(types.end(), l.count, l.type);
+        }
+        words = (types.size() + 63) / 64;
+
+        find_blocks();
+        solve_liveness();
+        build_interference();
+        std::vector<uint32_t> new_index = assign_slots(new_locals);
+
+        stats.locals_before += types.size() - params;
+        stats.runs_before += codes[index].locals.size();
+        stats.runs_after += new_locals.size();
+        WASMAssembler body;
+        for (const BodySplitter::Instr& i : insts) {
+            if (is_local(i.op)) {
+                body.emit_b8(i.op);
+                body.emit_u32(new_index[i.index]);
+            } else {
+                body.emit_bytes(wasm_bytes.data() + i.start, i.size);
+            }
+        }
+        return body.code;
+    }
+
+   private:
+    typedef std::vector<uint64_t> Bits;
+
+    struct Block {
+        uint32_t first, last;         // instructions
+        std::vector<uint32_t> succs;  // blocks, the exit has none
+        Bits gen, kill, live_in, live_out;
+    };
+
+    static constexpr uint32_t EXIT = ~0U;
+
+    CoalesceStats& stats;
+    std::vector<BodySplitter::Instr> insts;
+    uint32_t params;
+    std::vector<uint8_t> types;  // of the params and the declared locals
+    size_t words;                // per set of locals
+    std::vector<Block> blocks;
+    std::vector<uint32_t> block_of;  // by instruction
+    std::vector<Bits> interferes;    // by local
+
+    static bool is_local(uint8_t op) { return op >= 0x20 && op <= 0x22; }
+
+    static bool is_control(uint8_t op) { return op <= 0x05 || (op >= 0x0B && op <= 0x0F); }
+
+    static bool test(const Bits& b, uint32_t i) { return (b[i / 64] >> (i % 64)) & 1; }
+
+    static void set(Bits& b, uint32_t i) { b[i / 64] |= (uint64_t)1 << (i % 64); }
+
+    static void reset(Bits& b, uint32_t i) { b[i / 64] &= ~((uint64_t)1 << (i % 64)); }
+
+    uint32_t block_at(uint32_t inst) const { return inst < insts.size() ? block_of[inst] : EXIT; }
+
+    void find_blocks() {
+        uint32_t n = insts.size();
+        blocks.clear();
+        block_of.assign(n, 0);
+        for (uint32_t i = 0; i < n; i++) {
+            bool leader = i == 0 || is_control(insts[i].op) || is_control(insts[i - 1].op);
+            if (leader) {
+                blocks.push_back({i, i, {}, Bits(words), Bits(words), Bits(words), Bits(words)});
+            }
+            blocks.back().last = i;
+            block_of[i] = blocks.size() - 1;
+        }
+
+        // the `end` of every block, loop and if, and the `else` of an if
+        std::vector<uint32_t> match(n, EXIT), else_of(n, EXIT), open;
+        for (uint32_t i = 0; i < n; i++) {
+            uint8_t op = insts[i].op;
+            if (op >= 0x02 && op <= 0x04) {
+                open.push_back(i);
+            } else if (op == 0x05) {
+                else_of[open.back()] = i;
+            } else if (op == 0x0B) {
+                match[open.back()] = i;
+                if (else_of[open.back()] != EXIT) {
+                    match[else_of[open.back()]] = i;
+                }
+                open.pop_back();
+            }
+        }
+
+        // where a branch to label `depth` goes from inside `open`
+        auto target = [&](uint32_t depth) {
+            if (depth >= open.size()) {
+                return EXIT;  // the function's own label
+            }
+            uint32_t start = open[open.size() - 1 - depth];
+            return block_at(insts[start].op == 0x03 ? start : match[start]);
+        };
+        for (uint32_t i = 0; i < n; i++) {
+            const BodySplitter::Instr& inst = insts[i];
+            Block& b = blocks[block_of[i]];
+            if (b.last != i) {
+                continue;
+            }
+            uint32_t offset = inst.start + 1;
+            switch (inst.op) {
+                case 0x00:  // unreachable
+                case 0x0F:  // return
+                    break;
+                case 0x04: {  // if
+                    b.succs.push_back(block_at(i + 1));
+                    b.succs.push_back(else_of[i] != EXIT ? block_at(else_of[i] + 1) : block_at(match[i]));
+                    break;
+                }
+                case 0x05: b.succs.push_back(block_at(match[i])); break;
+                case 0x0C: b.succs.push_back(target(read_unsigned_num(offset))); break;
+                case 0x0D:
+                    b.succs.push_back(block_at(i + 1));
+                    b.succs.push_back(target(read_unsigned_num(offset)));
+                    break;
+                case 0x0E: {  // br_table
+                    for (uint32_t l : read_u32_vector(offset)) {
+                        b.succs.push_back(target(l));
+                    }
+                    b.succs.push_back(target(read_unsigned_num(offset)));
+                    break;
+                }
+                default: b.succs.push_back(block_at(i + 1)); break;
+            }
+            if (inst.op >= 0x02 && inst.op <= 0x04) {
+                open.push_back(i);
+            } else if (inst.op == 0x0B) {
+                open.pop_back();
+            }
+            b.succs.erase(std::remove(b.succs.begin(), b.succs.end(), EXIT), b.succs.end());
+        }
+    }
+
+    void solve_liveness() {
+        for (Block& b : blocks) {
+            for (uint32_t i = b.first; i <= b.last; i++) {
+                const BodySplitter::Instr& inst = insts[i];
+                if (inst.op == 0x20 && !test(b.kill, inst.index)) {
+                    set(b.gen, inst.index);
+                } else if (inst.op == 0x21 || inst.op == 0x22) {
+                    set(b.kill, inst.index);
+                }
+            }
+        }
+        // backwards, so that most blocks see their successors' final sets
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t k = blocks.size(); k-- > 0;) {
+                Block& b = blocks[k];
+                for (uint32_t s : b.succs) {
+                    for (size_t w = 0; w < words; w++) {
+                        b.live_out[w] |= blocks[s].live_in[w];
+                    }
+                }
+                for (size_t w = 0; w < words; w++) {
+                    uint64_t in = b.gen[w] | (b.live_out[w] & ~b.kill[w]);
+                    if (in != b.live_in[w]) {
+                        b.live_in[w] = in;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    void build_interference() {
+        interferes.assign(types.size(), Bits(words));
+        Bits live(words);
+        for (const Block& b : blocks) {
+            live = b.live_out;
+            for (uint32_t i = b.last + 1; i-- > b.first;) {
+                const BodySplitter::Instr& inst = insts[i];
+                if (inst.op == 0x21 || inst.op == 0x22) {
+                    for (size_t w = 0; w < words; w++) {
+                        interferes[inst.index][w] |= live[w];
+                    }
+                    reset(live, inst.index);
+                } else if (inst.op == 0x20) {
+                    set(live, inst.index);
+                }
+            }
+        }
+        Bits entry = blocks.empty() ? Bits(words) : blocks[0].live_in;
+        for (uint32_t v = 0; v < types.size(); v++) {
+            if (v < params || test(entry, v)) {
+                for (size_t w = 0; w < words; w++) {
+                    interferes[v][w] |= entry[w];
+                }
+            }
+        }
+        for (uint32_t v = 0; v < types.size(); v++) {
+            reset(interferes[v], v);
+            for (uint32_t u = 0; u < types.size(); u++) {
+                if (test(interferes[v], u)) {
+                    set(interferes[u], v);
+                }
+            }
+        }
+    }
+
+    // The new index of every local, params stay where they are and the
+    // other slots are grouped by type
+    std::vector<uint32_t> assign_slots(std::vector<Local>& new_locals) {
+        std::vector<Bits> members;
+        std::vector<uint8_t> slot_types;
+        std::vector<uint32_t> slot_of(types.size());
+        for (uint32_t v = 0; v < types.size(); v++) {
+            uint32_t slot = v < params ? v : (uint32_t)members.size();
+            for (uint32_t k = 0; v >= params && k < members.size(); k++) {
+                if (slot_types[k] != types[v]) {
+                    continue;
+                }
+                bool free = true;
+                for (size_t w = 0; w < words && free; w++) {
+                    free = !(members[k][w] & interferes[v][w]);
+                }
+                if (free) {
+                    slot = k;
+                    break;
+                }
+            }
+            if (slot == members.size()) {
+                members.push_back(Bits(words));
+                slot_types.push_back(types[v]);
+            }
+            set(members[slot], v);
+            slot_of[v] = slot;
+        }
+
+        std::vector<uint32_t> order;
+        for (uint32_t k = params; k < members.size(); k++) {
+            order.push_back(k);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return slot_types[a] > slot_types[b]; });
+        std::vector<uint32_t> new_slot(members.size());
+        for (uint32_t k = 0; k < params; k++) {
+            new_slot[k] = k;
+        }
+        new_locals.clear();
+        for (uint32_t k = 0; k < order.size(); k++) {
+            new_slot[order[k]] = params + k;
+            if (new_locals.empty() || new_locals.back().type != slot_types[order[k]]) {
+                new_locals.push_back({0, slot_types[order[k]]});
+            }
+            new_locals.back().count++;
+        }
+        stats.locals_after += order.size();
+
+        std::vector<uint32_t> new_index(types.size());
+        for (uint32_t v = 0; v < types.size(); v++) {
+            new_index[v] = new_slot[slot_of[v]];
+        }
+        return new_index;
+    }
+};
+
+// Coalesces the locals of every function of the decoded module and returns
+// the rewritten module
+std::vector<uint8_t> coalesce_locals(CoalesceStats& stats) {
+    LocalCoalescer c(stats);
+    WASMAssembler section;
+    section.emit_u32(codes.size());
+    for (uint32_t i = 0; i < codes.size(); i++) {
+        std::vector<Local> locals;
+        std::vector<uint8_t> insts = c.coalesce(i, locals);
+        emit_function_body(section, locals, insts);
+    }
+    return replace_code_section(section.code);
+}
+
+}  // namespace LFortran
+
+#endif  // LFORTRAN_WASM_COALESCE_H
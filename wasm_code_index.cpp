@@ -0,0 +1,55 @@
+#include <iostream>
+#include <string>
+
+#include "wasm_code_index.h"
+#include "wasm_to_wat.h"
+
+using namespace LFortran;
+
+// Prints code entry `i` through the index: where it is, its locals and its
+// WAT, or its bytes if the WAT printer lacks one of its instructions
+void show(CodeIndex& index, uint32_t i) {
+    const CodeIndex::Entry& e = index.entry(i);
+    Code code = index.load_function(i);
+    std::cout << "code entry " << i << " at " << e.offset << ": " << e.size << " bytes, " << e.num_locals
+              << " locals in " << e.num_runs << " declarations";
+    WASM_INSTS_VISITOR::WATVisitor v;
+    v.indent = "\n    ";
+    try {
+        v.decode_instructions(code.insts_start_index);
+        std::cout << v.src << std::endl;
+    } catch (const std::string&) {
+        char hex[4];
+        for (uint32_t k = code.insts_start_index; k < wasm_bytes.size(); k++) {
+            snprintf(hex, sizeof(hex), " %02x", wasm_bytes[k]);
+            std::cout << (k % 16 == code.insts_start_index % 16 ? "\n   " : "") << hex;
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Builds the code section index of a module, as a sidecar or embedded, and
+// prints functions through it
+int main(int argc, char** argv) {
+    std::string command = argc > 1 ? argv[1] : "";
+    bool embed = argc > 2 && std::string(argv[2]) == "--embed";
+    try {
+        if (command == "build" && argc == 3 + embed) {
+            CodeIndex::write(argv[2 + embed], embed);
+            return 0;
+        }
+        if (command == "show" && argc >= 4) {
+            CodeIndex index(argv[2]);
+            for (int i = 3; i < argc; i++) {
+                show(index, std::stoul(argv[i]));
+            }
+            return 0;
+        }
+    } catch (const std::string& e) {
+        std::cerr << e << std::endl;
+        return 1;
+    }
+    std::cerr << "Usage: " << argv[0] << " build [--embed] in.wasm" << std::endl;
+    std::cerr << "       " << argv[0] << " show in.wasm N..." << std::endl;
+    return 1;
+}
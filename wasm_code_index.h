@@ -0,0 +1,322 @@
+#ifndef LFORTRAN_WASM_CODE_INDEX_H
+#define LFORTRAN_WASM_CODE_INDEX_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "wasm_utils.h"
+
+namespace LFortran {
+
+// Where the code entry of every function is, how big it is and a summary of
+// its locals, so that a tool can go straight to function N of a module of
+// any size instead of walking the entries before it. The index is kept in a
+// sidecar file `<module>.cidx` or in a custom section `code.index` at the
+// end of the module, both holding
+//
+//     header | entries
+//
+// Opening an index checks it against the module by the module size, the
+// function count of the code section and a hash of the first and last bytes
+// of the section, and every entry is checked against the length in front of
+// it when used. Neither reads more than a few pages of the module.
+class CodeIndex {
+   public:
+    static const uint32_t VERSION = 1;
+    static constexpr uint64_t PROBE_BYTES = 4096;  // hashed at each end of the code section
+    static constexpr const char* SECTION_NAME = "code.index";
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t num_funcs;
+        uint64_t module_size;  // without the index section when it is embedded
+        uint64_t code_offset;  // the contents of the code section
+        uint64_t code_size;
+        uint64_t probe_hash;
+    };
+
+    struct Entry {
+        uint64_t offset;       // of the code entry, after its length
+        uint32_t size;         // of the code entry
+        uint32_t locals_size;  // bytes of its locals declaration, the instructions follow
+        uint32_t num_locals;   // declared, without the params
+        uint16_t num_runs;     // of locals of one type, at most 0xFFFF
+        uint8_t length_size;   // bytes of the length in front of the entry
+        uint8_t reserved;
+    };
+
+    // Indexes the module of `size` bytes at `module`, which is only walked
+    // once, and returns the header and entries
+    static std::vector<uint8_t> build(const uint8_t* module, uint64_t size) {
+        Header h = {};
+        std::memcpy(h.magic, "WASMCIDX", 8);
+        h.version = VERSION;
+        h.module_size = size;
+        std::vector<Entry> entries;
+        uint64_t offset = 8;
+        while (offset < size) {
+            uint64_t section_start = offset;
+            uint8_t id = module[offset++];
+            uint64_t section_size = leb(module, size, offset);
+            if (section_size > size - offset) {
+                throw LFortranException("CodeIndex: section out of bounds");
+            }
+            if (id == 0 && offset + section_size == size && is_index(module, offset, size)) {
+                h.module_size = section_start;  // an earlier index is left out
+                break;
+            }
+            if (id == 10) {
+                h.code_offset = offset;
+                h.code_size = section_size;
+                uint64_t entry = offset;
+                uint64_t n = leb(module, size, entry);
+                for (uint64_t i = 0; i < n; i++) {
+                    Entry e = {};
+                    uint64_t length = entry;
+                    e.size = leb(module, size, entry);
+                    e.offset = entry;
+                    e.length_size = entry - length;
+                    uint64_t runs = leb(module, size, entry);
+                    e.num_runs = std::min<uint64_t>(runs, 0xFFFF);
+                    for (uint64_t k = 0; k < runs; k++) {
+                        e.num_locals += leb(module, size, entry);
+                        entry++;  // the type
+                    }
+                    e.locals_size = entry - e.offset;
+                    if (e.size > offset + section_size - e.offset || e.locals_size > e.size) {
+                        throw LFortranException("CodeIndex: function body out of bounds");
+                    }
+                    entries.push_back(e);
+                    entry = e.offset + e.size;
+                }
+            }
+            offset += section_size;
+        }
+        h.num_funcs = entries.size();
+        h.probe_hash = probe_hash(module, h.code_offset, h.code_size);
+        std::vector<uint8_t> out;
+        ByteWriter w{out};
+        w.put(h);
+        w.put_vector(entries);
+        return out;
+    }
+
+    // The custom section holding the index `payload`, to be appended to the
+    // module it was built for
+    static std::vector<uint8_t> section(const std::vector<uint8_t>& payload) {
+        std::vector<uint8_t> contents;
+        contents.push_back(std::strlen(SECTION_NAME));
+        contents.insert(contents.end(), SECTION_NAME, SECTION_NAME + std::strlen(SECTION_NAME));
+        contents.insert(contents.end(), payload.begin(), payload.end());
+        std::vector<uint8_t> out = {0};
+        uint64_t n = contents.size();
+        do {
+            out.push_back((n & 0x7F) | (n >= 0x80 ? 0x80 : 0));
+            n >>= 7;
+        } while (n);
+        out.insert(out.end(), contents.begin(), contents.end());
+        return out;
+    }
+
+    // Maps the module at `path` and its index: the sidecar if there is one,
+    // else the section at its end. Throws if neither is there or matches.
+    explicit CodeIndex(const std::string& path) {
+        module = map(path, module_size);
+        if (!module) {
+            throw LFortranException("CodeIndex: cannot read " + path);
+        }
+        try {
+            uint64_t payload_size;
+            sidecar = map(path + ".cidx", sidecar_size);
+            if (sidecar) {
+                payload = sidecar;
+                payload_size = sidecar_size;
+            } else if (!find_section(payload, payload_size)) {
+                throw LFortranException("CodeIndex: " + path + " has no index");
+            }
+            ByteReader r{payload, payload_size, 0};
+            header = r.get<Header>();
+            if (std::memcmp(header.magic, "WASMCIDX", 8) != 0 || header.version != VERSION ||
+                r.get<uint64_t>() != header.num_funcs ||
+                payload_size - r.pos != (uint64_t)header.num_funcs * sizeof(Entry) || !matches()) {
+                throw LFortranException("CodeIndex: the index of " + path + " is stale");
+            }
+            entries = (const Entry*)(payload + r.pos);
+        } catch (const std::string&) {
+            unmap();
+            throw;
+        }
+    }
+
+    CodeIndex(const CodeIndex&) = delete;
+    CodeIndex& operator=(const CodeIndex&) = delete;
+
+    ~CodeIndex() { unmap(); }
+
+    // Indexes the module at `path` into its sidecar, or into a section
+    // appended to it in place of an earlier one if `embed`
+    static void write(const std::string& path, bool embed) {
+        uint64_t size;
+        const uint8_t* module = map(path, size);
+        if (!module) {
+            throw LFortranException("CodeIndex: cannot read " + path);
+        }
+        std::vector<uint8_t> payload;
+        try {
+            payload = build(module, size);
+        } catch (const std::string&) {
+            munmap((void*)module, size);
+            throw;
+        }
+        munmap((void*)module, size);
+        uint64_t module_size = ((const Header*)payload.data())->module_size;
+        std::string out = embed ? path : path + ".cidx";
+        std::vector<uint8_t> bytes = embed ? section(payload) : payload;
+        int fd = open(out.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (embed ? 0 : O_TRUNC), 0644);
+        bool ok = fd >= 0 && (!embed || ftruncate(fd, module_size) == 0);
+        for (size_t done = 0; ok && done < bytes.size();) {
+            ssize_t n = pwrite(fd, bytes.data() + done, bytes.size() - done, (embed ? module_size : 0) + done);
+            ok = n > 0;
+            done += ok ? n : 0;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (!ok) {
+            throw LFortranException("CodeIndex: cannot write " + out);
+        }
+        if (embed) {
+            unlink((path + ".cidx").c_str());  // it would be found first
+        }
+    }
+
+    uint32_t num_funcs() const { return header.num_funcs; }
+
+    // The entry of function `i` of the code section, checked against the
+    // length that precedes it in the module
+    const Entry& entry(uint32_t i) const {
+        if (i >= header.num_funcs) {
+            throw LFortranException("CodeIndex: no function " + std::to_string(i));
+        }
+        const Entry& e = entries[i];
+        uint64_t length = e.offset - e.length_size;  // read up to the entry, where it has to end
+        if (length < header.code_offset || e.offset + e.size > header.code_offset + header.code_size ||
+            leb(module, e.offset, length) != e.size || length != e.offset) {
+            throw LFortranException("CodeIndex: the index is stale at function " + std::to_string(i));
+        }
+        return e;
+    }
+
+    // Puts the code entry of function `i` of the code section into
+    // wasm_bytes, the decoder's buffer, and returns its Code for visitors
+    Code load_function(uint32_t i) {
+        const Entry& e = entry(i);
+        wasm_bytes.assign(module + e.offset, module + e.offset + e.size);
+        Code code;
+        code.size = e.size;
+        uint32_t offset = 0;
+        code.locals.resize(read_unsigned_num(offset));
+        for (Local& l : code.locals) {
+            l.count = read_unsigned_num(offset);
+            l.type = read_byte(offset);
+        }
+        code.insts_start_index = offset;
+        return code;
+    }
+
+   private:
+    const uint8_t* module = nullptr;
+    uint64_t module_size = 0;
+    const uint8_t* sidecar = nullptr;
+    uint64_t sidecar_size = 0;
+    const uint8_t* payload = nullptr;
+    uint64_t index_start = 0;  // of the embedded index section
+    Header header;
+    const Entry* entries = nullptr;
+
+    void unmap() {
+        munmap((void*)module, module_size);
+        if (sidecar) {
+            munmap((void*)sidecar, sidecar_size);
+        }
+    }
+
+    static uint64_t leb(const uint8_t* data, uint64_t size, uint64_t& offset) {
+        uint64_t result = 0;
+        uint32_t shift = 0;
+        while (true) {
+            if (offset >= size || shift > 63) {
+                throw LFortranException("CodeIndex: truncated module");
+            }
+            uint8_t byte = data[offset++];
+            result |= (uint64_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return result;
+            }
+            shift += 7;
+        }
+    }
+
+    static bool is_index(const uint8_t* module, uint64_t offset, uint64_t end) {
+        size_t n = std::strlen(SECTION_NAME);
+        return end - offset > n && module[offset] == n && std::memcmp(module + offset + 1, SECTION_NAME, n) == 0;
+    }
+
+    static uint64_t probe_hash(const uint8_t* module, uint64_t offset, uint64_t size) {
+        uint64_t n = std::min(size, PROBE_BYTES);
+        return hash_bytes(module + offset, n) ^ hash_bytes(module + offset + size - n, n) * 31;
+    }
+
+    static const uint8_t* map(const std::string& path, uint64_t& size) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return nullptr;
+        }
+        struct stat st;
+        void* p = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            size = st.st_size;
+            p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        return p == MAP_FAILED ? nullptr : (const uint8_t*)p;
+    }
+
+    // Walks the section headers, not their contents, for an index section
+    // at the end of the module
+    bool find_section(const uint8_t*& contents, uint64_t& size) {
+        uint64_t offset = 8;
+        while (offset < module_size) {
+            index_start = offset;
+            uint8_t id = module[offset++];
+            uint64_t section_size = leb(module, module_size, offset);
+            if (section_size > module_size - offset) {
+                return false;
+            }
+            if (id == 0 && offset + section_size == module_size &&
+                is_index(module, offset, offset + section_size)) {
+                contents = module + offset + 1 + std::strlen(SECTION_NAME);
+                size = section_size - 1 - std::strlen(SECTION_NAME);
+                return true;
+            }
+            offset += section_size;
+        }
+        return false;
+    }
+
+    bool matches() const {
+        if (header.module_size != (sidecar ? module_size : index_start) || header.code_offset == 0 ||
+            header.code_offset + header.code_size > header.module_size) {
+            return false;
+        }
+        uint64_t offset = header.code_offset;
+        return leb(module, module_size, offset) == header.num_funcs &&
+               probe_hash(module, header.code_offset, header.code_size) == header.probe_hash;
+    }
+};
+
+}  // namespace LFortran
+
+#endif  // LFORTRAN_WASM_CODE_INDEX_H
@@ -0,0 +1,354 @@
+#ifndef LFORTRAN_WASM_DCE_H
+#define LFORTRAN_WASM_DCE_H
+
+#include "wasm_optimizer.h"
+
+namespace LFortran {
+
+struct DeadCodeStats {
+    uint32_t functions_before = 0;  // defined ones, imports are always kept
+    uint32_t functions_after = 0;
+    uint32_t types_before = 0;
+    uint32_t types_after = 0;
+    size_t bytes_before = 0;
+    size_t bytes_after = 0;
+};
+
+// Removes the defined functions that no export, start function, element
+// segment or global initializer can reach through `call` and `ref.func`,
+// then the types nothing uses anymore, and renumbers what is left. Tables
+// are not traced, every function in an element segment is kept since any
+// `call_indirect` may reach it.
+//
+// Every body is decoded once to find what it reaches and once more to
+// renumber it, so the pass is linear in the size of the module. The name
+// section and the code index are dropped, they would no longer match.
+class DeadCodeEliminator {
+   public:
+    static constexpr uint32_t REMOVED = ~0U;
+
+    DeadCodeEliminator(DeadCodeStats& stats) : stats(stats) {}
+
+    std::vector<uint8_t> run() {
+        num_imported = num_imported_funcs();
+        mark_functions();
+        mark_types();
+        std::map<uint32_t, std::vector<uint8_t>> sections;
+        sections[1] = type_section();
+        if (!imports.empty()) {
+            sections[2] = import_section();
+        }
+        sections[3] = function_section();
+        if (!globals.empty()) {
+            sections[6] = global_section();
+        }
+        sections[7] = export_section();
+        uint32_t offset, size;
+        if (find_section(8, offset, size)) {
+            WASMAssembler start;
+            start.emit_u32(new_func[read_unsigned_num(offset)]);
+            sections[8] = start.code;
+        }
+        if (!elements.empty()) {
+            sections[9] = element_section();
+        }
+        sections[10] = code_section();
+        std::vector<uint8_t> result = replace_sections(sections, {"name", "code.index"});
+        stats.functions_before += codes.size();
+        stats.types_before += func_types.size();
+        stats.bytes_before += wasm_bytes.size();
+        stats.bytes_after += result.size();
+        return result;
+    }
+
+   private:
+    DeadCodeStats& stats;
+    uint32_t num_imported;
+    uint32_t num_kept;  // defined functions
+    uint32_t num_types;
+    std::vector<uint32_t> new_func;  // by function index, REMOVED if unreachable
+    std::vector<uint32_t> new_type;  // by type index, REMOVED if unused
+    std::vector<std::vector<BodySplitter::Instr>> bodies;  // of the reachable functions
+
+    void mark_functions() {
+        new_func.assign(num_funcs(), REMOVED);
+        std::vector<uint32_t> work;
+        auto reach = [&](uint32_t func_idx) {
+            if (func_idx < new_func.size() && new_func[func_idx] == REMOVED) {
+                new_func[func_idx] = 0;
+                work.push_back(func_idx);
+            }
+        };
+        for (const Export& e : exports) {
+            if (e.kind == 0x00) {
+                reach(e.index);
+            }
+        }
+        uint32_t offset, size;
+        if (find_section(8, offset, size)) {
+            reach(read_unsigned_num(offset));
+        }
+        for (const Element& e : elements) {
+            for (uint32_t f : e.func_indices) {
+                reach(f);
+            }
+        }
+        for (const Global& g : globals) {
+            uint32_t offset = g.insts_start_index;
+            rewrite_const_expr(offset, nullptr, reach);
+        }
+        bodies.resize(codes.size());
+        while (!work.empty()) {
+            uint32_t func_idx = work.back();
+            work.pop_back();
+            if (func_idx < num_imported) {
+                continue;
+            }
+            BodySplitter s;
+            s.split(func_idx - num_imported);
+            for (const BodySplitter::Instr& i : s.insts) {
+                if (i.op == 0x10 || i.op == 0xD2) {
+                    reach(i.index);
+                }
+            }
+            bodies[func_idx - num_imported] = std::move(s.insts);
+        }
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < new_func.size(); i++) {
+            if (i < num_imported || new_func[i] != REMOVED) {
+                new_func[i] = n++;
+            }
+        }
+        num_kept = n - num_imported;
+        stats.functions_after += num_kept;
+    }
+
+    void mark_types() {
+        new_type.assign(func_types.size(), REMOVED);
+        for (const Import& i : imports) {
+            if (i.kind == 0x00) {
+                new_type[i.type_index] = 0;
+            }
+        }
+        for (uint32_t i = 0; i < codes.size(); i++) {
+            if (new_func[num_imported + i] == REMOVED) {
+                continue;
+            }
+            new_type[type_indices[i]] = 0;
+            for (const BodySplitter::Instr& inst : bodies[i]) {
+                if (refers_to_type(inst)) {
+                    new_type[inst.index] = 0;
+                }
+            }
+        }
+        uint32_t n = 0;
+        for (uint32_t& t : new_type) {
+            if (t != REMOVED) {
+                t = n++;
+            }
+        }
+        num_types = n;
+        stats.types_after += n;
+    }
+
+    static bool refers_to_type(const BodySplitter::Instr& i) {
+        return (i.op == 0x11 || (i.op >= 0x02 && i.op <= 0x04)) && i.index != BodySplitter::NO_INDEX;
+    }
+
+    // Copies the constant expression at `offset` to `out` with the `ref.func`
+    // indices renumbered, or only passes them to `reach` if `out` is null
+    template <class F>
+    void rewrite_const_expr(uint32_t& offset, WASMAssembler* out, F reach) {
+        uint32_t start = offset;
+        skip_const_expr(offset);
+        uint32_t i = start;
+        while (i < offset) {
+            uint32_t inst_start = i;
+            uint8_t op = read_byte(i);
+            if (op == 0xD2) {
+                uint32_t func_idx = read_unsigned_num(i);
+                reach(func_idx);
+                if (out) {
+                    out->emit_b8(op);
+                    out->emit_u32(new_func[func_idx]);
+                }
+                continue;
+            }
+            switch (op) {
+                case 0x23: read_unsigned_num(i); break;
+                case 0x41: read_signed_num(i); break;
+                case 0x42: read_signed_num64(i); break;
+                case 0x43: read_float(i); break;
+                case 0x44: read_double(i); break;
+                case 0xD0: read_byte(i); break;
+            }
+            if (out) {
+                out->emit_bytes(wasm_bytes.data() + inst_start, i - inst_start);
+            }
+        }
+    }
+
+    void rewrite_const_expr(uint32_t& offset, WASMAssembler& out) {
+        rewrite_const_expr(offset, &out, [](uint32_t) {});
+    }
+
+    std::vector<uint8_t> type_section() {
+        WASMAssembler s;
+        s.emit_u32(num_types);
+        for (uint32_t i = 0; i < func_types.size(); i++) {
+            if (new_type[i] == REMOVED) {
+                continue;
+            }
+            s.emit_b8(0x60);
+            s.emit_u32(func_types[i].param_types.size());
+            s.emit_bytes(func_types[i].param_types.data(), func_types[i].param_types.size());
+            s.emit_u32(func_types[i].result_types.size());
+            s.emit_bytes(func_types[i].result_types.data(), func_types[i].result_types.size());
+        }
+        return s.code;
+    }
+
+    std::vector<uint8_t> import_section() {
+        WASMAssembler s;
+        uint32_t offset, size;
+        find_section(2, offset, size);
+        uint32_t n = read_unsigned_num(offset);
+        s.emit_u32(n);
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t start = offset;
+            decode_name(offset);
+            decode_name(offset);
+            uint8_t kind = read_byte(offset);
+            s.emit_bytes(wasm_bytes.data() + start, offset - start);
+            start = offset;
+            switch (kind) {
+                case 0x00:
+                    s.emit_u32(new_type[read_unsigned_num(offset)]);
+                    continue;
+                case 0x01:
+                    read_byte(offset);
+                    decode_limits(offset);
+                    break;
+                case 0x02: decode_limits(offset); break;
+                case 0x03: offset += 2; break;
+            }
+            s.emit_bytes(wasm_bytes.data() + start, offset - start);
+        }
+        return s.code;
+    }
+
+    std::vector<uint8_t> function_section() {
+        WASMAssembler s;
+        s.emit_u32(num_kept);
+        for (uint32_t i = 0; i < codes.size(); i++) {
+            if (new_func[num_imported + i] != REMOVED) {
+                s.emit_u32(new_type[type_indices[i]]);
+            }
+        }
+        return s.code;
+    }
+
+    std::vector<uint8_t> global_section() {
+        WASMAssembler s;
+        s.emit_u32(globals.size());
+        for (const Global& g : globals) {
+            s.emit_b8(g.type);
+            s.emit_b8(g.mut);
+            uint32_t offset = g.insts_start_index;
+            rewrite_const_expr(offset, s);
+        }
+        return s.code;
+    }
+
+    std::vector<uint8_t> export_section() {
+        WASMAssembler s;
+        s.emit_u32(exports.size());
+        for (const Export& e : exports) {
+            s.emit_u32(e.name.size());
+            s.emit_bytes((const uint8_t*)e.name.data(), e.name.size());
+            s.emit_b8(e.kind);
+            s.emit_u32(e.kind == 0x00 ? new_func[e.index] : e.index);
+        }
+        return s.code;
+    }
+
+    // follows decode_element_section
+    std::vector<uint8_t> element_section() {
+        WASMAssembler s;
+        uint32_t offset, size;
+        find_section(9, offset, size);
+        uint32_t n = read_unsigned_num(offset);
+        s.emit_u32(n);
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t kind = read_unsigned_num(offset);
+            s.emit_u32(kind);
+            if ((kind & 2U) && !(kind & 1U)) {
+                s.emit_u32(read_unsigned_num(offset));
+            }
+            if (!(kind & 1U)) {
+                rewrite_const_expr(offset, s);
+            }
+            if (kind & 3U) {
+                s.emit_b8(read_byte(offset));
+            }
+            uint32_t no_of_funcs = read_unsigned_num(offset);
+            s.emit_u32(no_of_funcs);
+            for (uint32_t j = 0; j < no_of_funcs; j++) {
+                if (kind & 4U) {
+                    rewrite_const_expr(offset, s);
+                } else {
+                    s.emit_u32(new_func[read_unsigned_num(offset)]);
+                }
+            }
+        }
+        return s.code;
+    }
+
+    std::vector<uint8_t> code_section() {
+        WASMAssembler section;
+        section.emit_u32(num_kept);
+        for (uint32_t i = 0; i < codes.size(); i++) {
+            if (new_func[num_imported + i] == REMOVED) {
+                continue;
+            }
+            WASMAssembler insts;
+            for (const BodySplitter::Instr& inst : bodies[i]) {
+                if (inst.op == 0x10 || inst.op == 0xD2) {
+                    renumber(insts, inst, new_func[inst.index]);
+                } else if (refers_to_type(inst)) {
+                    renumber(insts, inst, new_type[inst.index]);
+                } else {
+                    insts.emit_bytes(wasm_bytes.data() + inst.start, inst.size);
+                }
+            }
+            emit_function_body(section, codes[i].locals, insts.code);
+        }
+        return section.code;
+    }
+
+    // Copies an instruction whose first immediate is an index with the index
+    // replaced; block types are signed
+    static void renumber(WASMAssembler& insts, const BodySplitter::Instr& inst, uint32_t index) {
+        uint32_t offset = inst.start + 1;
+        insts.emit_b8(inst.op);
+        if (inst.op >= 0x02 && inst.op <= 0x04) {
+            read_signed_num64(offset);
+            insts.emit_i64(index);
+        } else {
+            read_unsigned_num(offset);
+            insts.emit_u32(index);
+        }
+        insts.emit_bytes(wasm_bytes.data() + offset, inst.start + inst.size - offset);
+    }
+};
+
+// Removes the functions and types the exports cannot reach and returns the
+// rewritten module
+std::vector<uint8_t> eliminate_dead_code(DeadCodeStats& stats) {
+    DeadCodeEliminator dce(stats);
+    return dce.run();
+}
+
+}  // namespace LFortran
+
+#endif  // LFORTRAN_WASM_DCE_H
@@ -0,0 +1,347 @@
+#ifndef LFORTRAN_WASM_DECODER_H
+#define LFORTRAN_WASM_DECODER_H
+
+#include <cassert>
+#include "wasm_utils.h"
+
+#ifdef WAT_DEBUG
+#define DEBUG(s) std::cout << s << std::endl
+#else
+#define DEBUG(s)
+#endif
+
+void decode_type_section(uint32_t offset) {
+    // read type section contents
+    uint32_t no_of_func_types = read_unsigned_num(offset);
+    DEBUG("no_of_func_types: " + std::to_string(no_of_func_types));
+    func_types.resize(no_of_func_types);
+
+    for (uint32_t i = 0; i < no_of_func_types; i++) {
+        if (wasm_bytes[offset] != 0x60) {
+            std::cout << "Error: Invalid type section" << std::endl;
+            exit(1);
+        }
+        offset++;
+
+        // read result type 1
+        uint32_t no_of_params = read_unsigned_num(offset);
+        func_types[i].param_types.resize(no_of_params);
+
+        for (uint32_t j = 0; j < no_of_params; j++) {
+            func_types[i].param_types[j] = wasm_bytes[offset++];
+        }
+
+        uint32_t no_of_results = read_unsigned_num(offset);
+        func_types[i].result_types.resize(no_of_results);
+
+        for (uint32_t j = 0; j < no_of_results; j++) {
+            func_types[i].result_types[j] = wasm_bytes[offset++];
+        }
+    }
+}
+
+Limits decode_limits(uint32_t& offset) {
+    Limits limits;
+    uint8_t flag = read_byte(offset);
+    limits.min = read_unsigned_num(offset);
+    limits.has_max = (flag == 0x01);
+    limits.max = limits.has_max ? read_unsigned_num(offset) : 0U;
+    return limits;
+}
+
+std::string decode_name(uint32_t& offset) {
+    uint32_t size = read_unsigned_num(offset);
+    if ((uint64_t)offset + size > wasm_bytes.size()) {
+        throw LFortran::LFortranException("decode_name: name out of bounds");
+    }
+    std::string name(wasm_bytes.begin() + offset, wasm_bytes.begin() + offset + size);
+    offset += size;
+    return name;
+}
+
+void decode_import_section(uint32_t offset) {
+    // read import section contents
+    uint32_t no_of_imports = read_unsigned_num(offset);
+    DEBUG("no_of_imports: " + std::to_string(no_of_imports));
+    imports.resize(no_of_imports);
+
+    for (uint32_t i = 0; i < no_of_imports; i++) {
+        imports[i].module = decode_name(offset);
+        imports[i].name = decode_name(offset);
+        DEBUG("import: " + imports[i].module + "." + imports[i].name);
+        imports[i].kind = read_byte(offset);
+        imports[i].type_index = 0U;
+        switch (imports[i].kind) {
+            case 0x00: imports[i].type_index = read_unsigned_num(offset); break;
+            case 0x01:
+                read_byte(offset);  // reftype
+                decode_limits(offset);
+                break;
+            case 0x02: decode_limits(offset); break;
+            case 0x03:
+                read_byte(offset);  // valtype
+                read_byte(offset);  // mut
+                break;
+            default: throw LFortran::LFortranException("Invalid import kind");
+        }
+    }
+}
+
+void decode_function_section(uint32_t offset) {
+    // read function section contents
+    uint32_t no_of_indices = read_unsigned_num(offset);
+    DEBUG("no_of_indices: " + std::to_string(no_of_indices));
+    type_indices.resize(no_of_indices);
+
+    for (uint32_t i = 0; i < no_of_indices; i++) {
+        type_indices[i] = read_unsigned_num(offset);
+    }
+}
+
+// skips a constant expression, returns the offset of its first instruction
+uint32_t skip_const_expr(uint32_t& offset) {
+    uint32_t start = offset;
+    uint8_t cur_byte = read_byte(offset);
+    while (cur_byte != 0x0B) {
+        switch (cur_byte) {
+            case 0x23:
+            case 0xD2: read_unsigned_num(offset); break;
+            case 0x41: read_signed_num(offset); break;
+            case 0x42: read_signed_num64(offset); break;
+            case 0x43: read_float(offset); break;
+            case 0x44: read_double(offset); break;
+            case 0xD0: read_byte(offset); break;
+            default: throw LFortran::LFortranException("Invalid instruction in constant expression");
+        }
+        cur_byte = read_byte(offset);
+    }
+    return start;
+}
+
+void decode_table_section(uint32_t offset) {
+    // read table section contents
+    uint32_t no_of_tables = read_unsigned_num(offset);
+    DEBUG("no_of_tables: " + std::to_string(no_of_tables));
+    tables.resize(no_of_tables);
+
+    for (uint32_t i = 0; i < no_of_tables; i++) {
+        tables[i].type = read_byte(offset);
+        tables[i].limits = decode_limits(offset);
+    }
+}
+
+void decode_memory_section(uint32_t offset) {
+    // read memory section contents
+    uint32_t no_of_memories = read_unsigned_num(offset);
+    DEBUG("no_of_memories: " + std::to_string(no_of_memories));
+    memories.resize(no_of_memories);
+
+    for (uint32_t i = 0; i < no_of_memories; i++) {
+        memories[i] = decode_limits(offset);
+    }
+}
+
+void decode_global_section(uint32_t offset) {
+    // read global section contents
+    uint32_t no_of_globals = read_unsigned_num(offset);
+    DEBUG("no_of_globals: " + std::to_string(no_of_globals));
+    globals.resize(no_of_globals);
+
+    for (uint32_t i = 0; i < no_of_globals; i++) {
+        globals[i].type = read_byte(offset);
+        globals[i].mut = read_byte(offset);
+        globals[i].insts_start_index = skip_const_expr(offset);
+    }
+}
+
+void decode_export_section(uint32_t offset) {
+    // read export section contents
+    uint32_t no_of_exports = read_unsigned_num(offset);
+    DEBUG("no_of_exports: " + std::to_string(no_of_exports));
+    exports.resize(no_of_exports);
+
+    for (uint32_t i = 0; i < no_of_exports; i++) {
+        uint32_t name_size = read_unsigned_num(offset);
+        exports[i].name.resize(name_size);
+        for (uint32_t j = 0; j < name_size; j++) {
+            exports[i].name[j] = wasm_bytes[offset++];
+        }
+        DEBUG("export name: " + exports[i].name);
+        exports[i].kind = wasm_bytes[offset++];
+        DEBUG("export kind: " + std::to_string(exports[i].kind));
+        exports[i].index = read_unsigned_num(offset);
+        DEBUG("export index: " + std::to_string(exports[i].index));
+    }
+}
+
+void decode_start_section(uint32_t offset) { start_function = read_unsigned_num(offset); }
+
+// reads an element initializer, which is either `ref.func x` or `ref.null t`
+uint32_t decode_element_expr(uint32_t& offset) {
+    uint32_t func_index;
+    uint8_t cur_byte = read_byte(offset);
+    if (cur_byte == 0xD2) {
+        func_index = read_unsigned_num(offset);
+    } else if (cur_byte == 0xD0) {
+        read_byte(offset);
+        func_index = NULL_REF;
+    } else {
+        throw LFortran::LFortranException("Unsupported element expression");
+    }
+    if (read_byte(offset) != 0x0B) {
+        throw LFortran::LFortranException("Unsupported element expression");
+    }
+    return func_index;
+}
+
+void decode_element_section(uint32_t offset) {
+    // read element section contents
+    uint32_t no_of_elements = read_unsigned_num(offset);
+    DEBUG("no_of_elements: " + std::to_string(no_of_elements));
+    elements.resize(no_of_elements);
+
+    for (uint32_t i = 0; i < no_of_elements; i++) {
+        uint32_t kind = read_unsigned_num(offset);
+        elements[i].kind = kind;
+        elements[i].table_index = (kind & 2U) && !(kind & 1U) ? read_unsigned_num(offset) : 0U;
+        if (!(kind & 1U)) {
+            elements[i].insts_start_index = skip_const_expr(offset);
+        }
+        if (kind & 3U) {
+            read_byte(offset);  // elemkind or reftype
+        }
+        uint32_t no_of_funcs = read_unsigned_num(offset);
+        elements[i].func_indices.resize(no_of_funcs);
+        for (uint32_t j = 0; j < no_of_funcs; j++) {
+            elements[i].func_indices[j] = (kind & 4U) ? decode_element_expr(offset) : read_unsigned_num(offset);
+        }
+    }
+}
+
+void decode_code_section(uint32_t offset) {
+    // read code section contents
+    uint32_t no_of_codes = read_unsigned_num(offset);
+    DEBUG("no_of_codes: " + std::to_string(no_of_codes));
+    codes.resize(no_of_codes);
+
+    for (uint32_t i = 0; i < no_of_codes; i++) {
+        codes[i].size = read_unsigned_num(offset);
+        uint32_t code_start_offset = offset;
+        uint32_t no_of_locals = read_unsigned_num(offset);
+        DEBUG("no_of_locals: " + std::to_string(no_of_locals));
+        codes[i].locals.resize(no_of_locals);
+
+        DEBUG("Entering loop");
+        for (uint32_t j = 0U; j < no_of_locals; j++) {
+            codes[i].locals[j].count = read_unsigned_num(offset);
+            DEBUG("count: " + std::to_string(codes[i].locals[j].count));
+            codes[i].locals[j].type = wasm_bytes[offset++];
+            DEBUG("type: " + std::to_string(codes[i].locals[j].type));
+        }
+        DEBUG("Exiting loop");
+
+        codes[i].insts_start_index = offset;
+
+        // skip offset to directly the end of instructions
+        offset = code_start_offset + codes[i].size;
+    }
+}
+
+void decode_data_section(uint32_t offset) {
+    // read data section contents
+    uint32_t no_of_datas = read_unsigned_num(offset);
+    DEBUG("no_of_datas: " + std::to_string(no_of_datas));
+    datas.resize(no_of_datas);
+
+    for (uint32_t i = 0; i < no_of_datas; i++) {
+        datas[i].kind = read_unsigned_num(offset);
+        if (datas[i].kind == 2U && read_unsigned_num(offset) != 0U) {
+            throw LFortran::LFortranException("Only memory 0 is supported");
+        }
+        if (datas[i].kind != 1U) {
+            datas[i].insts_start_index = skip_const_expr(offset);
+        }
+        datas[i].size = read_unsigned_num(offset);
+        datas[i].bytes_start = offset;
+        offset += datas[i].size;
+    }
+}
+
+// Forgets the decoded module, so that another one can be decoded
+void clear_module() {
+    func_types.clear();
+    type_indices.clear();
+    imports.clear();
+    exports.clear();
+    codes.clear();
+    tables.clear();
+    memories.clear();
+    globals.clear();
+    elements.clear();
+    datas.clear();
+}
+
+void decode_wasm() {
+    // first 8 bytes are magic number and wasm version number
+    // currently, in this first version, we are skipping them
+    uint32_t index = 8U;
+    start_function = NO_START;
+
+    while (index < wasm_bytes.size()) {
+        uint32_t section_id = read_unsigned_num(index);
+        uint32_t section_size = read_unsigned_num(index);
+        switch (section_id) {
+            case 1U:
+                decode_type_section(index);
+                // exit(0);
+                break;
+            case 2U:
+                decode_import_section(index);
+                break;
+            case 3U:
+                decode_function_section(index);
+                // exit(0);
+                break;
+            case 4U:
+                decode_table_section(index);
+                break;
+            case 5U:
+                decode_memory_section(index);
+                break;
+            case 6U:
+                decode_global_section(index);
+                break;
+            case 7U:
+                decode_export_section(index);
+                // exit(0);
+                break;
+            case 8U:
+                decode_start_section(index);
+                break;
+            case 9U:
+                decode_element_section(index);
+                break;
+            case 10U:
+                decode_code_section(index);
+                // exit(0)
+                break;
+            case 11U:
+                decode_data_section(index);
+                break;
+            case 12U:
+                // data count, only needed by a single pass validator
+                break;
+            case 0U:
+                // custom, read by the tools that use it
+                break;
+            default:
+                throw LFortran::LFortranException("decode_wasm: unknown section id " + std::to_string(section_id));
+        }
+        index += section_size;
+    }
+
+    assert(index == wasm_bytes.size());
+    assert(type_indices.size() == codes.size());
+}
+
+#endif  // LFORTRAN_WASM_DECODER_H
@@ -0,0 +1,77 @@
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include "wasm_decoder.h"
+#include "wasm_interpreter.h"
+
+using namespace LFortran;
+
+// Times an exported function under the switch loop and under the tail call
+// threaded handlers. The runs alternate between the two, so both see the
+// same caches and clock, and the best run of each is reported.
+int main(int argc, char** argv) {
+    int runs = 10;
+    int argi = 1;
+    if (argi < argc && std::string(argv[argi]).rfind("--runs=", 0) == 0) {
+        runs = std::stoi(std::string(argv[argi]).substr(7));
+        argi++;
+    }
+    if (argc - argi < 2) {
+        std::cerr << "Usage: " << argv[0] << " [--runs=N] file.wasm function [args...]" << std::endl;
+        return 1;
+    }
+    load_file(argv[argi]);
+    decode_wasm();
+
+    Interpreter interp;
+    interp.compile_all();
+    uint32_t func_idx = Interpreter::find_export(argv[argi + 1]);
+    const FuncType& type = func_types[func_type_index(func_idx)];
+    if ((size_t)(argc - argi - 2) != type.param_types.size()) {
+        std::cerr << argv[argi + 1] << " expects " << type.param_types.size() << " arguments" << std::endl;
+        return 1;
+    }
+    std::vector<Value> args;
+    for (uint32_t i = 0; i < type.param_types.size(); i++) {
+        Value v = {};
+        switch (type.param_types[i]) {
+            case 0x7F: v.i32 = std::stol(argv[argi + 2 + i]); break;
+            case 0x7E: v.i64 = std::stoll(argv[argi + 2 + i]); break;
+            case 0x7D: v.f32 = std::stof(argv[argi + 2 + i]); break;
+            case 0x7C: v.f64 = std::stod(argv[argi + 2 + i]); break;
+            default: std::cerr << "unsupported parameter type" << std::endl; return 1;
+        }
+        args.push_back(v);
+    }
+
+    const char* names[2] = {"switch", "threaded"};
+    double best[2] = {1e300, 1e300};
+    std::vector<Value> results[2];
+    try {
+        for (int run = 0; run < runs; run++) {
+            for (int threaded = 0; threaded < 2; threaded++) {
+                interp.use_threaded_dispatch(threaded);
+                auto start = std::chrono::steady_clock::now();
+                results[threaded] = interp.invoke(func_idx, args);
+                std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+                best[threaded] = std::min(best[threaded], took.count());
+            }
+        }
+    } catch (const std::string& e) {
+        std::cerr << e << std::endl;
+        return 1;
+    }
+    for (size_t i = 0; i < results[0].size(); i++) {
+        if (std::memcmp(&results[0][i], &results[1][i], sizeof(Value)) != 0) {
+            std::cerr << "the two dispatches computed different results" << std::endl;
+            return 1;
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        std::cout << names[i] << ": " << best[i] << " ms" << std::endl;
+    }
+    std::cout << "speedup: " << best[0] / best[1] << std::endl;
+    return 0;
+}
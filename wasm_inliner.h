@@ -0,0 +1,159 @@
+#ifndef LFORTRAN_WASM_INLINER_H
+#define LFORTRAN_WASM_INLINER_H
+
+#include <algorithm>
+#include <map>
+#include "wasm_optimizer.h"
+
+namespace LFortran {
+
+struct InlinerStats {
+    uint64_t call_sites = 0;  // calls replaced by the callee's body
+    uint64_t callees = 0;     // functions inlined at least once
+    size_t bytes_before = 0;
+    size_t bytes_after = 0;
+};
+
+// Replaces direct calls to small functions by their bodies. At a call site
+// the arguments are popped into fresh locals of the caller, the callee's own
+// locals are zeroed, since the site may run more than once, and the body
+// runs in a block with the callee's results, where `return` becomes a
+// branch to its end. The fresh locals are shared by the sites of a callee in
+// one caller, which never run nested.
+//
+// Only one level is inlined: the calls in an inlined body stay calls. The
+// callees themselves are kept, they may still be exported or in a table.
+class Inliner {
+   public:
+    Inliner(InlinerStats& stats, uint32_t max_size) : stats(stats), max_size(max_size) {}
+
+    std::vector<uint8_t> run() {
+        bodies.resize(codes.size());
+        for (uint32_t i = 0; i < codes.size(); i++) {
+            BodySplitter s;
+            s.split(i);
+            bodies[i] = s.insts;
+            sizes.push_back(s.size);
+        }
+        std::vector<bool> inlined(codes.size());
+        WASMAssembler section;
+        section.emit_u32(codes.size());
+        for (uint32_t i = 0; i < codes.size(); i++) {
+            std::vector<Local> locals = codes[i].locals;
+            WASMAssembler insts;
+            rewrite(i, locals, insts, inlined);
+            emit_function_body(section, locals, insts.code);
+        }
+        stats.callees += std::count(inlined.begin(), inlined.end(), true);
+        stats.bytes_before += section_size(10);
+        stats.bytes_after += section.code.size();
+        return replace_code_section(section.code);
+    }
+
+   private:
+    InlinerStats& stats;
+    uint32_t max_size;  // of an inlined body in bytes, without its locals
+    std::vector<std::vector<BodySplitter::Instr>> bodies;
+    std::vector<uint32_t> sizes;
+
+    bool can_inline(uint32_t caller, uint32_t func_idx) const {
+        uint32_t n = num_imported_funcs();
+        if (func_idx < n || func_idx - n == caller || sizes[func_idx - n] > max_size) {
+            return false;
+        }
+        // a block type can only name more results through the type section
+        return func_types[type_indices[func_idx - n]].result_types.size() <= 1;
+    }
+
+    void rewrite(uint32_t caller, std::vector<Local>& locals, WASMAssembler& insts, std::vector<bool>& inlined) {
+        uint32_t num_locals = func_types[type_indices[caller]].param_types.size();
+        for (const Local& l : locals) {
+            num_locals += l.count;
+        }
+        std::map<uint32_t, uint32_t> first_local;  // of every inlined callee
+        for (const BodySplitter::Instr& i : bodies[caller]) {
+            if (i.op != 0x10 || !can_inline(caller, i.index)) {
+                insts.emit_bytes(wasm_bytes.data() + i.start, i.size);
+                continue;
+            }
+            uint32_t callee = i.index - num_imported_funcs();
+            const FuncType& type = func_types[type_indices[callee]];
+            auto it = first_local.find(callee);
+            if (it == first_local.end()) {
+                it = first_local.emplace(callee, num_locals).first;
+                for (uint8_t t : type.param_types) {
+                    locals.push_back({1, t});
+                }
+                for (const Local& l : codes[callee].locals) {
+                    locals.push_back(l);
+                }
+                num_locals += type.param_types.size();
+                for (const Local& l : codes[callee].locals) {
+                    num_locals += l.count;
+                }
+            }
+            uint32_t base = it->second;
+            for (uint32_t p = type.param_types.size(); p-- > 0;) {
+                insts.emit_set_local(base + p);
+            }
+            uint32_t k = base + type.param_types.size();
+            for (const Local& l : codes[callee].locals) {
+                for (uint32_t j = 0; j < l.count; j++) {
+                    emit_zero(insts, l.type);
+                    insts.emit_set_local(k++);
+                }
+            }
+            insts.emit_b8(0x02);
+            insts.emit_b8(type.result_types.empty() ? 0x40 : type.result_types[0]);
+            for (const BodySplitter::Instr& c : bodies[callee]) {
+                if (c.op >= 0x20 && c.op <= 0x22) {
+                    insts.emit_b8(c.op);
+                    insts.emit_u32(base + c.index);
+                } else if (c.op == 0x0F) {  // return, a branch out of the block
+                    insts.emit_b8(0x0C);
+                    insts.emit_u32(c.depth);
+                } else {
+                    insts.emit_bytes(wasm_bytes.data() + c.start, c.size);
+                }
+            }
+            insts.emit_end();
+            inlined[callee] = true;
+            stats.call_sites++;
+        }
+    }
+
+    static void emit_zero(WASMAssembler& insts, uint8_t type) {
+        switch (type) {
+            case 0x7F: insts.emit_i32_const(0); break;
+            case 0x7E: insts.emit_i64_const(0); break;
+            case 0x7D:
+                insts.emit_b8(0x43);
+                insts.code.insert(insts.code.end(), 4, 0);
+                break;
+            case 0x7C:
+                insts.emit_b8(0x44);
+                insts.code.insert(insts.code.end(), 8, 0);
+                break;
+            case 0x7B:  // v128.const
+                insts.emit_b8(0xFD);
+                insts.emit_u32(12);
+                insts.code.insert(insts.code.end(), 16, 0);
+                break;
+            default:  // funcref and externref
+                insts.emit_b8(0xD0);
+                insts.emit_b8(type);
+                break;
+        }
+    }
+};
+
+// Inlines the functions of at most `max_size` bytes of instructions into
+// their callers and returns the rewritten module
+std::vector<uint8_t> inline_wasm(InlinerStats& stats, uint32_t max_size) {
+    Inliner inliner(stats, max_size);
+    return inliner.run();
+}
+
+}  // namespace LFortran
+
+#endif  // LFORTRAN_WASM_INLINER_H
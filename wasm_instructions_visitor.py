@@ -25,6 +25,21 @@ FOOT = r"""
 #endif // LFORTRAN_%(MOD)s_H
 """
 
+THREADED_HEAD = r"""#ifndef LFORTRAN_WASM_THREADED_H
+#define LFORTRAN_WASM_THREADED_H
+
+// Generated by grammar/wasm_instructions_visitor.py
+
+// Every instruction as X(Name, lowered opcode), for defining one handler of
+// the tail call threaded interpreter per instruction. Prefixed instructions
+// are numbered from OP_FC_PREFIX and OP_FD_PREFIX.
+#define WASM_THREADED_OPS(X) \
+"""
+
+THREADED_FOOT = r"""
+#endif // LFORTRAN_WASM_THREADED_H
+"""
+
 class WASMInstructionsVisitor():
     def __init__(self, stream, data):
         self.stream = stream
@@ -39,16 +54,28 @@ class WASMInstructionsVisitor():
 
         for inst in mod["instructions"]:
             self.emit("void visit_%s(%s) {throw LFortran::LFortranException(\"visit_%s() not implemented\");}\n" % (inst["func"], make_param_list(inst["params"]), inst["func"]), 1)
+        # called with the offset of every instruction before it is decoded
+        self.emit("void begin_instruction(uint32_t /*offset*/) {}\n", 1)
+
 
-        self.emit(    "void decode_instructions(uint32_t offset) {", 1)
+        # decodes up to the `end` of the function or constant expression,
+        # the `end`s of nested blocks are visited like any other instruction,
+        # and returns the offset just past it
+        self.emit(    "uint32_t decode_instructions(uint32_t offset) {", 1)
+        self.emit(        "uint32_t depth = 0;", 2)
         self.emit(        "uint8_t cur_byte = read_byte(offset);", 2)
-        self.emit(        "while (cur_byte != 0x0B) {", 2)
+        self.emit(        "while (cur_byte != 0x0B || depth > 0) {", 2)
+        self.emit(            "self().begin_instruction(offset - 1);", 3)
         self.emit(            "switch (cur_byte) {", 3)
         for inst in filter(lambda i: i["opcode"] not in ["0xFC", "0xFD"], mod["instructions"]):
             self.emit(            "case %s: {" % (inst["opcode"]), 4)
             for param in inst["params"]:
                 self.emit(            "%s %s = %s(offset);" % (param["type"], param["name"], param["read_func"]), 5)
             self.emit(                "self().visit_%s(%s);" % (inst["func"], make_param_list(inst["params"], call=True)), 5)
+            if any(param["name"] == "blocktype" for param in inst["params"]):
+                self.emit(            "depth++;", 5)
+            elif inst["opcode"] == "0x0B":
+                self.emit(            "depth--;", 5)
             self.emit(                "break;", 5)
             self.emit(            "}", 4)
         
@@ -70,7 +97,7 @@ class WASMInstructionsVisitor():
         self.emit(                "}", 4)
         
         self.emit(                "case 0xFD: {", 4)
-        self.emit(                    "uint32_t num = read_signed_num(offset);", 5)
+        self.emit(                    "uint32_t num = read_unsigned_num(offset);", 5)
         self.emit(                    "switch(num) {", 5)
         for inst in filter(lambda i: i["opcode"] == "0xFD", mod["instructions"]):
             self.emit(                    "case %sU: {" % (inst["params"][0]["val"]), 6)
@@ -92,6 +119,7 @@ class WASMInstructionsVisitor():
         self.emit(            "}", 3)
         self.emit(            "cur_byte = read_byte(offset);", 3)
         self.emit(        "}", 2)
+        self.emit(        "return offset;", 2)
         self.emit(    "}", 1)
         self.emit("};", 0)
 
@@ -100,6 +128,19 @@ class WASMInstructionsVisitor():
         indent = "    "*level
         self.stream.write(indent + line + "\n")
 
+def lowered_opcode(inst):
+    if inst["opcode"] == "0xFC":
+        return "OP_FC_PREFIX + %s" % inst["params"][0]["val"]
+    if inst["opcode"] == "0xFD":
+        return "OP_FD_PREFIX + %s" % inst["params"][0]["val"]
+    return inst["opcode"]
+
+def write_threaded_ops(stream, instructions):
+    stream.write(THREADED_HEAD)
+    lines = ["    X(%s, %s)" % (inst["func"], lowered_opcode(inst)) for inst in instructions]
+    stream.write(" \\\n".join(lines) + "\n")
+    stream.write(THREADED_FOOT)
+
 def make_param_list(params, call = False):
     params = list(filter(lambda param: param["val"] != "0x00" and param["name"] != "num", params))
     if call:
@@ -129,9 +170,11 @@ param_read_function = {
     "uint8_t": "read_byte",
     "uint32_t": "read_unsigned_num",
     "int32_t": "read_signed_num",
-    "int64_t": "read_signed_num",
+    "int64_t": "read_signed_num64",
     "float": "read_float",
-    "double": "read_double"
+    "double": "read_double",
+    "v128_t": "read_v128",
+    "std::vector<uint32_t>": "read_u32_vector"
 }
 
 param_type = {
@@ -141,6 +184,9 @@ param_type = {
     "i64": "int64_t",
     "f32": "float",
     "f64": "double",
+    "v128": "v128_t",
+    "s33": "int64_t",
+    "vec": "std::vector<uint32_t>",
 }
 
 def parse_param_info(param_info):
@@ -164,13 +210,17 @@ def parse_instructions(instructions):
     return instructions_info
 
 def main(argv):
-    if len(argv) == 3:
-        def_file, out_file = argv[1:]
+    threaded_file = None
+    if len(argv) in (3, 4):
+        def_file, out_file = argv[1:3]
+        if len(argv) == 4:
+            threaded_file = argv[3]
     elif len(argv) == 1:
-        print("Assuming default values of wasm_instructions.txt and wasm_visitor.h")
+        print("Assuming default values of wasm_instructions.txt, wasm_visitor.h and wasm_threaded.h")
         here = os.path.dirname(__file__)
         def_file = os.path.join(here, "..", "src", "libasr", "wasm_instructions.txt")
         out_file = os.path.join(here, "..", "src", "libasr", "wasm_visitor.h")
+        threaded_file = os.path.join(here, "..", "src", "libasr", "wasm_threaded.h")
     else:
         print("invalid arguments")
         return 2
@@ -186,6 +236,9 @@ def main(argv):
         fp.write(FOOT % subs)
     finally:
         fp.close()
+    if threaded_file:
+        with open(threaded_file, "w", encoding="utf-8") as fp:
+            write_threaded_ops(fp, instructions_info)
 
 if __name__ == "__main__":
     sys.exit(main(sys.argv))
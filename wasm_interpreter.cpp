@@ -0,0 +1,185 @@
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include "wasm_decoder.h"
+#include "wasm_interpreter.h"
+#include "wasm_module_cache.h"
+#include "wasm_profiler.h"
+#include "wasm_wasi.h"
+
+using namespace LFortran;
+
+Value parse_value(uint8_t type, const std::string& s) {
+    Value v = {};
+    switch (type) {
+        case 0x7F: v.i32 = std::stol(s); break;
+        case 0x7E: v.i64 = std::stoll(s); break;
+        case 0x7D: v.f32 = std::stof(s); break;
+        case 0x7C: v.f64 = std::stod(s); break;
+        default: throw LFortranException("parse_value: unsupported type");
+    }
+    return v;
+}
+
+std::string value_to_string(uint8_t type, Value v) {
+    switch (type) {
+        case 0x7F: return std::to_string(v.i32);
+        case 0x7E: return std::to_string(v.i64);
+        case 0x7D: return std::to_string(v.f32);
+        case 0x7C: return std::to_string(v.f64);
+        case 0x7B: {
+            int32_t lanes[4];
+            std::memcpy(lanes, v.v128, 16);
+            return "i32x4 " + std::to_string(lanes[0]) + " " + std::to_string(lanes[1]) + " " +
+                   std::to_string(lanes[2]) + " " + std::to_string(lanes[3]);
+        }
+        default: throw LFortranException("value_to_string: unsupported type");
+    }
+}
+
+int main(int argc, char** argv) {
+    bool eager = false, threaded = false;
+    unsigned num_threads = 0;
+    long long fuel = -1;
+    std::string cache_dir, profile_file;
+    bool perf_map = false, jitdump = false;
+    size_t stack_size = 1U << 20;
+    bool auto_stack = false;
+    int argi = 1;
+    for (; argi < argc && std::string(argv[argi]).rfind("--", 0) == 0; argi++) {
+        std::string opt = argv[argi];
+        if (opt == "--eager") {
+            eager = true;
+        } else if (opt == "--threaded") {
+            threaded = true;
+        } else if (opt.rfind("--threads=", 0) == 0) {
+            num_threads = std::stoul(opt.substr(10));
+        } else if (opt.rfind("--fuel=", 0) == 0) {
+            fuel = std::stoll(opt.substr(7));
+        } else if (opt == "--perf-map") {
+            perf_map = true;
+        } else if (opt == "--jitdump") {
+            jitdump = true;
+        } else if (opt == "--stack=auto") {
+            auto_stack = true;
+        } else if (opt.rfind("--stack=", 0) == 0) {
+            stack_size = std::stoull(opt.substr(8));
+        } else if (opt.rfind("--profile=", 0) == 0) {
+            profile_file = opt.substr(10);
+        } else if (opt.rfind("--cache=", 0) == 0) {
+            cache_dir = opt.substr(8);
+        } else {
+            std::cerr << "Unknown option: " << opt << std::endl;
+            return 1;
+        }
+    }
+    if (argc - argi < 2) {
+        std::cerr << "Usage: " << argv[0] << " [--eager] [--threaded] [--threads=N] [--fuel=N] [--cache=DIR] [--stack=N|auto]"
+                  << " [--perf-map] [--jitdump] [--profile=FILE]"
+                  << " file.wasm function [args...] [program args...]" << std::endl;
+        return 1;
+    }
+    std::unique_ptr<ModuleCache> cache;
+    std::unique_ptr<CodeImage> image;
+    std::unique_ptr<Interpreter> interp;
+    std::unique_ptr<PerfMap> perf;
+    // samples go to FILE as collapsed stacks and a summary to stderr
+    std::unique_ptr<SamplingProfiler> profiler;
+    auto write_profile = [&] {
+        if (profiler) {
+            profiler->stop();
+            std::ofstream out(profile_file);
+            profiler->write_collapsed(out);
+            profiler->print_functions(std::cerr);
+            profiler.reset();
+        }
+    };
+    try {
+        load_file(argv[argi]);
+        if (!cache_dir.empty()) {
+            cache.reset(new ModuleCache(cache_dir));
+            image = cache->load(fuel >= 0);
+        }
+        if (!image) {
+            decode_wasm();
+        }
+
+        uint32_t func_idx = Interpreter::find_export(argv[argi + 1]);
+        if (auto_stack) {
+            // as deep as the calls can go, the default if they can recurse
+            uint64_t chain = Interpreter::max_call_chain(func_idx);
+            if (start_function != NO_START) {
+                chain = std::max(chain, Interpreter::max_call_chain(start_function));
+            }
+            if (chain != Interpreter::UNBOUNDED) {
+                stack_size = chain;
+            }
+        }
+        interp.reset(new Interpreter(stack_size));
+        if (perf_map || jitdump) {
+            perf.reset(new PerfMap(perf_map, jitdump));
+            interp->set_perf_map(perf.get());
+        }
+        if (fuel >= 0) {
+            interp->enable_fuel_metering(fuel);
+        }
+        interp->use_threaded_dispatch(threaded);
+        if (image) {
+            interp->use_code_image(std::move(image));
+        } else if (cache) {
+            // a cache entry holds the whole module
+            interp->compile_all(num_threads);
+            cache->store(*interp);
+        } else if (eager) {
+            interp->compile_all(num_threads);
+        }
+        const FuncType& type = func_types[func_type_index(func_idx)];
+        if ((size_t)(argc - argi - 2) < type.param_types.size()) {
+            std::cerr << argv[argi + 1] << " expects " << type.param_types.size() << " arguments" << std::endl;
+            return 1;
+        }
+        // the program sees the module and the arguments left over as its WASI args
+        std::vector<std::string> wasi_args = {argv[argi]};
+        for (int i = argi + 2 + type.param_types.size(); i < argc; i++) {
+            wasi_args.push_back(argv[i]);
+        }
+        std::vector<std::string> wasi_env;
+        for (char** e = environ; *e; e++) {
+            wasi_env.push_back(*e);
+        }
+        Wasi wasi(wasi_args, wasi_env);
+        wasi.bind(*interp);
+        std::vector<Value> args;
+        for (uint32_t i = 0; i < type.param_types.size(); i++) {
+            args.push_back(parse_value(type.param_types[i], argv[argi + 2 + i]));
+        }
+
+        if (!profile_file.empty()) {
+            profiler.reset(new SamplingProfiler(*interp));
+            profiler->start();
+        }
+        interp->start();
+        std::vector<Value> results;
+        if (!interp->out_of_fuel()) {
+            results = interp->invoke(func_idx, args);
+        }
+        write_profile();
+        if (interp->out_of_fuel()) {
+            std::cerr << "out of fuel" << std::endl;
+            return 1;
+        }
+        for (uint32_t i = 0; i < results.size(); i++) {
+            std::cout << value_to_string(type.result_types[i], results[i]) << std::endl;
+        }
+    } catch (const std::string& e) {
+        write_profile();
+        std::cerr << e << std::endl;
+        return 1;
+    } catch (const WasiExit& e) {
+        write_profile();
+        return e.code;
+    }
+    return 0;
+}
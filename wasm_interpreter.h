@@ -0,0 +1,2514 @@
+#ifndef LFORTRAN_WASM_INTERPRETER_H
+#define LFORTRAN_WASM_INTERPRETER_H
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "wasm_bulk_memory.h"
+#include "wasm_memory.h"
+#include "wasm_numeric.h"
+#include "wasm_perf_map.h"
+#include "wasm_simd.h"
+#include "wasm_snapshot.h"
+#include "wasm_thread_pool.h"
+#include "wasm_threaded.h"
+#include "wasm_visitor.h"
+
+// Guaranteed tail calls for the threaded dispatch. Without them (GCC before
+// 15) the handlers return to a loop instead. Defining WASM_MUSTTAIL empty
+// relies on the optimizer turning the calls into jumps, which it does not
+// promise, so deep enough runs may overflow the native stack.
+#ifndef WASM_MUSTTAIL
+#if defined(__has_cpp_attribute)
+#if __has_cpp_attribute(clang::musttail)
+#define WASM_MUSTTAIL [[clang::musttail]]
+#elif __has_cpp_attribute(gnu::musttail)
+#define WASM_MUSTTAIL [[gnu::musttail]]
+#endif
+#endif
+#endif
+
+#define WASM_ALWAYS_INLINE inline __attribute__((always_inline))
+
+namespace LFortran {
+
+union Value {
+    int32_t i32;
+    int64_t i64;
+    float f32;
+    double f64;
+    uint8_t v128[16];
+};
+
+// The inline cache of one call_indirect site: the functions it has called
+// before, which are known to have the expected type. A hit needs one compare
+// against the function reference from the table and no signature check.
+// Sites that have seen more than MAX_TARGETS functions stay polymorphic on
+// the first ones and check the type of any other target on every call.
+struct CallCache {
+    static const uint32_t MAX_TARGETS = 4;
+    uint32_t type_idx;
+    uint32_t num_targets;
+    uint32_t targets[MAX_TARGETS];
+
+    bool lookup(uint32_t func_idx) const {
+        for (uint32_t i = 0; i < num_targets; i++) {
+            if (targets[i] == func_idx) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void insert(uint32_t func_idx) {
+        if (num_targets < MAX_TARGETS) {
+            targets[num_targets++] = func_idx;
+        }
+    }
+};
+
+// The immediate of a lowered instruction. A v128 immediate does not fit, so
+// v128.const and i8x16.shuffle keep their upper 8 bytes in the immediate of
+// an extra instruction right after them.
+union Imm {
+    int32_t i32;
+    int64_t i64;
+    float f32;
+    double f64;
+    CallCache* cache;
+    struct {
+        uint32_t keep;  // values on top of the stack the branch carries
+        uint32_t drop;  // values below them it discards
+    } br;
+};
+
+// A lowered instruction. `op` is the WASM opcode for the single byte opcodes,
+// OP_FC_PREFIX + num and OP_FD_PREFIX + num for the prefixed ones and
+// anything from OP_INTERNAL on only exists in lowered code.
+//
+// Structured control flow lowers to jumps whose `arg` is the offset of the
+// target from the jump itself:
+// - `if` (0x04) pops the condition and jumps to the else branch or the end
+//   if it is zero;
+// - `br` (0x0C) moves imm.br.keep values down over imm.br.drop ones and
+//   jumps, `else` lowers to one to the end of the if;
+// - `br_if` (0x0D) pops the condition and does the same if it is nonzero;
+// - `br_table` (0x0E) pops the index and jumps to the matching one of the
+//   `arg` + 1 `br`s (or `return`s) that follow it, the last is the default.
+struct Inst {
+    uint32_t op;
+    uint32_t arg;
+    Imm imm;
+};
+
+const uint32_t OP_INTERNAL = 0x300;
+const uint32_t OP_LAZY_COMPILE = OP_INTERNAL + 0;
+// SIMD instructions that only work on values, `arg` is the 0xFD num indexing
+// the matching SimdOps table
+const uint32_t OP_V128_UNARY = OP_INTERNAL + 1;
+const uint32_t OP_V128_BINARY = OP_INTERNAL + 2;
+const uint32_t OP_V128_TERNARY = OP_INTERNAL + 3;
+const uint32_t OP_V128_TEST = OP_INTERNAL + 4;
+const uint32_t OP_V128_SHIFT = OP_INTERNAL + 5;
+// Starts a basic block when fuel metering is on, `arg` is the number of
+// instructions in the block
+const uint32_t OP_CHARGE_FUEL = OP_INTERNAL + 6;
+// The body of an imported function, `arg` is its function index
+const uint32_t OP_HOST_CALL = OP_INTERNAL + 7;
+const uint32_t NUM_LOWERED_OPS = OP_INTERNAL + 8;
+
+// The internal opcodes as X(Name, opcode), next to WASM_THREADED_OPS
+#define WASM_INTERNAL_OPS(X)           \
+    X(LazyCompile, OP_LAZY_COMPILE)    \
+    X(V128Unary, OP_V128_UNARY)        \
+    X(V128Binary, OP_V128_BINARY)      \
+    X(V128Ternary, OP_V128_TERNARY)    \
+    X(V128Test, OP_V128_TEST)          \
+    X(V128Shift, OP_V128_SHIFT)        \
+    X(ChargeFuel, OP_CHARGE_FUEL)      \
+    X(HostCall, OP_HOST_CALL)
+
+struct CompiledFunc {
+    std::vector<Inst> insts;
+    std::vector<CallCache> call_caches;  // one per call_indirect, in order
+};
+
+struct FuncInfo {
+    uint32_t num_params;
+    uint32_t num_results;
+    uint32_t num_locals;  // including the params
+    uint32_t max_stack;   // upper bound of the operand stack depth
+};
+
+// Every call table entry starts out pointing to this stub. Entering it
+// compiles the called function and patches the call table, so later calls go
+// straight to the compiled body.
+const Inst lazy_compile_stub[] = {{OP_LAZY_COMPILE, 0, {}}};
+
+// Lowered code the interpreter does not own, such as the code of a mapped
+// module cache entry. Its call caches are written to, so an image belongs to
+// a single interpreter.
+struct CodeImage {
+    bool metered;
+    std::vector<const Inst*> entries;  // per function, nullptr if not lowered
+    std::vector<size_t> sizes;         // instruction count per function
+
+    virtual ~CodeImage() {}
+};
+
+namespace WASM_INSTS_VISITOR {
+class LoweringVisitor : public BaseWASMVisitor<LoweringVisitor> {
+   public:
+    std::vector<Inst> insts;
+    std::vector<CallCache> call_caches;
+    bool metered = false;
+    size_t block_start = 0;  // the OP_CHARGE_FUEL of the current block
+
+    // A block, loop or if being lowered, or the function body itself
+    struct Label {
+        uint8_t kind;      // 0x02, 0x03 or 0x04 like the opcode, 0x00 for the body
+        uint32_t height;   // operand stack height below the params
+        uint32_t params;
+        uint32_t results;
+        size_t start;      // the first instruction, where branches to a loop go
+        size_t if_branch;  // the `if` jump while it still needs its target
+        std::vector<size_t> fixups;  // branches to the end
+        bool unreachable;  // the rest of the block is dead code
+    };
+
+    static const size_t NO_BRANCH = ~(size_t)0;
+
+    std::vector<Label> labels;
+    // operand stack height above the locals, which tells every branch how
+    // many values it drops
+    int64_t height = 0;
+    int64_t max_height = 0;
+    uint64_t num_locals = 0;  // including the params
+    std::vector<uint32_t> callees;         // in order, with repeats
+    std::vector<uint32_t> indirect_types;  // of every call_indirect
+    // with record_starts, the first lowered instruction of every instruction
+    // of the body and its module byte offset
+    bool record_starts = false;
+    std::vector<std::pair<size_t, uint32_t>> starts;
+
+    void begin_instruction(uint32_t offset) {
+        if (record_starts) {
+            starts.push_back({insts.size(), offset});
+        }
+    }
+
+    void emit(uint32_t op, uint32_t arg = 0, Imm imm = {}) {
+        require(op == 0x0F ? labels.front().results : stack_pops(op));
+        insts.push_back({op, arg, imm});
+        adjust_height(stack_delta(op));
+    }
+
+    // Reachable code must not pop into the values of the enclosing blocks
+    // or below the frame, which the lowered code would read unchecked
+    void require(int64_t values) {
+        if (!labels.back().unreachable && height - values < (int64_t)labels.back().height) {
+            throw LFortranException("operand stack underflow");
+        }
+    }
+
+    void adjust_height(int64_t delta) {
+        height += delta;
+        // dead code may pop values that were never pushed
+        if (labels.back().unreachable && height < labels.back().height) {
+            height = labels.back().height;
+        }
+        max_height = std::max(max_height, height);
+    }
+
+    // How many values an instruction pushes minus how many it pops, not
+    // counting the callee of a call
+    static int stack_delta(uint32_t op) {
+        if (op >= 0x46 && op <= 0x4F) return -1;  // i32 comparisons
+        if (op >= 0x51 && op <= 0x66) return -1;  // i64, f32, f64 comparisons
+        if (op >= 0x6A && op <= 0x78) return -1;  // i32 binary
+        if (op >= 0x7C && op <= 0x8A) return -1;  // i64 binary
+        if (op >= 0x92 && op <= 0x98) return -1;  // f32 binary
+        if (op >= 0xA0 && op <= 0xA6) return -1;  // f64 binary
+        if (op >= 0x36 && op <= 0x3E) return -2;  // stores
+        switch (op) {
+            case 0x04: case 0x0D: case 0x0E: case 0x11: case 0x1A: case 0x21: case 0x24: return -1;
+            case 0x1B: case 0x26: return -2;
+            case 0x20: case 0x23: case 0x3F: case 0x41: case 0x42: case 0x43: case 0x44: case 0xD0: case 0xD2: return 1;
+            case OP_FC_PREFIX + 8: case OP_FC_PREFIX + 10: case OP_FC_PREFIX + 11:
+            case OP_FC_PREFIX + 12: case OP_FC_PREFIX + 14: case OP_FC_PREFIX + 17: return -3;
+            case OP_FC_PREFIX + 15: return -1;
+            case OP_FC_PREFIX + 16: return 1;
+            case OP_FD_PREFIX + 11: return -2;
+            case OP_FD_PREFIX + 12: return 1;
+            case OP_FD_PREFIX + 13: return -1;
+            case OP_FD_PREFIX + 23: case OP_FD_PREFIX + 26: case OP_FD_PREFIX + 28:
+            case OP_FD_PREFIX + 30: case OP_FD_PREFIX + 32: case OP_FD_PREFIX + 34: return -1;
+            case OP_FD_PREFIX + 84: case OP_FD_PREFIX + 85: case OP_FD_PREFIX + 86: case OP_FD_PREFIX + 87: return -1;
+            case OP_FD_PREFIX + 88: case OP_FD_PREFIX + 89: case OP_FD_PREFIX + 90: case OP_FD_PREFIX + 91: return -2;
+            case OP_V128_BINARY: case OP_V128_SHIFT: return -1;
+            case OP_V128_TERNARY: return -2;
+            default: return 0;
+        }
+    }
+
+    // How many values an instruction pops, not counting the values a branch
+    // keeps or the params of a callee
+    static int stack_pops(uint32_t op) {
+        bool result = true;
+        if (op >= 0x36 && op <= 0x3E) result = false;  // stores
+        switch (op) {
+            case 0x00: case 0x04: case 0x0C: case 0x0D: case 0x0E: case 0x0F: case 0x10: case 0x11:
+            case 0x1A: case 0x21: case 0x24: case 0x26:
+            case OP_FC_PREFIX + 8: case OP_FC_PREFIX + 9: case OP_FC_PREFIX + 10: case OP_FC_PREFIX + 11:
+            case OP_FC_PREFIX + 12: case OP_FC_PREFIX + 13: case OP_FC_PREFIX + 14: case OP_FC_PREFIX + 17:
+            case OP_FD_PREFIX + 11: case OP_FD_PREFIX + 88: case OP_FD_PREFIX + 89: case OP_FD_PREFIX + 90:
+            case OP_FD_PREFIX + 91: case OP_CHARGE_FUEL:
+                result = false;
+        }
+        return (result ? 1 : 0) - stack_delta(op);
+    }
+
+    void begin_function(uint32_t num_results, uint64_t num_locals) {
+        labels.push_back({0x00, 0, 0, num_results, 0, NO_BRANCH, {}, false});
+        this->num_locals = num_locals;
+    }
+
+    void check_local(uint32_t localidx, const char* what) {
+        if (localidx >= num_locals) {
+            throw LFortranException(std::string(what) + ": local index out of range");
+        }
+    }
+
+    // The rest of the current block cannot be reached
+    void end_reachable() {
+        labels.back().unreachable = true;
+        height = labels.back().height;
+        begin_block();
+    }
+
+    void block_type(int64_t blocktype, uint32_t& params, uint32_t& results) {
+        if (blocktype == -64) {  // 0x40, no params and no results
+            params = results = 0;
+        } else if (blocktype < 0) {  // a single value type
+            params = 0;
+            results = 1;
+        } else {
+            check_index(blocktype, func_types.size(), "block type");
+            params = func_types[blocktype].param_types.size();
+            results = func_types[blocktype].result_types.size();
+        }
+    }
+
+    void push_label(uint8_t kind, int64_t blocktype, size_t start) {
+        uint32_t params, results;
+        block_type(blocktype, params, results);
+        if (height < params || (!labels.back().unreachable && height - params < labels.back().height)) {
+            throw LFortranException("block: not enough values for its params");
+        }
+        labels.push_back({kind, (uint32_t)(height - params), params, results, start, NO_BRANCH, {}, false});
+    }
+
+    // Makes the jump at `from` go to `to`
+    void patch(size_t from, size_t to) { insts[from].arg = (uint32_t)(int32_t)(to - from); }
+
+    // Emits a `br` or `br_if` to `labelidx`. A branch to the function body
+    // is a return.
+    void emit_branch(uint32_t op, uint32_t labelidx) {
+        check_index(labelidx, labels.size(), "br: label");
+        Label& target = labels[labels.size() - 1 - labelidx];
+        require((target.kind == 0x03 ? target.params : target.results) + (op == 0x0D ? 1 : 0));
+        if (target.kind == 0x00) {
+            if (op == 0x0D) {
+                emit(0x04, 2);  // skips the return unless the condition holds
+            }
+            insts.push_back({0x0F, 0, {}});
+            return;
+        }
+        int64_t from = height - (op == 0x0D ? 1 : 0);
+        uint32_t arity = target.kind == 0x03 ? target.params : target.results;
+        Imm v = {};
+        v.br.keep = arity;
+        v.br.drop = std::max<int64_t>(from - target.height - arity, 0);
+        size_t at = insts.size();
+        emit(op, 0, v);
+        if (target.kind == 0x03) {
+            patch(at, target.start);
+        } else {
+            target.fixups.push_back(at);
+        }
+    }
+
+    void visit_Block(int64_t blocktype) { push_label(0x02, blocktype, insts.size()); }
+
+    void visit_Loop(int64_t blocktype) {
+        // every iteration starts a basic block and pays for it
+        size_t start = insts.size();
+        begin_block();
+        push_label(0x03, blocktype, start);
+    }
+
+    void visit_If(int64_t blocktype) {
+        size_t at = insts.size();
+        emit(0x04);
+        push_label(0x04, blocktype, insts.size());
+        labels.back().if_branch = at;
+        begin_block();
+    }
+
+    void visit_Else() {
+        Label& label = labels.back();
+        if (label.kind != 0x04 || label.if_branch == NO_BRANCH) {
+            throw LFortranException("else: not in an if");
+        }
+        emit_branch(0x0C, 0);  // the then branch skips the else branch
+        patch(label.if_branch, insts.size());
+        label.if_branch = NO_BRANCH;
+        label.unreachable = false;
+        height = label.height + label.params;
+        begin_block();
+    }
+
+    void visit_End() {
+        if (labels.size() < 2) {
+            throw LFortranException("end: no block to end");
+        }
+        require(labels.back().results);
+        Label label = std::move(labels.back());
+        labels.pop_back();
+        size_t target = insts.size();
+        if (label.if_branch != NO_BRANCH) {
+            patch(label.if_branch, target);
+        }
+        for (size_t at : label.fixups) {
+            patch(at, target);
+        }
+        height = label.height + label.results;
+        max_height = std::max(max_height, height);
+        if (label.if_branch != NO_BRANCH || !label.fixups.empty()) {
+            begin_block();
+        }
+    }
+
+    void visit_Br(uint32_t labelidx) {
+        emit_branch(0x0C, labelidx);
+        end_reachable();
+    }
+
+    void visit_BrIf(uint32_t labelidx) { emit_branch(0x0D, labelidx); }
+
+    void visit_BrTable(const std::vector<uint32_t>& labelidxs, uint32_t default_labelidx) {
+        emit(0x0E, labelidxs.size());
+        for (uint32_t l : labelidxs) {
+            emit_branch(0x0C, l);
+        }
+        emit_branch(0x0C, default_labelidx);
+        end_reachable();
+    }
+
+    // With fuel metering every basic block starts with an OP_CHARGE_FUEL for
+    // its length, which is known once the next block begins. Calls return to
+    // the instruction after them, so they do not end a block: the code after
+    // a call is paid for before the call, and the callee pays for itself.
+    // Neither does a `br_if`: a taken branch pays for the instructions it
+    // skips up to the next block, which halves the charges of a loop that
+    // tests its exit at the top.
+    void begin_block() {
+        if (!metered) {
+            return;
+        }
+        end_block();
+        block_start = insts.size();
+        emit(OP_CHARGE_FUEL);
+    }
+
+    void end_block() {
+        if (metered && block_start < insts.size()) {
+            insts[block_start].arg = insts.size() - block_start - 1;
+        }
+    }
+
+    void visit_Unreachable() {
+        emit(0x00);
+        end_reachable();
+    }
+
+    void visit_Nop() {}
+
+    void visit_Return() {
+        emit(0x0F);
+        end_reachable();
+    }
+
+    void visit_Call(uint32_t funcidx) {
+        if (funcidx >= num_funcs()) {
+            throw LFortranException("call: function index out of range");
+        }
+        emit(0x10, funcidx);
+        callees.push_back(funcidx);
+        call_effect(func_type_index(funcidx));
+    }
+
+    void call_effect(uint32_t typeidx) {
+        const FuncType& type = func_types[typeidx];
+        require(type.param_types.size());
+        adjust_height((int64_t)type.result_types.size() - (int64_t)type.param_types.size());
+    }
+
+    // The immediate is the index of the site's cache until lower() turns it
+    // into a pointer, once the caches no longer move.
+    void visit_CallIndirect(uint32_t typeidx, uint32_t tableidx) {
+        check_index(typeidx, func_types.size(), "call_indirect: type");
+        check_index(tableidx, tables.size(), "call_indirect: table");
+        Imm v = {};
+        v.i32 = call_caches.size();
+        call_caches.push_back({typeidx, 0, {}});
+        emit(0x11, tableidx, v);
+        indirect_types.push_back(typeidx);
+        call_effect(typeidx);
+    }
+
+    void visit_RefNull(uint8_t /*reftype*/) { emit(0xD0); }
+
+    void visit_RefIsNull() { emit(0xD1); }
+
+    void visit_RefFunc(uint32_t funcidx) {
+        check_index(funcidx, num_funcs(), "ref.func: function");
+        emit(0xD2, funcidx);
+    }
+
+    void visit_Drop() { emit(0x1A); }
+
+    void visit_Select() { emit(0x1B); }
+
+    void visit_LocalGet(uint32_t localidx) {
+        check_local(localidx, "local.get");
+        emit(0x20, localidx);
+    }
+
+    void visit_LocalSet(uint32_t localidx) {
+        check_local(localidx, "local.set");
+        emit(0x21, localidx);
+    }
+
+    void visit_LocalTee(uint32_t localidx) {
+        check_local(localidx, "local.tee");
+        emit(0x22, localidx);
+    }
+
+    void visit_GlobalGet(uint32_t globalidx) {
+        if (globalidx >= globals.size()) {
+            throw LFortranException("global.get: global index out of range");
+        }
+        emit(0x23, globalidx);
+    }
+
+    void visit_GlobalSet(uint32_t globalidx) {
+        if (globalidx >= globals.size() || !globals[globalidx].mut) {
+            throw LFortranException("global.set: no mutable global with this index");
+        }
+        emit(0x24, globalidx);
+    }
+
+    void check_index(uint32_t idx, size_t size, const std::string& what) {
+        if (idx >= size) {
+            throw LFortranException(what + " index out of range");
+        }
+    }
+
+    void visit_TableGet(uint32_t tableidx) {
+        check_index(tableidx, tables.size(), "table.get: table");
+        emit(0x25, tableidx);
+    }
+
+    void visit_TableSet(uint32_t tableidx) {
+        check_index(tableidx, tables.size(), "table.set: table");
+        emit(0x26, tableidx);
+    }
+
+    void visit_TableInit(uint32_t elemidx, uint32_t tableidx) {
+        check_index(elemidx, elements.size(), "table.init: element");
+        check_index(tableidx, tables.size(), "table.init: table");
+        Imm v = {};
+        v.i32 = tableidx;
+        emit(OP_FC_PREFIX + 12, elemidx, v);
+    }
+
+    void visit_ElemDrop(uint32_t elemidx) {
+        check_index(elemidx, elements.size(), "elem.drop: element");
+        emit(OP_FC_PREFIX + 13, elemidx);
+    }
+
+    void visit_TableCopy(uint32_t des_tableidx, uint32_t src_tableidx) {
+        check_index(des_tableidx, tables.size(), "table.copy: table");
+        check_index(src_tableidx, tables.size(), "table.copy: table");
+        Imm v = {};
+        v.i32 = src_tableidx;
+        emit(OP_FC_PREFIX + 14, des_tableidx, v);
+    }
+
+    void visit_TableGrow(uint32_t tableidx) {
+        check_index(tableidx, tables.size(), "table.grow: table");
+        emit(OP_FC_PREFIX + 15, tableidx);
+    }
+
+    void visit_TableSize(uint32_t tableidx) {
+        check_index(tableidx, tables.size(), "table.size: table");
+        emit(OP_FC_PREFIX + 16, tableidx);
+    }
+
+    void visit_TableFill(uint32_t tableidx) {
+        check_index(tableidx, tables.size(), "table.fill: table");
+        emit(OP_FC_PREFIX + 17, tableidx);
+    }
+
+    void emit_memory_op(uint32_t op, uint32_t mem_offset, int32_t imm = 0) {
+        if (memories.empty()) {
+            throw LFortranException("memory access in a module without memory");
+        }
+        Imm v = {};
+        v.i32 = imm;
+        emit(op, mem_offset, v);
+    }
+
+    void visit_I32Load(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x28, mem_offset); }
+    void visit_I64Load(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x29, mem_offset); }
+    void visit_F32Load(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x2A, mem_offset); }
+    void visit_F64Load(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x2B, mem_offset); }
+    void visit_I32Load8S(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x2C, mem_offset); }
+    void visit_I32Load8U(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x2D, mem_offset); }
+    void visit_I32Load16S(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x2E, mem_offset); }
+    void visit_I32Load16U(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x2F, mem_offset); }
+    void visit_I64Load8S(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x30, mem_offset); }
+    void visit_I64Load8U(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x31, mem_offset); }
+    void visit_I64Load16S(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x32, mem_offset); }
+    void visit_I64Load16U(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x33, mem_offset); }
+    void visit_I64Load32S(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x34, mem_offset); }
+    void visit_I64Load32U(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x35, mem_offset); }
+    void visit_I32Store(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x36, mem_offset); }
+    void visit_I64Store(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x37, mem_offset); }
+    void visit_F32Store(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x38, mem_offset); }
+    void visit_F64Store(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x39, mem_offset); }
+    void visit_I32Store8(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x3A, mem_offset); }
+    void visit_I32Store16(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x3B, mem_offset); }
+    void visit_I64Store8(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x3C, mem_offset); }
+    void visit_I64Store16(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x3D, mem_offset); }
+    void visit_I64Store32(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(0x3E, mem_offset); }
+
+    void visit_MemorySize() { emit_memory_op(0x3F, 0); }
+
+    void visit_MemoryGrow() { emit_memory_op(0x40, 0); }
+
+    void visit_MemoryInit(uint32_t dataidx) {
+        check_index(dataidx, datas.size(), "memory.init: data");
+        emit_memory_op(OP_FC_PREFIX + 8, dataidx);
+    }
+
+    void visit_DataDrop(uint32_t dataidx) {
+        check_index(dataidx, datas.size(), "data.drop: data");
+        emit(OP_FC_PREFIX + 9, dataidx);
+    }
+
+    void visit_MemoryCopy() { emit_memory_op(OP_FC_PREFIX + 10, 0); }
+
+    void visit_MemoryFill() { emit_memory_op(OP_FC_PREFIX + 11, 0); }
+
+    void visit_I32Const(int32_t n) {
+        Imm v = {};
+        v.i32 = n;
+        emit(0x41, 0, v);
+    }
+
+    void visit_I64Const(int64_t n) {
+        Imm v;
+        v.i64 = n;
+        emit(0x42, 0, v);
+    }
+
+    void visit_F32Const(float z) {
+        Imm v = {};
+        v.f32 = z;
+        emit(0x43, 0, v);
+    }
+
+    void visit_F64Const(double z) {
+        Imm v;
+        v.f64 = z;
+        emit(0x44, 0, v);
+    }
+
+    void visit_I32Eqz() { emit(0x45); }
+    void visit_I32Eq() { emit(0x46); }
+    void visit_I32Ne() { emit(0x47); }
+    void visit_I32LtS() { emit(0x48); }
+    void visit_I32LtU() { emit(0x49); }
+    void visit_I32GtS() { emit(0x4A); }
+    void visit_I32GtU() { emit(0x4B); }
+    void visit_I32LeS() { emit(0x4C); }
+    void visit_I32LeU() { emit(0x4D); }
+    void visit_I32GeS() { emit(0x4E); }
+    void visit_I32GeU() { emit(0x4F); }
+    void visit_I64Eqz() { emit(0x50); }
+    void visit_I64Eq() { emit(0x51); }
+    void visit_I64Ne() { emit(0x52); }
+    void visit_I64LtS() { emit(0x53); }
+    void visit_I64LtU() { emit(0x54); }
+    void visit_I64GtS() { emit(0x55); }
+    void visit_I64GtU() { emit(0x56); }
+    void visit_I64LeS() { emit(0x57); }
+    void visit_I64LeU() { emit(0x58); }
+    void visit_I64GeS() { emit(0x59); }
+    void visit_I64GeU() { emit(0x5A); }
+    void visit_F32Eq() { emit(0x5B); }
+    void visit_F32Ne() { emit(0x5C); }
+    void visit_F32Lt() { emit(0x5D); }
+    void visit_F32Gt() { emit(0x5E); }
+    void visit_F32Le() { emit(0x5F); }
+    void visit_F32Ge() { emit(0x60); }
+    void visit_F64Eq() { emit(0x61); }
+    void visit_F64Ne() { emit(0x62); }
+    void visit_F64Lt() { emit(0x63); }
+    void visit_F64Gt() { emit(0x64); }
+    void visit_F64Le() { emit(0x65); }
+    void visit_F64Ge() { emit(0x66); }
+    void visit_I32Clz() { emit(0x67); }
+    void visit_I32Ctz() { emit(0x68); }
+    void visit_I32Popcnt() { emit(0x69); }
+    void visit_I32Add() { emit(0x6A); }
+    void visit_I32Sub() { emit(0x6B); }
+    void visit_I32Mul() { emit(0x6C); }
+    void visit_I32DivS() { emit(0x6D); }
+    void visit_I32DivU() { emit(0x6E); }
+    void visit_I32RemS() { emit(0x6F); }
+    void visit_I32RemU() { emit(0x70); }
+    void visit_I32And() { emit(0x71); }
+    void visit_I32Or() { emit(0x72); }
+    void visit_I32Xor() { emit(0x73); }
+    void visit_I32Shl() { emit(0x74); }
+    void visit_I32ShrS() { emit(0x75); }
+    void visit_I32ShrU() { emit(0x76); }
+    void visit_I32Rotl() { emit(0x77); }
+    void visit_I32Rotr() { emit(0x78); }
+    void visit_I64Clz() { emit(0x79); }
+    void visit_I64Ctz() { emit(0x7A); }
+    void visit_I64Popcnt() { emit(0x7B); }
+    void visit_I64Add() { emit(0x7C); }
+    void visit_I64Sub() { emit(0x7D); }
+    void visit_I64Mul() { emit(0x7E); }
+    void visit_I64DivS() { emit(0x7F); }
+    void visit_I64DivU() { emit(0x80); }
+    void visit_I64RemS() { emit(0x81); }
+    void visit_I64RemU() { emit(0x82); }
+    void visit_I64And() { emit(0x83); }
+    void visit_I64Or() { emit(0x84); }
+    void visit_I64Xor() { emit(0x85); }
+    void visit_I64Shl() { emit(0x86); }
+    void visit_I64ShrS() { emit(0x87); }
+    void visit_I64ShrU() { emit(0x88); }
+    void visit_I64Rotl() { emit(0x89); }
+    void visit_I64Rotr() { emit(0x8A); }
+    void visit_F32Abs() { emit(0x8B); }
+    void visit_F32Neg() { emit(0x8C); }
+    void visit_F32Ceil() { emit(0x8D); }
+    void visit_F32Floor() { emit(0x8E); }
+    void visit_F32Trunc() { emit(0x8F); }
+    void visit_F32Nearest() { emit(0x90); }
+    void visit_F32Sqrt() { emit(0x91); }
+    void visit_F32Add() { emit(0x92); }
+    void visit_F32Sub() { emit(0x93); }
+    void visit_F32Mul() { emit(0x94); }
+    void visit_F32Div() { emit(0x95); }
+    void visit_F32Min() { emit(0x96); }
+    void visit_F32Max() { emit(0x97); }
+    void visit_F32Copysign() { emit(0x98); }
+    void visit_F64Abs() { emit(0x99); }
+    void visit_F64Neg() { emit(0x9A); }
+    void visit_F64Ceil() { emit(0x9B); }
+    void visit_F64Floor() { emit(0x9C); }
+    void visit_F64Trunc() { emit(0x9D); }
+    void visit_F64Nearest() { emit(0x9E); }
+    void visit_F64Sqrt() { emit(0x9F); }
+    void visit_F64Add() { emit(0xA0); }
+    void visit_F64Sub() { emit(0xA1); }
+    void visit_F64Mul() { emit(0xA2); }
+    void visit_F64Div() { emit(0xA3); }
+    void visit_F64Min() { emit(0xA4); }
+    void visit_F64Max() { emit(0xA5); }
+    void visit_F64Copysign() { emit(0xA6); }
+    void visit_I32WrapI64() { emit(0xA7); }
+    void visit_I32TruncF32S() { emit(0xA8); }
+    void visit_I32TruncF32U() { emit(0xA9); }
+    void visit_I32TruncF64S() { emit(0xAA); }
+    void visit_I32TruncF64U() { emit(0xAB); }
+    void visit_I64ExtendI32S() { emit(0xAC); }
+    void visit_I64ExtendI32U() { emit(0xAD); }
+    void visit_I64TruncF32S() { emit(0xAE); }
+    void visit_I64TruncF32U() { emit(0xAF); }
+    void visit_I64TruncF64S() { emit(0xB0); }
+    void visit_I64TruncF64U() { emit(0xB1); }
+    void visit_F32ConvertI32S() { emit(0xB2); }
+    void visit_F32ConvertI32U() { emit(0xB3); }
+    void visit_F32ConvertI64S() { emit(0xB4); }
+    void visit_F32ConvertI64U() { emit(0xB5); }
+    void visit_F32DemoteF64() { emit(0xB6); }
+    void visit_F64ConvertI32S() { emit(0xB7); }
+    void visit_F64ConvertI32U() { emit(0xB8); }
+    void visit_F64ConvertI64S() { emit(0xB9); }
+    void visit_F64ConvertI64U() { emit(0xBA); }
+    void visit_F64PromoteF32() { emit(0xBB); }
+    // reinterpretations are no-ops on the untyped stack slots
+    void visit_I32ReinterpretF32() {}
+    void visit_I64ReinterpretF64() {}
+    void visit_F32ReinterpretI32() {}
+    void visit_F64ReinterpretI64() {}
+    void visit_I32Extend8S() { emit(0xC0); }
+    void visit_I32Extend16S() { emit(0xC1); }
+    void visit_I64Extend8S() { emit(0xC2); }
+    void visit_I64Extend16S() { emit(0xC3); }
+    void visit_I64Extend32S() { emit(0xC4); }
+
+    void visit_I32TruncSatF32S() { emit(OP_FC_PREFIX + 0); }
+    void visit_I32TruncSatF32U() { emit(OP_FC_PREFIX + 1); }
+    void visit_I32TruncSatF64S() { emit(OP_FC_PREFIX + 2); }
+    void visit_I32TruncSatF64U() { emit(OP_FC_PREFIX + 3); }
+    void visit_I64TruncSatF32S() { emit(OP_FC_PREFIX + 4); }
+    void visit_I64TruncSatF32U() { emit(OP_FC_PREFIX + 5); }
+    void visit_I64TruncSatF64S() { emit(OP_FC_PREFIX + 6); }
+    void visit_I64TruncSatF64U() { emit(OP_FC_PREFIX + 7); }
+
+    // The extending loads keep the 0xFD num of the matching extend_low
+    // instruction in their immediate and apply it to the 8 loaded bytes.
+    void visit_V128Load(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(OP_FD_PREFIX + 0, mem_offset); }
+    void visit_V128Load8x8S(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(OP_FD_PREFIX + 1, mem_offset, 135); }
+    void visit_V128Load8x8U(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(OP_FD_PREFIX + 1, mem_offset, 137); }
+    void visit_V128Load16x4S(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(OP_FD_PREFIX + 1, mem_offset, 167); }
+    void visit_V128Load16x4U(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(OP_FD_PREFIX + 1, mem_offset, 169); }
+    void visit_V128Load32x2S(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(OP_FD_PREFIX + 1, mem_offset, 199); }
+    void visit_V128Load32x2U(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(OP_FD_PREFIX + 1, mem_offset, 201); }
+    void visit_V128Load8Splat(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(OP_FD_PREFIX + 7, mem_offset); }
+    void visit_V128Load16Splat(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(OP_FD_PREFIX + 8, mem_offset); }
+    void visit_V128Load32Splat(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(OP_FD_PREFIX + 9, mem_offset); }
+    void visit_V128Load64Splat(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(OP_FD_PREFIX + 10, mem_offset); }
+    void visit_V128Load32Zero(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(OP_FD_PREFIX + 92, mem_offset); }
+    void visit_V128Load64Zero(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(OP_FD_PREFIX + 93, mem_offset); }
+    void visit_V128Store(uint32_t /*mem_align*/, uint32_t mem_offset) { emit_memory_op(OP_FD_PREFIX + 11, mem_offset); }
+
+    void emit_lane_memory_op(uint32_t num, uint32_t mem_offset, uint8_t laneidx, uint32_t lanes) {
+        check_index(laneidx, lanes, "v128 memory access: lane");
+        emit_memory_op(OP_FD_PREFIX + num, mem_offset, laneidx);
+    }
+
+    void visit_V128Load8Lane(uint32_t /*mem_align*/, uint32_t mem_offset, uint8_t laneidx) { emit_lane_memory_op(84, mem_offset, laneidx, 16); }
+    void visit_V128Load16Lane(uint32_t /*mem_align*/, uint32_t mem_offset, uint8_t laneidx) { emit_lane_memory_op(85, mem_offset, laneidx, 8); }
+    void visit_V128Load32Lane(uint32_t /*mem_align*/, uint32_t mem_offset, uint8_t laneidx) { emit_lane_memory_op(86, mem_offset, laneidx, 4); }
+    void visit_V128Load64Lane(uint32_t /*mem_align*/, uint32_t mem_offset, uint8_t laneidx) { emit_lane_memory_op(87, mem_offset, laneidx, 2); }
+    void visit_V128Store8Lane(uint32_t /*mem_align*/, uint32_t mem_offset, uint8_t laneidx) { emit_lane_memory_op(88, mem_offset, laneidx, 16); }
+    void visit_V128Store16Lane(uint32_t /*mem_align*/, uint32_t mem_offset, uint8_t laneidx) { emit_lane_memory_op(89, mem_offset, laneidx, 8); }
+    void visit_V128Store32Lane(uint32_t /*mem_align*/, uint32_t mem_offset, uint8_t laneidx) { emit_lane_memory_op(90, mem_offset, laneidx, 4); }
+    void visit_V128Store64Lane(uint32_t /*mem_align*/, uint32_t mem_offset, uint8_t laneidx) { emit_lane_memory_op(91, mem_offset, laneidx, 2); }
+
+    void emit_v128(uint32_t op, const v128_t& bytes) {
+        Imm lo, hi;
+        std::memcpy(&lo, bytes.bytes, 8);
+        std::memcpy(&hi, bytes.bytes + 8, 8);
+        emit(op, 0, lo);
+        insts.push_back({op, 0, hi});  // never executed, only carries the upper half
+    }
+
+    void visit_V128Const(v128_t bytes) { emit_v128(OP_FD_PREFIX + 12, bytes); }
+
+    void visit_I8x16Shuffle(v128_t laneidxs) {
+        for (uint8_t l : laneidxs.bytes) {
+            check_index(l, 32, "i8x16.shuffle: lane");
+        }
+        emit_v128(OP_FD_PREFIX + 13, laneidxs);
+    }
+
+    void emit_lane_op(uint32_t num, uint8_t laneidx, uint32_t lanes) {
+        check_index(laneidx, lanes, "extract_lane/replace_lane: lane");
+        emit(OP_FD_PREFIX + num, laneidx);
+    }
+
+    void visit_I8x16ExtractLaneS(uint8_t laneidx) { emit_lane_op(21, laneidx, 16); }
+    void visit_I8x16ExtractLaneU(uint8_t laneidx) { emit_lane_op(22, laneidx, 16); }
+    void visit_I8x16ReplaceLane(uint8_t laneidx) { emit_lane_op(23, laneidx, 16); }
+    void visit_I16x8ExtractLaneS(uint8_t laneidx) { emit_lane_op(24, laneidx, 8); }
+    void visit_I16x8ExtractLaneU(uint8_t laneidx) { emit_lane_op(25, laneidx, 8); }
+    void visit_I16x8ReplaceLane(uint8_t laneidx) { emit_lane_op(26, laneidx, 8); }
+    void visit_I32x4ExtractLane(uint8_t laneidx) { emit_lane_op(27, laneidx, 4); }
+    void visit_I32x4ReplaceLane(uint8_t laneidx) { emit_lane_op(28, laneidx, 4); }
+    void visit_I64x2ExtractLane(uint8_t laneidx) { emit_lane_op(29, laneidx, 2); }
+    void visit_I64x2ReplaceLane(uint8_t laneidx) { emit_lane_op(30, laneidx, 2); }
+    void visit_F32x4ExtractLane(uint8_t laneidx) { emit_lane_op(31, laneidx, 4); }
+    void visit_F32x4ReplaceLane(uint8_t laneidx) { emit_lane_op(32, laneidx, 4); }
+    void visit_F64x2ExtractLane(uint8_t laneidx) { emit_lane_op(33, laneidx, 2); }
+    void visit_F64x2ReplaceLane(uint8_t laneidx) { emit_lane_op(34, laneidx, 2); }
+
+    void visit_I8x16Swizzle() { emit(OP_V128_BINARY, 14); }
+    void visit_I8x16Splat() { emit(OP_V128_UNARY, 15); }
+    void visit_I16x8Splat() { emit(OP_V128_UNARY, 16); }
+    void visit_I32x4Splat() { emit(OP_V128_UNARY, 17); }
+    void visit_I64x2Splat() { emit(OP_V128_UNARY, 18); }
+    void visit_F32x4Splat() { emit(OP_V128_UNARY, 19); }
+    void visit_F64x2Splat() { emit(OP_V128_UNARY, 20); }
+    void visit_I8x16Eq() { emit(OP_V128_BINARY, 35); }
+    void visit_I8x16Ne() { emit(OP_V128_BINARY, 36); }
+    void visit_I8x16LtS() { emit(OP_V128_BINARY, 37); }
+    void visit_I8x16LtU() { emit(OP_V128_BINARY, 38); }
+    void visit_I8x16GtS() { emit(OP_V128_BINARY, 39); }
+    void visit_I8x16GtU() { emit(OP_V128_BINARY, 40); }
+    void visit_I8x16LeS() { emit(OP_V128_BINARY, 41); }
+    void visit_I8x16LeU() { emit(OP_V128_BINARY, 42); }
+    void visit_I8x16GeS() { emit(OP_V128_BINARY, 43); }
+    void visit_I8x16GeU() { emit(OP_V128_BINARY, 44); }
+    void visit_I16x8Eq() { emit(OP_V128_BINARY, 45); }
+    void visit_I16x8Ne() { emit(OP_V128_BINARY, 46); }
+    void visit_I16x8LtS() { emit(OP_V128_BINARY, 47); }
+    void visit_I16x8LtU() { emit(OP_V128_BINARY, 48); }
+    void visit_I16x8GtS() { emit(OP_V128_BINARY, 49); }
+    void visit_I16x8GtU() { emit(OP_V128_BINARY, 50); }
+    void visit_I16x8LeS() { emit(OP_V128_BINARY, 51); }
+    void visit_I16x8LeU() { emit(OP_V128_BINARY, 52); }
+    void visit_I16x8GeS() { emit(OP_V128_BINARY, 53); }
+    void visit_I16x8GeU() { emit(OP_V128_BINARY, 54); }
+    void visit_I32x4Eq() { emit(OP_V128_BINARY, 55); }
+    void visit_I32x4Ne() { emit(OP_V128_BINARY, 56); }
+    void visit_I32x4LtS() { emit(OP_V128_BINARY, 57); }
+    void visit_I32x4LtU() { emit(OP_V128_BINARY, 58); }
+    void visit_I32x4GtS() { emit(OP_V128_BINARY, 59); }
+    void visit_I32x4GtU() { emit(OP_V128_BINARY, 60); }
+    void visit_I32x4LeS() { emit(OP_V128_BINARY, 61); }
+    void visit_I32x4LeU() { emit(OP_V128_BINARY, 62); }
+    void visit_I32x4GeS() { emit(OP_V128_BINARY, 63); }
+    void visit_I32x4GeU() { emit(OP_V128_BINARY, 64); }
+    void visit_I64x2Eq() { emit(OP_V128_BINARY, 214); }
+    void visit_I64x2Ne() { emit(OP_V128_BINARY, 215); }
+    void visit_I64x2LtS() { emit(OP_V128_BINARY, 216); }
+    void visit_I64x2GtS() { emit(OP_V128_BINARY, 217); }
+    void visit_I64x2LeS() { emit(OP_V128_BINARY, 218); }
+    void visit_I64x2GeS() { emit(OP_V128_BINARY, 219); }
+    void visit_F32x4Eq() { emit(OP_V128_BINARY, 65); }
+    void visit_F32x4Ne() { emit(OP_V128_BINARY, 66); }
+    void visit_F32x4Lt() { emit(OP_V128_BINARY, 67); }
+    void visit_F32x4Gt() { emit(OP_V128_BINARY, 68); }
+    void visit_F32x4Le() { emit(OP_V128_BINARY, 69); }
+    void visit_F32x4Ge() { emit(OP_V128_BINARY, 70); }
+    void visit_F64x2Eq() { emit(OP_V128_BINARY, 71); }
+    void visit_F64x2Ne() { emit(OP_V128_BINARY, 72); }
+    void visit_F64x2Lt() { emit(OP_V128_BINARY, 73); }
+    void visit_F64x2Gt() { emit(OP_V128_BINARY, 74); }
+    void visit_F64x2Le() { emit(OP_V128_BINARY, 75); }
+    void visit_F64x2Ge() { emit(OP_V128_BINARY, 76); }
+    void visit_V128Not() { emit(OP_V128_UNARY, 77); }
+    void visit_V128And() { emit(OP_V128_BINARY, 78); }
+    void visit_V128Andnot() { emit(OP_V128_BINARY, 79); }
+    void visit_V128Or() { emit(OP_V128_BINARY, 80); }
+    void visit_V128Xor() { emit(OP_V128_BINARY, 81); }
+    void visit_V128Bitselect() { emit(OP_V128_TERNARY, 82); }
+    void visit_V128AnyTrue() { emit(OP_V128_TEST, 83); }
+    void visit_I8x16Abs() { emit(OP_V128_UNARY, 96); }
+    void visit_I8x16Neg() { emit(OP_V128_UNARY, 97); }
+    void visit_I8x16Popcnt() { emit(OP_V128_UNARY, 98); }
+    void visit_I8x16AllTrue() { emit(OP_V128_TEST, 99); }
+    void visit_I8x16Bitmask() { emit(OP_V128_TEST, 100); }
+    void visit_I8x16NarrowI16x8S() { emit(OP_V128_BINARY, 101); }
+    void visit_I8x16NarrowI16x8U() { emit(OP_V128_BINARY, 102); }
+    void visit_I8x16Shl() { emit(OP_V128_SHIFT, 107); }
+    void visit_I8x16ShrS() { emit(OP_V128_SHIFT, 108); }
+    void visit_I8x16ShrU() { emit(OP_V128_SHIFT, 109); }
+    void visit_I8x16Add() { emit(OP_V128_BINARY, 110); }
+    void visit_I8x16AddSatS() { emit(OP_V128_BINARY, 111); }
+    void visit_I8x16AddSatU() { emit(OP_V128_BINARY, 112); }
+    void visit_I8x16Sub() { emit(OP_V128_BINARY, 113); }
+    void visit_I8x16SubSatS() { emit(OP_V128_BINARY, 114); }
+    void visit_I8x16SubSatU() { emit(OP_V128_BINARY, 115); }
+    void visit_I8x16MinS() { emit(OP_V128_BINARY, 118); }
+    void visit_I8x16MinU() { emit(OP_V128_BINARY, 119); }
+    void visit_I8x16MaxS() { emit(OP_V128_BINARY, 120); }
+    void visit_I8x16MaxU() { emit(OP_V128_BINARY, 121); }
+    void visit_I8x16AvgrU() { emit(OP_V128_BINARY, 123); }
+    void visit_I16x8ExtaddPairwiseI8x16S() { emit(OP_V128_UNARY, 124); }
+    void visit_I16x8ExtaddPairwiseI8x16U() { emit(OP_V128_UNARY, 125); }
+    void visit_I16x8Abs() { emit(OP_V128_UNARY, 128); }
+    void visit_I16x8Neg() { emit(OP_V128_UNARY, 129); }
+    void visit_I16x8Q15mulrSatS() { emit(OP_V128_BINARY, 130); }
+    void visit_I16x8AllTrue() { emit(OP_V128_TEST, 131); }
+    void visit_I16x8Bitmask() { emit(OP_V128_TEST, 132); }
+    void visit_I16x8NarrowI32x4S() { emit(OP_V128_BINARY, 133); }
+    void visit_I16x8NarrowI32x4U() { emit(OP_V128_BINARY, 134); }
+    void visit_I16x8ExtendLowI8x16S() { emit(OP_V128_UNARY, 135); }
+    void visit_I16x8ExtendHighI8x16S() { emit(OP_V128_UNARY, 136); }
+    void visit_I16x8ExtendLowI8x16U() { emit(OP_V128_UNARY, 137); }
+    void visit_I16x8ExtendHighI8x16U() { emit(OP_V128_UNARY, 138); }
+    void visit_I16x8Shl() { emit(OP_V128_SHIFT, 139); }
+    void visit_I16x8ShrS() { emit(OP_V128_SHIFT, 140); }
+    void visit_I16x8ShrU() { emit(OP_V128_SHIFT, 141); }
+    void visit_I16x8Add() { emit(OP_V128_BINARY, 142); }
+    void visit_I16x8AddSatS() { emit(OP_V128_BINARY, 143); }
+    void visit_I16x8AddSatU() { emit(OP_V128_BINARY, 144); }
+    void visit_I16x8Sub() { emit(OP_V128_BINARY, 145); }
+    void visit_I16x8SubSatS() { emit(OP_V128_BINARY, 146); }
+    void visit_I16x8SubSatU() { emit(OP_V128_BINARY, 147); }
+    void visit_I16x8Mul() { emit(OP_V128_BINARY, 149); }
+    void visit_I16x8MinS() { emit(OP_V128_BINARY, 150); }
+    void visit_I16x8MinU() { emit(OP_V128_BINARY, 151); }
+    void visit_I16x8MaxS() { emit(OP_V128_BINARY, 152); }
+    void visit_I16x8MaxU() { emit(OP_V128_BINARY, 153); }
+    void visit_I16x8AvgrU() { emit(OP_V128_BINARY, 155); }
+    void visit_I16x8ExtmulLowI8x16S() { emit(OP_V128_BINARY, 156); }
+    void visit_I16x8ExtmulHighI8x16S() { emit(OP_V128_BINARY, 157); }
+    void visit_I16x8ExtmulLowI8x16U() { emit(OP_V128_BINARY, 158); }
+    void visit_I16x8ExtmulHighI8x16U() { emit(OP_V128_BINARY, 159); }
+    void visit_I32x4ExtaddPairwiseI16x8S() { emit(OP_V128_UNARY, 126); }
+    void visit_I32x4ExtaddPairwiseI16x8U() { emit(OP_V128_UNARY, 127); }
+    void visit_I32x4Abs() { emit(OP_V128_UNARY, 160); }
+    void visit_I32x4Neg() { emit(OP_V128_UNARY, 161); }
+    void visit_I32x4AllTrue() { emit(OP_V128_TEST, 163); }
+    void visit_I32x4Bitmask() { emit(OP_V128_TEST, 164); }
+    void visit_I32x4ExtendLowI16x8S() { emit(OP_V128_UNARY, 167); }
+    void visit_I32x4ExtendHighI16x8S() { emit(OP_V128_UNARY, 168); }
+    void visit_I32x4ExtendLowI16x8U() { emit(OP_V128_UNARY, 169); }
+    void visit_I32x4ExtendHighI16x8U() { emit(OP_V128_UNARY, 170); }
+    void visit_I32x4Shl() { emit(OP_V128_SHIFT, 171); }
+    void visit_I32x4ShrS() { emit(OP_V128_SHIFT, 172); }
+    void visit_I32x4ShrU() { emit(OP_V128_SHIFT, 173); }
+    void visit_I32x4Add() { emit(OP_V128_BINARY, 174); }
+    void visit_I32x4Sub() { emit(OP_V128_BINARY, 177); }
+    void visit_I32x4Mul() { emit(OP_V128_BINARY, 181); }
+    void visit_I32x4MinS() { emit(OP_V128_BINARY, 182); }
+    void visit_I32x4MinU() { emit(OP_V128_BINARY, 183); }
+    void visit_I32x4MaxS() { emit(OP_V128_BINARY, 184); }
+    void visit_I32x4MaxU() { emit(OP_V128_BINARY, 185); }
+    void visit_I32x4DotI16x8S() { emit(OP_V128_BINARY, 186); }
+    void visit_I32x4ExtmulLowI16x8S() { emit(OP_V128_BINARY, 188); }
+    void visit_I32x4ExtmulHighI16x8S() { emit(OP_V128_BINARY, 189); }
+    void visit_I32x4ExtmulLowI16x8U() { emit(OP_V128_BINARY, 190); }
+    void visit_I32x4ExtmulHighI16x8U() { emit(OP_V128_BINARY, 191); }
+    void visit_I64x2Abs() { emit(OP_V128_UNARY, 192); }
+    void visit_I64x2Neg() { emit(OP_V128_UNARY, 193); }
+    void visit_I64x2AllTrue() { emit(OP_V128_TEST, 195); }
+    void visit_I64x2Bitmask() { emit(OP_V128_TEST, 196); }
+    void visit_I64x2ExtendLowI32x4S() { emit(OP_V128_UNARY, 199); }
+    void visit_I64x2ExtendHighI32x4S() { emit(OP_V128_UNARY, 200); }
+    void visit_I64x2ExtendLowI32x4U() { emit(OP_V128_UNARY, 201); }
+    void visit_I64x2ExtendHighI32x4U() { emit(OP_V128_UNARY, 202); }
+    void visit_I64x2Shl() { emit(OP_V128_SHIFT, 203); }
+    void visit_I64x2ShrS() { emit(OP_V128_SHIFT, 204); }
+    void visit_I64x2ShrU() { emit(OP_V128_SHIFT, 205); }
+    void visit_I64x2Add() { emit(OP_V128_BINARY, 206); }
+    void visit_I64x2Sub() { emit(OP_V128_BINARY, 209); }
+    void visit_I64x2Mul() { emit(OP_V128_BINARY, 213); }
+    void visit_I64x2ExtmulLowI32x4S() { emit(OP_V128_BINARY, 220); }
+    void visit_I64x2ExtmulHighI32x4S() { emit(OP_V128_BINARY, 221); }
+    void visit_I64x2ExtmulLowI32x4U() { emit(OP_V128_BINARY, 222); }
+    void visit_I64x2ExtmulHighI32x4U() { emit(OP_V128_BINARY, 223); }
+    void visit_F32x4Ceil() { emit(OP_V128_UNARY, 103); }
+    void visit_F32x4Floor() { emit(OP_V128_UNARY, 104); }
+    void visit_F32x4Trunc() { emit(OP_V128_UNARY, 105); }
+    void visit_F32x4Nearest() { emit(OP_V128_UNARY, 106); }
+    void visit_F32x4Abs() { emit(OP_V128_UNARY, 224); }
+    void visit_F32x4Neg() { emit(OP_V128_UNARY, 225); }
+    void visit_F32x4Sqrt() { emit(OP_V128_UNARY, 227); }
+    void visit_F32x4Add() { emit(OP_V128_BINARY, 228); }
+    void visit_F32x4Sub() { emit(OP_V128_BINARY, 229); }
+    void visit_F32x4Mul() { emit(OP_V128_BINARY, 230); }
+    void visit_F32x4Div() { emit(OP_V128_BINARY, 231); }
+    void visit_F32x4Min() { emit(OP_V128_BINARY, 232); }
+    void visit_F32x4Max() { emit(OP_V128_BINARY, 233); }
+    void visit_F32x4Pmin() { emit(OP_V128_BINARY, 234); }
+    void visit_F32x4Pmax() { emit(OP_V128_BINARY, 235); }
+    void visit_F64x2Ceil() { emit(OP_V128_UNARY, 116); }
+    void visit_F64x2Floor() { emit(OP_V128_UNARY, 117); }
+    void visit_F64x2Trunc() { emit(OP_V128_UNARY, 122); }
+    void visit_F64x2Nearest() { emit(OP_V128_UNARY, 148); }
+    void visit_F64x2Abs() { emit(OP_V128_UNARY, 236); }
+    void visit_F64x2Neg() { emit(OP_V128_UNARY, 237); }
+    void visit_F64x2Sqrt() { emit(OP_V128_UNARY, 239); }
+    void visit_F64x2Add() { emit(OP_V128_BINARY, 240); }
+    void visit_F64x2Sub() { emit(OP_V128_BINARY, 241); }
+    void visit_F64x2Mul() { emit(OP_V128_BINARY, 242); }
+    void visit_F64x2Div() { emit(OP_V128_BINARY, 243); }
+    void visit_F64x2Min() { emit(OP_V128_BINARY, 244); }
+    void visit_F64x2Max() { emit(OP_V128_BINARY, 245); }
+    void visit_F64x2Pmin() { emit(OP_V128_BINARY, 246); }
+    void visit_F64x2Pmax() { emit(OP_V128_BINARY, 247); }
+    void visit_I32x4TruncSatF32x4S() { emit(OP_V128_UNARY, 248); }
+    void visit_I32x4TruncSatF32x4U() { emit(OP_V128_UNARY, 249); }
+    void visit_F32x4ConvertI32x4S() { emit(OP_V128_UNARY, 250); }
+    void visit_F32x4ConvertI32x4U() { emit(OP_V128_UNARY, 251); }
+    void visit_I32x4TruncSatF64x2SZero() { emit(OP_V128_UNARY, 252); }
+    void visit_I32x4TruncSatF64x2UZero() { emit(OP_V128_UNARY, 253); }
+    void visit_F64x2ConvertLowI32x4S() { emit(OP_V128_UNARY, 254); }
+    void visit_F64x2ConvertLowI32x4U() { emit(OP_V128_UNARY, 255); }
+    void visit_F32x4DemoteF64x2Zero() { emit(OP_V128_UNARY, 94); }
+    void visit_F64x2PromoteLowF32x4() { emit(OP_V128_UNARY, 95); }
+};
+
+// Evaluates the constant expression of a global initializer or segment offset
+class ConstExprVisitor : public BaseWASMVisitor<ConstExprVisitor> {
+   public:
+    const std::vector<Value>& global_values;
+    Value result;
+
+    ConstExprVisitor(const std::vector<Value>& global_values) : global_values(global_values), result() {}
+
+    void visit_GlobalGet(uint32_t globalidx) {
+        if (globalidx >= global_values.size()) {
+            throw LFortranException("constant expression: global index out of range");
+        }
+        result = global_values[globalidx];
+    }
+
+    void visit_I32Const(int32_t n) { result.i32 = n; }
+
+    void visit_I64Const(int64_t n) { result.i64 = n; }
+
+    void visit_F32Const(float z) { result.f32 = z; }
+
+    void visit_F64Const(double z) { result.f64 = z; }
+
+    void visit_V128Const(v128_t bytes) { std::memcpy(result.v128, bytes.bytes, 16); }
+};
+}  // namespace WASM_INSTS_VISITOR
+
+class Interpreter;
+
+// An imported function provided by the embedder. It finds its arguments in
+// `args` and writes its results over them.
+typedef std::function<void(Interpreter& interp, Value* args)> HostFunction;
+
+class Interpreter {
+   public:
+    struct Frame {
+        uint32_t func_idx;
+        const Inst* ret_ip;
+        Value* fp;
+    };
+
+    std::vector<FuncInfo> func_infos;
+    std::vector<const Inst*> call_table;
+    std::vector<HostFunction> host_functions;  // per imported function
+    std::vector<Inst> host_stubs;              // the bodies of the imported functions
+    std::vector<size_t> code_sizes;  // instruction count behind each call table entry
+    std::vector<std::unique_ptr<CompiledFunc>> compiled;
+    std::vector<std::unique_ptr<CodeImage>> code_images;
+    // not initialized, so the pages are only touched as deep as calls go
+    std::unique_ptr<Value[]> stack;
+    size_t stack_size;
+    std::vector<Frame> frames;
+    std::vector<Value> global_values;
+    std::unique_ptr<LinearMemory> memory;
+    std::vector<std::vector<uint32_t>> table_elements;
+    std::vector<uint32_t> data_sizes;  // 0 once a segment has been dropped
+    std::vector<std::vector<uint32_t>> element_refs;  // empty once dropped
+    std::vector<uint32_t> type_ids;       // canonical id of every type index
+    std::vector<uint32_t> func_type_ids;  // canonical id of every function's type
+    uint32_t max_call_depth;
+    bool metered;
+    uint64_t fuel;
+    PerfMap* perf_map;
+    const SimdOps& simd;
+
+    // Instantiates the module currently decoded into the globals of
+    // wasm_utils.h. No function body is touched here; each one is lowered
+    // the first time it is called. The start function is left to start(),
+    // so that imports, fuel and the perf map can be set up before it runs.
+    Interpreter(size_t stack_size = 1U << 20, uint32_t max_call_depth = 10000U)
+        : stack(new Value[stack_size]), stack_size(stack_size), max_call_depth(max_call_depth), metered(false), fuel(0), perf_map(nullptr),
+          simd(simd_ops()) {
+        setup_functions();
+        instantiate();
+    }
+
+    // Creates an instance in the state captured by `snapshot` without running
+    // any initialization; its memory maps the snapshot copy-on-write.
+    Interpreter(const InstanceSnapshot& snapshot, size_t stack_size = 1U << 20, uint32_t max_call_depth = 10000U)
+        : stack(new Value[stack_size]), stack_size(stack_size), max_call_depth(max_call_depth), metered(false), fuel(0), perf_map(nullptr),
+          simd(simd_ops()) {
+        setup_functions();
+        if (memories.size() > 1) {
+            throw LFortranException("Interpreter: only a single memory is supported");
+        }
+        if (!memories.empty()) {
+            const Limits& limits = memories[0];
+            memory = std::make_unique<LinearMemory>(0, limits.has_max ? limits.max : LinearMemory::MAX_PAGES);
+        }
+        restore(snapshot);
+    }
+
+    // Captures the memory, globals and tables of this instance into `fd`, or
+    // into a new memfd if `fd` is -1.
+    InstanceSnapshot snapshot(int fd = -1) const {
+        std::vector<uint8_t> state;
+        ByteWriter w{state};
+        w.put_vector(global_values);
+        w.put<uint64_t>(table_elements.size());
+        for (const std::vector<uint32_t>& table : table_elements) {
+            w.put_vector(table);
+        }
+        w.put_vector(data_sizes);
+        w.put<uint64_t>(element_refs.size());
+        for (const std::vector<uint32_t>& refs : element_refs) {
+            w.put_vector(refs);
+        }
+        return InstanceSnapshot::write(state, memory.get(), fd);
+    }
+
+    // Puts this instance back into the state captured by `snapshot`. If the
+    // memory already maps that snapshot only the pages written since are
+    // dropped, so the cost does not depend on the memory size.
+    void restore(const InstanceSnapshot& snapshot) {
+        const std::string mismatch = "restore: snapshot does not match the module";
+        if (snapshot.header.has_memory != (memory != nullptr)) {
+            throw LFortranException(mismatch);
+        }
+        ByteReader r{snapshot.state.data(), snapshot.state.size(), 0};
+        std::vector<Value> new_globals = r.get_vector<Value>();
+        if (new_globals.size() != globals.size() || r.get<uint64_t>() != tables.size()) {
+            throw LFortranException(mismatch);
+        }
+        std::vector<std::vector<uint32_t>> new_tables(tables.size());
+        for (std::vector<uint32_t>& table : new_tables) {
+            table = r.get_vector<uint32_t>();
+        }
+        std::vector<uint32_t> new_data_sizes = r.get_vector<uint32_t>();
+        if (new_data_sizes.size() != datas.size() || r.get<uint64_t>() != elements.size()) {
+            throw LFortranException(mismatch);
+        }
+        std::vector<std::vector<uint32_t>> new_element_refs(elements.size());
+        for (std::vector<uint32_t>& refs : new_element_refs) {
+            refs = r.get_vector<uint32_t>();
+        }
+        if (memory) {
+            if (mapped_snapshot == snapshot.id) {
+                memory->reset_to_file();
+            } else {
+                memory->map_file(snapshot.fd, snapshot.header.memory_offset, snapshot.header.memory_pages);
+                mapped_snapshot = snapshot.id;
+            }
+        }
+        global_values = std::move(new_globals);
+        table_elements = std::move(new_tables);
+        data_sizes = std::move(new_data_sizes);
+        element_refs = std::move(new_element_refs);
+        suspension.active = false;
+    }
+
+    Value evaluate_const_expr(uint32_t offset) {
+        WASM_INSTS_VISITOR::ConstExprVisitor c(global_values);
+        c.decode_instructions(offset);
+        return c.result;
+    }
+
+   private:
+    uint64_t mapped_snapshot = 0;  // id of the snapshot the memory maps, if any
+
+    void setup_functions() {
+        for (const Import& import : imports) {
+            if (import.kind != 0x00) {
+                throw LFortranException("Interpreter: only function imports are supported");
+            }
+        }
+        uint32_t num_imported = num_imported_funcs();
+        func_infos.resize(num_funcs());
+        for (uint32_t i = 0; i < func_infos.size(); i++) {
+            const FuncType& type = func_types[func_type_index(i)];
+            func_infos[i].num_params = type.param_types.size();
+            func_infos[i].num_results = type.result_types.size();
+            func_infos[i].num_locals = type.param_types.size();
+            if (i < num_imported) {
+                func_infos[i].max_stack = type.result_types.size();
+                continue;
+            }
+            const Code& code = codes[i - num_imported];
+            for (const Local& local : code.locals) {
+                func_infos[i].num_locals += local.count;
+            }
+            // until the body is lowered: every instruction is at least one byte
+            // and pushes at most one value
+            func_infos[i].max_stack = code.analyzed ? code.max_stack : code.size;
+        }
+        call_table.assign(func_infos.size(), lazy_compile_stub);
+        code_sizes.assign(func_infos.size(), 0);
+        compiled.resize(func_infos.size());
+        // an imported function runs its host function and returns
+        host_functions.resize(num_imported);
+        host_stubs.resize(2 * num_imported);
+        for (uint32_t i = 0; i < num_imported; i++) {
+            host_stubs[2 * i] = {OP_HOST_CALL, i, {}};
+            host_stubs[2 * i + 1] = {0x0F, 0, {}};
+            call_table[i] = &host_stubs[2 * i];
+            code_sizes[i] = 2;
+        }
+
+        // structurally equal types share an id, so call_indirect compares
+        // signatures with a single integer compare
+        std::map<std::pair<std::vector<uint8_t>, std::vector<uint8_t>>, uint32_t> canonical;
+        for (const FuncType& type : func_types) {
+            auto key = std::make_pair(type.param_types, type.result_types);
+            type_ids.push_back(canonical.emplace(key, canonical.size()).first->second);
+        }
+        for (uint32_t i = 0; i < func_infos.size(); i++) {
+            func_type_ids.push_back(type_ids[func_type_index(i)]);
+        }
+    }
+
+    // Evaluates the global initializers and copies the active segments
+    void instantiate() {
+        for (const Global& global : globals) {
+            Value v = {};
+            v.i64 = 0;
+            WASM_INSTS_VISITOR::ConstExprVisitor c(global_values);
+            c.result = v;
+            c.decode_instructions(global.insts_start_index);
+            global_values.push_back(c.result);
+        }
+
+        if (memories.size() > 1) {
+            throw LFortranException("Interpreter: only a single memory is supported");
+        }
+        if (!memories.empty()) {
+            const Limits& limits = memories[0];
+            memory = std::make_unique<LinearMemory>(limits.min, limits.has_max ? limits.max : LinearMemory::MAX_PAGES);
+        }
+        for (const Data& data : datas) {
+            // active segments are dropped once they have been copied
+            data_sizes.push_back(data.kind == 1U ? data.size : 0U);
+            if (data.kind == 1U) {
+                continue;
+            }
+            if (!memory) {
+                throw LFortranException("Interpreter: data segment without memory");
+            }
+            uint32_t start = evaluate_const_expr(data.insts_start_index).i32;
+            if ((uint64_t)start + data.size > memory->size()) {
+                throw LFortranException("trap: out of bounds memory access");
+            }
+            bulk_copy(memory->base + start, &wasm_bytes[data.bytes_start], data.size);
+        }
+
+        for (const Table& table : tables) {
+            table_elements.emplace_back(table.limits.min, NULL_REF);
+        }
+        for (const Element& element : elements) {
+            bool passive = (element.kind & 3U) == 1U;
+            element_refs.push_back(passive ? element.func_indices : std::vector<uint32_t>());
+            if (element.kind & 1U) {
+                continue;
+            }
+            if (element.table_index >= table_elements.size()) {
+                throw LFortranException("Interpreter: element segment without table");
+            }
+            std::vector<uint32_t>& table = table_elements[element.table_index];
+            uint32_t start = evaluate_const_expr(element.insts_start_index).i32;
+            if ((uint64_t)start + element.func_indices.size() > table.size()) {
+                throw LFortranException("trap: out of bounds table access");
+            }
+            std::copy(element.func_indices.begin(), element.func_indices.end(), table.begin() + start);
+        }
+    }
+
+    // Stores what lowering found out about the frame of a function next to
+    // its Code, so it is worked out only once per module
+    static void record_frame(uint32_t func_idx, Code& code, const WASM_INSTS_VISITOR::LoweringVisitor& v) {
+        const FuncType& type = func_types[func_type_index(func_idx)];
+        uint64_t num_locals = type.param_types.size();
+        for (const Local& local : code.locals) {
+            num_locals += local.count;
+        }
+        code.max_stack = v.max_height;
+        code.frame_size = num_locals + v.max_height;
+        code.callees = v.callees;
+        std::sort(code.callees.begin(), code.callees.end());
+        code.callees.erase(std::unique(code.callees.begin(), code.callees.end()), code.callees.end());
+        code.indirect_types = v.indirect_types;
+        code.analyzed = true;
+    }
+
+    static void lower_into(WASM_INSTS_VISITOR::LoweringVisitor& v, uint32_t func_idx) {
+        const FuncType& type = func_types[func_type_index(func_idx)];
+        uint64_t num_locals = type.param_types.size();
+        for (const Local& local : codes[func_idx - num_imported_funcs()].locals) {
+            num_locals += local.count;
+        }
+        v.begin_function(type.result_types.size(), num_locals);
+        v.begin_block();
+        v.decode_instructions(codes[func_idx - num_imported_funcs()].insts_start_index);
+        v.emit(0x0F);  // the final `end` returns
+        v.end_block();
+    }
+
+   public:
+    // Lowers one function body. It only reads the decoded module, except
+    // for filling in the function's frame in its Code, so any number of
+    // functions can be lowered concurrently.
+    static std::unique_ptr<CompiledFunc> lower(uint32_t func_idx, bool metered = false) {
+        WASM_INSTS_VISITOR::LoweringVisitor v;
+        v.metered = metered;
+        lower_into(v, func_idx);
+        Code& code = codes[func_idx - num_imported_funcs()];
+        if (!code.analyzed) {
+            record_frame(func_idx, code, v);
+        }
+        auto f = std::make_unique<CompiledFunc>(CompiledFunc{std::move(v.insts), std::move(v.call_caches)});
+        for (Inst& inst : f->insts) {
+            if (inst.op == 0x11) {
+                inst.imm.cache = &f->call_caches[inst.imm.i32];
+            }
+        }
+        return f;
+    }
+
+    static const uint64_t UNBOUNDED = ~(uint64_t)0;
+
+    // An upper bound of the stack a call of `func_idx` needs, in values: its
+    // frame plus the deepest chain of calls it can make, where a
+    // call_indirect may reach every function of its type. UNBOUNDED if the
+    // calls can recurse. Functions on the way that were never lowered are
+    // lowered once to find their frames.
+    static uint64_t max_call_chain(uint32_t func_idx) {
+        uint32_t n = num_funcs(), num_imported = num_imported_funcs();
+        if (func_idx >= n) {
+            throw LFortranException("max_call_chain: function index out of range");
+        }
+        // every call_indirect type is a node past the functions, whose
+        // successors are the functions of that type
+        std::map<std::pair<std::vector<uint8_t>, std::vector<uint8_t>>, uint32_t> canonical;
+        std::vector<uint32_t> type_nodes;
+        for (const FuncType& type : func_types) {
+            auto key = std::make_pair(type.param_types, type.result_types);
+            type_nodes.push_back(n + canonical.emplace(key, canonical.size()).first->second);
+        }
+        std::vector<std::vector<uint32_t>> members(canonical.size());
+        for (uint32_t i = 0; i < n; i++) {
+            members[type_nodes[func_type_index(i)] - n].push_back(i);
+        }
+        auto successors = [&](uint32_t node) {
+            std::vector<uint32_t> next;
+            if (node >= n) {
+                next = members[node - n];
+            } else if (node >= num_imported) {
+                const Code& code = analyze_frame(node);
+                next = code.callees;
+                for (uint32_t typeidx : code.indirect_types) {
+                    next.push_back(type_nodes[typeidx]);
+                }
+            }
+            return next;
+        };
+        auto frame = [&](uint32_t node) -> uint64_t {
+            if (node >= n) {
+                return 0;
+            }
+            if (node < num_imported) {
+                // the host function gets the params and leaves the results
+                const FuncType& type = func_types[func_type_index(node)];
+                return std::max(type.param_types.size(), type.result_types.size());
+            }
+            return codes[node - num_imported].frame_size;
+        };
+
+        // depth first, a node still on the path is reached again by recursion
+        const uint8_t ON_PATH = 1, DONE = 2;
+        std::vector<uint8_t> state(n + canonical.size(), 0);
+        std::vector<uint64_t> chain(state.size(), 0);
+        struct Visit {
+            uint32_t node;
+            std::vector<uint32_t> next;
+            size_t i;
+        };
+        std::vector<Visit> path;
+        path.push_back({func_idx, successors(func_idx), 0});
+        state[func_idx] = ON_PATH;
+        while (!path.empty()) {
+            Visit& v = path.back();
+            if (v.i < v.next.size()) {
+                uint32_t s = v.next[v.i++];
+                if (state[s] == ON_PATH) {
+                    return UNBOUNDED;
+                }
+                if (state[s] != DONE) {
+                    state[s] = ON_PATH;
+                    path.push_back({s, successors(s), 0});
+                }
+                continue;
+            }
+            uint64_t deepest = 0;
+            for (uint32_t s : v.next) {
+                deepest = std::max(deepest, chain[s]);
+            }
+            chain[v.node] = frame(v.node) + deepest;
+            state[v.node] = DONE;
+            path.pop_back();
+        }
+        return chain[func_idx];
+    }
+
+    // The Code of a function body with its frame filled in
+    static const Code& analyze_frame(uint32_t func_idx) {
+        const Code& code = codes[func_idx - num_imported_funcs()];
+        if (!code.analyzed) {
+            lower(func_idx);
+        }
+        return code;
+    }
+
+    // The module byte offset of the instruction every lowered instruction of
+    // `func_idx` came from, lowering it again the way it was lowered
+    std::vector<uint32_t> byte_offsets(uint32_t func_idx) const {
+        WASM_INSTS_VISITOR::LoweringVisitor v;
+        v.metered = metered;
+        v.record_starts = true;
+        lower_into(v, func_idx);
+        const Code& code = codes[func_idx - num_imported_funcs()];
+        std::vector<uint32_t> offsets(v.insts.size(), code.insts_start_index);
+        for (size_t i = 0; i < v.starts.size(); i++) {
+            size_t end = i + 1 < v.starts.size() ? v.starts[i + 1].first : v.insts.size();
+            std::fill(offsets.begin() + v.starts[i].first, offsets.begin() + end, v.starts[i].second);
+        }
+        return offsets;
+    }
+
+    const Inst* compile(uint32_t func_idx) {
+        if (call_table[func_idx] == lazy_compile_stub) {
+            compiled[func_idx] = lower(func_idx, metered);
+            install(func_idx, compiled[func_idx]->insts.data(), compiled[func_idx]->insts.size());
+        }
+        return call_table[func_idx];
+    }
+
+    // Eagerly lowers every function not compiled yet on `num_threads` threads
+    // (0 means one per core) and then links them. Each body is lowered
+    // independently of the others, so the result does not depend on the
+    // thread count or the order in which the workers pick functions.
+    void compile_all(unsigned num_threads = 0) {
+        WorkStealingPool pool(num_threads);
+        pool.parallel_for(call_table.size(), [this](uint32_t i) {
+            if (call_table[i] == lazy_compile_stub) {
+                compiled[i] = lower(i, metered);
+            }
+        });
+        link();
+    }
+
+    // Resolves calls to compiled functions by pointing their call table
+    // entries at the lowered bodies, in function index order.
+    void link() {
+        for (uint32_t i = 0; i < compiled.size(); i++) {
+            if (compiled[i] && call_table[i] != compiled[i]->insts.data()) {
+                install(i, compiled[i]->insts.data(), compiled[i]->insts.size());
+            }
+        }
+    }
+
+    // Runs the functions of `image` that are not compiled yet from its code
+    void use_code_image(std::unique_ptr<CodeImage> image) {
+        if (image->metered != metered || image->entries.size() != call_table.size()) {
+            throw LFortranException("use_code_image: code does not match this instance");
+        }
+        for (uint32_t i = 0; i < call_table.size(); i++) {
+            if (image->entries[i] && call_table[i] == lazy_compile_stub) {
+                install(i, image->entries[i], image->sizes[i]);
+            }
+        }
+        code_images.push_back(std::move(image));
+    }
+
+    // Reports the lowered code of every function to `map`, the functions
+    // compiled so far right away and later ones as they are compiled
+    void set_perf_map(PerfMap* map) {
+        perf_map = map;
+        for (uint32_t i = host_functions.size(); i < call_table.size(); i++) {
+            if (call_table[i] != lazy_compile_stub) {
+                report(i);
+            }
+        }
+    }
+
+    // Runs the lowered code with tail call threaded handlers instead of the
+    // switch loop. The lowered code is the same, so this may change between
+    // calls.
+    void use_threaded_dispatch(bool on) {
+        if (on) {
+            init_threaded_handlers();
+        }
+        threaded = on;
+    }
+
+    // Without call caches every call_indirect compares the params and
+    // results of its target with the expected type, as it would without
+    // them; wasm_call_bench.cpp measures the caches against that. This has
+    // to come before the first call_indirect runs.
+    void use_call_caches(bool on) { call_caches = on; }
+
+    // Makes execution consume one unit of fuel per lowered instruction, charged
+    // a basic block at a time, starting with `initial_fuel`. Metering is
+    // compiled into the lowered code, so this has to come before any function
+    // is compiled. A call that faults on guest memory is not charged for the
+    // fuel it used since it started or last called an import.
+    void enable_fuel_metering(uint64_t initial_fuel) {
+        for (uint32_t i = host_functions.size(); i < call_table.size(); i++) {
+            if (call_table[i] != lazy_compile_stub) {
+                throw LFortranException("enable_fuel_metering: functions have already been compiled");
+            }
+        }
+        metered = true;
+        fuel = initial_fuel;
+    }
+
+    void add_fuel(uint64_t amount) { fuel += amount; }
+
+    // True when the last invoke() or resume() stopped because it ran out of
+    // fuel; resume() continues it where it stopped.
+    bool out_of_fuel() const { return suspension.active; }
+
+    // Makes the imported function `func_idx` run `f`. The type of the import
+    // is the caller's to check.
+    void bind_import(uint32_t func_idx, HostFunction f) {
+        if (func_idx >= host_functions.size()) {
+            throw LFortranException("bind_import: not an imported function");
+        }
+        host_functions[func_idx] = std::move(f);
+    }
+
+    static uint32_t find_export(const std::string& name) {
+        for (const Export& e : exports) {
+            if (e.kind == 0x00 && e.name == name) {
+                return e.index;
+            }
+        }
+        throw LFortranException("find_export: no exported function named " + name);
+    }
+
+    // Runs the start function of the module, if it has one. An instance
+    // created from a snapshot has already run it.
+    void start() {
+        if (start_function != NO_START) {
+            invoke(start_function, {});
+        }
+    }
+
+    std::vector<Value> invoke(uint32_t func_idx, const std::vector<Value>& args) {
+        if (func_idx >= func_infos.size()) {
+            throw LFortranException("invoke: function index out of range");
+        }
+        if (args.size() != func_infos[func_idx].num_params) {
+            throw LFortranException("invoke: wrong number of arguments");
+        }
+        std::copy(args.begin(), args.end(), stack.get());
+        suspension.active = false;
+        suspension.func_idx = func_idx;
+        return guarded([&] { return execute(func_idx, stack.get() + args.size()); });
+    }
+
+    // Continues an invocation that ran out of fuel. Returns its results once
+    // it finishes, or nothing if it runs out of fuel again.
+    std::vector<Value> resume() {
+        if (!suspension.active) {
+            throw LFortranException("resume: no invocation ran out of fuel");
+        }
+        suspension.active = false;
+        return guarded([&] { return run(suspension.ip, suspension.sp, suspension.fp); });
+    }
+
+   private:
+    struct Suspension {
+        bool active = false;
+        uint32_t func_idx = 0;  // the invoked function
+        const Inst* ip = nullptr;
+        Value* sp = nullptr;
+        Value* fp = nullptr;
+    } suspension;
+
+    // What an instruction leaves the dispatch to do
+    enum Status { RUNNING, FINISHED, SUSPENDED };
+    typedef Status (*Handler)(const Inst* ip, Value* sp, Value* fp, Interpreter* self, uint8_t* mem, Value* global);
+
+    static inline Handler threaded_handlers[NUM_LOWERED_OPS];
+    bool threaded = false;
+    bool call_caches = true;
+    // where the next handler starts when handlers return to run_threaded()
+    struct {
+        const Inst* ip;
+        Value* sp;
+        Value* fp;
+    } threaded_regs;
+
+    void install(uint32_t func_idx, const Inst* code, size_t size) {
+        call_table[func_idx] = code;
+        code_sizes[func_idx] = size;
+        if (func_idx >= host_functions.size() && codes[func_idx - host_functions.size()].analyzed) {
+            func_infos[func_idx].max_stack = codes[func_idx - host_functions.size()].max_stack;
+        }
+        if (perf_map) {
+            report(func_idx);
+        }
+    }
+
+    std::string import_name(uint32_t func_idx) const {
+        uint32_t n = 0;
+        for (const Import& import : imports) {
+            if (import.kind == 0x00 && n++ == func_idx) {
+                return import.module + "." + import.name;
+            }
+        }
+        return function_name(func_idx);
+    }
+
+    void report(uint32_t func_idx) {
+        perf_map->add(call_table[func_idx], code_sizes[func_idx] * sizeof(Inst), function_name(func_idx));
+    }
+
+    // Runs `body`, which returns whether the invocation finished, with guest
+    // memory faults turned into traps, and collects the results.
+    template <typename F>
+    std::vector<Value> guarded(F body) {
+        // Guest memory faults jump back here, see LinearMemory
+        LinearMemory* outer_memory = LinearMemory::active;
+        sigjmp_buf* outer_jmp = LinearMemory::trap_jmp;
+        sigjmp_buf trap_buf;
+        if (sigsetjmp(trap_buf, 1)) {
+            LinearMemory::active = outer_memory;
+            LinearMemory::trap_jmp = outer_jmp;
+            throw LFortranException("trap: out of bounds memory access");
+        }
+        LinearMemory::active = memory.get();
+        LinearMemory::trap_jmp = &trap_buf;
+        bool finished;
+        try {
+            finished = body();
+        } catch (...) {
+            LinearMemory::active = outer_memory;
+            LinearMemory::trap_jmp = outer_jmp;
+            throw;
+        }
+        LinearMemory::active = outer_memory;
+        LinearMemory::trap_jmp = outer_jmp;
+        if (!finished) {
+            return {};
+        }
+        const FuncInfo& info = func_infos[suspension.func_idx];
+        return std::vector<Value>(stack.get(), stack.get() + info.num_results);
+    }
+
+    // Turns the arguments on top of the stack into the first locals of a new
+    // frame and zeroes the remaining locals.
+    Value* enter(uint32_t func_idx, Value*& sp) {
+        const FuncInfo& info = func_infos[func_idx];
+        Value* fp = sp - info.num_params;
+        if (fp + info.num_locals + info.max_stack > stack.get() + stack_size) {
+            throw LFortranException("trap: call stack exhausted");
+        }
+        std::memset((void*)sp, 0, (info.num_locals - info.num_params) * sizeof(Value));
+        sp = fp + info.num_locals;
+        return fp;
+    }
+
+    // Moves the values a branch carries down over the ones it discards
+    static Value* branch(const Inst* ip, Value* sp) {
+        uint32_t keep = ip->imm.br.keep, drop = ip->imm.br.drop;
+        if (drop) {
+            std::copy(sp - keep, sp, sp - keep - drop);
+            sp -= drop;
+        }
+        return sp;
+    }
+
+    // Runs `func_idx` with its arguments just below `sp`. The results are left
+    // where the arguments were. Returns false if it ran out of fuel.
+    bool execute(uint32_t func_idx, Value* sp) {
+        frames.clear();
+        frames.push_back({func_idx, nullptr, nullptr});
+        Value* fp = enter(func_idx, sp);
+        return run(call_table[func_idx], sp, fp);
+    }
+
+    // The interpreter loop, from `ip` in the innermost of `frames`. Nothing in
+    // here owns resources, so a memory fault may longjmp out of it at any load
+    // or store.
+    bool run(const Inst* ip, Value* sp, Value* fp) {
+        uint8_t* mem = memory ? memory->base : nullptr;
+        Value* global = global_values.data();
+        if (threaded) {
+            return run_threaded(ip, sp, fp, mem, global);
+        }
+        // the switch loop keeps the fuel in a register and writes it back
+        // whenever it leaves the loop
+        uint64_t fuel_left = fuel;
+        try {
+            while (true) {
+                Status status = step(ip->op, ip, sp, fp, mem, global, fuel_left);
+                if (status != RUNNING) {
+                    fuel = fuel_left;
+                    return status == FINISHED;
+                }
+            }
+        } catch (...) {
+            fuel = fuel_left;
+            throw;
+        }
+    }
+
+    // Tail call threaded dispatch: every handler runs its instruction and
+    // tail calls the handler of the next one, so `ip`, `sp` and `fp` stay in
+    // argument registers and each instruction ends in its own indirect jump.
+    // Without guaranteed tail calls the handlers return to this loop instead.
+    bool run_threaded(const Inst* ip, Value* sp, Value* fp, uint8_t* mem, Value* global) {
+        Status status = threaded_handlers[ip->op](ip, sp, fp, this, mem, global);
+#ifndef WASM_MUSTTAIL
+        while (status == RUNNING) {
+            status = threaded_handlers[threaded_regs.ip->op](threaded_regs.ip, threaded_regs.sp, threaded_regs.fp, this,
+                                                             mem, global);
+        }
+#endif
+        return status == FINISHED;
+    }
+
+#ifdef WASM_MUSTTAIL
+#define WASM_DISPATCH WASM_MUSTTAIL return threaded_handlers[ip->op](ip, sp, fp, self, mem, global)
+#else
+#define WASM_DISPATCH                 \
+    self->threaded_regs = {ip, sp, fp}; \
+    return RUNNING
+#endif
+#define WASM_HANDLER(name, opcode)                                                                       \
+    static Status op_##name(const Inst* ip, Value* sp, Value* fp, Interpreter* self, uint8_t* mem, Value* global) { \
+        Status status = self->step(opcode, ip, sp, fp, mem, global, self->fuel);                                    \
+        if (status != RUNNING) {                                                                         \
+            return status;                                                                               \
+        }                                                                                                \
+        WASM_DISPATCH;                                                                                   \
+    }
+    WASM_THREADED_OPS(WASM_HANDLER)
+    WASM_INTERNAL_OPS(WASM_HANDLER)
+#undef WASM_HANDLER
+
+    // Any other opcode goes through the whole switch
+    static Status op_Generic(const Inst* ip, Value* sp, Value* fp, Interpreter* self, uint8_t* mem, Value* global) {
+        Status status = self->step(ip->op, ip, sp, fp, mem, global, self->fuel);
+        if (status != RUNNING) {
+            return status;
+        }
+        WASM_DISPATCH;
+    }
+#undef WASM_DISPATCH
+
+    static void init_threaded_handlers() {
+        static std::once_flag once;
+        std::call_once(once, [] {
+            std::fill(std::begin(threaded_handlers), std::end(threaded_handlers), op_Generic);
+#define WASM_INSTALL(name, opcode) threaded_handlers[opcode] = op_##name;
+            WASM_THREADED_OPS(WASM_INSTALL)
+            WASM_INTERNAL_OPS(WASM_INSTALL)
+#undef WASM_INSTALL
+        });
+    }
+
+    // Executes the instruction at `ip`, whose opcode is `op`, and moves `ip`
+    // on. Both dispatch loops inline it; in a threaded handler `op` is a
+    // constant, so the switch folds down to that one case.
+    WASM_ALWAYS_INLINE Status step(uint32_t op, const Inst*& ip, Value*& sp, Value*& fp, uint8_t* mem, Value* global,
+                                   uint64_t& fuel) {
+
+#define UNOP(opcode, in, T, out, expr) \
+    case opcode: {                     \
+        T a = sp[-1].in;               \
+        sp[-1].out = (expr);           \
+        break;                         \
+    }
+#define BINOP(opcode, in, T, out, expr) \
+    case opcode: {                      \
+        T a = sp[-2].in;                \
+        T b = sp[-1].in;                \
+        sp--;                           \
+        sp[-1].out = (expr);            \
+        break;                          \
+    }
+// Effective addresses cannot leave the guard region, so there is no bounds
+// check; the memory does not move on growth, so `mem` stays valid.
+#define LOAD(opcode, T, out, R)                                                    \
+    case opcode: {                                                                 \
+        T x;                                                                       \
+        std::memcpy(&x, mem + (uint32_t)sp[-1].i32 + (uint64_t)ip->arg, sizeof(T)); \
+        sp[-1].out = (R)x;                                                         \
+        break;                                                                     \
+    }
+#define STORE(opcode, in, T)                                                       \
+    case opcode: {                                                                 \
+        T x = (T)sp[-1].in;                                                        \
+        std::memcpy(mem + (uint32_t)sp[-2].i32 + (uint64_t)ip->arg, &x, sizeof(T)); \
+        sp -= 2;                                                                   \
+        break;                                                                     \
+    }
+
+        // `continue` leaves `ip` where a case moved it
+        do {
+            switch (op) {
+                case 0x00: {
+                    throw LFortranException("trap: unreachable");
+                }
+                case 0x04: {
+                    if (!(--sp)->i32) {
+                        ip += (int32_t)ip->arg;
+                        continue;
+                    }
+                    break;
+                }
+                case 0x0C: {
+                    sp = branch(ip, sp);
+                    ip += (int32_t)ip->arg;
+                    continue;
+                }
+                case 0x0D: {
+                    if ((--sp)->i32) {
+                        sp = branch(ip, sp);
+                        ip += (int32_t)ip->arg;
+                        continue;
+                    }
+                    break;
+                }
+                case 0x0E: {
+                    uint32_t i = (--sp)->i32;
+                    ip += 1 + std::min(i, ip->arg);
+                    continue;
+                }
+                case 0x0F: {
+                    const FuncInfo& info = func_infos[frames.back().func_idx];
+                    std::copy(sp - info.num_results, sp, fp);
+                    sp = fp + info.num_results;
+                    ip = frames.back().ret_ip;
+                    fp = frames.back().fp;
+                    frames.pop_back();
+                    if (frames.empty()) {
+                        return FINISHED;
+                    }
+                    continue;
+                }
+                case 0x10: {
+                    if (frames.size() >= max_call_depth) {
+                        throw LFortranException("trap: call stack exhausted");
+                    }
+                    frames.push_back({ip->arg, ip + 1, fp});
+                    fp = enter(ip->arg, sp);
+                    ip = call_table[frames.back().func_idx];
+                    continue;
+                }
+                case 0x11: {
+                    const std::vector<uint32_t>& table = table_elements[ip->arg];
+                    uint32_t i = (--sp)->i32;
+                    if (i >= table.size()) {
+                        throw LFortranException("trap: undefined element");
+                    }
+                    uint32_t callee = table[i];
+                    CallCache& cache = *ip->imm.cache;
+                    if (!cache.lookup(callee)) {
+                        if (callee == NULL_REF) {
+                            throw LFortranException("trap: uninitialized element");
+                        }
+                        if (!call_caches) {
+                            const FuncType& type = func_types[func_type_index(callee)];
+                            const FuncType& expected = func_types[cache.type_idx];
+                            if (type.param_types != expected.param_types ||
+                                type.result_types != expected.result_types) {
+                                throw LFortranException("trap: indirect call type mismatch");
+                            }
+                        } else if (func_type_ids[callee] != type_ids[cache.type_idx]) {
+                            throw LFortranException("trap: indirect call type mismatch");
+                        } else {
+                            cache.insert(callee);
+                        }
+                    }
+                    if (frames.size() >= max_call_depth) {
+                        throw LFortranException("trap: call stack exhausted");
+                    }
+                    frames.push_back({callee, ip + 1, fp});
+                    fp = enter(callee, sp);
+                    ip = call_table[callee];
+                    continue;
+                }
+                case 0x1A: {
+                    sp--;
+                    break;
+                }
+                case 0x1B: {
+                    int32_t c = sp[-1].i32;
+                    sp -= 2;
+                    if (!c) {
+                        sp[-1] = sp[0];
+                    }
+                    break;
+                }
+                case 0x20: {
+                    *sp++ = fp[ip->arg];
+                    break;
+                }
+                case 0x21: {
+                    fp[ip->arg] = *--sp;
+                    break;
+                }
+                case 0x22: {
+                    fp[ip->arg] = sp[-1];
+                    break;
+                }
+                case 0x23: {
+                    *sp++ = global[ip->arg];
+                    break;
+                }
+                case 0x24: {
+                    global[ip->arg] = *--sp;
+                    break;
+                }
+
+                LOAD(0x28, int32_t, i32, int32_t)
+                LOAD(0x29, int64_t, i64, int64_t)
+                LOAD(0x2A, float, f32, float)
+                LOAD(0x2B, double, f64, double)
+                LOAD(0x2C, int8_t, i32, int32_t)
+                LOAD(0x2D, uint8_t, i32, int32_t)
+                LOAD(0x2E, int16_t, i32, int32_t)
+                LOAD(0x2F, uint16_t, i32, int32_t)
+                LOAD(0x30, int8_t, i64, int64_t)
+                LOAD(0x31, uint8_t, i64, int64_t)
+                LOAD(0x32, int16_t, i64, int64_t)
+                LOAD(0x33, uint16_t, i64, int64_t)
+                LOAD(0x34, int32_t, i64, int64_t)
+                LOAD(0x35, uint32_t, i64, int64_t)
+                STORE(0x36, i32, int32_t)
+                STORE(0x37, i64, int64_t)
+                STORE(0x38, f32, float)
+                STORE(0x39, f64, double)
+                STORE(0x3A, i32, uint8_t)
+                STORE(0x3B, i32, uint16_t)
+                STORE(0x3C, i64, uint8_t)
+                STORE(0x3D, i64, uint16_t)
+                STORE(0x3E, i64, uint32_t)
+                case 0x3F: {
+                    (sp++)->i32 = memory->pages;
+                    break;
+                }
+                case 0x40: {
+                    sp[-1].i32 = memory->grow(sp[-1].i32);
+                    break;
+                }
+
+                case 0x25: {
+                    std::vector<uint32_t>& table = table_elements[ip->arg];
+                    uint32_t i = sp[-1].i32;
+                    if (i >= table.size()) {
+                        throw LFortranException("trap: out of bounds table access");
+                    }
+                    sp[-1].i32 = table[i];
+                    break;
+                }
+                case 0x26: {
+                    std::vector<uint32_t>& table = table_elements[ip->arg];
+                    uint32_t i = sp[-2].i32;
+                    if (i >= table.size()) {
+                        throw LFortranException("trap: out of bounds table access");
+                    }
+                    table[i] = sp[-1].i32;
+                    sp -= 2;
+                    break;
+                }
+                case 0xD0: {
+                    (sp++)->i32 = NULL_REF;
+                    break;
+                }
+                case 0xD1: {
+                    sp[-1].i32 = ((uint32_t)sp[-1].i32 == NULL_REF);
+                    break;
+                }
+                case 0xD2: {
+                    (sp++)->i32 = ip->arg;
+                    break;
+                }
+
+                case 0x41:
+                case 0x42:
+                case 0x43:
+                case 0x44: {
+                    (sp++)->i64 = ip->imm.i64;
+                    break;
+                }
+
+                UNOP(0x45, i32, int32_t, i32, a == 0)
+                BINOP(0x46, i32, int32_t, i32, a == b)
+                BINOP(0x47, i32, int32_t, i32, a != b)
+                BINOP(0x48, i32, int32_t, i32, a < b)
+                BINOP(0x49, i32, uint32_t, i32, a < b)
+                BINOP(0x4A, i32, int32_t, i32, a > b)
+                BINOP(0x4B, i32, uint32_t, i32, a > b)
+                BINOP(0x4C, i32, int32_t, i32, a <= b)
+                BINOP(0x4D, i32, uint32_t, i32, a <= b)
+                BINOP(0x4E, i32, int32_t, i32, a >= b)
+                BINOP(0x4F, i32, uint32_t, i32, a >= b)
+
+                UNOP(0x50, i64, int64_t, i32, a == 0)
+                BINOP(0x51, i64, int64_t, i32, a == b)
+                BINOP(0x52, i64, int64_t, i32, a != b)
+                BINOP(0x53, i64, int64_t, i32, a < b)
+                BINOP(0x54, i64, uint64_t, i32, a < b)
+                BINOP(0x55, i64, int64_t, i32, a > b)
+                BINOP(0x56, i64, uint64_t, i32, a > b)
+                BINOP(0x57, i64, int64_t, i32, a <= b)
+                BINOP(0x58, i64, uint64_t, i32, a <= b)
+                BINOP(0x59, i64, int64_t, i32, a >= b)
+                BINOP(0x5A, i64, uint64_t, i32, a >= b)
+
+                BINOP(0x5B, f32, float, i32, a == b)
+                BINOP(0x5C, f32, float, i32, a != b)
+                BINOP(0x5D, f32, float, i32, a < b)
+                BINOP(0x5E, f32, float, i32, a > b)
+                BINOP(0x5F, f32, float, i32, a <= b)
+                BINOP(0x60, f32, float, i32, a >= b)
+
+                BINOP(0x61, f64, double, i32, a == b)
+                BINOP(0x62, f64, double, i32, a != b)
+                BINOP(0x63, f64, double, i32, a < b)
+                BINOP(0x64, f64, double, i32, a > b)
+                BINOP(0x65, f64, double, i32, a <= b)
+                BINOP(0x66, f64, double, i32, a >= b)
+
+                UNOP(0x67, i32, uint32_t, i32, a == 0 ? 32 : __builtin_clz(a))
+                UNOP(0x68, i32, uint32_t, i32, a == 0 ? 32 : __builtin_ctz(a))
+                UNOP(0x69, i32, uint32_t, i32, __builtin_popcount(a))
+                BINOP(0x6A, i32, uint32_t, i32, a + b)
+                BINOP(0x6B, i32, uint32_t, i32, a - b)
+                BINOP(0x6C, i32, uint32_t, i32, a * b)
+                case 0x6D: {
+                    int32_t a = sp[-2].i32, b = sp[-1].i32;
+                    if (b == 0) {
+                        throw LFortranException("trap: integer divide by zero");
+                    }
+                    if (a == std::numeric_limits<int32_t>::min() && b == -1) {
+                        throw LFortranException("trap: integer overflow");
+                    }
+                    sp--;
+                    sp[-1].i32 = a / b;
+                    break;
+                }
+                case 0x6E: {
+                    uint32_t a = sp[-2].i32, b = sp[-1].i32;
+                    if (b == 0) {
+                        throw LFortranException("trap: integer divide by zero");
+                    }
+                    sp--;
+                    sp[-1].i32 = a / b;
+                    break;
+                }
+                case 0x6F: {
+                    int32_t a = sp[-2].i32, b = sp[-1].i32;
+                    if (b == 0) {
+                        throw LFortranException("trap: integer divide by zero");
+                    }
+                    sp--;
+                    sp[-1].i32 = (b == -1) ? 0 : a % b;
+                    break;
+                }
+                case 0x70: {
+                    uint32_t a = sp[-2].i32, b = sp[-1].i32;
+                    if (b == 0) {
+                        throw LFortranException("trap: integer divide by zero");
+                    }
+                    sp--;
+                    sp[-1].i32 = a % b;
+                    break;
+                }
+                BINOP(0x71, i32, uint32_t, i32, a & b)
+                BINOP(0x72, i32, uint32_t, i32, a | b)
+                BINOP(0x73, i32, uint32_t, i32, a ^ b)
+                BINOP(0x74, i32, uint32_t, i32, a << (b & 31))
+                BINOP(0x75, i32, int32_t, i32, a >> (b & 31))
+                BINOP(0x76, i32, uint32_t, i32, a >> (b & 31))
+                BINOP(0x77, i32, uint32_t, i32, rotl(a, b))
+                BINOP(0x78, i32, uint32_t, i32, rotr(a, b))
+
+                UNOP(0x79, i64, uint64_t, i64, a == 0 ? 64 : __builtin_clzll(a))
+                UNOP(0x7A, i64, uint64_t, i64, a == 0 ? 64 : __builtin_ctzll(a))
+                UNOP(0x7B, i64, uint64_t, i64, __builtin_popcountll(a))
+                BINOP(0x7C, i64, uint64_t, i64, a + b)
+                BINOP(0x7D, i64, uint64_t, i64, a - b)
+                BINOP(0x7E, i64, uint64_t, i64, a * b)
+                case 0x7F: {
+                    int64_t a = sp[-2].i64, b = sp[-1].i64;
+                    if (b == 0) {
+                        throw LFortranException("trap: integer divide by zero");
+                    }
+                    if (a == std::numeric_limits<int64_t>::min() && b == -1) {
+                        throw LFortranException("trap: integer overflow");
+                    }
+                    sp--;
+                    sp[-1].i64 = a / b;
+                    break;
+                }
+                case 0x80: {
+                    uint64_t a = sp[-2].i64, b = sp[-1].i64;
+                    if (b == 0) {
+                        throw LFortranException("trap: integer divide by zero");
+                    }
+                    sp--;
+                    sp[-1].i64 = a / b;
+                    break;
+                }
+                case 0x81: {
+                    int64_t a = sp[-2].i64, b = sp[-1].i64;
+                    if (b == 0) {
+                        throw LFortranException("trap: integer divide by zero");
+                    }
+                    sp--;
+                    sp[-1].i64 = (b == -1) ? 0 : a % b;
+                    break;
+                }
+                case 0x82: {
+                    uint64_t a = sp[-2].i64, b = sp[-1].i64;
+                    if (b == 0) {
+                        throw LFortranException("trap: integer divide by zero");
+                    }
+                    sp--;
+                    sp[-1].i64 = a % b;
+                    break;
+                }
+                BINOP(0x83, i64, uint64_t, i64, a & b)
+                BINOP(0x84, i64, uint64_t, i64, a | b)
+                BINOP(0x85, i64, uint64_t, i64, a ^ b)
+                BINOP(0x86, i64, uint64_t, i64, a << (b & 63))
+                BINOP(0x87, i64, int64_t, i64, a >> (b & 63))
+                BINOP(0x88, i64, uint64_t, i64, a >> (b & 63))
+                BINOP(0x89, i64, uint64_t, i64, rotl(a, b))
+                BINOP(0x8A, i64, uint64_t, i64, rotr(a, b))
+
+                UNOP(0x8B, f32, float, f32, std::fabs(a))
+                UNOP(0x8C, f32, float, f32, -a)
+                UNOP(0x8D, f32, float, f32, std::ceil(a))
+                UNOP(0x8E, f32, float, f32, std::floor(a))
+                UNOP(0x8F, f32, float, f32, std::trunc(a))
+                UNOP(0x90, f32, float, f32, std::nearbyint(a))
+                UNOP(0x91, f32, float, f32, std::sqrt(a))
+                BINOP(0x92, f32, float, f32, a + b)
+                BINOP(0x93, f32, float, f32, a - b)
+                BINOP(0x94, f32, float, f32, a * b)
+                BINOP(0x95, f32, float, f32, a / b)
+                BINOP(0x96, f32, float, f32, wasm_min(a, b))
+                BINOP(0x97, f32, float, f32, wasm_max(a, b))
+                BINOP(0x98, f32, float, f32, std::copysign(a, b))
+
+                UNOP(0x99, f64, double, f64, std::fabs(a))
+                UNOP(0x9A, f64, double, f64, -a)
+                UNOP(0x9B, f64, double, f64, std::ceil(a))
+                UNOP(0x9C, f64, double, f64, std::floor(a))
+                UNOP(0x9D, f64, double, f64, std::trunc(a))
+                UNOP(0x9E, f64, double, f64, std::nearbyint(a))
+                UNOP(0x9F, f64, double, f64, std::sqrt(a))
+                BINOP(0xA0, f64, double, f64, a + b)
+                BINOP(0xA1, f64, double, f64, a - b)
+                BINOP(0xA2, f64, double, f64, a * b)
+                BINOP(0xA3, f64, double, f64, a / b)
+                BINOP(0xA4, f64, double, f64, wasm_min(a, b))
+                BINOP(0xA5, f64, double, f64, wasm_max(a, b))
+                BINOP(0xA6, f64, double, f64, std::copysign(a, b))
+
+                UNOP(0xA7, i64, int64_t, i32, (int32_t)a)
+                UNOP(0xA8, f32, float, i32, (trunc_or_trap<int32_t>(a)))
+                UNOP(0xA9, f32, float, i32, (trunc_or_trap<uint32_t>(a)))
+                UNOP(0xAA, f64, double, i32, (trunc_or_trap<int32_t>(a)))
+                UNOP(0xAB, f64, double, i32, (trunc_or_trap<uint32_t>(a)))
+                UNOP(0xAC, i32, int32_t, i64, (int64_t)a)
+                UNOP(0xAD, i32, uint32_t, i64, (int64_t)a)
+                UNOP(0xAE, f32, float, i64, (trunc_or_trap<int64_t>(a)))
+                UNOP(0xAF, f32, float, i64, (trunc_or_trap<uint64_t>(a)))
+                UNOP(0xB0, f64, double, i64, (trunc_or_trap<int64_t>(a)))
+                UNOP(0xB1, f64, double, i64, (trunc_or_trap<uint64_t>(a)))
+                UNOP(0xB2, i32, int32_t, f32, (float)a)
+                UNOP(0xB3, i32, uint32_t, f32, (float)a)
+                UNOP(0xB4, i64, int64_t, f32, (float)a)
+                UNOP(0xB5, i64, uint64_t, f32, (float)a)
+                UNOP(0xB6, f64, double, f32, (float)a)
+                UNOP(0xB7, i32, int32_t, f64, (double)a)
+                UNOP(0xB8, i32, uint32_t, f64, (double)a)
+                UNOP(0xB9, i64, int64_t, f64, (double)a)
+                UNOP(0xBA, i64, uint64_t, f64, (double)a)
+                UNOP(0xBB, f32, float, f64, (double)a)
+                UNOP(0xC0, i32, int32_t, i32, (int8_t)a)
+                UNOP(0xC1, i32, int32_t, i32, (int16_t)a)
+                UNOP(0xC2, i64, int64_t, i64, (int8_t)a)
+                UNOP(0xC3, i64, int64_t, i64, (int16_t)a)
+                UNOP(0xC4, i64, int64_t, i64, (int32_t)a)
+
+                UNOP(OP_FC_PREFIX + 0, f32, float, i32, (trunc_sat<int32_t>(a)))
+                UNOP(OP_FC_PREFIX + 1, f32, float, i32, (trunc_sat<uint32_t>(a)))
+                UNOP(OP_FC_PREFIX + 2, f64, double, i32, (trunc_sat<int32_t>(a)))
+                UNOP(OP_FC_PREFIX + 3, f64, double, i32, (trunc_sat<uint32_t>(a)))
+                UNOP(OP_FC_PREFIX + 4, f32, float, i64, (trunc_sat<int64_t>(a)))
+                UNOP(OP_FC_PREFIX + 5, f32, float, i64, (trunc_sat<uint64_t>(a)))
+                UNOP(OP_FC_PREFIX + 6, f64, double, i64, (trunc_sat<int64_t>(a)))
+                UNOP(OP_FC_PREFIX + 7, f64, double, i64, (trunc_sat<uint64_t>(a)))
+
+                // The bulk operations check their whole range once up front,
+                // so they either trap or complete without partial writes
+                case OP_FC_PREFIX + 8: {
+                    uint32_t d = sp[-3].i32, s = sp[-2].i32, n = sp[-1].i32;
+                    sp -= 3;
+                    if ((uint64_t)s + n > data_sizes[ip->arg] || (uint64_t)d + n > memory->size()) {
+                        throw LFortranException("trap: out of bounds memory access");
+                    }
+                    bulk_copy(mem + d, &wasm_bytes[datas[ip->arg].bytes_start + s], n);
+                    break;
+                }
+                case OP_FC_PREFIX + 9: {
+                    data_sizes[ip->arg] = 0;
+                    break;
+                }
+                case OP_FC_PREFIX + 10: {
+                    uint32_t d = sp[-3].i32, s = sp[-2].i32, n = sp[-1].i32;
+                    sp -= 3;
+                    if ((uint64_t)s + n > memory->size() || (uint64_t)d + n > memory->size()) {
+                        throw LFortranException("trap: out of bounds memory access");
+                    }
+                    bulk_copy(mem + d, mem + s, n);
+                    break;
+                }
+                case OP_FC_PREFIX + 11: {
+                    uint32_t d = sp[-3].i32, n = sp[-1].i32;
+                    uint8_t val = sp[-2].i32;
+                    sp -= 3;
+                    if ((uint64_t)d + n > memory->size()) {
+                        throw LFortranException("trap: out of bounds memory access");
+                    }
+                    bulk_fill(mem + d, val, n);
+                    break;
+                }
+                case OP_FC_PREFIX + 12: {
+                    std::vector<uint32_t>& table = table_elements[ip->imm.i32];
+                    const std::vector<uint32_t>& refs = element_refs[ip->arg];
+                    uint32_t d = sp[-3].i32, s = sp[-2].i32, n = sp[-1].i32;
+                    sp -= 3;
+                    if ((uint64_t)s + n > refs.size() || (uint64_t)d + n > table.size()) {
+                        throw LFortranException("trap: out of bounds table access");
+                    }
+                    std::copy(refs.begin() + s, refs.begin() + s + n, table.begin() + d);
+                    break;
+                }
+                case OP_FC_PREFIX + 13: {
+                    element_refs[ip->arg].clear();
+                    break;
+                }
+                case OP_FC_PREFIX + 14: {
+                    std::vector<uint32_t>& dst = table_elements[ip->arg];
+                    const std::vector<uint32_t>& src = table_elements[ip->imm.i32];
+                    uint32_t d = sp[-3].i32, s = sp[-2].i32, n = sp[-1].i32;
+                    sp -= 3;
+                    if ((uint64_t)s + n > src.size() || (uint64_t)d + n > dst.size()) {
+                        throw LFortranException("trap: out of bounds table access");
+                    }
+                    std::memmove(dst.data() + d, src.data() + s, (size_t)n * sizeof(uint32_t));
+                    break;
+                }
+                case OP_FC_PREFIX + 15: {
+                    std::vector<uint32_t>& table = table_elements[ip->arg];
+                    const Limits& limits = tables[ip->arg].limits;
+                    uint32_t init = sp[-2].i32, n = sp[-1].i32;
+                    uint64_t max = limits.has_max ? limits.max : 0xFFFFFFFFULL;
+                    sp--;
+                    if (table.size() + (uint64_t)n > max) {
+                        sp[-1].i32 = -1;
+                    } else {
+                        sp[-1].i32 = table.size();
+                        table.resize(table.size() + n, init);
+                    }
+                    break;
+                }
+                case OP_FC_PREFIX + 16: {
+                    (sp++)->i32 = table_elements[ip->arg].size();
+                    break;
+                }
+                case OP_FC_PREFIX + 17: {
+                    std::vector<uint32_t>& table = table_elements[ip->arg];
+                    uint32_t i = sp[-3].i32, val = sp[-2].i32, n = sp[-1].i32;
+                    sp -= 3;
+                    if ((uint64_t)i + n > table.size()) {
+                        throw LFortranException("trap: out of bounds table access");
+                    }
+                    std::fill(table.begin() + i, table.begin() + i + n, val);
+                    break;
+                }
+
+                case OP_FD_PREFIX + 0: {
+                    std::memcpy(sp[-1].v128, mem + (uint32_t)sp[-1].i32 + (uint64_t)ip->arg, 16);
+                    break;
+                }
+                case OP_FD_PREFIX + 1: {
+                    uint8_t* addr = mem + (uint32_t)sp[-1].i32 + (uint64_t)ip->arg;
+                    std::memcpy(sp[-1].v128, addr, 8);
+                    simd.unary[ip->imm.i32](sp[-1].v128);
+                    break;
+                }
+                case OP_FD_PREFIX + 7:
+                case OP_FD_PREFIX + 8:
+                case OP_FD_PREFIX + 9:
+                case OP_FD_PREFIX + 10: {
+                    // the splat of the loaded lane size, which is 1 << (num - 7)
+                    uint32_t num = ip->op - OP_FD_PREFIX;
+                    uint8_t* addr = mem + (uint32_t)sp[-1].i32 + (uint64_t)ip->arg;
+                    std::memcpy(sp[-1].v128, addr, 1U << (num - 7));
+                    simd.unary[num + 8](sp[-1].v128);
+                    break;
+                }
+                case OP_FD_PREFIX + 92:
+                case OP_FD_PREFIX + 93: {
+                    uint32_t size = ip->op == OP_FD_PREFIX + 92 ? 4 : 8;
+                    uint8_t* addr = mem + (uint32_t)sp[-1].i32 + (uint64_t)ip->arg;
+                    std::memset(sp[-1].v128, 0, 16);
+                    std::memcpy(sp[-1].v128, addr, size);
+                    break;
+                }
+                case OP_FD_PREFIX + 11: {
+                    std::memcpy(mem + (uint32_t)sp[-2].i32 + (uint64_t)ip->arg, sp[-1].v128, 16);
+                    sp -= 2;
+                    break;
+                }
+                case OP_FD_PREFIX + 84:
+                case OP_FD_PREFIX + 85:
+                case OP_FD_PREFIX + 86:
+                case OP_FD_PREFIX + 87: {
+                    uint32_t size = 1U << (ip->op - (OP_FD_PREFIX + 84));
+                    uint8_t* addr = mem + (uint32_t)sp[-2].i32 + (uint64_t)ip->arg;
+                    std::memcpy(sp[-1].v128 + ip->imm.i32 * size, addr, size);
+                    sp[-2] = sp[-1];
+                    sp--;
+                    break;
+                }
+                case OP_FD_PREFIX + 88:
+                case OP_FD_PREFIX + 89:
+                case OP_FD_PREFIX + 90:
+                case OP_FD_PREFIX + 91: {
+                    uint32_t size = 1U << (ip->op - (OP_FD_PREFIX + 88));
+                    uint8_t* addr = mem + (uint32_t)sp[-2].i32 + (uint64_t)ip->arg;
+                    std::memcpy(addr, sp[-1].v128 + ip->imm.i32 * size, size);
+                    sp -= 2;
+                    break;
+                }
+                case OP_FD_PREFIX + 12: {
+                    std::memcpy(sp->v128, &ip[0].imm, 8);
+                    std::memcpy(sp->v128 + 8, &ip[1].imm, 8);
+                    sp++;
+                    ip++;
+                    break;
+                }
+                case OP_FD_PREFIX + 13: {
+                    uint8_t lanes[16], r[16];
+                    std::memcpy(lanes, &ip[0].imm, 8);
+                    std::memcpy(lanes + 8, &ip[1].imm, 8);
+                    for (int i = 0; i < 16; i++) {
+                        r[i] = lanes[i] < 16 ? sp[-2].v128[lanes[i]] : sp[-1].v128[lanes[i] - 16];
+                    }
+                    sp--;
+                    std::memcpy(sp[-1].v128, r, 16);
+                    ip++;
+                    break;
+                }
+                case OP_FD_PREFIX + 21: {
+                    sp[-1].i32 = (int8_t)sp[-1].v128[ip->arg];
+                    break;
+                }
+                case OP_FD_PREFIX + 22: {
+                    sp[-1].i32 = sp[-1].v128[ip->arg];
+                    break;
+                }
+                case OP_FD_PREFIX + 24:
+                case OP_FD_PREFIX + 25: {
+                    uint16_t x;
+                    std::memcpy(&x, sp[-1].v128 + 2 * ip->arg, 2);
+                    sp[-1].i32 = ip->op == OP_FD_PREFIX + 24 ? (int32_t)(int16_t)x : (int32_t)x;
+                    break;
+                }
+                case OP_FD_PREFIX + 27:
+                case OP_FD_PREFIX + 29:
+                case OP_FD_PREFIX + 31:
+                case OP_FD_PREFIX + 33: {
+                    // 4 byte lanes for i32x4/f32x4, 8 byte lanes for i64x2/f64x2
+                    uint32_t size = (ip->op - (OP_FD_PREFIX + 27)) % 4 == 0 ? 4 : 8;
+                    Value r = {};
+                    std::memcpy(&r, sp[-1].v128 + size * ip->arg, size);
+                    sp[-1] = r;
+                    break;
+                }
+                case OP_FD_PREFIX + 23:
+                case OP_FD_PREFIX + 26:
+                case OP_FD_PREFIX + 28:
+                case OP_FD_PREFIX + 30:
+                case OP_FD_PREFIX + 32:
+                case OP_FD_PREFIX + 34: {
+                    uint32_t num = ip->op - OP_FD_PREFIX;
+                    uint32_t size = num == 23 ? 1 : num == 26 ? 2 : num == 28 || num == 32 ? 4 : 8;
+                    std::memcpy(sp[-2].v128 + size * ip->arg, &sp[-1], size);
+                    sp--;
+                    break;
+                }
+                case OP_V128_UNARY: {
+                    simd.unary[ip->arg](sp[-1].v128);
+                    break;
+                }
+                case OP_V128_BINARY: {
+                    simd.binary[ip->arg](sp[-2].v128, sp[-1].v128);
+                    sp--;
+                    break;
+                }
+                case OP_V128_TERNARY: {
+                    simd.ternary[ip->arg](sp[-3].v128, sp[-2].v128, sp[-1].v128);
+                    sp -= 2;
+                    break;
+                }
+                case OP_V128_TEST: {
+                    sp[-1].i32 = simd.test[ip->arg](sp[-1].v128);
+                    break;
+                }
+                case OP_V128_SHIFT: {
+                    simd.shift[ip->arg](sp[-2].v128, sp[-1].i32);
+                    sp--;
+                    break;
+                }
+
+                case OP_CHARGE_FUEL: {
+                    if (fuel < ip->arg) {
+                        // stop before the block, resume() charges it again
+                        suspension = {true, suspension.func_idx, ip, sp, fp};
+                        return SUSPENDED;
+                    }
+                    fuel -= ip->arg;
+                    break;
+                }
+
+                case OP_LAZY_COMPILE: {
+                    ip = compile(frames.back().func_idx);
+                    continue;
+                }
+                case OP_HOST_CALL: {
+                    if (!host_functions[ip->arg]) {
+                        throw LFortranException("trap: unresolved import " + import_name(ip->arg));
+                    }
+                    // the host function may look at the fuel or add to it
+                    this->fuel = fuel;
+                    host_functions[ip->arg](*this, fp);
+                    fuel = this->fuel;
+                    sp = fp + func_infos[ip->arg].num_results;
+                    break;
+                }
+                default: {
+                    throw LFortranException("execute: unknown lowered opcode " + std::to_string(ip->op));
+                }
+            }
+            ip++;
+        } while (false);
+        return RUNNING;
+
+#undef UNOP
+#undef BINOP
+#undef LOAD
+#undef STORE
+    }
+};
+
+}  // namespace LFortran
+
+#endif  // LFORTRAN_WASM_INTERPRETER_H
@@ -0,0 +1,43 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "wasm_linker.h"
+
+using namespace LFortran;
+
+// Links modules into one and reports what it merged
+int main(int argc, char** argv) {
+    unsigned num_threads = 0;
+    int argi = 1;
+    for (; argi < argc && std::string(argv[argi]).rfind("--", 0) == 0; argi++) {
+        std::string arg = argv[argi];
+        if (arg.rfind("--threads=", 0) == 0) {
+            num_threads = std::stoul(arg.substr(10));
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (argc - argi < 2) {
+        std::cerr << "Usage: " << argv[0] << " [--threads=N] out.wasm in.wasm..." << std::endl;
+        return 1;
+    }
+    LinkStats stats;
+    WASMAssembler wasm;
+    try {
+        wasm.code = link_modules(stats, std::vector<std::string>(argv + argi + 1, argv + argc), num_threads);
+    } catch (const std::string& e) {
+        std::cerr << e << std::endl;
+        return 1;
+    }
+    wasm.save_bin(argv[argi]);
+
+    std::cout << "inputs: " << stats.inputs << ", functions: " << stats.functions << std::endl;
+    std::cout << "imports: " << stats.imports_resolved << " resolved, " << stats.imports_left << " left" << std::endl;
+    std::cout << "types: " << stats.types_before << " -> " << stats.types_after << std::endl;
+    std::cout << "code: " << stats.bytes_copied << " bytes copied, " << stats.bytes_rewritten << " rewritten"
+              << std::endl;
+    std::cout << "module: " << wasm.code.size() << " bytes" << std::endl;
+    return 0;
+}
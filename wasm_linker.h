@@ -0,0 +1,510 @@
+#ifndef LFORTRAN_WASM_LINKER_H
+#define LFORTRAN_WASM_LINKER_H
+
+#include <fcntl.h>
+#include <map>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "wasm_assembler.h"
+#include "wasm_decoder.h"
+#include "wasm_thread_pool.h"
+#include "wasm_threaded.h"
+#include "wasm_visitor.h"
+
+namespace LFortran {
+
+struct LinkStats {
+    uint32_t inputs = 0;
+    uint32_t functions = 0;         // defined ones
+    uint32_t imports_resolved = 0;  // function imports bound to an export of another input
+    uint32_t imports_left = 0;      // function imports of the linked module
+    uint32_t types_before = 0;
+    uint32_t types_after = 0;
+    uint64_t bytes_copied = 0;     // of code entries, copied as they were
+    uint64_t bytes_rewritten = 0;  // of the instructions whose index changed
+};
+
+// The instructions of a body that refer to a function or a type, the only
+// ones linking changes
+class IndexFinder : public WASM_INSTS_VISITOR::BaseWASMVisitor<IndexFinder> {
+   public:
+    struct Ref {
+        uint32_t start;  // of the instruction, in wasm_bytes
+        uint32_t index;
+        bool type;  // a type index, else a function index
+    };
+
+    std::vector<Ref> refs;
+
+    // Finds the references of the body whose instructions start at
+    // `offset`, returns where it ends
+    uint32_t find(uint32_t offset) {
+        refs.clear();
+        return decode_instructions(offset);
+    }
+
+    void begin_instruction(uint32_t offset) { start = offset; }
+
+#define X(name, op)                      \
+    template <class... Args>             \
+    void visit_##name(const Args&...) {}
+    WASM_THREADED_OPS(X)
+#undef X
+
+    void visit_Call(uint32_t funcidx) { refs.push_back({start, funcidx, false}); }
+
+    void visit_RefFunc(uint32_t funcidx) { refs.push_back({start, funcidx, false}); }
+
+    void visit_CallIndirect(uint32_t typeidx, uint32_t /*tableidx*/) { refs.push_back({start, typeidx, true}); }
+
+    void visit_Block(int64_t blocktype) { block_type(blocktype); }
+
+    void visit_Loop(int64_t blocktype) { block_type(blocktype); }
+
+    void visit_If(int64_t blocktype) { block_type(blocktype); }
+
+   private:
+    uint32_t start = 0;
+
+    void block_type(int64_t blocktype) {
+        if (blocktype >= 0) {
+            refs.push_back({start, (uint32_t)blocktype, true});
+        }
+    }
+};
+
+// Links modules into one: their types are merged with duplicates removed,
+// a function import is bound to the function another input exports under
+// its name (the import's module name is not looked at) and the rest stay
+// imports, deduplicated by module and name. Functions keep the order of the
+// inputs after the imports, so the result does not depend on scheduling.
+//
+// The inputs are laid out one after another in wasm_bytes. Reading them
+// and rewriting their code run in parallel per input; a code entry is
+// copied in runs between the `call`, `ref.func`, `call_indirect` and block
+// types whose index changed, which are the only instructions re-encoded.
+// Only type, import, function, export, code and custom sections can be
+// linked, the custom sections are dropped, and inputs with imports other
+// than functions must all import the same ones (such as a shared memory).
+class Linker {
+   public:
+    Linker(LinkStats& stats, unsigned num_threads = 0) : stats(stats), pool(num_threads) {}
+
+    std::vector<uint8_t> link(const std::vector<std::string>& paths) {
+        read_inputs(paths);
+        for (Input& in : inputs) {
+            decode_input(in);
+        }
+        merge_types();
+        resolve_functions();
+        pool.parallel_for(inputs.size(), [this](uint32_t i) { link_code(inputs[i]); });
+        return emit_module();
+    }
+
+   private:
+    struct InputImport {
+        Import import;
+        uint32_t start;  // of the entry in wasm_bytes
+        uint32_t end;
+    };
+
+    // A code entry, after its length
+    struct Body {
+        uint32_t start;
+        uint32_t size;
+        uint32_t insts_start;
+    };
+
+    struct Input {
+        std::string path;
+        uint32_t base;
+        uint32_t size;
+        std::vector<FuncType> types;
+        std::vector<uint32_t> type_indices;
+        std::vector<InputImport> imports;
+        std::vector<Export> exports;
+        std::vector<Body> bodies;
+        uint32_t num_imported = 0;  // functions
+        std::vector<uint32_t> new_type;
+        std::vector<uint32_t> new_func;  // by function index of the input
+        std::vector<uint8_t> code;       // the linked code entries
+        uint64_t bytes_copied = 0;
+        uint64_t bytes_rewritten = 0;
+    };
+
+    LinkStats& stats;
+    WorkStealingPool pool;
+    std::vector<Input> inputs;
+    std::vector<FuncType> types;
+    std::vector<Import> func_imports;    // of the linked module
+    std::vector<uint8_t> other_imports;  // entries of the other kinds, the same in every input that has any
+    uint32_t num_other_imports = 0;
+
+    void read_inputs(const std::vector<std::string>& paths) {
+        uint64_t total = 0;
+        inputs.resize(paths.size());
+        for (size_t i = 0; i < paths.size(); i++) {
+            struct stat st;
+            if (stat(paths[i].c_str(), &st) != 0) {
+                throw LFortranException("link: cannot read " + paths[i]);
+            }
+            inputs[i].path = paths[i];
+            inputs[i].base = total;
+            inputs[i].size = st.st_size;
+            total += st.st_size;
+            if (total > UINT32_MAX) {
+                throw LFortranException("link: the inputs take more than 4 GB");
+            }
+        }
+        wasm_bytes.resize(total);
+        pool.parallel_for(inputs.size(), [this](uint32_t i) {
+            const Input& in = inputs[i];
+            int fd = open(in.path.c_str(), O_RDONLY | O_CLOEXEC);
+            size_t done = 0;
+            while (fd >= 0 && done < in.size) {
+                ssize_t n = pread(fd, wasm_bytes.data() + in.base + done, in.size - done, done);
+                if (n <= 0) {
+                    break;
+                }
+                done += n;
+            }
+            if (fd >= 0) {
+                close(fd);
+            }
+            if (done != in.size) {
+                throw LFortranException("link: cannot read " + in.path);
+            }
+        });
+        stats.inputs += inputs.size();
+    }
+
+    // Decodes what linking needs of an input with the section decoders,
+    // which fill the module globals, and moves it out of them
+    void decode_input(Input& in) {
+        static const char* SECTION_NAMES[] = {"custom", "type",  "import",  "function", "table", "memory",   "global",
+                                              "export", "start", "element", "code",     "data",  "datacount"};
+        if (in.size < 8 || std::memcmp(&wasm_bytes[in.base], "\0asm", 4) != 0) {
+            throw LFortranException("link: " + in.path + " is not a wasm module");
+        }
+        clear_module();
+        uint32_t offset = in.base + 8;
+        uint32_t end = in.base + in.size;
+        while (offset < end) {
+            uint32_t id = read_unsigned_num(offset);
+            uint32_t size = read_unsigned_num(offset);
+            if (size > end - offset) {
+                throw LFortranException("link: " + in.path + ": section out of bounds");
+            }
+            switch (id) {
+                case 0U: break;
+                case 1U: decode_type_section(offset); break;
+                case 2U: decode_imports(in, offset); break;
+                case 3U: decode_function_section(offset); break;
+                case 7U: decode_export_section(offset); break;
+                case 10U: decode_bodies(in, offset); break;
+                default:
+                    throw LFortranException("link: " + in.path + " has a " +
+                                            (id < 13 ? SECTION_NAMES[id] : "unknown") +
+                                            " section, only type, import, function, export and code sections are linked");
+            }
+            offset += size;
+        }
+        in.types = std::move(func_types);
+        in.type_indices = std::move(type_indices);
+        in.exports = std::move(exports);
+        clear_module();
+        if (in.type_indices.size() != in.bodies.size()) {
+            throw LFortranException("link: " + in.path + ": function and code sections differ");
+        }
+        stats.types_before += in.types.size();
+    }
+
+    // follows decode_import_section, keeping where each entry is
+    void decode_imports(Input& in, uint32_t offset) {
+        uint32_t n = read_unsigned_num(offset);
+        for (uint32_t i = 0; i < n; i++) {
+            InputImport imp;
+            imp.start = offset;
+            imp.import.module = decode_name(offset);
+            imp.import.name = decode_name(offset);
+            imp.import.kind = read_byte(offset);
+            imp.import.type_index = 0;
+            switch (imp.import.kind) {
+                case 0x00:
+                    imp.import.type_index = read_unsigned_num(offset);
+                    in.num_imported++;
+                    break;
+                case 0x01:
+                    read_byte(offset);
+                    decode_limits(offset);
+                    break;
+                case 0x02: decode_limits(offset); break;
+                case 0x03: offset += 2; break;
+                default: throw LFortranException("link: " + in.path + ": invalid import kind");
+            }
+            imp.end = offset;
+            in.imports.push_back(imp);
+        }
+    }
+
+    void decode_bodies(Input& in, uint32_t offset) {
+        uint32_t n = read_unsigned_num(offset);
+        for (uint32_t i = 0; i < n; i++) {
+            Body b;
+            b.size = read_unsigned_num(offset);
+            b.start = offset;
+            uint32_t runs = read_unsigned_num(offset);
+            for (uint32_t k = 0; k < runs; k++) {
+                read_unsigned_num(offset);
+                read_byte(offset);
+            }
+            b.insts_start = offset;
+            in.bodies.push_back(b);
+            offset = b.start + b.size;
+        }
+    }
+
+    void merge_types() {
+        std::map<std::pair<std::vector<uint8_t>, std::vector<uint8_t>>, uint32_t> found;
+        for (Input& in : inputs) {
+            for (const FuncType& t : in.types) {
+                auto it = found.emplace(std::make_pair(t.param_types, t.result_types), types.size());
+                if (it.second) {
+                    types.push_back(t);
+                }
+                in.new_type.push_back(it.first->second);
+            }
+        }
+        stats.types_after += types.size();
+    }
+
+    // The linked index of function `func_idx` of input `k` is either a
+    // function import of the result (the first) or a defined function
+    // (the second, its input and code index)
+    struct Target {
+        bool imported;
+        uint32_t index;  // into func_imports, or of the code entry
+        uint32_t input;
+    };
+
+    void resolve_functions() {
+        std::map<std::string, std::pair<uint32_t, uint32_t>> exported;  // input and function index
+        for (uint32_t k = 0; k < inputs.size(); k++) {
+            for (const Export& e : inputs[k].exports) {
+                if (e.kind == 0x00 && !exported.emplace(e.name, std::make_pair(k, e.index)).second) {
+                    throw LFortranException("link: " + e.name + " is exported by " +
+                                            inputs[exported[e.name].first].path + " and " + inputs[k].path);
+                }
+            }
+        }
+
+        std::map<std::pair<std::string, std::string>, uint32_t> imported;  // module and name
+        std::vector<std::vector<Target>> targets(inputs.size());
+        for (uint32_t k = 0; k < inputs.size(); k++) {
+            std::vector<uint8_t> others;
+            uint32_t num_others = 0;
+            for (const InputImport& imp : inputs[k].imports) {
+                if (imp.import.kind != 0x00) {
+                    others.insert(others.end(), wasm_bytes.begin() + imp.start, wasm_bytes.begin() + imp.end);
+                    num_others++;
+                    continue;
+                }
+                Target t = resolve(k, imp.import, exported, 0);
+                if (t.imported) {
+                    auto key = std::make_pair(imp.import.module, imp.import.name);
+                    auto it = imported.emplace(key, func_imports.size());
+                    if (it.second) {
+                        func_imports.push_back(imp.import);
+                        func_imports.back().type_index = inputs[k].new_type[imp.import.type_index];
+                    }
+                    t.index = it.first->second;
+                } else {
+                    stats.imports_resolved++;
+                }
+                if (type_of(t) != inputs[k].new_type[imp.import.type_index]) {
+                    throw LFortranException("link: " + inputs[k].path + " imports " + imp.import.name +
+                                            " with another type than it has");
+                }
+                targets[k].push_back(t);
+            }
+            if (num_other_imports == 0) {
+                other_imports = std::move(others);
+                num_other_imports = num_others;
+            } else if (num_others > 0 && others != other_imports) {
+                throw LFortranException("link: " + inputs[k].path +
+                                        " imports other memories, tables or globals than the inputs before it");
+            }
+        }
+        stats.imports_left += func_imports.size();
+
+        std::vector<uint32_t> base(inputs.size());
+        uint32_t n = func_imports.size();
+        for (uint32_t k = 0; k < inputs.size(); k++) {
+            base[k] = n;
+            n += inputs[k].bodies.size();
+        }
+        stats.functions += n - func_imports.size();
+        for (uint32_t k = 0; k < inputs.size(); k++) {
+            Input& in = inputs[k];
+            for (const Target& t : targets[k]) {
+                in.new_func.push_back(t.imported ? t.index : base[t.input] + t.index);
+            }
+            for (uint32_t i = 0; i < in.bodies.size(); i++) {
+                in.new_func.push_back(base[k] + i);
+            }
+        }
+    }
+
+    // Follows an import of input `k` through the exports of the other
+    // inputs, which may themselves re-export an import
+    Target resolve(uint32_t k, const Import& imp, const std::map<std::string, std::pair<uint32_t, uint32_t>>& exported,
+                   uint32_t depth) {
+        auto it = exported.find(imp.name);
+        if (it == exported.end() || it->second.first == k) {
+            return {true, 0, k};
+        }
+        if (depth > inputs.size()) {
+            throw LFortranException("link: the imports of " + imp.name + " form a cycle");
+        }
+        const Input& from = inputs[it->second.first];
+        uint32_t func_idx = it->second.second;
+        if (func_idx >= from.num_imported) {
+            return {false, func_idx - from.num_imported, it->second.first};
+        }
+        for (const InputImport& next : from.imports) {
+            if (next.import.kind == 0x00 && func_idx-- == 0) {
+                Target t = resolve(it->second.first, next.import, exported, depth + 1);
+                return t.imported ? Target{true, 0, k} : t;  // left an import of the first importer
+            }
+        }
+        throw LFortranException("link: " + from.path + " exports a function it does not have");
+    }
+
+    uint32_t type_of(const Target& t) const {
+        if (t.imported) {
+            return func_imports[t.index].type_index;
+        }
+        const Input& in = inputs[t.input];
+        return in.new_type[in.type_indices[t.index]];
+    }
+
+    // Copies the code entries of an input with the changed indices replaced
+    void link_code(Input& in) {
+        IndexFinder finder;
+        WASMAssembler insts;
+        WASMAssembler code;
+        for (const Body& b : in.bodies) {
+            insts.code.clear();
+            finder.find(b.insts_start);
+            uint32_t copied = b.start;  // the locals go with the first run
+            uint32_t rewritten = 0;
+            for (const IndexFinder::Ref& r : finder.refs) {
+                uint32_t index = r.type ? in.new_type[r.index] : in.new_func[r.index];
+                if (index == r.index) {
+                    continue;
+                }
+                insts.emit_bytes(wasm_bytes.data() + copied, r.start - copied);
+                uint32_t offset = r.start;
+                uint8_t op = read_byte(offset);
+                insts.emit_b8(op);
+                if (op >= 0x02 && op <= 0x04) {
+                    read_signed_num64(offset);
+                    insts.emit_i64(index);
+                } else {
+                    read_unsigned_num(offset);
+                    insts.emit_u32(index);
+                }
+                rewritten += offset - r.start;
+                copied = offset;
+            }
+            insts.emit_bytes(wasm_bytes.data() + copied, b.start + b.size - copied);
+            in.bytes_copied += b.size - rewritten;
+            in.bytes_rewritten += rewritten;
+            code.emit_u32(insts.code.size());
+            code.emit_bytes(insts.code.data(), insts.code.size());
+        }
+        in.code = std::move(code.code);
+    }
+
+    static void emit_section(WASMAssembler& wasm, uint8_t id, const std::vector<uint8_t>& contents) {
+        wasm.emit_b8(id);
+        wasm.emit_u32(contents.size());
+        wasm.emit_bytes(contents.data(), contents.size());
+    }
+
+    std::vector<uint8_t> emit_module() {
+        WASMAssembler wasm;
+        wasm.emit_bytes(wasm_bytes.data() + inputs[0].base, 8);  // magic number and version
+
+        WASMAssembler s;
+        s.emit_u32(types.size());
+        for (const FuncType& t : types) {
+            s.emit_b8(0x60);
+            s.emit_u32(t.param_types.size());
+            s.emit_bytes(t.param_types.data(), t.param_types.size());
+            s.emit_u32(t.result_types.size());
+            s.emit_bytes(t.result_types.data(), t.result_types.size());
+        }
+        emit_section(wasm, 1, s.code);
+
+        if (!func_imports.empty() || num_other_imports > 0) {
+            s.code.clear();
+            s.emit_u32(func_imports.size() + num_other_imports);
+            for (const Import& imp : func_imports) {
+                s.emit_u32(imp.module.size());
+                s.emit_bytes((const uint8_t*)imp.module.data(), imp.module.size());
+                s.emit_u32(imp.name.size());
+                s.emit_bytes((const uint8_t*)imp.name.data(), imp.name.size());
+                s.emit_b8(0x00);
+                s.emit_u32(imp.type_index);
+            }
+            s.emit_bytes(other_imports.data(), other_imports.size());
+            emit_section(wasm, 2, s.code);
+        }
+
+        s.code.clear();
+        s.emit_u32(stats.functions);
+        for (const Input& in : inputs) {
+            for (uint32_t t : in.type_indices) {
+                s.emit_u32(in.new_type[t]);
+            }
+        }
+        emit_section(wasm, 3, s.code);
+
+        s.code.clear();
+        uint32_t num_exports = 0;
+        for (const Input& in : inputs) {
+            num_exports += in.exports.size();
+        }
+        s.emit_u32(num_exports);
+        for (const Input& in : inputs) {
+            for (const Export& e : in.exports) {
+                s.emit_u32(e.name.size());
+                s.emit_bytes((const uint8_t*)e.name.data(), e.name.size());
+                s.emit_b8(e.kind);
+                s.emit_u32(e.kind == 0x00 ? in.new_func[e.index] : e.index);
+            }
+        }
+        emit_section(wasm, 7, s.code);
+
+        s.code.clear();
+        s.emit_u32(stats.functions);
+        for (Input& in : inputs) {
+            s.emit_bytes(in.code.data(), in.code.size());
+            stats.bytes_copied += in.bytes_copied;
+            stats.bytes_rewritten += in.bytes_rewritten;
+        }
+        emit_section(wasm, 10, s.code);
+        return wasm.code;
+    }
+};
+
+// Links the modules at `paths` into one and returns it
+std::vector<uint8_t> link_modules(LinkStats& stats, const std::vector<std::string>& paths, unsigned num_threads = 0) {
+    Linker linker(stats, num_threads);
+    return linker.link(paths);
+}
+
+}  // namespace LFortran
+
+#endif  // LFORTRAN_WASM_LINKER_H
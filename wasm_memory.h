@@ -0,0 +1,154 @@
+#ifndef LFORTRAN_WASM_MEMORY_H
+#define LFORTRAN_WASM_MEMORY_H
+
+#include <csetjmp>
+#include <csignal>
+#include <sys/mman.h>
+#include "wasm_utils.h"
+
+// Linear memory backed by a fixed virtual reservation. An effective address
+// is a 32-bit index plus a 32-bit static offset, so it is always below 8 GiB;
+// reserving that much (plus room for the widest access) means no access can
+// leave the reservation. Only the pages of the current memory size are
+// accessible, everything above them is PROT_NONE, so an out of bounds access
+// faults and is turned into a trap by the fault handler below instead of
+// being compared against the memory size on every load and store.
+class LinearMemory {
+   public:
+    static const uint64_t PAGE_SIZE = 65536ULL;
+    static const uint64_t MAX_PAGES = 65536ULL;
+    static const uint64_t RESERVATION = (1ULL << 33) + PAGE_SIZE;
+
+    uint8_t* base;
+    uint32_t pages;
+    uint32_t max_pages;
+
+    LinearMemory(uint32_t min_pages, uint32_t max_pages) : pages(0), max_pages(max_pages) {
+        if (min_pages > max_pages || max_pages > MAX_PAGES) {
+            throw LFortran::LFortranException("LinearMemory: invalid memory limits");
+        }
+        void* p = mmap(nullptr, RESERVATION, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+            throw LFortran::LFortranException("LinearMemory: cannot reserve address space");
+        }
+        base = (uint8_t*)p;
+        install_trap_handler();
+        if (grow(min_pages) < 0) {
+            munmap(base, RESERVATION);
+            throw LFortran::LFortranException("LinearMemory: cannot commit initial pages");
+        }
+    }
+
+    LinearMemory(const LinearMemory&) = delete;
+    LinearMemory& operator=(const LinearMemory&) = delete;
+
+    ~LinearMemory() { munmap(base, RESERVATION); }
+
+    uint64_t size() const { return (uint64_t)pages * PAGE_SIZE; }
+
+    // Makes `delta` more pages accessible in place; the memory never moves,
+    // so pointers into it stay valid. Returns the old size in pages, or -1.
+    int32_t grow(uint32_t delta) {
+        uint32_t old_pages = pages;
+        if ((uint64_t)pages + delta > max_pages) {
+            return -1;
+        }
+        if (delta > 0 && mprotect(base + size(), (uint64_t)delta * PAGE_SIZE, PROT_READ | PROT_WRITE) != 0) {
+            return -1;
+        }
+        pages += delta;
+        return old_pages;
+    }
+
+    // Replaces the contents with `num_pages` pages mapped copy-on-write from
+    // `fd` at `offset`, which must be aligned to PAGE_SIZE. Writes stay
+    // private to this memory; nothing is read until it is touched.
+    void map_file(int fd, uint64_t offset, uint32_t num_pages) {
+        if (num_pages > max_pages) {
+            throw LFortran::LFortranException("LinearMemory: mapped memory exceeds the maximum size");
+        }
+        decommit(0);
+        void* p = mmap(base, (uint64_t)num_pages * PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, offset);
+        if (p == MAP_FAILED) {
+            throw LFortran::LFortranException("LinearMemory: cannot map memory from file");
+        }
+        pages = num_pages;
+        file_pages = num_pages;
+    }
+
+    // Returns a memory set up by map_file() to the mapped contents: dropping
+    // the private copies of the touched pages makes them read through to the
+    // file again, and pages grown since are released.
+    void reset_to_file() {
+        decommit(file_pages);
+        if (madvise(base, size(), MADV_DONTNEED) != 0) {
+            throw LFortran::LFortranException("LinearMemory: cannot reset memory");
+        }
+    }
+
+    bool contains(const void* addr) const {
+        return (const uint8_t*)addr >= base && (const uint8_t*)addr < base + RESERVATION;
+    }
+
+    // The memory and jump buffer of the innermost running invocation on this
+    // thread; a fault inside that reservation jumps back to it.
+    static thread_local LinearMemory* active;
+    static thread_local sigjmp_buf* trap_jmp;
+
+   private:
+    uint32_t file_pages = 0;
+
+    // Releases every page from `num_pages` on and makes it inaccessible again
+    void decommit(uint32_t num_pages) {
+        if (num_pages >= pages) {
+            return;
+        }
+        uint64_t start = (uint64_t)num_pages * PAGE_SIZE;
+        void* p = mmap(base + start, size() - start, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+        if (p == MAP_FAILED) {
+            throw LFortran::LFortranException("LinearMemory: cannot release memory");
+        }
+        pages = num_pages;
+    }
+
+    // The handlers SIGSEGV and SIGBUS had before ours
+    static struct sigaction& previous_action(int sig) {
+        static struct sigaction segv, bus;
+        return sig == SIGBUS ? bus : segv;
+    }
+
+    // Linux raises SIGSEGV for an access to a PROT_NONE page, macOS SIGBUS
+    static void fault_handler(int sig, siginfo_t* info, void* context) {
+        if (active && trap_jmp && active->contains(info->si_addr)) {
+            siglongjmp(*trap_jmp, 1);
+        }
+        // not a guest access: hand the fault to whoever had it before us
+        struct sigaction& prev = previous_action(sig);
+        if (prev.sa_flags & SA_SIGINFO) {
+            prev.sa_sigaction(sig, info, context);
+        } else if (prev.sa_handler != SIG_DFL && prev.sa_handler != SIG_IGN) {
+            prev.sa_handler(sig);
+        } else {
+            sigaction(sig, &prev, nullptr);  // the faulting access re-executes and kills us
+        }
+    }
+
+    static void install_trap_handler() {
+        static bool installed = false;
+        if (installed) {
+            return;
+        }
+        struct sigaction action = {};
+        action.sa_sigaction = fault_handler;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGSEGV, &action, &previous_action(SIGSEGV));
+        sigaction(SIGBUS, &action, &previous_action(SIGBUS));
+        installed = true;
+    }
+};
+
+thread_local LinearMemory* LinearMemory::active = nullptr;
+thread_local sigjmp_buf* LinearMemory::trap_jmp = nullptr;
+
+#endif  // LFORTRAN_WASM_MEMORY_H
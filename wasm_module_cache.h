@@ -0,0 +1,445 @@
+#ifndef LFORTRAN_WASM_MODULE_CACHE_H
+#define LFORTRAN_WASM_MODULE_CACHE_H
+
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "wasm_interpreter.h"
+
+namespace LFortran {
+
+// An on-disk cache of decoded modules and their lowered code, one file per
+// module named after the hash of its bytes (FNV-1a, see hash_bytes()):
+//
+//     header | decoded module | function entries | instructions | call caches | relocations
+//
+// Everything is addressed by offsets, so an entry is used by mapping the
+// file privately and patching the call_indirect instructions, which are the
+// only ones holding pointers, to their call caches.
+class ModuleCache {
+   public:
+    static const uint32_t VERSION = 5;
+    static const uint64_t DEFAULT_MAX_BYTES = 256ULL << 20;
+    static constexpr uint64_t NOT_LOWERED = ~0ULL;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t metered;
+        uint64_t module_hash;
+        uint64_t module_size;
+        uint64_t file_size;
+        uint64_t module_offset;  // the decoded module, see write_module()
+        uint64_t module_bytes;
+        uint64_t entries_offset;  // first instruction of every function
+        uint64_t num_funcs;
+        uint64_t insts_offset;
+        uint64_t num_insts;
+        uint64_t caches_offset;
+        uint64_t num_caches;
+        uint64_t relocs_offset;
+        uint64_t num_relocs;
+    };
+
+    // The call_indirect at instruction `inst` uses call cache `cache`
+    struct Reloc {
+        uint64_t inst;
+        uint64_t cache;
+    };
+
+    std::string dir;
+    uint64_t max_bytes;
+
+    explicit ModuleCache(const std::string& dir, uint64_t max_bytes = DEFAULT_MAX_BYTES) : dir(dir), max_bytes(max_bytes) {
+        mkdir(dir.c_str(), 0755);
+    }
+
+    // Looks up the module in wasm_bytes. On a hit the decoded module is
+    // restored into the globals of wasm_utils.h, as decode_wasm() would, and
+    // the returned image holds its lowered code; nullptr means the caller has
+    // to decode. Entries from another version or of another module are
+    // stale and get removed.
+    std::unique_ptr<CodeImage> load(bool metered = false) {
+        uint64_t hash = hash_bytes(wasm_bytes.data(), wasm_bytes.size());
+        std::string path = entry_path(hash, metered);
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return nullptr;
+        }
+        struct stat st;
+        void* base = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && (uint64_t)st.st_size >= sizeof(Header)) {
+            base = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (base == MAP_FAILED) {
+            return nullptr;
+        }
+        std::unique_ptr<MappedImage> image(new MappedImage(base, st.st_size));
+        const Header& h = *(const Header*)base;
+        if (!valid(h, st.st_size, hash) || h.metered != metered) {
+            unlink(path.c_str());
+            return nullptr;
+        }
+
+        ByteReader r{(const uint8_t*)base + h.module_offset, h.module_bytes, 0};
+        read_module(r);
+        if (::num_funcs() != h.num_funcs) {
+            unlink(path.c_str());
+            return nullptr;
+        }
+        uint8_t* p = (uint8_t*)base;
+        const uint64_t* entries = (const uint64_t*)(p + h.entries_offset);
+        Inst* insts = (Inst*)(p + h.insts_offset);
+        CallCache* caches = (CallCache*)(p + h.caches_offset);
+        const Reloc* relocs = (const Reloc*)(p + h.relocs_offset);
+        for (uint64_t i = 0; i < h.num_relocs; i++) {
+            insts[relocs[i].inst].imm.cache = &caches[relocs[i].cache];
+        }
+        image->metered = metered;
+        image->entries.resize(h.num_funcs);
+        image->sizes.resize(h.num_funcs);
+        uint64_t end = h.num_insts;  // functions are stored in index order
+        for (uint64_t i = h.num_funcs; i-- > 0;) {
+            if (entries[i] != NOT_LOWERED) {
+                image->entries[i] = &insts[entries[i]];
+                image->sizes[i] = end - entries[i];
+                end = entries[i];
+            }
+        }
+        utimensat(AT_FDCWD, path.c_str(), nullptr, 0);  // most recently used
+        return image;
+    }
+
+    // Stores the decoded module in the globals of wasm_utils.h together with
+    // the functions `interp` has lowered, then evicts the least recently used
+    // entries beyond the size bound.
+    void store(const Interpreter& interp) {
+        std::vector<uint8_t> module;
+        ByteWriter mw{module};
+        write_module(mw);
+
+        std::vector<uint64_t> entries(interp.compiled.size(), NOT_LOWERED);
+        std::vector<Inst> insts;
+        std::vector<CallCache> caches;
+        std::vector<Reloc> relocs;
+        for (uint32_t i = 0; i < interp.compiled.size(); i++) {
+            const CompiledFunc* f = interp.compiled[i].get();
+            if (!f) {
+                continue;
+            }
+            entries[i] = insts.size();
+            for (const Inst& inst : f->insts) {
+                Inst copy = inst;
+                if (inst.op == 0x11) {
+                    relocs.push_back({insts.size(), caches.size() + (inst.imm.cache - f->call_caches.data())});
+                    copy.imm.i64 = 0;
+                }
+                insts.push_back(copy);
+            }
+            for (const CallCache& cache : f->call_caches) {
+                caches.push_back({cache.type_idx, 0, {}});  // the targets start out empty
+            }
+        }
+
+        Header h = {};
+        std::memcpy(h.magic, "WASMLOWR", 8);
+        h.version = VERSION;
+        h.metered = interp.metered;
+        h.module_hash = hash_bytes(wasm_bytes.data(), wasm_bytes.size());
+        h.module_size = wasm_bytes.size();
+        std::vector<uint8_t> out;
+        out.resize(sizeof(Header));
+        h.module_offset = append(out, module.data(), module.size());
+        h.module_bytes = module.size();
+        h.entries_offset = append(out, entries.data(), entries.size() * sizeof(uint64_t));
+        h.num_funcs = entries.size();
+        h.insts_offset = append(out, insts.data(), insts.size() * sizeof(Inst));
+        h.num_insts = insts.size();
+        h.caches_offset = append(out, caches.data(), caches.size() * sizeof(CallCache));
+        h.num_caches = caches.size();
+        h.relocs_offset = append(out, relocs.data(), relocs.size() * sizeof(Reloc));
+        h.num_relocs = relocs.size();
+        h.file_size = out.size();
+        std::memcpy(out.data(), &h, sizeof(Header));
+
+        // written next to the entry and renamed over it, so a reader never
+        // sees a partial file
+        std::string path = entry_path(h.module_hash, h.metered);
+        std::string tmp = path + ".tmp" + std::to_string(getpid());
+        int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw LFortranException("ModuleCache: cannot create " + tmp);
+        }
+        size_t done = 0;
+        while (done < out.size()) {
+            ssize_t n = write(fd, out.data() + done, out.size() - done);
+            if (n <= 0) {
+                close(fd);
+                unlink(tmp.c_str());
+                throw LFortranException("ModuleCache: cannot write " + tmp);
+            }
+            done += n;
+        }
+        close(fd);
+        if (rename(tmp.c_str(), path.c_str()) != 0) {
+            unlink(tmp.c_str());
+            throw LFortranException("ModuleCache: cannot write " + path);
+        }
+        evict();
+    }
+
+    // Removes the least recently used entries until the cache fits max_bytes
+    void evict() {
+        struct Entry {
+            std::string path;
+            uint64_t size;
+            struct timespec used;
+        };
+        std::vector<Entry> found;
+        uint64_t total = 0;
+        DIR* d = opendir(dir.c_str());
+        if (!d) {
+            return;
+        }
+        while (struct dirent* e = readdir(d)) {
+            std::string name = e->d_name;
+            if (name.size() < 7 || name.compare(name.size() - 7, 7, ".wcache") != 0) {
+                continue;
+            }
+            struct stat st;
+            std::string path = dir + "/" + name;
+            if (stat(path.c_str(), &st) == 0) {
+                found.push_back({path, (uint64_t)st.st_size, st.st_mtim});
+                total += st.st_size;
+            }
+        }
+        closedir(d);
+        std::sort(found.begin(), found.end(), [](const Entry& a, const Entry& b) {
+            return a.used.tv_sec != b.used.tv_sec ? a.used.tv_sec < b.used.tv_sec : a.used.tv_nsec < b.used.tv_nsec;
+        });
+        for (const Entry& e : found) {
+            if (total <= max_bytes) {
+                break;
+            }
+            unlink(e.path.c_str());
+            total -= e.size;
+        }
+    }
+
+   private:
+    struct MappedImage : CodeImage {
+        void* base;
+        size_t size;
+
+        MappedImage(void* base, size_t size) : base(base), size(size) {}
+
+        ~MappedImage() { munmap(base, size); }
+    };
+
+    // metered code differs from the plain one, so both get an entry
+    std::string entry_path(uint64_t hash, bool metered) const {
+        char name[40];
+        snprintf(name, sizeof(name), "%016llx%s.wcache", (unsigned long long)hash, metered ? "-fuel" : "");
+        return dir + "/" + name;
+    }
+
+    static uint64_t append(std::vector<uint8_t>& out, const void* data, size_t size) {
+        out.resize((out.size() + 15) / 16 * 16);  // keeps the instructions aligned
+        uint64_t offset = out.size();
+        out.insert(out.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+        return offset;
+    }
+
+    static bool in_file(uint64_t offset, uint64_t count, uint64_t size, uint64_t file_size) {
+        return offset <= file_size && count <= (file_size - offset) / size;
+    }
+
+    static bool valid(const Header& h, uint64_t file_size, uint64_t hash) {
+        if (std::memcmp(h.magic, "WASMLOWR", 8) != 0 || h.version != VERSION || h.file_size != file_size ||
+            h.module_hash != hash || h.module_size != wasm_bytes.size()) {
+            return false;
+        }
+        if (!in_file(h.module_offset, h.module_bytes, 1, file_size) ||
+            !in_file(h.entries_offset, h.num_funcs, sizeof(uint64_t), file_size) ||
+            !in_file(h.insts_offset, h.num_insts, sizeof(Inst), file_size) ||
+            !in_file(h.caches_offset, h.num_caches, sizeof(CallCache), file_size) ||
+            !in_file(h.relocs_offset, h.num_relocs, sizeof(Reloc), file_size)) {
+            return false;
+        }
+        const uint8_t* p = (const uint8_t*)&h;
+        const uint64_t* entries = (const uint64_t*)(p + h.entries_offset);
+        uint64_t next = 0;
+        for (uint64_t i = 0; i < h.num_funcs; i++) {
+            if (entries[i] != NOT_LOWERED) {
+                if (entries[i] < next || entries[i] >= h.num_insts) {
+                    return false;
+                }
+                next = entries[i] + 1;
+            }
+        }
+        const Reloc* relocs = (const Reloc*)(p + h.relocs_offset);
+        for (uint64_t i = 0; i < h.num_relocs; i++) {
+            if (relocs[i].inst >= h.num_insts || relocs[i].cache >= h.num_caches) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The decoded module, field by field so padding never reaches the file
+    static void write_module(ByteWriter& w) {
+        w.put<uint64_t>(func_types.size());
+        for (const FuncType& t : func_types) {
+            w.put_vector(t.param_types);
+            w.put_vector(t.result_types);
+        }
+        w.put_vector(type_indices);
+        w.put<uint64_t>(imports.size());
+        for (const Import& i : imports) {
+            w.put_string(i.module);
+            w.put_string(i.name);
+            w.put(i.kind);
+            w.put(i.type_index);
+        }
+        w.put<uint64_t>(exports.size());
+        for (const Export& e : exports) {
+            w.put_string(e.name);
+            w.put(e.kind);
+            w.put(e.index);
+        }
+        w.put<uint64_t>(codes.size());
+        for (const Code& c : codes) {
+            w.put(c.size);
+            w.put<uint64_t>(c.locals.size());
+            for (const Local& l : c.locals) {
+                w.put(l.count);
+                w.put(l.type);
+            }
+            w.put(c.insts_start_index);
+            w.put<uint8_t>(c.analyzed);
+            w.put(c.max_stack);
+            w.put(c.frame_size);
+            w.put_vector(c.callees);
+            w.put_vector(c.indirect_types);
+        }
+        w.put<uint64_t>(tables.size());
+        for (const Table& t : tables) {
+            w.put(t.type);
+            write_limits(w, t.limits);
+        }
+        w.put<uint64_t>(memories.size());
+        for (const Limits& l : memories) {
+            write_limits(w, l);
+        }
+        w.put<uint64_t>(globals.size());
+        for (const Global& g : globals) {
+            w.put(g.type);
+            w.put(g.mut);
+            w.put(g.insts_start_index);
+        }
+        w.put<uint64_t>(elements.size());
+        for (const Element& e : elements) {
+            w.put(e.kind);
+            w.put(e.table_index);
+            w.put(e.insts_start_index);
+            w.put_vector(e.func_indices);
+        }
+        w.put<uint64_t>(datas.size());
+        for (const Data& d : datas) {
+            w.put(d.kind);
+            w.put(d.insts_start_index);
+            w.put(d.bytes_start);
+            w.put(d.size);
+        }
+        w.put(start_function);
+    }
+
+    static void write_limits(ByteWriter& w, const Limits& l) {
+        w.put(l.min);
+        w.put(l.max);
+        w.put<uint8_t>(l.has_max);
+    }
+
+    static Limits read_limits(ByteReader& r) {
+        Limits l;
+        l.min = r.get<uint32_t>();
+        l.max = r.get<uint32_t>();
+        l.has_max = r.get<uint8_t>();
+        return l;
+    }
+
+    static void read_module(ByteReader& r) {
+        func_types.resize(r.get<uint64_t>());
+        for (FuncType& t : func_types) {
+            t.param_types = r.get_vector<uint8_t>();
+            t.result_types = r.get_vector<uint8_t>();
+        }
+        type_indices = r.get_vector<uint32_t>();
+        imports.resize(r.get<uint64_t>());
+        for (Import& i : imports) {
+            i.module = r.get_string();
+            i.name = r.get_string();
+            i.kind = r.get<uint8_t>();
+            i.type_index = r.get<uint32_t>();
+        }
+        exports.resize(r.get<uint64_t>());
+        for (Export& e : exports) {
+            e.name = r.get_string();
+            e.kind = r.get<uint8_t>();
+            e.index = r.get<uint32_t>();
+        }
+        codes.resize(r.get<uint64_t>());
+        for (Code& c : codes) {
+            c.size = r.get<int>();
+            c.locals.resize(r.get<uint64_t>());
+            for (Local& l : c.locals) {
+                l.count = r.get<uint32_t>();
+                l.type = r.get<uint8_t>();
+            }
+            c.insts_start_index = r.get<uint32_t>();
+            c.analyzed = r.get<uint8_t>();
+            c.max_stack = r.get<uint32_t>();
+            c.frame_size = r.get<uint32_t>();
+            c.callees = r.get_vector<uint32_t>();
+            c.indirect_types = r.get_vector<uint32_t>();
+        }
+        tables.resize(r.get<uint64_t>());
+        for (Table& t : tables) {
+            t.type = r.get<uint8_t>();
+            t.limits = read_limits(r);
+        }
+        memories.resize(r.get<uint64_t>());
+        for (Limits& l : memories) {
+            l = read_limits(r);
+        }
+        globals.resize(r.get<uint64_t>());
+        for (Global& g : globals) {
+            g.type = r.get<uint8_t>();
+            g.mut = r.get<uint8_t>();
+            g.insts_start_index = r.get<uint32_t>();
+        }
+        elements.resize(r.get<uint64_t>());
+        for (Element& e : elements) {
+            e.kind = r.get<uint32_t>();
+            e.table_index = r.get<uint32_t>();
+            e.insts_start_index = r.get<uint32_t>();
+            e.func_indices = r.get_vector<uint32_t>();
+        }
+        datas.resize(r.get<uint64_t>());
+        for (Data& d : datas) {
+            d.kind = r.get<uint32_t>();
+            d.insts_start_index = r.get<uint32_t>();
+            d.bytes_start = r.get<uint32_t>();
+            d.size = r.get<uint32_t>();
+        }
+        start_function = r.get<uint32_t>();
+    }
+};
+
+}  // namespace LFortran
+
+#endif  // LFORTRAN_WASM_MODULE_CACHE_H
@@ -0,0 +1,78 @@
+#ifndef LFORTRAN_WASM_NUMERIC_H
+#define LFORTRAN_WASM_NUMERIC_H
+
+#include <cmath>
+#include <limits>
+#include "wasm_utils.h"
+
+// Scalar helpers with WASM semantics, shared by the scalar instructions and
+// the lanes of the SIMD ones.
+
+template <typename I, typename F>
+I trunc_or_trap(F x) {
+    if (std::isnan(x)) {
+        throw LFortran::LFortranException("trap: invalid conversion to integer");
+    }
+    double t = std::trunc((double)x);
+    double hi = std::ldexp(1.0, std::numeric_limits<I>::digits);
+    double lo = std::numeric_limits<I>::is_signed ? -hi : 0.0;
+    if (!(t >= lo && t < hi)) {
+        throw LFortran::LFortranException("trap: integer overflow");
+    }
+    return (I)t;
+}
+
+template <typename I, typename F>
+I trunc_sat(F x) {
+    if (std::isnan(x)) {
+        return 0;
+    }
+    double t = std::trunc((double)x);
+    double hi = std::ldexp(1.0, std::numeric_limits<I>::digits);
+    double lo = std::numeric_limits<I>::is_signed ? -hi : 0.0;
+    if (t < lo) {
+        return std::numeric_limits<I>::min();
+    }
+    if (t >= hi) {
+        return std::numeric_limits<I>::max();
+    }
+    return (I)t;
+}
+
+template <typename F>
+F wasm_min(F a, F b) {
+    if (std::isnan(a) || std::isnan(b)) {
+        return std::numeric_limits<F>::quiet_NaN();
+    }
+    if (a == b) {
+        return std::signbit(a) ? a : b;
+    }
+    return a < b ? a : b;
+}
+
+template <typename F>
+F wasm_max(F a, F b) {
+    if (std::isnan(a) || std::isnan(b)) {
+        return std::numeric_limits<F>::quiet_NaN();
+    }
+    if (a == b) {
+        return std::signbit(a) ? b : a;
+    }
+    return a > b ? a : b;
+}
+
+template <typename T>
+T rotl(T x, T n) {
+    const T bits = sizeof(T) * 8;
+    n &= bits - 1;
+    return (x << n) | (x >> ((bits - n) & (bits - 1)));
+}
+
+template <typename T>
+T rotr(T x, T n) {
+    const T bits = sizeof(T) * 8;
+    n &= bits - 1;
+    return (x >> n) | (x << ((bits - n) & (bits - 1)));
+}
+
+#endif  // LFORTRAN_WASM_NUMERIC_H
@@ -0,0 +1,98 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "wasm_opcode_stats.h"
+#include "wasm_thread_pool.h"
+
+using namespace LFortran;
+
+// Modules are read into wasm_bytes one after another, up to this many bytes
+// at a time, and the bodies of all of them are counted in one parallel loop
+const size_t BATCH_BYTES = 256 << 20;
+
+// Counts the instructions of a batch of modules on every worker of the pool,
+// each into its own OpcodeStats
+void count_batch(WorkStealingPool& pool, std::vector<OpcodeStats>& per_worker, const std::vector<uint32_t>& bodies) {
+    pool.parallel_for(bodies.size(), [&](uint32_t i, unsigned worker) {
+        OpcodeStatsVisitor v(per_worker[worker]);
+        v.count(bodies[i]);
+    });
+}
+
+// Writes opcode, immediate size and instruction pair counts over a corpus of
+// modules as CSV
+int main(int argc, char** argv) {
+    unsigned num_threads = 0;
+    std::vector<std::string> files;
+    int argi = 1;
+    for (; argi < argc && std::string(argv[argi]).rfind("--", 0) == 0; argi++) {
+        std::string arg = argv[argi];
+        if (arg.rfind("--threads=", 0) == 0) {
+            num_threads = std::stoul(arg.substr(10));
+        } else if (arg.rfind("--list=", 0) == 0) {
+            std::ifstream list(arg.substr(7));
+            std::string line;
+            while (std::getline(list, line)) {
+                if (!line.empty()) {
+                    files.push_back(line);
+                }
+            }
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+    files.insert(files.end(), argv + argi, argv + argc);
+    if (files.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--threads=N] [--list=FILE] [in.wasm...] > stats.csv" << std::endl;
+        return 1;
+    }
+
+    WorkStealingPool pool(num_threads);
+    std::vector<OpcodeStats> per_worker(pool.num_threads);
+    std::vector<uint32_t> bodies;
+    uint64_t modules = 0, skipped = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t f = 0; f < files.size();) {
+        wasm_bytes.clear();
+        bodies.clear();
+        for (; f < files.size() && wasm_bytes.size() < BATCH_BYTES; f++) {
+            std::ifstream file(files[f], std::ios::binary | std::ios::ate);
+            size_t base = wasm_bytes.size();
+            size_t size = file ? (size_t)file.tellg() : 0;
+            if (!file || base + size > UINT32_MAX) {
+                std::cerr << files[f] << ": cannot read" << std::endl;
+                skipped++;
+                continue;
+            }
+            wasm_bytes.resize(base + size);
+            file.seekg(0);
+            file.read((char*)wasm_bytes.data() + base, size);
+            size_t num_bodies = bodies.size();
+            try {
+                find_function_bodies(base, size, bodies);
+                modules++;
+            } catch (const std::string& e) {
+                std::cerr << files[f] << ": " << e << std::endl;
+                bodies.resize(num_bodies);
+                wasm_bytes.resize(base);
+                skipped++;
+            }
+        }
+        count_batch(pool, per_worker, bodies);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    OpcodeStats total;
+    for (const OpcodeStats& s : per_worker) {
+        total.merge(s);
+    }
+    print_opcode_csv(total, std::cout);
+    std::cerr << modules << " modules (" << skipped << " skipped), " << total.functions << " functions ("
+              << total.errors << " failed), " << total.instructions << " instructions, "
+              << total.code_bytes / seconds / 1e6 << " MB/s of code" << std::endl;
+    return 0;
+}
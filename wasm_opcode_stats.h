@@ -0,0 +1,204 @@
+#ifndef LFORTRAN_WASM_OPCODE_STATS_H
+#define LFORTRAN_WASM_OPCODE_STATS_H
+
+#include <memory>
+#include <ostream>
+#include "wasm_threaded.h"
+#include "wasm_visitor.h"
+
+namespace LFortran {
+
+// How often each instruction occurs, with how many bytes of immediates and
+// which instruction follows it in the same body. Instructions are numbered
+// as in WASM_THREADED_OPS, the `end` closing a body is not counted. Aligned
+// so that the counters of different workers never share a cache line.
+struct alignas(64) OpcodeStats {
+    static constexpr uint32_t NUM_OPS = OP_FD_PREFIX + 0x100;
+    static constexpr uint32_t MAX_IMMEDIATE = 16;  // larger ones share a bucket
+
+    uint64_t functions = 0;
+    uint64_t instructions = 0;
+    uint64_t code_bytes = 0;
+    uint64_t errors = 0;  // bodies that failed to decode, counted up to the error
+    std::vector<uint64_t> counts;
+    std::vector<uint64_t> immediates;  // NUM_OPS rows of MAX_IMMEDIATE + 2 buckets
+    std::vector<std::unique_ptr<uint64_t[]>> bigrams;  // rows of NUM_OPS, made on first use
+
+    OpcodeStats() : counts(NUM_OPS), immediates(NUM_OPS * (MAX_IMMEDIATE + 2)), bigrams(NUM_OPS) {}
+
+    uint64_t* bigram_row(uint32_t op) {
+        if (!bigrams[op]) {
+            bigrams[op].reset(new uint64_t[NUM_OPS]());
+        }
+        return bigrams[op].get();
+    }
+
+    void merge(const OpcodeStats& other) {
+        functions += other.functions;
+        instructions += other.instructions;
+        code_bytes += other.code_bytes;
+        errors += other.errors;
+        for (uint32_t i = 0; i < counts.size(); i++) {
+            counts[i] += other.counts[i];
+        }
+        for (uint32_t i = 0; i < immediates.size(); i++) {
+            immediates[i] += other.immediates[i];
+        }
+        for (uint32_t op = 0; op < NUM_OPS; op++) {
+            if (other.bigrams[op]) {
+                uint64_t* row = bigram_row(op);
+                for (uint32_t next = 0; next < NUM_OPS; next++) {
+                    row[next] += other.bigrams[op][next];
+                }
+            }
+        }
+    }
+};
+
+// Counts the instructions of function bodies into one OpcodeStats. The
+// opcode comes from the visit of each instruction and its size from where
+// the next one begins.
+class OpcodeStatsVisitor : public WASM_INSTS_VISITOR::BaseWASMVisitor<OpcodeStatsVisitor> {
+   public:
+    OpcodeStats& stats;
+
+    OpcodeStatsVisitor(OpcodeStats& stats) : stats(stats) {}
+
+    // Counts the body whose instructions start at `offset`, up to the final
+    // `end`
+    void count(uint32_t offset) {
+        uint32_t start = offset;
+        current = NONE;
+        previous = NONE;
+        stats.functions++;
+        try {
+            uint32_t end = decode_instructions(offset);
+            finish(end - 1);
+            stats.code_bytes += end - start;
+        } catch (const std::string&) {
+            stats.errors++;
+        }
+    }
+
+    void begin_instruction(uint32_t offset) {
+        finish(offset);
+        current_start = offset;
+        current_opcode_size = 1;
+        if (wasm_bytes[offset] == 0xFC || wasm_bytes[offset] == 0xFD) {
+            while (wasm_bytes[offset + current_opcode_size] & 0x80) {
+                current_opcode_size++;
+            }
+            current_opcode_size++;
+        }
+    }
+
+#define X(name, op)                                 \
+    template <class... Args>                        \
+    void visit_##name(const Args&...) { current = op; }
+    WASM_THREADED_OPS(X)
+#undef X
+
+   private:
+    static constexpr uint32_t NONE = ~0U;
+
+    uint32_t current;  // the instruction decoded, waiting for its end
+    uint32_t current_start = 0;
+    uint32_t current_opcode_size = 0;
+    uint32_t previous;
+
+    void finish(uint32_t end) {
+        if (current == NONE) {
+            return;
+        }
+        uint32_t immediate = std::min(end - current_start - current_opcode_size, OpcodeStats::MAX_IMMEDIATE + 1);
+        stats.instructions++;
+        stats.counts[current]++;
+        stats.immediates[current * (OpcodeStats::MAX_IMMEDIATE + 2) + immediate]++;
+        if (previous != NONE) {
+            stats.bigram_row(previous)[current]++;
+        }
+        previous = current;
+        current = NONE;
+    }
+};
+
+// Appends where the instructions of every function body start, for the
+// module of `size` bytes at `base` in wasm_bytes. Only the section headers
+// and the code section are read, so modules can be laid out one after another.
+void find_function_bodies(uint32_t base, uint32_t size, std::vector<uint32_t>& bodies) {
+    if (size < 8 || std::memcmp(&wasm_bytes[base], "\0asm", 4) != 0) {
+        throw LFortran::LFortranException("Not a wasm module");
+    }
+    uint32_t offset = base + 8;
+    while (offset < base + size) {
+        uint32_t id = read_unsigned_num(offset);
+        uint32_t section_size = read_unsigned_num(offset);
+        if (offset > base + size || section_size > base + size - offset) {
+            throw LFortran::LFortranException("Section out of bounds");
+        }
+        if (id == 10U) {
+            uint32_t body = offset;
+            uint32_t n = read_unsigned_num(body);
+            for (uint32_t i = 0; i < n; i++) {
+                uint32_t body_size = read_unsigned_num(body);
+                uint32_t next = body + body_size;
+                if (body_size > offset + section_size - body) {
+                    throw LFortran::LFortranException("Function body out of bounds");
+                }
+                uint32_t runs = read_unsigned_num(body);
+                for (uint32_t k = 0; k < runs; k++) {
+                    read_unsigned_num(body);
+                    read_byte(body);
+                }
+                bodies.push_back(body);
+                body = next;
+            }
+        }
+        offset += section_size;
+    }
+}
+
+// The names of the instructions by their number in WASM_THREADED_OPS
+std::vector<std::string> opcode_names() {
+    std::vector<std::string> names(OpcodeStats::NUM_OPS);
+#define X(name, op) names[op] = #name;
+    WASM_THREADED_OPS(X)
+#undef X
+    return names;
+}
+
+// The counts as CSV rows of kind,instruction,next,immediate_bytes,count:
+// `opcode` rows count an instruction, `immediate` rows the times it had so
+// many bytes of immediates (the last bucket holds all larger ones) and
+// `bigram` rows the times `next` directly followed it
+void print_opcode_csv(const OpcodeStats& stats, std::ostream& out) {
+    std::vector<std::string> names = opcode_names();
+    out << "kind,instruction,next,immediate_bytes,count\n";
+    for (uint32_t op = 0; op < OpcodeStats::NUM_OPS; op++) {
+        if (stats.counts[op] > 0) {
+            out << "opcode," << names[op] << ",,," << stats.counts[op] << "\n";
+        }
+    }
+    for (uint32_t op = 0; op < OpcodeStats::NUM_OPS; op++) {
+        for (uint32_t size = 0; size <= OpcodeStats::MAX_IMMEDIATE + 1; size++) {
+            uint64_t n = stats.immediates[op * (OpcodeStats::MAX_IMMEDIATE + 2) + size];
+            if (n > 0) {
+                out << "immediate," << names[op] << ",," << size << "," << n << "\n";
+            }
+        }
+    }
+    for (uint32_t op = 0; op < OpcodeStats::NUM_OPS; op++) {
+        if (!stats.bigrams[op]) {
+            continue;
+        }
+        for (uint32_t next = 0; next < OpcodeStats::NUM_OPS; next++) {
+            if (stats.bigrams[op][next] > 0) {
+                out << "bigram," << names[op] << "," << names[next] << ",," << stats.bigrams[op][next] << "\n";
+            }
+        }
+    }
+}
+
+}  // namespace LFortran
+
+#endif  // LFORTRAN_WASM_OPCODE_STATS_H
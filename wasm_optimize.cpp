@@ -0,0 +1,101 @@
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include "wasm_coalesce.h"
+#include "wasm_dce.h"
+#include "wasm_decoder.h"
+#include "wasm_inliner.h"
+#include "wasm_optimizer.h"
+#include "wasm_ssa.h"
+
+using namespace LFortran;
+
+// Decodes a module produced by the previous pass
+void redecode(std::vector<uint8_t> bytes) {
+    wasm_bytes = std::move(bytes);
+    clear_module();
+    decode_wasm();
+}
+
+// Rewrites the function bodies of a module with the peephole optimizer,
+// after inlining small functions, removing unreachable ones, going through
+// SSA form and merging locals if asked to, and reports what changed.
+int main(int argc, char** argv) {
+    int inline_size = -1;
+    bool dce = false;
+    bool coalesce = false;
+    bool ssa = false;
+    int argi = 1;
+    for (; argi < argc && std::string(argv[argi]).rfind("--", 0) == 0; argi++) {
+        std::string arg = argv[argi];
+        if (arg.rfind("--inline=", 0) == 0) {
+            inline_size = std::stoi(arg.substr(9));
+        } else if (arg == "--dce") {
+            dce = true;
+        } else if (arg == "--coalesce") {
+            coalesce = true;
+        } else if (arg == "--ssa") {
+            ssa = true;
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (argc - argi != 2) {
+        std::cerr << "Usage: " << argv[0] << " [--inline=BYTES] [--dce] [--ssa] [--coalesce] in.wasm out.wasm" << std::endl;
+        return 1;
+    }
+    size_t module_before = 0;
+    InlinerStats inliner;
+    DeadCodeStats dead;
+    SsaStats lifted;
+    CoalesceStats locals;
+    OptimizerStats stats;
+    WASMAssembler wasm;
+    try {
+        load_file(argv[argi]);
+        decode_wasm();
+        module_before = wasm_bytes.size();
+        if (inline_size >= 0) {
+            redecode(inline_wasm(inliner, inline_size));
+        }
+        if (dce) {
+            redecode(eliminate_dead_code(dead));
+        }
+        if (ssa) {
+            redecode(ssa_round_trip(lifted));
+        }
+        if (coalesce) {
+            redecode(coalesce_locals(locals));
+        }
+        wasm.code = optimize_wasm(stats);
+    } catch (const std::string& e) {
+        std::cerr << e << std::endl;
+        return 1;
+    }
+    wasm.save_bin(argv[argi + 1]);
+
+    if (inline_size >= 0) {
+        std::cout << "inlined: " << inliner.call_sites << " calls to " << inliner.callees << " functions" << std::endl;
+    }
+    if (dce) {
+        std::cout << "functions: " << dead.functions_before << " -> " << dead.functions_after << ", types: "
+                  << dead.types_before << " -> " << dead.types_after << std::endl;
+    }
+    if (ssa) {
+        std::cout << "ssa: " << lifted.blocks << " blocks, " << lifted.values << " values, " << lifted.phis
+                  << " phis, lifted at " << lifted.code_bytes / lifted.lift_seconds / 1e6 << " MB/s" << std::endl;
+    }
+    if (coalesce) {
+        std::cout << "locals: " << locals.locals_before << " -> " << locals.locals_after << " in "
+                  << locals.runs_before << " -> " << locals.runs_after << " declarations" << std::endl;
+    }
+    std::cout << "instructions: " << stats.instructions_before << " -> " << stats.instructions_after << " ("
+              << stats.instructions_before - stats.instructions_after << " removed)" << std::endl;
+    std::cout << "  folded: " << stats.folded << std::endl;
+    std::cout << "  local.tee: " << stats.tees << std::endl;
+    std::cout << "  dropped: " << stats.drops << std::endl;
+    std::cout << "module: " << module_before << " -> " << wasm.code.size() << " bytes" << std::endl;
+    return 0;
+}
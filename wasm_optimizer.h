@@ -0,0 +1,509 @@
+#ifndef LFORTRAN_WASM_OPTIMIZER_H
+#define LFORTRAN_WASM_OPTIMIZER_H
+
+#include <limits>
+#include <map>
+#include <set>
+#include <type_traits>
+#include "wasm_assembler.h"
+#include "wasm_decoder.h"
+#include "wasm_numeric.h"
+#include "wasm_threaded.h"
+#include "wasm_visitor.h"
+
+namespace LFortran {
+
+struct OptimizerStats {
+    uint64_t instructions_before = 0;
+    uint64_t instructions_after = 0;
+    uint64_t folded = 0;  // removed by constant folding and identities such as `x + 0`
+    uint64_t tees = 0;    // `local.set x; local.get x` pairs turned into `local.tee x`
+    uint64_t drops = 0;   // removed along with a `drop`
+    size_t bytes_before = 0;
+    size_t bytes_after = 0;
+};
+
+// Rewrites a function body while it is decoded. Every instruction is
+// appended to `out` and the patterns are matched against the end of `out`,
+// so a rewrite can enable the next one: `i32.const 1; i32.const 2; i32.add;
+// drop` goes away entirely. Branches only target the ends of blocks and
+// loops, never the middle of a straight run of instructions, so no pattern
+// needs to know about control flow.
+//
+// Only integer instructions are folded, floats keep the engine's NaN bits.
+class PeepholeVisitor : public WASM_INSTS_VISITOR::BaseWASMVisitor<PeepholeVisitor> {
+   public:
+    struct Instr {
+        uint8_t op;       // the first byte
+        bool owned;       // rewritten, its bytes are in `emitted` instead of wasm_bytes
+        uint32_t start;
+        uint32_t size;
+        int64_t value;    // of a const, or the index of a local
+        // the number of instructions at the end of `out` that compute the
+        // value this one leaves, without side effects or traps; 0 if they
+        // do not
+        uint32_t pure;
+    };
+
+    std::vector<Instr> out;
+    WASMAssembler emitted;
+    OptimizerStats& stats;
+
+    PeepholeVisitor(OptimizerStats& stats) : stats(stats), decoding(false) {}
+
+    // Rewrites the body of codes[index], returns its instructions without
+    // the final `end`
+    void optimize(uint32_t index) {
+        out.clear();
+        emitted.code.clear();
+        decoding = false;
+        uint32_t end = decode_instructions(codes[index].insts_start_index);
+        flush(end - 1);
+    }
+
+    // The bytes of the instructions in `out`
+    void write(WASMAssembler& wasm) const {
+        for (const Instr& i : out) {
+            wasm.emit_bytes((i.owned ? emitted.code.data() : wasm_bytes.data()) + i.start, i.size);
+        }
+    }
+
+    void begin_instruction(uint32_t offset) {
+        flush(offset);
+        decoding = true;
+        current = {wasm_bytes[offset], false, offset, 0, 0, 0};
+    }
+
+    // Only the immediates of these are needed, the rest are copied as they are
+#define X(name, op)                      \
+    template <class... Args>             \
+    void visit_##name(const Args&...) {}
+    WASM_THREADED_OPS(X)
+#undef X
+
+    void visit_I32Const(int32_t value) { current.value = value; }
+
+    void visit_I64Const(int64_t value) { current.value = value; }
+
+    void visit_LocalGet(uint32_t localidx) { current.value = localidx; }
+
+    void visit_LocalSet(uint32_t localidx) { current.value = localidx; }
+
+    void visit_LocalTee(uint32_t localidx) { current.value = localidx; }
+
+   private:
+    bool decoding;
+    Instr current;  // decoded, waiting for its end
+
+    void flush(uint32_t end) {
+        if (decoding) {
+            current.size = end - current.start;
+            stats.instructions_before++;
+            push(current);
+            decoding = false;
+        }
+    }
+
+    bool is_const(size_t back, uint8_t op) const { return out.size() > back && out[out.size() - 1 - back].op == op; }
+
+    Instr make(uint8_t op, int64_t value, uint32_t pure) {
+        uint32_t start = emitted.code.size();
+        switch (op) {
+            case 0x41: emitted.emit_i32_const((int32_t)value); break;
+            case 0x42: emitted.emit_i64_const(value); break;
+            case 0x21: emitted.emit_set_local((uint32_t)value); break;
+            case 0x22: emitted.emit_tee_local((uint32_t)value); break;
+            default: assert(false);
+        }
+        return {op, true, start, (uint32_t)(emitted.code.size() - start), value, pure};
+    }
+
+    // Replaces the last `n` instructions of `out` and the one being pushed
+    // with a constant
+    void replace_with_const(size_t n, uint8_t op, int64_t value) {
+        out.resize(out.size() - n);
+        out.push_back(make(op, value, 1));
+        stats.folded += n;
+    }
+
+    // Marks `in` pure if its `operands` are the pure expressions at the end
+    // of `out`
+    void push_pure(Instr in, uint32_t operands) {
+        uint32_t n = 0;
+        for (uint32_t k = 0; k < operands; k++) {
+            if (out.size() <= n || out[out.size() - 1 - n].pure == 0) {
+                out.push_back(in);
+                return;
+            }
+            n += out[out.size() - 1 - n].pure;
+        }
+        in.pure = n + 1;
+        out.push_back(in);
+    }
+
+    void push(Instr in) {
+        uint8_t op = in.op;
+        switch (op) {
+            case 0x41:    // i32.const
+            case 0x42:    // i64.const
+            case 0x23:    // global.get
+            case 0xD0:    // ref.null
+            case 0xD2: {  // ref.func
+                in.pure = 1;
+                out.push_back(in);
+                return;
+            }
+            case 0x20: {  // local.get
+                if (!out.empty() && out.back().op == 0x21 && out.back().value == in.value) {
+                    out.back() = make(0x22, in.value, 0);
+                    stats.tees++;
+                    return;
+                }
+                in.pure = 1;
+                out.push_back(in);
+                return;
+            }
+            case 0x1A: {  // drop
+                if (!out.empty() && out.back().pure > 0) {
+                    stats.drops += out.back().pure + 1;
+                    out.resize(out.size() - out.back().pure);
+                    return;
+                }
+                if (!out.empty() && out.back().op == 0x22) {
+                    out.back() = make(0x21, out.back().value, 0);
+                    stats.drops++;
+                    return;
+                }
+                break;
+            }
+        }
+
+        if (op >= 0x6A && op <= 0x78) {
+            binary<int32_t>(in, op - 0x6A, 0x41);
+        } else if (op >= 0x7C && op <= 0x8A) {
+            binary<int64_t>(in, op - 0x7C, 0x42);
+        } else if (op >= 0x46 && op <= 0x4F) {
+            compare<int32_t>(in, op - 0x46, 0x41);
+        } else if (op >= 0x51 && op <= 0x5A) {
+            compare<int64_t>(in, op - 0x51, 0x42);
+        } else if (op == 0x45 || (op >= 0x67 && op <= 0x69) || op == 0xC0 || op == 0xC1) {
+            unary<int32_t>(in, 0x41, 0x41);
+        } else if (op == 0x50) {
+            unary<int64_t>(in, 0x42, 0x41);
+        } else if ((op >= 0x79 && op <= 0x7B) || (op >= 0xC2 && op <= 0xC4)) {
+            unary<int64_t>(in, 0x42, 0x42);
+        } else if (op == 0xA7) {  // i32.wrap_i64
+            unary<int64_t>(in, 0x42, 0x41);
+        } else if (op == 0xAC || op == 0xAD) {  // i64.extend_i32_s, i64.extend_i32_u
+            unary<int32_t>(in, 0x41, 0x42);
+        } else {
+            out.push_back(in);
+        }
+    }
+
+    // add, sub, mul, div_s, div_u, rem_s, rem_u, and, or, xor, shl, shr_s,
+    // shr_u, rotl, rotr in the opcode order, numbered by `k`
+    template <class T>
+    void binary(Instr in, uint32_t k, uint8_t const_op) {
+        if (is_const(0, const_op) && is_const(1, const_op)) {
+            int64_t r;
+            if (fold_binary<T>(k, out[out.size() - 2].value, out.back().value, r)) {
+                replace_with_const(2, const_op, r);
+                return;
+            }
+        }
+        if (is_const(0, const_op)) {
+            T b = (T)out.back().value;
+            bool add_like = k == 0 || k == 1 || (k >= 8 && k <= 14);  // x op 0 == x
+            bool mul_like = k == 2 || k == 3 || k == 4;                // x op 1 == x
+            if ((add_like && b == 0) || (mul_like && b == 1)) {
+                out.pop_back();
+                stats.folded += 2;
+                return;
+            }
+        }
+        if (k >= 3 && k <= 6) {  // may trap
+            out.push_back(in);
+            return;
+        }
+        push_pure(in, 2);
+    }
+
+    template <class T>
+    void compare(Instr in, uint32_t k, uint8_t const_op) {
+        if (is_const(0, const_op) && is_const(1, const_op)) {
+            using U = std::make_unsigned_t<T>;
+            T a = (T)out[out.size() - 2].value;
+            T b = (T)out.back().value;
+            bool r = false;
+            switch (k) {
+                case 0: r = a == b; break;
+                case 1: r = a != b; break;
+                case 2: r = a < b; break;
+                case 3: r = (U)a < (U)b; break;
+                case 4: r = a > b; break;
+                case 5: r = (U)a > (U)b; break;
+                case 6: r = a <= b; break;
+                case 7: r = (U)a <= (U)b; break;
+                case 8: r = a >= b; break;
+                case 9: r = (U)a >= (U)b; break;
+            }
+            replace_with_const(2, 0x41, r);
+            return;
+        }
+        push_pure(in, 2);
+    }
+
+    // eqz, clz, ctz, popcnt, the sign extensions, wrap and extend, whose
+    // operand is a T made by `const_op` and whose result is made by `result_op`
+    template <class T>
+    void unary(Instr in, uint8_t const_op, uint8_t result_op) {
+        if (is_const(0, const_op)) {
+            using U = std::make_unsigned_t<T>;
+            const int bits = sizeof(T) * 8;
+            T a = (T)out.back().value;
+            int64_t r;
+            switch (in.op) {
+                case 0x45:
+                case 0x50: r = a == 0; break;
+                case 0x67:
+                case 0x79: r = a == 0 ? bits : __builtin_clzll((uint64_t)(U)a) - (64 - bits); break;
+                case 0x68:
+                case 0x7A: r = a == 0 ? bits : __builtin_ctzll((uint64_t)(U)a); break;
+                case 0x69:
+                case 0x7B: r = __builtin_popcountll((uint64_t)(U)a); break;
+                case 0xC0:
+                case 0xC2: r = (int8_t)a; break;
+                case 0xC1:
+                case 0xC3: r = (int16_t)a; break;
+                case 0xC4: r = (int32_t)a; break;
+                case 0xA7: r = (int32_t)a; break;
+                case 0xAC: r = (int64_t)a; break;
+                case 0xAD: r = (int64_t)(U)a; break;
+                default: assert(false); return;
+            }
+            replace_with_const(1, result_op, result_op == 0x41 ? (int32_t)r : r);
+            return;
+        }
+        push_pure(in, 1);
+    }
+
+    // The value of binary instruction `k` on constants as a sign extended T,
+    // false if it traps
+    template <class T>
+    static bool fold_binary(uint32_t k, int64_t x, int64_t y, int64_t& r) {
+        using U = std::make_unsigned_t<T>;
+        const U bits = sizeof(T) * 8;
+        T a = (T)x, b = (T)y;
+        U ua = (U)a, ub = (U)b;
+        U u;
+        switch (k) {
+            case 0: u = ua + ub; break;
+            case 1: u = ua - ub; break;
+            case 2: u = ua * ub; break;
+            case 3:
+                if (b == 0 || (a == std::numeric_limits<T>::min() && b == -1)) return false;
+                u = (U)(a / b);
+                break;
+            case 4:
+                if (b == 0) return false;
+                u = ua / ub;
+                break;
+            case 5:
+                if (b == 0) return false;
+                u = b == -1 ? 0 : (U)(a % b);
+                break;
+            case 6:
+                if (b == 0) return false;
+                u = ua % ub;
+                break;
+            case 7: u = ua & ub; break;
+            case 8: u = ua | ub; break;
+            case 9: u = ua ^ ub; break;
+            case 10: u = ua << (ub & (bits - 1)); break;
+            case 11: u = (U)(a >> (ub & (bits - 1))); break;
+            case 12: u = ua >> (ub & (bits - 1)); break;
+            case 13: u = rotl<U>(ua, ub); break;
+            case 14: u = rotr<U>(ua, ub); break;
+            default: return false;
+        }
+        r = (T)u;
+        return true;
+    }
+};
+
+// The instructions of a function body, with what the passes that renumber
+// or move them need: the index they refer to and how many blocks are open.
+class BodySplitter : public WASM_INSTS_VISITOR::BaseWASMVisitor<BodySplitter> {
+   public:
+    struct Instr {
+        uint8_t op;      // the first byte
+        uint32_t start;  // in wasm_bytes
+        uint32_t size;
+        // of the local, the function of a call or ref.func, the type of a
+        // call_indirect or block type, NO_INDEX for other instructions
+        uint32_t index;
+        uint32_t depth;  // blocks, loops and ifs around it in the body
+    };
+
+    static const uint32_t NO_INDEX = ~0U;
+
+    std::vector<Instr> insts;  // without the final `end`
+    uint32_t size = 0;         // in bytes
+
+    void split(uint32_t code_index) {
+        insts.clear();
+        size = 0;
+        depth = 0;
+        decoding = false;
+        uint32_t end = decode_instructions(codes[code_index].insts_start_index);
+        flush(end - 1);
+    }
+
+    void begin_instruction(uint32_t offset) {
+        flush(offset);
+        decoding = true;
+        current = {wasm_bytes[offset], offset, 0, NO_INDEX, depth};
+        if (current.op >= 0x02 && current.op <= 0x04) {
+            depth++;
+        } else if (current.op == 0x0B) {
+            depth--;
+        }
+    }
+
+#define X(name, op)                      \
+    template <class... Args>             \
+    void visit_##name(const Args&...) {}
+    WASM_THREADED_OPS(X)
+#undef X
+
+    void visit_LocalGet(uint32_t localidx) { current.index = localidx; }
+
+    void visit_LocalSet(uint32_t localidx) { current.index = localidx; }
+
+    void visit_LocalTee(uint32_t localidx) { current.index = localidx; }
+
+    void visit_Call(uint32_t funcidx) { current.index = funcidx; }
+
+    void visit_RefFunc(uint32_t funcidx) { current.index = funcidx; }
+
+    void visit_CallIndirect(uint32_t typeidx, uint32_t /*tableidx*/) { current.index = typeidx; }
+
+    void visit_Block(int64_t blocktype) { block_type(blocktype); }
+
+    void visit_Loop(int64_t blocktype) { block_type(blocktype); }
+
+    void visit_If(int64_t blocktype) { block_type(blocktype); }
+
+   private:
+    uint32_t depth = 0;
+    bool decoding = false;
+    Instr current;
+
+    void block_type(int64_t blocktype) {
+        if (blocktype >= 0) {
+            current.index = blocktype;
+        }
+    }
+
+    void flush(uint32_t end) {
+        if (decoding) {
+            current.size = end - current.start;
+            size += current.size;
+            insts.push_back(current);
+            decoding = false;
+        }
+    }
+};
+
+// Finds the first section with `id`, sets `offset` to its contents
+bool find_section(uint32_t id, uint32_t& offset, uint32_t& size) {
+    uint32_t index = 8U;
+    while (index < wasm_bytes.size()) {
+        uint32_t section_id = read_unsigned_num(index);
+        size = read_unsigned_num(index);
+        if (section_id == id) {
+            offset = index;
+            return true;
+        }
+        index += size;
+    }
+    return false;
+}
+
+// The size of the contents of the first section with `id`, 0 if there is none
+uint32_t section_size(uint32_t id) {
+    uint32_t offset, size;
+    return find_section(id, offset, size) ? size : 0;
+}
+
+// Appends a function body to the contents of a code section, `insts`
+// without the final `end`
+void emit_function_body(WASMAssembler& section, const std::vector<Local>& locals, const std::vector<uint8_t>& insts) {
+    WASMAssembler body;
+    body.emit_u32(locals.size());
+    for (const Local& local : locals) {
+        body.emit_u32(local.count);
+        body.emit_b8(local.type);
+    }
+    body.emit_bytes(insts.data(), insts.size());
+    body.emit_end();
+    section.emit_u32(body.code.size());
+    section.emit_bytes(body.code.data(), body.code.size());
+}
+
+// The decoded module with the contents of the sections in `contents`
+// replaced, by id. The other sections are copied as they are, except the
+// custom sections named in `dropped`, so custom sections that point into
+// the code, such as DWARF, go stale.
+std::vector<uint8_t> replace_sections(const std::map<uint32_t, std::vector<uint8_t>>& contents,
+                                      const std::set<std::string>& dropped = {}) {
+    WASMAssembler wasm;
+    wasm.emit_bytes(wasm_bytes.data(), 8);  // magic number and version
+    uint32_t index = 8U;
+    while (index < wasm_bytes.size()) {
+        uint32_t section_start = index;
+        uint32_t section_id = read_unsigned_num(index);
+        uint32_t size = read_unsigned_num(index);
+        auto it = contents.find(section_id);
+        if (it != contents.end()) {
+            wasm.emit_u32(section_id);
+            wasm.emit_u32(it->second.size());
+            wasm.emit_bytes(it->second.data(), it->second.size());
+        } else {
+            uint32_t name_offset = index;
+            if (section_id != 0U || !dropped.count(decode_name(name_offset))) {
+                wasm.emit_bytes(wasm_bytes.data() + section_start, index + size - section_start);
+            }
+        }
+        index += size;
+    }
+    return wasm.code;
+}
+
+// The index of wasm_code_index.h, if any, is dropped with the code it points into
+std::vector<uint8_t> replace_code_section(const std::vector<uint8_t>& contents) {
+    return replace_sections({{10U, contents}}, {"code.index"});
+}
+
+// Runs the peephole rewrites over every function body of the decoded module
+// and returns the rewritten module
+std::vector<uint8_t> optimize_wasm(OptimizerStats& stats) {
+    PeepholeVisitor v(stats);
+    WASMAssembler section;
+    section.emit_u32(codes.size());
+    for (uint32_t i = 0; i < codes.size(); i++) {
+        v.optimize(i);
+        stats.instructions_after += v.out.size();
+        WASMAssembler insts;
+        v.write(insts);
+        emit_function_body(section, codes[i].locals, insts.code);
+    }
+    stats.bytes_before += section_size(10);
+    stats.bytes_after += section.code.size();
+    return replace_code_section(section.code);
+}
+
+}  // namespace LFortran
+
+#endif  // LFORTRAN_WASM_OPTIMIZER_H
@@ -0,0 +1,160 @@
+#ifndef LFORTRAN_WASM_PERF_MAP_H
+#define LFORTRAN_WASM_PERF_MAP_H
+
+#include <cstdio>
+#include <ctime>
+#include <elf.h>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Tells `perf` which function occupies a range of generated code, through
+// the two interfaces it reads:
+//
+// - /tmp/perf-<pid>.map, one "start size name" line per range, picked up by
+//   `perf report` directly;
+// - /tmp/jit-<pid>.dump in the jitdump format, which also carries the code
+//   bytes and a timestamp per load. `perf record -k 1` sees the marker
+//   mapping of the file and `perf inject --jit` turns the records into ELF
+//   images.
+//
+// Ranges are only written when code is generated, never while it runs.
+class PerfMap {
+   public:
+    PerfMap(bool map_file, bool jitdump) : map(nullptr), dump(nullptr), marker(MAP_FAILED), code_index(0) {
+        if (map_file) {
+            std::string path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+            map = fopen(path.c_str(), "w");
+            if (!map) {
+                throw LFortran::LFortranException("PerfMap: cannot create " + path);
+            }
+        }
+        if (jitdump) {
+            open_jitdump();
+        }
+    }
+
+    PerfMap(const PerfMap&) = delete;
+    PerfMap& operator=(const PerfMap&) = delete;
+
+    ~PerfMap() {
+        if (map) {
+            fclose(map);
+        }
+        if (dump) {
+            RecordHeader close_record = {JIT_CODE_CLOSE, sizeof(RecordHeader), timestamp()};
+            fwrite(&close_record, sizeof(close_record), 1, dump);
+            fclose(dump);
+        }
+        if (marker != MAP_FAILED) {
+            munmap(marker, page_size());
+        }
+    }
+
+    // Records that `code` to `code + size` holds the function `name`. Safe to
+    // call from several threads.
+    void add(const void* code, size_t size, const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (map) {
+            fprintf(map, "%llx %zx %s\n", (unsigned long long)(uintptr_t)code, size, name.c_str());
+            fflush(map);
+        }
+        if (dump) {
+            CodeLoad record;
+            record.header.id = JIT_CODE_LOAD;
+            record.header.total_size = sizeof(CodeLoad) + name.size() + 1 + size;
+            record.header.timestamp = timestamp();
+            record.pid = getpid();
+            record.tid = syscall(SYS_gettid);
+            record.vma = (uintptr_t)code;
+            record.code_addr = (uintptr_t)code;
+            record.code_size = size;
+            record.code_index = code_index++;
+            fwrite(&record, sizeof(record), 1, dump);
+            fwrite(name.c_str(), name.size() + 1, 1, dump);
+            fwrite(code, size, 1, dump);
+            fflush(dump);
+        }
+    }
+
+   private:
+    static const uint32_t JITDUMP_MAGIC = 0x4A695444;  // "JiTD"
+    static const uint32_t JITDUMP_VERSION = 1;
+    static const uint32_t JIT_CODE_LOAD = 0;
+    static const uint32_t JIT_CODE_CLOSE = 3;
+
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t total_size;
+        uint32_t elf_mach;
+        uint32_t pad1;
+        uint32_t pid;
+        uint64_t timestamp;
+        uint64_t flags;
+    };
+
+    struct RecordHeader {
+        uint32_t id;
+        uint32_t total_size;
+        uint64_t timestamp;
+    };
+
+    // followed by the name, zero terminated, and the code bytes
+    struct CodeLoad {
+        RecordHeader header;
+        uint32_t pid;
+        uint32_t tid;
+        uint64_t vma;
+        uint64_t code_addr;
+        uint64_t code_size;
+        uint64_t code_index;
+    };
+
+    FILE* map;
+    FILE* dump;
+    void* marker;
+    uint64_t code_index;
+    std::mutex mutex;
+
+    // perf orders the records against its samples by CLOCK_MONOTONIC
+    static uint64_t timestamp() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    static size_t page_size() { return sysconf(_SC_PAGESIZE); }
+
+    void open_jitdump() {
+        std::string path = "/tmp/jit-" + std::to_string(getpid()) + ".dump";
+        int fd = open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, 0666);
+        if (fd < 0) {
+            throw LFortran::LFortranException("PerfMap: cannot create " + path);
+        }
+        // perf finds the dump by this executable mapping of it
+        marker = mmap(nullptr, page_size(), PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+        dump = fdopen(fd, "wb");
+        if (marker == MAP_FAILED || !dump) {
+            throw LFortran::LFortranException("PerfMap: cannot map " + path);
+        }
+        FileHeader header = {};
+        header.magic = JITDUMP_MAGIC;
+        header.version = JITDUMP_VERSION;
+        header.total_size = sizeof(FileHeader);
+#if defined(__x86_64__)
+        header.elf_mach = EM_X86_64;
+#elif defined(__aarch64__)
+        header.elf_mach = EM_AARCH64;
+#endif
+        header.pid = getpid();
+        header.timestamp = timestamp();
+        fwrite(&header, sizeof(header), 1, dump);
+        fflush(dump);
+    }
+};
+
+#endif  // LFORTRAN_WASM_PERF_MAP_H
@@ -0,0 +1,270 @@
+#ifndef LFORTRAN_WASM_PROFILER_H
+#define LFORTRAN_WASM_PROFILER_H
+
+#include <csignal>
+#include <cstdio>
+#include <ostream>
+#include <sys/time.h>
+#include <ucontext.h>
+#include "wasm_interpreter.h"
+#include "wasm_to_wat.h"
+
+namespace LFortran {
+
+// Samples what an Interpreter runs on a SIGPROF timer: the call stack of
+// WASM functions and the byte offset in the innermost one. The interpreter
+// does nothing for it while running; the handler finds the instruction
+// pointer of the interpreter among the interrupted registers, as the one
+// that points at an instruction of the innermost function. A sample where
+// it is spilled, such as inside a host function, has no offset.
+//
+// The handler only copies into a buffer allocated up front; the offsets and
+// names are worked out when the results are read. ITIMER_PROF counts the CPU
+// time of the whole process, so the interpreter should be the only busy
+// thread while sampling.
+class SamplingProfiler {
+   public:
+    static const uint32_t MAX_DEPTH = 128;  // innermost frames kept per sample
+    static const uint32_t NO_OFFSET = ~0U;
+
+    struct FunctionProfile {
+        uint64_t samples = 0;                  // with the function innermost
+        std::map<uint32_t, uint64_t> offsets;  // module byte offset -> samples
+    };
+
+    // `buffer_size` is in 32 bit words, a sample takes two plus its depth
+    SamplingProfiler(Interpreter& interp, uint32_t hz = 1000, size_t buffer_size = 1U << 22)
+        : interp(interp), hz(hz), buffer(buffer_size), used(0), lost(0) {}
+
+    SamplingProfiler(const SamplingProfiler&) = delete;
+    SamplingProfiler& operator=(const SamplingProfiler&) = delete;
+
+    ~SamplingProfiler() {
+        if (active == this) {
+            stop();
+        }
+    }
+
+    void start() {
+        if (active) {
+            throw LFortranException("SamplingProfiler: another profiler is running");
+        }
+        // calls never go deeper, so the frames do not move under the handler
+        interp.frames.reserve(interp.max_call_depth);
+        active = this;
+        struct sigaction action = {};
+        action.sa_sigaction = on_sigprof;
+        action.sa_flags = SA_SIGINFO | SA_RESTART;  // samples do not interrupt the host's system calls
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGPROF, &action, &old_action);
+        struct itimerval timer = {};
+        long interval = std::max(1000000L / (long)std::max(hz, 1U), 1L);
+        timer.it_interval.tv_sec = interval / 1000000;
+        timer.it_interval.tv_usec = interval % 1000000;
+        timer.it_value = timer.it_interval;
+        setitimer(ITIMER_PROF, &timer, nullptr);
+    }
+
+    void stop() {
+        struct itimerval timer = {};
+        setitimer(ITIMER_PROF, &timer, nullptr);
+        sigaction(SIGPROF, &old_action, nullptr);
+        active = nullptr;
+    }
+
+    // Samples taken, including those outside WASM code and the lost ones
+    uint64_t total_samples() const { return num_samples() + lost; }
+
+    // Samples dropped because the buffer was full
+    uint64_t lost_samples() const { return lost; }
+
+    // The samples of every function that was innermost at least once
+    std::map<uint32_t, FunctionProfile> functions() const {
+        std::map<uint32_t, FunctionProfile> result;
+        for_each_sample([&](const uint32_t* stack, uint32_t depth, uint32_t index) {
+            FunctionProfile& f = result[stack[depth - 1]];
+            f.samples++;
+            uint32_t offset = byte_offset(stack[depth - 1], index);
+            if (offset != NO_OFFSET) {
+                f.offsets[offset]++;
+            }
+        });
+        return result;
+    }
+
+    // "samples percent name" per function, most samples first
+    void print_functions(std::ostream& out) const {
+        std::map<uint32_t, FunctionProfile> profiles = functions();
+        std::vector<std::pair<uint64_t, uint32_t>> order;
+        uint64_t in_wasm = 0;
+        for (const auto& p : profiles) {
+            order.push_back({p.second.samples, p.first});
+            in_wasm += p.second.samples;
+        }
+        std::sort(order.rbegin(), order.rend());
+        uint64_t total = std::max<uint64_t>(total_samples(), 1);
+        for (const auto& o : order) {
+            out << line(o.first, total) << function_name(o.second) << "\n";
+        }
+        if (total_samples() > in_wasm) {
+            out << line(total_samples() - in_wasm, total) << "(outside WASM or lost)\n";
+        }
+    }
+
+    // The WAT of `func_idx` with the samples of every instruction in front,
+    // or the sampled offsets alone if the WAT printer lacks an instruction
+    void print_offsets(std::ostream& out, uint32_t func_idx) const {
+        std::map<uint32_t, FunctionProfile> profiles = functions();
+        const FunctionProfile& f = profiles[func_idx];
+        uint64_t total = std::max<uint64_t>(f.samples, 1);
+        out << function_name(func_idx) << ": " << f.samples << " samples\n";
+        if (func_idx < num_imported_funcs()) {
+            return;
+        }
+        WASM_INSTS_VISITOR::WATVisitor v;
+        v.indent = "\n    ";
+        try {
+            v.decode_instructions(codes[func_idx - num_imported_funcs()].insts_start_index);
+        } catch (const std::string&) {
+            for (const auto& o : f.offsets) {
+                char offset[16];
+                snprintf(offset, sizeof(offset), "0x%x", o.first);
+                out << line(o.second, total) << offset << "\n";
+            }
+            return;
+        }
+        size_t pos = 1;  // every line starts with a newline
+        for (uint32_t offset : v.line_offsets) {
+            size_t end = std::min(v.src.find('\n', pos), v.src.size());
+            auto it = f.offsets.find(offset);
+            out << (it == f.offsets.end() ? std::string(17, ' ') : line(it->second, total)) << v.src.substr(pos, end - pos)
+                << "\n";
+            pos = end + 1;
+        }
+    }
+
+    // One "outer;...;inner samples" line per call stack, the input of
+    // flamegraph.pl and speedscope
+    void write_collapsed(std::ostream& out) const {
+        std::map<std::vector<uint32_t>, uint64_t> stacks;
+        for_each_sample([&](const uint32_t* stack, uint32_t depth, uint32_t) {
+            stacks[std::vector<uint32_t>(stack, stack + depth)]++;
+        });
+        for (const auto& s : stacks) {
+            for (size_t i = 0; i < s.first.size(); i++) {
+                out << (i ? ";" : "") << function_name(s.first[i]);
+            }
+            out << " " << s.second << "\n";
+        }
+    }
+
+   private:
+    static inline SamplingProfiler* volatile active = nullptr;
+
+    Interpreter& interp;
+    uint32_t hz;
+    struct sigaction old_action;
+    // per sample: its depth, the lowered instruction index in the innermost
+    // function or NO_OFFSET, and the functions from the outermost kept one in
+    std::vector<uint32_t> buffer;
+    volatile size_t used;
+    volatile uint64_t lost;
+    mutable std::map<uint32_t, std::vector<uint32_t>> offset_tables;  // per function, by lowered index
+
+    static void on_sigprof(int, siginfo_t*, void* context) {
+        SamplingProfiler* p = active;
+        if (p) {
+            p->sample(static_cast<const ucontext_t*>(context));
+        }
+    }
+
+    // The general purpose registers of the interrupted code
+    static size_t registers(const ucontext_t* context, const uintptr_t*& regs) {
+#if defined(__x86_64__)
+        regs = (const uintptr_t*)context->uc_mcontext.gregs;
+        return NGREG;
+#elif defined(__aarch64__)
+        regs = (const uintptr_t*)context->uc_mcontext.regs;
+        return 31;
+#else
+        (void)context;
+        regs = nullptr;
+        return 0;
+#endif
+    }
+
+    // Runs in the signal handler, so it only reads and fills memory that is
+    // already there
+    void sample(const ucontext_t* context) {
+        const Interpreter& in = interp;
+        uint32_t depth = std::min<size_t>(in.frames.size(), MAX_DEPTH);
+        if (used + 2 + depth > buffer.size()) {
+            lost = lost + 1;
+            return;
+        }
+        uint32_t* out = buffer.data() + used;
+        const Interpreter::Frame* frames = in.frames.data() + in.frames.size() - depth;
+        out[0] = depth;
+        out[1] = NO_OFFSET;
+        for (uint32_t i = 0; i < depth; i++) {
+            out[2 + i] = frames[i].func_idx;
+        }
+        uint32_t f = depth > 0 ? out[1 + depth] : ~0U;
+        if (f < in.call_table.size()) {
+            uintptr_t code = (uintptr_t)in.call_table[f];
+            uintptr_t size = in.code_sizes[f] * sizeof(Inst);
+            const uintptr_t* regs;
+            for (size_t i = 0, n = registers(context, regs); i < n; i++) {
+                uintptr_t d = regs[i] - code;
+                if (d < size && d % sizeof(Inst) == 0) {
+                    out[1] = d / sizeof(Inst);
+                    break;
+                }
+            }
+        }
+        used = used + 2 + depth;
+    }
+
+    uint64_t num_samples() const {
+        uint64_t n = 0;
+        for (size_t i = 0; i < used; i += 2 + buffer[i]) {
+            n++;
+        }
+        return n;
+    }
+
+    // Calls `f(stack, depth, index)` for every sample in WASM code
+    template <class F>
+    void for_each_sample(F f) const {
+        uint32_t n = num_funcs();
+        for (size_t i = 0; i < used; i += 2 + buffer[i]) {
+            uint32_t depth = buffer[i];
+            const uint32_t* stack = &buffer[i + 2];
+            // a sample may catch a frame being pushed
+            if (depth > 0 && std::all_of(stack, stack + depth, [n](uint32_t x) { return x < n; })) {
+                f(stack, depth, buffer[i + 1]);
+            }
+        }
+    }
+
+    uint32_t byte_offset(uint32_t func_idx, uint32_t index) const {
+        if (index == NO_OFFSET || func_idx < num_imported_funcs()) {
+            return NO_OFFSET;
+        }
+        auto it = offset_tables.find(func_idx);
+        if (it == offset_tables.end()) {
+            it = offset_tables.emplace(func_idx, interp.byte_offsets(func_idx)).first;
+        }
+        return index < it->second.size() ? it->second[index] : NO_OFFSET;
+    }
+
+    static std::string line(uint64_t samples, uint64_t total) {
+        char s[32];
+        snprintf(s, sizeof(s), "%9llu %5.1f%% ", (unsigned long long)samples, 100.0 * samples / total);
+        return s;
+    }
+};
+
+}  // namespace LFortran
+
+#endif  // LFORTRAN_WASM_PROFILER_H
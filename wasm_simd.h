@@ -0,0 +1,702 @@
+#ifndef LFORTRAN_WASM_SIMD_H
+#define LFORTRAN_WASM_SIMD_H
+
+#include <cstring>
+#include "wasm_numeric.h"
+
+// The SSE4.1 kernels are only built for x86; elsewhere every instruction runs
+// on the scalar table.
+#if defined(__x86_64__) || defined(__i386__)
+#define WASM_SIMD_SSE41
+#include <immintrin.h>
+#endif
+
+// Implementations of the 0xFD instructions that only work on values, indexed
+// by their opcode number. Every v128 is passed as a pointer to its 16 bytes;
+// scalar operands (splat, shift counts) live in the low bytes of a slot.
+typedef void (*V128Unary)(uint8_t* a);
+typedef void (*V128Binary)(uint8_t* a, const uint8_t* b);
+typedef void (*V128Ternary)(uint8_t* a, const uint8_t* b, const uint8_t* c);
+typedef int32_t (*V128Test)(const uint8_t* a);
+typedef void (*V128Shift)(uint8_t* a, uint32_t count);
+
+struct SimdOps {
+    V128Unary unary[256];
+    V128Binary binary[256];
+    V128Ternary ternary[256];
+    V128Test test[256];
+    V128Shift shift[256];
+};
+
+namespace Simd {
+
+template <typename T>
+struct Lanes {
+    static const int N = 16 / sizeof(T);
+    T v[N];
+};
+
+template <typename T>
+Lanes<T> load(const uint8_t* p) {
+    Lanes<T> l;
+    std::memcpy(l.v, p, 16);
+    return l;
+}
+
+template <typename T>
+void store(uint8_t* p, const Lanes<T>& l) {
+    std::memcpy(p, l.v, 16);
+}
+
+template <typename T, typename F>
+void map1(uint8_t* a, F f) {
+    Lanes<T> x = load<T>(a);
+    for (int i = 0; i < Lanes<T>::N; i++) {
+        x.v[i] = f(x.v[i]);
+    }
+    store(a, x);
+}
+
+template <typename T, typename F>
+void map2(uint8_t* a, const uint8_t* b, F f) {
+    Lanes<T> x = load<T>(a), y = load<T>(b);
+    for (int i = 0; i < Lanes<T>::N; i++) {
+        x.v[i] = f(x.v[i], y.v[i]);
+    }
+    store(a, x);
+}
+
+// lanes become all ones where f holds and zero elsewhere
+template <typename T, typename F>
+void compare(uint8_t* a, const uint8_t* b, F f) {
+    Lanes<T> x = load<T>(a), y = load<T>(b);
+    Lanes<T> r;
+    for (int i = 0; i < Lanes<T>::N; i++) {
+        bool c = f(x.v[i], y.v[i]);
+        std::memset(&r.v[i], c ? 0xFF : 0x00, sizeof(T));
+    }
+    store(a, r);
+}
+
+template <typename T>
+void splat(uint8_t* a) {
+    T x;
+    std::memcpy(&x, a, sizeof(T));
+    Lanes<T> r;
+    for (int i = 0; i < Lanes<T>::N; i++) {
+        r.v[i] = x;
+    }
+    store(a, r);
+}
+
+template <typename T>
+int32_t all_true(const uint8_t* a) {
+    Lanes<T> x = load<T>(a);
+    for (int i = 0; i < Lanes<T>::N; i++) {
+        if (x.v[i] == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+template <typename T>
+int32_t bitmask(const uint8_t* a) {
+    Lanes<T> x = load<T>(a);
+    int32_t r = 0;
+    for (int i = 0; i < Lanes<T>::N; i++) {
+        r |= (x.v[i] < 0) << i;
+    }
+    return r;
+}
+
+template <typename T, typename U>
+T saturate(U x) {
+    if (x < (U)std::numeric_limits<T>::min()) {
+        return std::numeric_limits<T>::min();
+    }
+    if (x > (U)std::numeric_limits<T>::max()) {
+        return std::numeric_limits<T>::max();
+    }
+    return (T)x;
+}
+
+// narrows the signed lanes S of a and then b into twice as many lanes D
+template <typename S, typename D>
+void narrow(uint8_t* a, const uint8_t* b) {
+    Lanes<S> x = load<S>(a), y = load<S>(b);
+    Lanes<D> r;
+    for (int i = 0; i < Lanes<S>::N; i++) {
+        r.v[i] = saturate<D>((int32_t)x.v[i]);
+        r.v[i + Lanes<S>::N] = saturate<D>((int32_t)y.v[i]);
+    }
+    store(a, r);
+}
+
+// widens the lanes S of the low (high = 0) or high half into lanes W
+template <typename S, typename W>
+void extend(uint8_t* a, int high) {
+    Lanes<S> x = load<S>(a);
+    Lanes<W> r;
+    for (int i = 0; i < Lanes<W>::N; i++) {
+        r.v[i] = (W)x.v[i + high * Lanes<W>::N];
+    }
+    store(a, r);
+}
+
+template <typename S, typename W>
+void extmul(uint8_t* a, const uint8_t* b, int high) {
+    Lanes<S> x = load<S>(a), y = load<S>(b);
+    Lanes<W> r;
+    for (int i = 0; i < Lanes<W>::N; i++) {
+        r.v[i] = (W)x.v[i + high * Lanes<W>::N] * (W)y.v[i + high * Lanes<W>::N];
+    }
+    store(a, r);
+}
+
+template <typename S, typename W>
+void extadd_pairwise(uint8_t* a) {
+    Lanes<S> x = load<S>(a);
+    Lanes<W> r;
+    for (int i = 0; i < Lanes<W>::N; i++) {
+        r.v[i] = (W)x.v[2 * i] + (W)x.v[2 * i + 1];
+    }
+    store(a, r);
+}
+
+template <typename T>
+void shl(uint8_t* a, uint32_t count) {
+    typedef typename std::make_unsigned<T>::type U;
+    map1<U>(a, [count](U x) -> U { return x << (count % (sizeof(T) * 8)); });
+}
+
+template <typename T>
+void shr(uint8_t* a, uint32_t count) {
+    map1<T>(a, [count](T x) -> T { return x >> (count % (sizeof(T) * 8)); });
+}
+
+// converts the lanes F into lanes T, zeroing the lanes T has in excess
+template <typename F, typename T, typename C>
+void convert(uint8_t* a, C c) {
+    Lanes<F> x = load<F>(a);
+    Lanes<T> r = {};
+    for (int i = 0; i < Lanes<T>::N && i < Lanes<F>::N; i++) {
+        r.v[i] = c(x.v[i]);
+    }
+    store(a, r);
+}
+
+inline SimdOps make_scalar_ops() {
+    SimdOps ops = {};
+
+#define UN(num, T, expr) ops.unary[num] = [](uint8_t* a) { map1<T>(a, [](T x) -> T { return expr; }); };
+#define BIN(num, T, expr) \
+    ops.binary[num] = [](uint8_t* a, const uint8_t* b) { map2<T>(a, b, [](T x, T y) -> T { return expr; }); };
+#define CMP(num, T, expr) \
+    ops.binary[num] = [](uint8_t* a, const uint8_t* b) { compare<T>(a, b, [](T x, T y) { return expr; }); };
+
+    ops.unary[15] = splat<int8_t>;
+    ops.unary[16] = splat<int16_t>;
+    ops.unary[17] = splat<int32_t>;
+    ops.unary[18] = splat<int64_t>;
+    ops.unary[19] = splat<float>;
+    ops.unary[20] = splat<double>;
+    ops.binary[14] = [](uint8_t* a, const uint8_t* b) {
+        uint8_t r[16];
+        for (int i = 0; i < 16; i++) {
+            r[i] = b[i] < 16 ? a[b[i]] : 0;
+        }
+        std::memcpy(a, r, 16);
+    };
+
+    CMP(35, int8_t, x == y)
+    CMP(36, int8_t, x != y)
+    CMP(37, int8_t, x < y)
+    CMP(38, uint8_t, x < y)
+    CMP(39, int8_t, x > y)
+    CMP(40, uint8_t, x > y)
+    CMP(41, int8_t, x <= y)
+    CMP(42, uint8_t, x <= y)
+    CMP(43, int8_t, x >= y)
+    CMP(44, uint8_t, x >= y)
+    CMP(45, int16_t, x == y)
+    CMP(46, int16_t, x != y)
+    CMP(47, int16_t, x < y)
+    CMP(48, uint16_t, x < y)
+    CMP(49, int16_t, x > y)
+    CMP(50, uint16_t, x > y)
+    CMP(51, int16_t, x <= y)
+    CMP(52, uint16_t, x <= y)
+    CMP(53, int16_t, x >= y)
+    CMP(54, uint16_t, x >= y)
+    CMP(55, int32_t, x == y)
+    CMP(56, int32_t, x != y)
+    CMP(57, int32_t, x < y)
+    CMP(58, uint32_t, x < y)
+    CMP(59, int32_t, x > y)
+    CMP(60, uint32_t, x > y)
+    CMP(61, int32_t, x <= y)
+    CMP(62, uint32_t, x <= y)
+    CMP(63, int32_t, x >= y)
+    CMP(64, uint32_t, x >= y)
+    CMP(214, int64_t, x == y)
+    CMP(215, int64_t, x != y)
+    CMP(216, int64_t, x < y)
+    CMP(217, int64_t, x > y)
+    CMP(218, int64_t, x <= y)
+    CMP(219, int64_t, x >= y)
+    CMP(65, float, x == y)
+    CMP(66, float, x != y)
+    CMP(67, float, x < y)
+    CMP(68, float, x > y)
+    CMP(69, float, x <= y)
+    CMP(70, float, x >= y)
+    CMP(71, double, x == y)
+    CMP(72, double, x != y)
+    CMP(73, double, x < y)
+    CMP(74, double, x > y)
+    CMP(75, double, x <= y)
+    CMP(76, double, x >= y)
+
+    UN(77, uint64_t, ~x)
+    BIN(78, uint64_t, x & y)
+    BIN(79, uint64_t, x & ~y)
+    BIN(80, uint64_t, x | y)
+    BIN(81, uint64_t, x ^ y)
+    ops.ternary[82] = [](uint8_t* a, const uint8_t* b, const uint8_t* c) {
+        for (int i = 0; i < 16; i++) {
+            a[i] = (a[i] & c[i]) | (b[i] & ~c[i]);
+        }
+    };
+    ops.test[83] = [](const uint8_t* a) -> int32_t {
+        Lanes<uint64_t> x = load<uint64_t>(a);
+        return (x.v[0] | x.v[1]) != 0;
+    };
+
+    UN(96, int8_t, x < 0 ? (int8_t)-x : x)
+    UN(97, int8_t, -x)
+    UN(98, uint8_t, __builtin_popcount(x))
+    ops.test[99] = all_true<int8_t>;
+    ops.test[100] = bitmask<int8_t>;
+    ops.binary[101] = narrow<int16_t, int8_t>;
+    ops.binary[102] = narrow<int16_t, uint8_t>;
+    ops.shift[107] = shl<int8_t>;
+    ops.shift[108] = shr<int8_t>;
+    ops.shift[109] = shr<uint8_t>;
+    BIN(110, int8_t, x + y)
+    BIN(111, int8_t, saturate<int8_t>(x + y))
+    BIN(112, uint8_t, saturate<uint8_t>(x + y))
+    BIN(113, int8_t, x - y)
+    BIN(114, int8_t, saturate<int8_t>(x - y))
+    BIN(115, uint8_t, saturate<uint8_t>(x - y))
+    BIN(118, int8_t, std::min(x, y))
+    BIN(119, uint8_t, std::min(x, y))
+    BIN(120, int8_t, std::max(x, y))
+    BIN(121, uint8_t, std::max(x, y))
+    BIN(123, uint8_t, (x + y + 1) / 2)
+
+    ops.unary[124] = extadd_pairwise<int8_t, int16_t>;
+    ops.unary[125] = extadd_pairwise<uint8_t, uint16_t>;
+    UN(128, int16_t, x < 0 ? (int16_t)-x : x)
+    UN(129, int16_t, -x)
+    BIN(130, int16_t, saturate<int16_t>(((int32_t)x * y + 0x4000) >> 15))
+    ops.test[131] = all_true<int16_t>;
+    ops.test[132] = bitmask<int16_t>;
+    ops.binary[133] = narrow<int32_t, int16_t>;
+    ops.binary[134] = narrow<int32_t, uint16_t>;
+    ops.unary[135] = [](uint8_t* a) { extend<int8_t, int16_t>(a, 0); };
+    ops.unary[136] = [](uint8_t* a) { extend<int8_t, int16_t>(a, 1); };
+    ops.unary[137] = [](uint8_t* a) { extend<uint8_t, uint16_t>(a, 0); };
+    ops.unary[138] = [](uint8_t* a) { extend<uint8_t, uint16_t>(a, 1); };
+    ops.shift[139] = shl<int16_t>;
+    ops.shift[140] = shr<int16_t>;
+    ops.shift[141] = shr<uint16_t>;
+    BIN(142, int16_t, x + y)
+    BIN(143, int16_t, saturate<int16_t>(x + y))
+    BIN(144, uint16_t, saturate<uint16_t>(x + y))
+    BIN(145, int16_t, x - y)
+    BIN(146, int16_t, saturate<int16_t>(x - y))
+    BIN(147, uint16_t, saturate<uint16_t>(x - y))
+    BIN(149, uint16_t, (uint32_t)x * y)
+    BIN(150, int16_t, std::min(x, y))
+    BIN(151, uint16_t, std::min(x, y))
+    BIN(152, int16_t, std::max(x, y))
+    BIN(153, uint16_t, std::max(x, y))
+    BIN(155, uint16_t, (x + y + 1) / 2)
+    ops.binary[156] = [](uint8_t* a, const uint8_t* b) { extmul<int8_t, int16_t>(a, b, 0); };
+    ops.binary[157] = [](uint8_t* a, const uint8_t* b) { extmul<int8_t, int16_t>(a, b, 1); };
+    ops.binary[158] = [](uint8_t* a, const uint8_t* b) { extmul<uint8_t, uint16_t>(a, b, 0); };
+    ops.binary[159] = [](uint8_t* a, const uint8_t* b) { extmul<uint8_t, uint16_t>(a, b, 1); };
+
+    ops.unary[126] = extadd_pairwise<int16_t, int32_t>;
+    ops.unary[127] = extadd_pairwise<uint16_t, uint32_t>;
+    UN(160, uint32_t, (int32_t)x < 0 ? 0 - x : x)
+    UN(161, uint32_t, 0 - x)
+    ops.test[163] = all_true<int32_t>;
+    ops.test[164] = bitmask<int32_t>;
+    ops.unary[167] = [](uint8_t* a) { extend<int16_t, int32_t>(a, 0); };
+    ops.unary[168] = [](uint8_t* a) { extend<int16_t, int32_t>(a, 1); };
+    ops.unary[169] = [](uint8_t* a) { extend<uint16_t, uint32_t>(a, 0); };
+    ops.unary[170] = [](uint8_t* a) { extend<uint16_t, uint32_t>(a, 1); };
+    ops.shift[171] = shl<int32_t>;
+    ops.shift[172] = shr<int32_t>;
+    ops.shift[173] = shr<uint32_t>;
+    BIN(174, uint32_t, x + y)
+    BIN(177, uint32_t, x - y)
+    BIN(181, uint32_t, x * y)
+    BIN(182, int32_t, std::min(x, y))
+    BIN(183, uint32_t, std::min(x, y))
+    BIN(184, int32_t, std::max(x, y))
+    BIN(185, uint32_t, std::max(x, y))
+    ops.binary[186] = [](uint8_t* a, const uint8_t* b) {
+        Lanes<int16_t> x = load<int16_t>(a), y = load<int16_t>(b);
+        Lanes<uint32_t> r;
+        for (int i = 0; i < 4; i++) {
+            r.v[i] = (uint32_t)(x.v[2 * i] * y.v[2 * i]) + (uint32_t)(x.v[2 * i + 1] * y.v[2 * i + 1]);
+        }
+        store(a, r);
+    };
+    ops.binary[188] = [](uint8_t* a, const uint8_t* b) { extmul<int16_t, int32_t>(a, b, 0); };
+    ops.binary[189] = [](uint8_t* a, const uint8_t* b) { extmul<int16_t, int32_t>(a, b, 1); };
+    ops.binary[190] = [](uint8_t* a, const uint8_t* b) { extmul<uint16_t, uint32_t>(a, b, 0); };
+    ops.binary[191] = [](uint8_t* a, const uint8_t* b) { extmul<uint16_t, uint32_t>(a, b, 1); };
+
+    UN(192, uint64_t, (int64_t)x < 0 ? 0 - x : x)
+    UN(193, uint64_t, 0 - x)
+    ops.test[195] = all_true<int64_t>;
+    ops.test[196] = bitmask<int64_t>;
+    ops.unary[199] = [](uint8_t* a) { extend<int32_t, int64_t>(a, 0); };
+    ops.unary[200] = [](uint8_t* a) { extend<int32_t, int64_t>(a, 1); };
+    ops.unary[201] = [](uint8_t* a) { extend<uint32_t, uint64_t>(a, 0); };
+    ops.unary[202] = [](uint8_t* a) { extend<uint32_t, uint64_t>(a, 1); };
+    ops.shift[203] = shl<int64_t>;
+    ops.shift[204] = shr<int64_t>;
+    ops.shift[205] = shr<uint64_t>;
+    BIN(206, uint64_t, x + y)
+    BIN(209, uint64_t, x - y)
+    BIN(213, uint64_t, x * y)
+    ops.binary[220] = [](uint8_t* a, const uint8_t* b) { extmul<int32_t, int64_t>(a, b, 0); };
+    ops.binary[221] = [](uint8_t* a, const uint8_t* b) { extmul<int32_t, int64_t>(a, b, 1); };
+    ops.binary[222] = [](uint8_t* a, const uint8_t* b) { extmul<uint32_t, uint64_t>(a, b, 0); };
+    ops.binary[223] = [](uint8_t* a, const uint8_t* b) { extmul<uint32_t, uint64_t>(a, b, 1); };
+
+    UN(103, float, std::ceil(x))
+    UN(104, float, std::floor(x))
+    UN(105, float, std::trunc(x))
+    UN(106, float, std::nearbyint(x))
+    UN(224, float, std::fabs(x))
+    UN(225, float, -x)
+    UN(227, float, std::sqrt(x))
+    BIN(228, float, x + y)
+    BIN(229, float, x - y)
+    BIN(230, float, x * y)
+    BIN(231, float, x / y)
+    BIN(232, float, wasm_min(x, y))
+    BIN(233, float, wasm_max(x, y))
+    BIN(234, float, y < x ? y : x)
+    BIN(235, float, x < y ? y : x)
+
+    UN(116, double, std::ceil(x))
+    UN(117, double, std::floor(x))
+    UN(122, double, std::trunc(x))
+    UN(148, double, std::nearbyint(x))
+    UN(236, double, std::fabs(x))
+    UN(237, double, -x)
+    UN(239, double, std::sqrt(x))
+    BIN(240, double, x + y)
+    BIN(241, double, x - y)
+    BIN(242, double, x * y)
+    BIN(243, double, x / y)
+    BIN(244, double, wasm_min(x, y))
+    BIN(245, double, wasm_max(x, y))
+    BIN(246, double, y < x ? y : x)
+    BIN(247, double, x < y ? y : x)
+
+    ops.unary[248] = [](uint8_t* a) { convert<float, int32_t>(a, trunc_sat<int32_t, float>); };
+    ops.unary[249] = [](uint8_t* a) { convert<float, uint32_t>(a, trunc_sat<uint32_t, float>); };
+    ops.unary[250] = [](uint8_t* a) { convert<int32_t, float>(a, [](int32_t x) { return (float)x; }); };
+    ops.unary[251] = [](uint8_t* a) { convert<uint32_t, float>(a, [](uint32_t x) { return (float)x; }); };
+    ops.unary[252] = [](uint8_t* a) { convert<double, int32_t>(a, trunc_sat<int32_t, double>); };
+    ops.unary[253] = [](uint8_t* a) { convert<double, uint32_t>(a, trunc_sat<uint32_t, double>); };
+    ops.unary[254] = [](uint8_t* a) { convert<int32_t, double>(a, [](int32_t x) { return (double)x; }); };
+    ops.unary[255] = [](uint8_t* a) { convert<uint32_t, double>(a, [](uint32_t x) { return (double)x; }); };
+    ops.unary[94] = [](uint8_t* a) { convert<double, float>(a, [](double x) { return (float)x; }); };
+    ops.unary[95] = [](uint8_t* a) { convert<float, double>(a, [](float x) { return (double)x; }); };
+
+#undef UN
+#undef BIN
+#undef CMP
+    return ops;
+}
+
+#ifdef WASM_SIMD_SSE41
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+
+inline __m128i ld(const uint8_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+
+inline void st(uint8_t* p, __m128i v) { _mm_storeu_si128((__m128i*)p, v); }
+
+inline __m128 ldps(const uint8_t* p) { return _mm_loadu_ps((const float*)p); }
+
+inline void stps(uint8_t* p, __m128 v) { _mm_storeu_ps((float*)p, v); }
+
+inline __m128d ldpd(const uint8_t* p) { return _mm_loadu_pd((const double*)p); }
+
+inline void stpd(uint8_t* p, __m128d v) { _mm_storeu_pd((double*)p, v); }
+
+// Replaces the scalar lanes loops with SSE4.1 sequences where one exists with
+// exactly the WASM semantics; the rest keep the scalar implementation.
+inline void add_sse41_ops(SimdOps& ops) {
+
+// Kernels are static functions of local classes rather than lambdas: the
+// function pointer of a lambda calls it through a thunk that lacks the
+// sse4.1 target, so it cannot inline the kernel and every call takes an
+// extra jump.
+#define KERNEL(table, num, params, ...)      \
+    {                                        \
+        struct K {                           \
+            static auto f params __VA_ARGS__ \
+        };                                   \
+        ops.table[num] = K::f;               \
+    }
+#define UN(num, expr) KERNEL(unary, num, (uint8_t* a), { __m128i x = ld(a); st(a, expr); })
+#define BIN(num, expr) KERNEL(binary, num, (uint8_t* a, const uint8_t* b), { __m128i x = ld(a), y = ld(b); st(a, expr); })
+#define UNPS(num, expr) KERNEL(unary, num, (uint8_t* a), { __m128 x = ldps(a); stps(a, expr); })
+#define BINPS(num, expr) KERNEL(binary, num, (uint8_t* a, const uint8_t* b), { __m128 x = ldps(a), y = ldps(b); stps(a, expr); })
+#define UNPD(num, expr) KERNEL(unary, num, (uint8_t* a), { __m128d x = ldpd(a); stpd(a, expr); })
+#define BINPD(num, expr) KERNEL(binary, num, (uint8_t* a, const uint8_t* b), { __m128d x = ldpd(a), y = ldpd(b); stpd(a, expr); })
+#define SHIFT(num, expr, bits) \
+    KERNEL(shift, num, (uint8_t* a, uint32_t count), { __m128i x = ld(a), n = _mm_cvtsi32_si128(count % bits); st(a, expr); })
+#define TEST(num, expr) KERNEL(test, num, (const uint8_t* a) -> int32_t, { return expr; })
+
+    UN(15, _mm_set1_epi8((char)_mm_cvtsi128_si32(x)))
+    UN(16, _mm_set1_epi16((short)_mm_cvtsi128_si32(x)))
+    UN(17, _mm_shuffle_epi32(x, 0))
+    UN(18, _mm_unpacklo_epi64(x, x))
+    UN(19, _mm_shuffle_epi32(x, 0))
+    UN(20, _mm_unpacklo_epi64(x, x))
+    // indices of 16 and above have their top bit set after this and select 0
+    BIN(14, _mm_shuffle_epi8(x, _mm_adds_epu8(y, _mm_set1_epi8(0x70))))
+
+#define NOT(v) _mm_xor_si128(v, _mm_set1_epi32(-1))
+    BIN(35, _mm_cmpeq_epi8(x, y))
+    BIN(36, NOT(_mm_cmpeq_epi8(x, y)))
+    BIN(37, _mm_cmplt_epi8(x, y))
+    BIN(38, NOT(_mm_cmpeq_epi8(_mm_max_epu8(x, y), x)))
+    BIN(39, _mm_cmpgt_epi8(x, y))
+    BIN(40, NOT(_mm_cmpeq_epi8(_mm_min_epu8(x, y), x)))
+    BIN(41, NOT(_mm_cmpgt_epi8(x, y)))
+    BIN(42, _mm_cmpeq_epi8(_mm_min_epu8(x, y), x))
+    BIN(43, NOT(_mm_cmplt_epi8(x, y)))
+    BIN(44, _mm_cmpeq_epi8(_mm_max_epu8(x, y), x))
+    BIN(45, _mm_cmpeq_epi16(x, y))
+    BIN(46, NOT(_mm_cmpeq_epi16(x, y)))
+    BIN(47, _mm_cmplt_epi16(x, y))
+    BIN(48, NOT(_mm_cmpeq_epi16(_mm_max_epu16(x, y), x)))
+    BIN(49, _mm_cmpgt_epi16(x, y))
+    BIN(50, NOT(_mm_cmpeq_epi16(_mm_min_epu16(x, y), x)))
+    BIN(51, NOT(_mm_cmpgt_epi16(x, y)))
+    BIN(52, _mm_cmpeq_epi16(_mm_min_epu16(x, y), x))
+    BIN(53, NOT(_mm_cmplt_epi16(x, y)))
+    BIN(54, _mm_cmpeq_epi16(_mm_max_epu16(x, y), x))
+    BIN(55, _mm_cmpeq_epi32(x, y))
+    BIN(56, NOT(_mm_cmpeq_epi32(x, y)))
+    BIN(57, _mm_cmplt_epi32(x, y))
+    BIN(58, NOT(_mm_cmpeq_epi32(_mm_max_epu32(x, y), x)))
+    BIN(59, _mm_cmpgt_epi32(x, y))
+    BIN(60, NOT(_mm_cmpeq_epi32(_mm_min_epu32(x, y), x)))
+    BIN(61, NOT(_mm_cmpgt_epi32(x, y)))
+    BIN(62, _mm_cmpeq_epi32(_mm_min_epu32(x, y), x))
+    BIN(63, NOT(_mm_cmplt_epi32(x, y)))
+    BIN(64, _mm_cmpeq_epi32(_mm_max_epu32(x, y), x))
+    BIN(214, _mm_cmpeq_epi64(x, y))
+    BIN(215, NOT(_mm_cmpeq_epi64(x, y)))
+    BINPS(65, _mm_cmpeq_ps(x, y))
+    BINPS(66, _mm_cmpneq_ps(x, y))
+    BINPS(67, _mm_cmplt_ps(x, y))
+    BINPS(68, _mm_cmpgt_ps(x, y))
+    BINPS(69, _mm_cmple_ps(x, y))
+    BINPS(70, _mm_cmpge_ps(x, y))
+    BINPD(71, _mm_cmpeq_pd(x, y))
+    BINPD(72, _mm_cmpneq_pd(x, y))
+    BINPD(73, _mm_cmplt_pd(x, y))
+    BINPD(74, _mm_cmpgt_pd(x, y))
+    BINPD(75, _mm_cmple_pd(x, y))
+    BINPD(76, _mm_cmpge_pd(x, y))
+
+    UN(77, NOT(x))
+    BIN(78, _mm_and_si128(x, y))
+    BIN(79, _mm_andnot_si128(y, x))
+    BIN(80, _mm_or_si128(x, y))
+    BIN(81, _mm_xor_si128(x, y))
+    KERNEL(ternary, 82, (uint8_t* a, const uint8_t* b, const uint8_t* c), {
+        __m128i m = ld(c);
+        st(a, _mm_or_si128(_mm_and_si128(ld(a), m), _mm_andnot_si128(m, ld(b))));
+    })
+    TEST(83, !_mm_testz_si128(ld(a), ld(a)))
+
+    UN(96, _mm_abs_epi8(x))
+    UN(97, _mm_sub_epi8(_mm_setzero_si128(), x))
+    TEST(99, _mm_movemask_epi8(_mm_cmpeq_epi8(ld(a), _mm_setzero_si128())) == 0)
+    TEST(100, _mm_movemask_epi8(ld(a)))
+    BIN(101, _mm_packs_epi16(x, y))
+    BIN(102, _mm_packus_epi16(x, y))
+    BIN(110, _mm_add_epi8(x, y))
+    BIN(111, _mm_adds_epi8(x, y))
+    BIN(112, _mm_adds_epu8(x, y))
+    BIN(113, _mm_sub_epi8(x, y))
+    BIN(114, _mm_subs_epi8(x, y))
+    BIN(115, _mm_subs_epu8(x, y))
+    BIN(118, _mm_min_epi8(x, y))
+    BIN(119, _mm_min_epu8(x, y))
+    BIN(120, _mm_max_epi8(x, y))
+    BIN(121, _mm_max_epu8(x, y))
+    BIN(123, _mm_avg_epu8(x, y))
+
+    UN(128, _mm_abs_epi16(x))
+    UN(129, _mm_sub_epi16(_mm_setzero_si128(), x))
+    // pmulhrsw only differs for 0x8000 * 0x8000, which has to saturate
+    BIN(130, _mm_xor_si128(_mm_mulhrs_epi16(x, y), _mm_cmpeq_epi16(_mm_mulhrs_epi16(x, y), _mm_set1_epi16((short)0x8000))))
+    TEST(131, _mm_movemask_epi8(_mm_cmpeq_epi16(ld(a), _mm_setzero_si128())) == 0)
+    TEST(132, _mm_movemask_epi8(_mm_packs_epi16(ld(a), _mm_setzero_si128())))
+    BIN(133, _mm_packs_epi32(x, y))
+    BIN(134, _mm_packus_epi32(x, y))
+    UN(135, _mm_cvtepi8_epi16(x))
+    UN(136, _mm_cvtepi8_epi16(_mm_srli_si128(x, 8)))
+    UN(137, _mm_cvtepu8_epi16(x))
+    UN(138, _mm_cvtepu8_epi16(_mm_srli_si128(x, 8)))
+    SHIFT(139, _mm_sll_epi16(x, n), 16)
+    SHIFT(140, _mm_sra_epi16(x, n), 16)
+    SHIFT(141, _mm_srl_epi16(x, n), 16)
+    BIN(142, _mm_add_epi16(x, y))
+    BIN(143, _mm_adds_epi16(x, y))
+    BIN(144, _mm_adds_epu16(x, y))
+    BIN(145, _mm_sub_epi16(x, y))
+    BIN(146, _mm_subs_epi16(x, y))
+    BIN(147, _mm_subs_epu16(x, y))
+    BIN(149, _mm_mullo_epi16(x, y))
+    BIN(150, _mm_min_epi16(x, y))
+    BIN(151, _mm_min_epu16(x, y))
+    BIN(152, _mm_max_epi16(x, y))
+    BIN(153, _mm_max_epu16(x, y))
+    BIN(155, _mm_avg_epu16(x, y))
+    BIN(156, _mm_mullo_epi16(_mm_cvtepi8_epi16(x), _mm_cvtepi8_epi16(y)))
+    BIN(157, _mm_mullo_epi16(_mm_cvtepi8_epi16(_mm_srli_si128(x, 8)), _mm_cvtepi8_epi16(_mm_srli_si128(y, 8))))
+    BIN(158, _mm_mullo_epi16(_mm_cvtepu8_epi16(x), _mm_cvtepu8_epi16(y)))
+    BIN(159, _mm_mullo_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(x, 8)), _mm_cvtepu8_epi16(_mm_srli_si128(y, 8))))
+
+    UN(126, _mm_madd_epi16(x, _mm_set1_epi16(1)))
+    UN(160, _mm_abs_epi32(x))
+    UN(161, _mm_sub_epi32(_mm_setzero_si128(), x))
+    TEST(163, _mm_movemask_epi8(_mm_cmpeq_epi32(ld(a), _mm_setzero_si128())) == 0)
+    TEST(164, _mm_movemask_ps(ldps(a)))
+    UN(167, _mm_cvtepi16_epi32(x))
+    UN(168, _mm_cvtepi16_epi32(_mm_srli_si128(x, 8)))
+    UN(169, _mm_cvtepu16_epi32(x))
+    UN(170, _mm_cvtepu16_epi32(_mm_srli_si128(x, 8)))
+    SHIFT(171, _mm_sll_epi32(x, n), 32)
+    SHIFT(172, _mm_sra_epi32(x, n), 32)
+    SHIFT(173, _mm_srl_epi32(x, n), 32)
+    BIN(174, _mm_add_epi32(x, y))
+    BIN(177, _mm_sub_epi32(x, y))
+    BIN(181, _mm_mullo_epi32(x, y))
+    BIN(182, _mm_min_epi32(x, y))
+    BIN(183, _mm_min_epu32(x, y))
+    BIN(184, _mm_max_epi32(x, y))
+    BIN(185, _mm_max_epu32(x, y))
+    BIN(186, _mm_madd_epi16(x, y))
+    BIN(188, _mm_mullo_epi32(_mm_cvtepi16_epi32(x), _mm_cvtepi16_epi32(y)))
+    BIN(189, _mm_mullo_epi32(_mm_cvtepi16_epi32(_mm_srli_si128(x, 8)), _mm_cvtepi16_epi32(_mm_srli_si128(y, 8))))
+    BIN(190, _mm_mullo_epi32(_mm_cvtepu16_epi32(x), _mm_cvtepu16_epi32(y)))
+    BIN(191, _mm_mullo_epi32(_mm_cvtepu16_epi32(_mm_srli_si128(x, 8)), _mm_cvtepu16_epi32(_mm_srli_si128(y, 8))))
+
+    UN(193, _mm_sub_epi64(_mm_setzero_si128(), x))
+    TEST(195, _mm_movemask_epi8(_mm_cmpeq_epi64(ld(a), _mm_setzero_si128())) == 0)
+    TEST(196, _mm_movemask_pd(ldpd(a)))
+    UN(199, _mm_cvtepi32_epi64(x))
+    UN(200, _mm_cvtepi32_epi64(_mm_srli_si128(x, 8)))
+    UN(201, _mm_cvtepu32_epi64(x))
+    UN(202, _mm_cvtepu32_epi64(_mm_srli_si128(x, 8)))
+    SHIFT(203, _mm_sll_epi64(x, n), 64)
+    SHIFT(205, _mm_srl_epi64(x, n), 64)
+    BIN(206, _mm_add_epi64(x, y))
+    BIN(209, _mm_sub_epi64(x, y))
+    BIN(220, _mm_mul_epi32(_mm_shuffle_epi32(x, 0x50), _mm_shuffle_epi32(y, 0x50)))
+    BIN(221, _mm_mul_epi32(_mm_shuffle_epi32(x, 0xFA), _mm_shuffle_epi32(y, 0xFA)))
+    BIN(222, _mm_mul_epu32(_mm_shuffle_epi32(x, 0x50), _mm_shuffle_epi32(y, 0x50)))
+    BIN(223, _mm_mul_epu32(_mm_shuffle_epi32(x, 0xFA), _mm_shuffle_epi32(y, 0xFA)))
+
+    UNPS(103, _mm_round_ps(x, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC))
+    UNPS(104, _mm_round_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC))
+    UNPS(105, _mm_round_ps(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC))
+    UNPS(106, _mm_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC))
+    UNPS(224, _mm_andnot_ps(_mm_set1_ps(-0.0f), x))
+    UNPS(225, _mm_xor_ps(_mm_set1_ps(-0.0f), x))
+    UNPS(227, _mm_sqrt_ps(x))
+    BINPS(228, _mm_add_ps(x, y))
+    BINPS(229, _mm_sub_ps(x, y))
+    BINPS(230, _mm_mul_ps(x, y))
+    BINPS(231, _mm_div_ps(x, y))
+    // pmin/pmax are defined as y < x ? y : x, which is exactly minps(y, x)
+    BINPS(234, _mm_min_ps(y, x))
+    BINPS(235, _mm_max_ps(y, x))
+
+    UNPD(116, _mm_round_pd(x, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC))
+    UNPD(117, _mm_round_pd(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC))
+    UNPD(122, _mm_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC))
+    UNPD(148, _mm_round_pd(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC))
+    UNPD(236, _mm_andnot_pd(_mm_set1_pd(-0.0), x))
+    UNPD(237, _mm_xor_pd(_mm_set1_pd(-0.0), x))
+    UNPD(239, _mm_sqrt_pd(x))
+    BINPD(240, _mm_add_pd(x, y))
+    BINPD(241, _mm_sub_pd(x, y))
+    BINPD(242, _mm_mul_pd(x, y))
+    BINPD(243, _mm_div_pd(x, y))
+    BINPD(246, _mm_min_pd(y, x))
+    BINPD(247, _mm_max_pd(y, x))
+
+    KERNEL(unary, 250, (uint8_t* a), { stps(a, _mm_cvtepi32_ps(ld(a))); })
+    KERNEL(unary, 254, (uint8_t* a), { stpd(a, _mm_cvtepi32_pd(ld(a))); })
+    KERNEL(unary, 94, (uint8_t* a), { stps(a, _mm_cvtpd_ps(ldpd(a))); })
+    KERNEL(unary, 95, (uint8_t* a), { stpd(a, _mm_cvtps_pd(ldps(a))); })
+
+#undef NOT
+#undef UN
+#undef BIN
+#undef UNPS
+#undef BINPS
+#undef UNPD
+#undef BINPD
+#undef SHIFT
+#undef TEST
+#undef KERNEL
+}
+
+#pragma GCC pop_options
+
+// Whether this CPU runs the kernels of add_sse41_ops()
+inline bool has_sse41() { return __builtin_cpu_supports("sse4.1"); }
+#else
+inline bool has_sse41() { return false; }
+#endif
+
+}  // namespace Simd
+
+// The SIMD implementations for this host, picked once by CPUID on x86. WASM
+// SIMD is fixed at 128 bits, so SSE4.1 covers it and wider AVX2 registers
+// would not help a single instruction.
+inline const SimdOps& simd_ops() {
+    static const SimdOps ops = [] {
+        SimdOps o = Simd::make_scalar_ops();
+#ifdef WASM_SIMD_SSE41
+        if (Simd::has_sse41()) {
+            Simd::add_sse41_ops(o);
+        }
+#endif
+        return o;
+    }();
+    return ops;
+}
+
+#endif  // LFORTRAN_WASM_SIMD_H
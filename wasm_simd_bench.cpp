@@ -0,0 +1,133 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "wasm_simd.h"
+
+static const size_t NUM_VECTORS = 64;  // a power of two
+
+// Calls one kernel through its table entry, as the interpreter does, on a
+// rotating set of operands. Returns the best time per call in nanoseconds.
+template <typename Call>
+static double time_kernel(Call call, std::vector<uint8_t>& vectors, int runs, int calls) {
+    double best = 1e300;
+    for (int run = 0; run < runs; run++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; i++) {
+            uint8_t* a = &vectors[16 * ((size_t)i % NUM_VECTORS)];
+            call(a, &vectors[16 * ((size_t)(i + 1) % NUM_VECTORS)], &vectors[16 * ((size_t)(i + 2) % NUM_VECTORS)]);
+        }
+        std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+        best = std::min(best, took.count() / calls);
+    }
+    return best;
+}
+
+// Times every kernel of the scalar table and of the SSE4.1 table of
+// wasm_simd.h and prints both with their ratio, by kernel kind and 0xFD
+// opcode number. Every kernel starts from the same operands, so one that
+// drifts them towards denormals or NaNs does not slow down the next.
+int main(int argc, char** argv) {
+    int runs = 5;
+    int calls = 1 << 20;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--runs=", 0) == 0) {
+            runs = std::stoi(arg.substr(7));
+        } else if (arg.rfind("--calls=", 0) == 0) {
+            calls = std::stoi(arg.substr(8));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--runs=N] [--calls=N]" << std::endl;
+            return 1;
+        }
+    }
+#ifndef WASM_SIMD_SSE41
+    std::cerr << "only the scalar kernels are built for this CPU" << std::endl;
+    return 1;
+#else
+    if (!Simd::has_sse41()) {
+        std::cerr << "this CPU has no SSE4.1" << std::endl;
+        return 1;
+    }
+    SimdOps scalar = Simd::make_scalar_ops();
+    SimdOps sse = Simd::make_scalar_ops();
+    Simd::add_sse41_ops(sse);
+
+    // random bytes, f32 lanes and f64 lanes in turn; the floats lie in
+    // [1, 17) so that no kernel takes a slow path on special values
+    std::vector<uint8_t> pristine(NUM_VECTORS * 16);
+    uint32_t seed = 12345;
+    for (size_t v = 0; v < NUM_VECTORS; v++) {
+        for (size_t i = 0; i < 16; i += 8) {
+            seed = seed * 1103515245 + 12345;
+            double x = 1.0 + (seed >> 8) / (double)(1 << 20);
+            float lanes[2] = {(float)x, (float)(x + 0.5)};
+            uint64_t bits = (uint64_t)seed * 0x9E3779B97F4A7C15ULL;
+            if (v % 3 == 1) std::memcpy(&bits, lanes, 8);
+            if (v % 3 == 2) std::memcpy(&bits, &x, 8);
+            std::memcpy(&pristine[16 * v + i], &bits, 8);
+        }
+    }
+    std::vector<uint8_t> vectors;
+
+    struct Row {
+        const char* kind;
+        int num;
+        double scalar, sse;
+    };
+    std::vector<Row> rows;
+    auto measure = [&](const char* kind, int num, auto scalar_call, auto sse_call) {
+        vectors = pristine;
+        double s = time_kernel(scalar_call, vectors, runs, calls);
+        vectors = pristine;
+        double v = time_kernel(sse_call, vectors, runs, calls);
+        rows.push_back({kind, num, s, v});
+    };
+    for (int num = 0; num < 256; num++) {
+        if (sse.unary[num] && sse.unary[num] != scalar.unary[num]) {
+            V128Unary f = scalar.unary[num], g = sse.unary[num];
+            measure("unary", num, [f](uint8_t* a, uint8_t*, uint8_t*) { f(a); },
+                    [g](uint8_t* a, uint8_t*, uint8_t*) { g(a); });
+        }
+        if (sse.binary[num] && sse.binary[num] != scalar.binary[num]) {
+            V128Binary f = scalar.binary[num], g = sse.binary[num];
+            measure("binary", num, [f](uint8_t* a, uint8_t* b, uint8_t*) { f(a, b); },
+                    [g](uint8_t* a, uint8_t* b, uint8_t*) { g(a, b); });
+        }
+        if (sse.ternary[num] && sse.ternary[num] != scalar.ternary[num]) {
+            V128Ternary f = scalar.ternary[num], g = sse.ternary[num];
+            measure("ternary", num, [f](uint8_t* a, uint8_t* b, uint8_t* c) { f(a, b, c); },
+                    [g](uint8_t* a, uint8_t* b, uint8_t* c) { g(a, b, c); });
+        }
+        if (sse.test[num] && sse.test[num] != scalar.test[num]) {
+            V128Test f = scalar.test[num], g = sse.test[num];
+            measure("test", num, [f](uint8_t* a, uint8_t*, uint8_t*) { a[0] ^= (uint8_t)f(a); },
+                    [g](uint8_t* a, uint8_t*, uint8_t*) { a[0] ^= (uint8_t)g(a); });
+        }
+        if (sse.shift[num] && sse.shift[num] != scalar.shift[num]) {
+            V128Shift f = scalar.shift[num], g = sse.shift[num];
+            measure("shift", num, [f](uint8_t* a, uint8_t* b, uint8_t*) { f(a, b[0] & 7); },
+                    [g](uint8_t* a, uint8_t* b, uint8_t*) { g(a, b[0] & 7); });
+        }
+    }
+
+    double log_sum = 0;
+    std::cout << "kernel   num  scalar ns  sse4.1 ns  speedup" << std::endl;
+    for (const Row& r : rows) {
+        char line[80];
+        std::snprintf(line, sizeof(line), "%-7s %4d %10.2f %10.2f %8.2f", r.kind, r.num, r.scalar, r.sse,
+                      r.scalar / r.sse);
+        std::cout << line << std::endl;
+        log_sum += std::log(r.scalar / r.sse);
+    }
+    if (!rows.empty()) {
+        std::cout << "geometric mean speedup over " << rows.size()
+                  << " kernels: " << std::exp(log_sum / rows.size()) << std::endl;
+    }
+    return 0;
+#endif
+}
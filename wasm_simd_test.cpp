@@ -0,0 +1,161 @@
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "wasm_simd.h"
+
+// One line of simd_cases.txt: a kernel, the indices of its operands and the
+// result node's WebAssembly gave
+struct SimdCase {
+    std::string kernel;
+    int num;
+    std::string name;
+    std::string lanes;
+    int a, b, c, k;
+    uint8_t expected[16];
+};
+
+static bool parse_hex(const std::string& hex, uint8_t* out) {
+    if (hex.size() != 32) {
+        return false;
+    }
+    for (int i = 0; i < 16; i++) {
+        out[i] = (uint8_t)std::stoul(hex.substr(2 * i, 2), nullptr, 16);
+    }
+    return true;
+}
+
+// Float lanes match when both are NaN, whatever their bits; WASM leaves
+// those to the engine
+template <typename F>
+static bool same_lanes(const uint8_t* x, const uint8_t* y) {
+    for (size_t i = 0; i < 16; i += sizeof(F)) {
+        F a, b;
+        std::memcpy(&a, x + i, sizeof(F));
+        std::memcpy(&b, y + i, sizeof(F));
+        if (std::memcmp(&a, &b, sizeof(F)) != 0 && !(std::isnan(a) && std::isnan(b))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool same(const std::string& lanes, const uint8_t* x, const uint8_t* y) {
+    if (lanes == "f32") return same_lanes<float>(x, y);
+    if (lanes == "f64") return same_lanes<double>(x, y);
+    return std::memcmp(x, y, 16) == 0;
+}
+
+static std::string hex(const uint8_t* p) {
+    static const char* digits = "0123456789abcdef";
+    std::string s;
+    for (int i = 0; i < 16; i++) {
+        s += digits[p[i] >> 4];
+        s += digits[p[i] & 15];
+    }
+    return s;
+}
+
+// Runs every case on `ops` and prints the ones that differ. Returns the
+// number of failed cases.
+static int check(const char* table, const SimdOps& ops, const std::vector<SimdCase>& cases,
+                 const std::vector<std::vector<uint8_t>>& vectors, const std::vector<int32_t>& shifts) {
+    int failed = 0;
+    for (const SimdCase& t : cases) {
+        alignas(16) uint8_t r[16];
+        std::memcpy(r, vectors[t.a].data(), 16);
+        const uint8_t* b = vectors[t.b].data();
+        const uint8_t* c = vectors[t.c].data();
+        bool missing = false;
+        if (t.kernel == "unary") {
+            if (!(missing = !ops.unary[t.num])) ops.unary[t.num](r);
+        } else if (t.kernel == "binary") {
+            if (!(missing = !ops.binary[t.num])) ops.binary[t.num](r, b);
+        } else if (t.kernel == "ternary") {
+            if (!(missing = !ops.ternary[t.num])) ops.ternary[t.num](r, b, c);
+        } else if (t.kernel == "test") {
+            if (!(missing = !ops.test[t.num])) {
+                int32_t x = ops.test[t.num](r);
+                std::memset(r, 0, 16);
+                std::memcpy(r, &x, 4);
+            }
+        } else if (t.kernel == "shift") {
+            if (!(missing = !ops.shift[t.num])) ops.shift[t.num](r, (uint32_t)shifts[t.k]);
+        } else {
+            missing = true;
+        }
+        if (missing) {
+            std::cout << table << ": no " << t.kernel << " kernel for " << t.name << std::endl;
+            failed++;
+        } else if (!same(t.lanes, r, t.expected)) {
+            std::cout << table << ": " << t.name << " (" << t.a << ", " << t.b << ", " << t.c << ", " << t.k
+                      << ") gives " << hex(r) << ", expected " << hex(t.expected) << std::endl;
+            failed++;
+        }
+    }
+    std::cout << table << ": " << cases.size() - failed << " of " << cases.size() << " cases pass" << std::endl;
+    return failed;
+}
+
+// Checks the scalar kernels of wasm_simd.h and, on a CPU with SSE4.1, the
+// SSE4.1 ones against the cases of simd_cases.py
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : "simd_cases.txt";
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "cannot read " << path << std::endl;
+        return 1;
+    }
+    std::vector<std::vector<uint8_t>> vectors;
+    std::vector<int32_t> shifts;
+    std::vector<SimdCase> cases;
+    std::string line;
+    int line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream s(line);
+        std::string tag, expected;
+        s >> tag;
+        bool ok;
+        if (tag == "v") {
+            std::vector<uint8_t> v(16);
+            ok = (bool)(s >> expected) && parse_hex(expected, v.data());
+            vectors.push_back(v);
+        } else if (tag == "s") {
+            int32_t shift;
+            ok = (bool)(s >> shift);
+            shifts.push_back(shift);
+        } else {
+            SimdCase t;
+            t.kernel = tag;
+            ok = (bool)(s >> t.num >> t.name >> t.lanes >> t.a >> t.b >> t.c >> t.k >> expected) &&
+                 parse_hex(expected, t.expected) && t.num >= 0 && t.num < 256 && t.a >= 0 &&
+                 (size_t)t.a < vectors.size() && t.b >= 0 && (size_t)t.b < vectors.size() && t.c >= 0 &&
+                 (size_t)t.c < vectors.size() && t.k >= 0 && (size_t)t.k < shifts.size();
+            cases.push_back(t);
+        }
+        if (!ok) {
+            std::cerr << path << ":" << line_no << ": malformed line" << std::endl;
+            return 1;
+        }
+    }
+
+    int failed = check("scalar", Simd::make_scalar_ops(), cases, vectors, shifts);
+#ifdef WASM_SIMD_SSE41
+    if (Simd::has_sse41()) {
+        SimdOps sse = Simd::make_scalar_ops();
+        Simd::add_sse41_ops(sse);
+        failed += check("sse4.1", sse, cases, vectors, shifts);
+    } else {
+        std::cout << "sse4.1: not supported by this CPU" << std::endl;
+    }
+#endif
+    return failed ? 1 : 0;
+}
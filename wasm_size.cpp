@@ -0,0 +1,44 @@
+#include <iostream>
+#include <string>
+
+#include "wasm_decoder.h"
+#include "wasm_size.h"
+
+using namespace LFortran;
+
+// Reports where the bytes of a module go, as text or as JSON
+int main(int argc, char** argv) {
+    bool json = false;
+    size_t top = 20;
+    int argi = 1;
+    for (; argi < argc && std::string(argv[argi]).rfind("--", 0) == 0; argi++) {
+        std::string arg = argv[argi];
+        if (arg == "--json") {
+            json = true;
+        } else if (arg.rfind("--top=", 0) == 0) {
+            top = std::stoul(arg.substr(6));
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (argc - argi != 1) {
+        std::cerr << "Usage: " << argv[0] << " [--json] [--top=N] in.wasm" << std::endl;
+        return 1;
+    }
+    SizeReport report;
+    try {
+        load_file(argv[argi]);
+        decode_wasm();
+        report = attribute_sizes();
+    } catch (const std::string& e) {
+        std::cerr << e << std::endl;
+        return 1;
+    }
+    if (json) {
+        print_size_json(report, std::cout);
+    } else {
+        print_size_report(report, std::cout, top);
+    }
+    return 0;
+}
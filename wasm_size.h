@@ -0,0 +1,243 @@
+#ifndef LFORTRAN_WASM_SIZE_H
+#define LFORTRAN_WASM_SIZE_H
+
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+#include "wasm_decoder.h"
+
+namespace LFortran {
+
+// Where the bytes of the decoded module go. Every byte is counted once: in
+// the body of a function, in the locals declaration of one, in the name of an
+// export, in the padding of a length longer than its value needs (the
+// placeholders of `emit_len_placeholder` take 4 bytes whatever they hold),
+// or else in the section it is part of, with the section's id and length.
+struct SizeReport {
+    struct Item {
+        std::string name;
+        uint64_t bytes;
+        uint64_t locals;  // of a function, its declaration
+    };
+
+    uint64_t total = 0;
+    uint64_t header = 0;        // magic number and version
+    uint64_t padding = 0;       // of the lengths of the sections and bodies
+    uint64_t bodies = 0;        // the instructions and lengths of all functions
+    uint64_t locals = 0;        // the declarations of all functions
+    uint64_t export_names = 0;  // with their lengths
+    std::vector<Item> sections;   // what the rest of each comes to
+    std::vector<Item> functions;  // the defined ones in order
+    std::vector<Item> exports;
+};
+
+// Attributes the bytes of the decoded module in one pass over its sections,
+// so a module costs no more than reading it once
+class SizeAttributor {
+   public:
+    SizeReport run() {
+        report = {};
+        report.total = wasm_bytes.size();
+        report.header = std::min<uint64_t>(8, wasm_bytes.size());
+        name_functions();
+        uint32_t offset = 8U;
+        while (offset < wasm_bytes.size()) {
+            uint32_t start = offset;
+            uint32_t id = read_unsigned_num(offset);
+            uint64_t padding = report.padding;
+            uint32_t size = padded_length(offset);
+            uint32_t contents = offset;
+            uint64_t elsewhere = report.padding - padding;  // bytes reported as something else
+            std::string name = id < NUM_SECTIONS ? SECTION_NAMES[id] : "unknown";
+            if (id == 0U) {
+                name += " " + decode_name(offset);
+            } else if (id == 7U) {
+                elsewhere += attribute_exports(offset);
+            } else if (id == 10U) {
+                elsewhere += attribute_bodies(offset);
+            }
+            offset = contents + size;
+            report.sections.push_back({name, offset - start - elsewhere, 0});
+        }
+        return report;
+    }
+
+   private:
+    static constexpr uint32_t NUM_SECTIONS = 13;
+    static constexpr const char* SECTION_NAMES[NUM_SECTIONS] = {
+        "custom", "type",   "import", "function", "table", "memory",   "global",
+        "export", "start", "element", "code",    "data",  "datacount"};
+
+    SizeReport report;
+    std::vector<std::string> names;  // of the defined functions
+
+    static uint32_t leb_length(uint64_t value) {
+        uint32_t n = 1;
+        while (value >= 0x80) {
+            value >>= 7;
+            n++;
+        }
+        return n;
+    }
+
+    // Reads a length and counts the bytes it takes beyond what it needs
+    uint32_t padded_length(uint32_t& offset) {
+        uint32_t start = offset;
+        uint32_t length = read_unsigned_num(offset);
+        report.padding += offset - start - leb_length(length);
+        return length;
+    }
+
+    // As function_name, without looking through the exports per function
+    void name_functions() {
+        uint32_t num_imported = num_imported_funcs();
+        names.assign(codes.size(), "");
+        for (const Export& e : exports) {
+            if (e.kind == 0x00 && e.index >= num_imported && e.index - num_imported < codes.size() &&
+                names[e.index - num_imported].empty()) {
+                names[e.index - num_imported] = e.name;
+            }
+        }
+        for (uint32_t i = 0; i < codes.size(); i++) {
+            if (names[i].empty()) {
+                names[i] = "$" + std::to_string(num_imported + i);
+            }
+        }
+    }
+
+    uint64_t attribute_exports(uint32_t& offset) {
+        uint32_t n = read_unsigned_num(offset);
+        uint64_t bytes = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t start = offset;
+            std::string name = decode_name(offset);
+            report.exports.push_back({name, offset - start, 0});
+            bytes += offset - start;
+            read_byte(offset);
+            read_unsigned_num(offset);
+        }
+        report.export_names += bytes;
+        return bytes;
+    }
+
+    uint64_t attribute_bodies(uint32_t& offset) {
+        uint32_t n = read_unsigned_num(offset);
+        uint64_t bytes = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t start = offset;
+            uint64_t padding = report.padding;
+            uint32_t size = padded_length(offset);
+            uint32_t body = offset;
+            uint32_t runs = read_unsigned_num(offset);
+            for (uint32_t k = 0; k < runs; k++) {
+                read_unsigned_num(offset);
+                read_byte(offset);
+            }
+            uint64_t locals = offset - body;
+            uint64_t insts = body + size - start - (report.padding - padding) - locals;
+            report.functions.push_back({i < names.size() ? names[i] : "$?", insts, locals});
+            report.bodies += insts;
+            report.locals += locals;
+            bytes += body + size - start;
+            offset = body + size;
+        }
+        return bytes;
+    }
+};
+
+SizeReport attribute_sizes() {
+    SizeAttributor a;
+    return a.run();
+}
+
+// The items sorted by size, largest first
+std::vector<SizeReport::Item> largest(std::vector<SizeReport::Item> items) {
+    std::stable_sort(items.begin(), items.end(),
+                     [](const SizeReport::Item& a, const SizeReport::Item& b) { return a.bytes > b.bytes; });
+    return items;
+}
+
+std::string size_line(uint64_t bytes, uint64_t total) {
+    char s[40];
+    snprintf(s, sizeof(s), "%12llu %5.1f%% ", (unsigned long long)bytes, 100.0 * bytes / std::max<uint64_t>(total, 1));
+    return s;
+}
+
+// The report as text, every list largest first and cut after `top` items
+void print_size_report(const SizeReport& r, std::ostream& out, size_t top) {
+    out << r.total << " bytes\n\nby kind\n";
+    uint64_t in_sections = 0;
+    for (const SizeReport::Item& s : r.sections) {
+        in_sections += s.bytes;
+    }
+    std::vector<SizeReport::Item> kinds = {{"function bodies", r.bodies, 0},
+                                           {"locals declarations", r.locals, 0},
+                                           {"export names", r.export_names, 0},
+                                           {"padded lengths", r.padding, 0},
+                                           {"header", r.header, 0},
+                                           {"rest of the sections", in_sections, 0}};
+    for (const SizeReport::Item& k : largest(kinds)) {
+        out << size_line(k.bytes, r.total) << k.name << "\n";
+    }
+    out << "\nrest of the sections\n";
+    for (const SizeReport::Item& s : largest(r.sections)) {
+        out << size_line(s.bytes, r.total) << s.name << "\n";
+    }
+    auto list = [&](const char* title, const std::vector<SizeReport::Item>& items, bool locals) {
+        out << "\n" << title << ", " << std::min(top, items.size()) << " of " << items.size() << "\n";
+        std::vector<SizeReport::Item> sorted = largest(items);
+        for (size_t i = 0; i < sorted.size() && i < top; i++) {
+            out << size_line(sorted[i].bytes, r.total) << sorted[i].name;
+            if (locals && sorted[i].locals > 0) {
+                out << " (+" << sorted[i].locals << " locals)";
+            }
+            out << "\n";
+        }
+    };
+    list("functions", r.functions, true);
+    list("export names", r.exports, false);
+}
+
+std::string json_string(const std::string& s) {
+    std::string result = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if ((unsigned char)c < 0x20) {
+            char e[8];
+            snprintf(e, sizeof(e), "\\u%04x", c);
+            result += e;
+        } else {
+            result += c;
+        }
+    }
+    return result + "\"";
+}
+
+// The whole report as JSON, every list largest first
+void print_size_json(const SizeReport& r, std::ostream& out) {
+    out << "{\"total\": " << r.total << ", \"header\": " << r.header << ", \"padding\": " << r.padding
+        << ", \"bodies\": " << r.bodies << ", \"locals\": " << r.locals << ", \"export_names\": " << r.export_names;
+    auto list = [&](const char* key, const std::vector<SizeReport::Item>& items, bool locals) {
+        out << ",\n \"" << key << "\": [";
+        const char* sep = "\n  ";
+        for (const SizeReport::Item& i : largest(items)) {
+            out << sep << "{\"name\": " << json_string(i.name) << ", \"bytes\": " << i.bytes;
+            if (locals) {
+                out << ", \"locals\": " << i.locals;
+            }
+            out << "}";
+            sep = ",\n  ";
+        }
+        out << "]";
+    };
+    list("sections", r.sections, false);
+    list("functions", r.functions, true);
+    list("exports", r.exports, false);
+    out << "}\n";
+}
+
+}  // namespace LFortran
+
+#endif  // LFORTRAN_WASM_SIZE_H
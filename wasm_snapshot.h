@@ -0,0 +1,150 @@
+#ifndef LFORTRAN_WASM_SNAPSHOT_H
+#define LFORTRAN_WASM_SNAPSHOT_H
+
+#include <atomic>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "wasm_memory.h"
+
+// The state of an initialized instance in a file or memfd:
+//
+//     header | instance state | padding | linear memory
+//
+// The instance state (globals, tables, dropped segments) is small and read
+// into memory. The linear memory starts at a multiple of the WASM page size,
+// which is a multiple of the system page size, so instances map it
+// copy-on-write instead of reading it.
+class InstanceSnapshot {
+   public:
+    static const uint32_t VERSION = 2;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t has_memory;
+        uint64_t module_hash;  // hash_bytes() of the module it was taken from
+        uint64_t state_size;
+        uint64_t memory_offset;
+        uint32_t memory_pages;
+        uint32_t reserved;
+    };
+
+    Header header;
+    std::vector<uint8_t> state;
+    int fd;
+    uint64_t id;  // unique in this process, tells which snapshot a memory maps
+
+    InstanceSnapshot(const InstanceSnapshot&) = delete;
+    InstanceSnapshot& operator=(const InstanceSnapshot&) = delete;
+
+    InstanceSnapshot(InstanceSnapshot&& other)
+        : header(other.header), state(std::move(other.state)), fd(other.fd), id(other.id) {
+        other.fd = -1;
+    }
+
+    ~InstanceSnapshot() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    // Writes a snapshot to `fd`, or to a new memfd if `fd` is -1. The
+    // snapshot keeps its own descriptor, the caller's one stays open.
+    static InstanceSnapshot write(const std::vector<uint8_t>& state, const LinearMemory* memory, int fd = -1) {
+        fd = fd < 0 ? memfd_create("wasm-snapshot", MFD_CLOEXEC) : dup(fd);
+        if (fd < 0) {
+            throw LFortran::LFortranException("InstanceSnapshot: cannot open snapshot file");
+        }
+        InstanceSnapshot s(fd);
+        std::memcpy(s.header.magic, "WASMSNAP", 8);
+        s.header.version = VERSION;
+        s.header.has_memory = memory != nullptr;
+        s.header.module_hash = hash_bytes(wasm_bytes.data(), wasm_bytes.size());
+        s.header.state_size = state.size();
+        uint64_t end = sizeof(Header) + state.size();
+        s.header.memory_offset = (end + LinearMemory::PAGE_SIZE - 1) / LinearMemory::PAGE_SIZE * LinearMemory::PAGE_SIZE;
+        s.header.memory_pages = memory ? memory->pages : 0;
+        s.header.reserved = 0;
+        s.state = state;
+        if (ftruncate(fd, s.header.memory_offset + (memory ? memory->size() : 0)) != 0) {
+            throw LFortran::LFortranException("InstanceSnapshot: cannot write snapshot");
+        }
+        s.write_at(0, &s.header, sizeof(Header));
+        s.write_at(sizeof(Header), state.data(), state.size());
+        for (uint32_t i = 0; i < s.header.memory_pages; i++) {
+            // pages that are still zero stay holes in the file
+            const uint8_t* page = memory->base + (uint64_t)i * LinearMemory::PAGE_SIZE;
+            if (!all_zero(page, LinearMemory::PAGE_SIZE)) {
+                s.write_at(s.header.memory_offset + (uint64_t)i * LinearMemory::PAGE_SIZE, page, LinearMemory::PAGE_SIZE);
+            }
+        }
+        return s;
+    }
+
+    // Reads a snapshot taken of the module currently decoded into the globals
+    // of wasm_utils.h.
+    static InstanceSnapshot read(int fd) {
+        fd = dup(fd);
+        if (fd < 0) {
+            throw LFortran::LFortranException("InstanceSnapshot: cannot open snapshot file");
+        }
+        InstanceSnapshot s(fd);
+        s.read_at(0, &s.header, sizeof(Header));
+        if (std::memcmp(s.header.magic, "WASMSNAP", 8) != 0 || s.header.version != VERSION) {
+            throw LFortran::LFortranException("InstanceSnapshot: not a snapshot of this version");
+        }
+        if (s.header.module_hash != hash_bytes(wasm_bytes.data(), wasm_bytes.size())) {
+            throw LFortran::LFortranException("InstanceSnapshot: snapshot of a different module");
+        }
+        s.state.resize(s.header.state_size);
+        s.read_at(sizeof(Header), s.state.data(), s.state.size());
+        return s;
+    }
+
+   private:
+    explicit InstanceSnapshot(int fd) : header(), fd(fd), id(next_id()) {}
+
+    static uint64_t next_id() {
+        static std::atomic<uint64_t> counter(0);
+        return ++counter;
+    }
+
+    static bool all_zero(const uint8_t* p, size_t size) {
+        for (size_t i = 0; i < size; i += sizeof(uint64_t)) {
+            uint64_t x;
+            std::memcpy(&x, p + i, sizeof(uint64_t));
+            if (x) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void write_at(uint64_t offset, const void* data, uint64_t size) {
+        const uint8_t* p = (const uint8_t*)data;
+        while (size > 0) {
+            ssize_t n = pwrite(fd, p, size, offset);
+            if (n <= 0) {
+                throw LFortran::LFortranException("InstanceSnapshot: cannot write snapshot");
+            }
+            p += n;
+            offset += n;
+            size -= n;
+        }
+    }
+
+    void read_at(uint64_t offset, void* data, uint64_t size) {
+        uint8_t* p = (uint8_t*)data;
+        while (size > 0) {
+            ssize_t n = pread(fd, p, size, offset);
+            if (n <= 0) {
+                throw LFortran::LFortranException("InstanceSnapshot: truncated snapshot");
+            }
+            p += n;
+            offset += n;
+            size -= n;
+        }
+    }
+};
+
+#endif  // LFORTRAN_WASM_SNAPSHOT_H
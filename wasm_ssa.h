@@ -0,0 +1,2102 @@
+#ifndef LFORTRAN_WASM_SSA_H
+#define LFORTRAN_WASM_SSA_H
+
+#include <algorithm>
+#include <chrono>
+#include "wasm_optimizer.h"
+
+namespace LFortran {
+
+// A function body in SSA form: basic blocks of typed values, where a local
+// no longer exists and every value is defined once, and phis merge the
+// values that reach a block along its predecessors.
+//
+// Everything lives in flat arrays indexed by uint32_t, the values, the
+// operands of all of them, the bodies of all blocks and so on, so a function
+// costs a handful of allocations however large it is, and the arrays of one
+// SsaFunction are reused for the next function lifted into it.
+//
+// The nesting of the original `block`, `loop` and `if` is kept in `nodes`,
+// which is how the function is lowered back without rebuilding structured
+// control flow from the graph.
+struct SsaFunction {
+    static constexpr uint32_t NONE = ~0U;
+
+    // Values that are no instruction, numbered after the prefixed ones
+    static constexpr uint16_t PHI = 0x300;
+    static constexpr uint16_t PARAM = 0x301;   // `start` is its index
+    static constexpr uint16_t ZERO = 0x302;    // what a declared local starts with
+    static constexpr uint16_t RESULT = 0x303;  // result `start` of the call that is its operand
+    static constexpr uint16_t FORWARD = 0x304;  // a phi that turned out to be the value `start`
+
+    static constexpr uint8_t NO_TYPE = 0x40;  // only an effect
+    static constexpr uint8_t MULTI = 0x00;    // a call with more than one result
+
+    struct Value {
+        uint16_t op;     // the opcode, OP_FC_PREFIX + n for 0xFC n, OP_FD_PREFIX + n for 0xFD n
+        uint8_t type;    // of the result
+        uint8_t size;    // of the instruction in bytes
+        uint32_t start;  // of the instruction in wasm_bytes
+        uint32_t block;
+        uint32_t first_operand;  // into `operands`, the values it pops in order
+        uint32_t num_operands;
+    };
+
+    // How a block ends, and what its successors are:
+    // FALLTHROUGH [next], BR [target], BR_IF [target, next],
+    // BR_TABLE [targets..., default], IF [then, else or join]
+    enum Exit { FALLTHROUGH, BR, BR_IF, BR_TABLE, IF, RETURN, UNREACHABLE };
+
+    struct Block {
+        uint32_t first_value, num_values;  // into `body`, in program order
+        uint32_t first_phi, num_phis;      // into `phis`
+        uint32_t first_pred, num_preds;    // into `preds`
+        uint32_t first_succ, num_succs;    // into `succs`, NONE for the function's own label
+        // into `operands`: the results of a return, or carried by the branches
+        // to the function's own label
+        uint32_t first_operand, num_operands;
+        uint32_t cond;  // of br_if, br_table and if
+        Exit exit;
+    };
+
+    enum NodeKind { BODY, BLOCK, LOOP, IF_, ELSE, END };
+
+    // BODY: the block. BLOCK and IF_: the block after their `end`. LOOP: the
+    // header. END: the block its `end` continues in, NONE if nothing does.
+    struct Node {
+        NodeKind kind;
+        uint32_t block;
+    };
+
+    std::vector<Value> values;
+    std::vector<uint32_t> operands;
+    std::vector<Block> blocks;  // the entry first
+    std::vector<uint32_t> body;
+    std::vector<uint32_t> phis;
+    std::vector<uint32_t> preds;
+    std::vector<uint32_t> succs;
+    std::vector<Node> nodes;
+    std::vector<uint8_t> param_types;
+
+    void clear() {
+        values.clear();
+        operands.clear();
+        blocks.clear();
+        body.clear();
+        phis.clear();
+        preds.clear();
+        succs.clear();
+        nodes.clear();
+        param_types.clear();
+    }
+
+    const uint32_t* operands_of(const Value& v) const { return operands.data() + v.first_operand; }
+};
+
+// What an instruction whose signature does not depend on its immediates or
+// the module pops, and the type of what it pushes; false for control flow,
+// the variable instructions, calls and the other instructions that need
+// their immediates
+static bool fixed_signature(uint32_t op, uint8_t& pops, uint8_t& type) {
+    const uint8_t i32 = 0x7F, i64 = 0x7E, f32 = 0x7D, f64 = 0x7C, v128 = 0x7B;
+    type = SsaFunction::NO_TYPE;
+    if (op >= OP_FD_PREFIX) {
+        uint32_t n = op - OP_FD_PREFIX;
+        type = v128;
+        if (n <= 10 || n == 92 || n == 93 || (n >= 15 && n <= 20) || n == 77 || n == 94 || n == 95) {
+            pops = 1;  // loads, splats and unary
+        } else if (n == 11 || (n >= 88 && n <= 91)) {
+            pops = 2;  // stores
+            type = SsaFunction::NO_TYPE;
+        } else if (n == 12) {
+            pops = 0;
+        } else if (n >= 21 && n <= 34) {  // lanes
+            static const uint8_t extracted[14] = {i32, i32, 0, i32, i32, 0, i32, 0, i64, 0, f32, 0, f64, 0};
+            type = extracted[n - 21] ? extracted[n - 21] : v128;
+            pops = extracted[n - 21] ? 1 : 2;
+        } else if (n == 82) {
+            pops = 3;  // bitselect
+        } else if (n == 83 || n == 99 || n == 100 || n == 131 || n == 132 || n == 163 || n == 164 || n == 195 ||
+                   n == 196) {
+            pops = 1;  // any_true, all_true and bitmask
+            type = i32;
+        } else if (n == 96 || n == 97 || n == 98 || (n >= 103 && n <= 106) || n == 116 || n == 117 || n == 122 ||
+                   (n >= 124 && n <= 129) || (n >= 135 && n <= 138) || n == 148 || n == 160 || n == 161 ||
+                   (n >= 167 && n <= 170) || n == 192 || n == 193 || (n >= 199 && n <= 202) || n == 224 ||
+                   n == 225 || n == 227 || n == 236 || n == 237 || n == 239 || n >= 248) {
+            pops = 1;  // unary
+        } else {
+            pops = 2;  // binary, comparisons, shifts, shuffle and the lane loads
+        }
+        return true;
+    }
+    if (op >= OP_FC_PREFIX) {
+        static const uint8_t fc_pops[18] = {1, 1, 1, 1, 1, 1, 1, 1, 3, 0, 3, 3, 3, 0, 3, 2, 0, 3};
+        uint32_t n = op - OP_FC_PREFIX;
+        pops = fc_pops[n];
+        if (n <= 3 || n == 15 || n == 16) {
+            type = i32;
+        } else if (n <= 7) {
+            type = i64;
+        }
+        return true;
+    }
+    if (op >= 0x28 && op <= 0x35) {
+        static const uint8_t loaded[14] = {i32, i64, f32, f64, i32, i32, i32, i32, i64, i64, i64, i64, i64, i64};
+        pops = 1;
+        type = loaded[op - 0x28];
+        return true;
+    }
+    if (op >= 0x36 && op <= 0x3E) {
+        pops = 2;
+        return true;
+    }
+    if (op >= 0x45 && op <= 0xC4) {
+        // by runs of the same signature: the first opcode of the run, what it
+        // pops and what it pushes
+        static const uint8_t runs[][3] = {
+            {0x45, 1, i32}, {0x46, 2, i32}, {0x50, 1, i32}, {0x51, 2, i32}, {0x67, 1, i32}, {0x6A, 2, i32},
+            {0x79, 1, i64}, {0x7C, 2, i64}, {0x8B, 1, f32}, {0x92, 2, f32}, {0x99, 1, f64}, {0xA0, 2, f64},
+            {0xA7, 1, i32}, {0xAC, 1, i64}, {0xB2, 1, f32}, {0xB7, 1, f64}, {0xBC, 1, i32}, {0xBD, 1, i64},
+            {0xBE, 1, f32}, {0xBF, 1, f64}, {0xC0, 1, i32}, {0xC2, 1, i64}};
+        size_t k = sizeof(runs) / sizeof(runs[0]);
+        while (runs[k - 1][0] > op) {
+            k--;
+        }
+        pops = runs[k - 1][1];
+        type = runs[k - 1][2];
+        return true;
+    }
+    switch (op) {
+        case 0x3F: pops = 0; type = i32; return true;  // memory.size
+        case 0x40: pops = 1; type = i32; return true;  // memory.grow
+        case 0x41: pops = 0; type = i32; return true;
+        case 0x42: pops = 0; type = i64; return true;
+        case 0x43: pops = 0; type = f32; return true;
+        case 0x44: pops = 0; type = f64; return true;
+        case 0xD1: pops = 1; type = i32; return true;   // ref.is_null
+        case 0xD2: pops = 0; type = 0x70; return true;  // ref.func
+        default: return false;
+    }
+}
+
+// Lifts function bodies from the stack form into an SsaFunction.
+//
+// Structured control flow lets the locals become values without looking
+// them up block by block: the value of every local on the path being lifted
+// is kept in a flat array, and a log of the writes restores it at an `else`
+// and at an `end`. A branch records the locals written since its label was
+// opened, and a join merges those, placing a phi where the branches
+// disagree. A loop header gets the phi of a local when the local is first
+// read in the loop before being written there, as in Braun et al., "Simple
+// and Efficient Construction of Static Single Assignment Form", and the phi
+// is completed at the loop's `end`. The values that branches carry to a
+// label are treated as locals of their own, one per position, so the results
+// of a block and the params of a loop get their phis the same way.
+//
+// Phis that merge a single value are forwarded to it and removed at the end.
+// Unreachable code is skipped.
+class SsaLifter : public WASM_INSTS_VISITOR::BaseWASMVisitor<SsaLifter> {
+   public:
+    typedef SsaFunction F;
+
+    SsaLifter() {
+        uint32_t offset, size;
+        if (find_section(2, offset, size)) {
+            uint32_t n = read_unsigned_num(offset);
+            for (uint32_t i = 0; i < n; i++) {
+                decode_name(offset);
+                decode_name(offset);
+                switch (read_byte(offset)) {
+                    case 0x00: read_unsigned_num(offset); break;
+                    case 0x01:
+                        table_types.push_back(read_byte(offset));
+                        decode_limits(offset);
+                        break;
+                    case 0x02: decode_limits(offset); break;
+                    case 0x03:
+                        global_types.push_back(read_byte(offset));
+                        read_byte(offset);
+                        break;
+                }
+            }
+        }
+        for (const Global& g : globals) {
+            global_types.push_back(g.type);
+        }
+        for (const Table& t : tables) {
+            table_types.push_back(t.type);
+        }
+        for (uint32_t op = 0; op < 0xFC; op++) {
+            fixed[op] = fixed_signature(op, fixed_pops[op], fixed_type[op]);
+        }
+    }
+
+    void lift(uint32_t code_index, SsaFunction& function) {
+        f = &function;
+        f->clear();
+        const FuncType& type = func_types[type_indices[code_index]];
+        f->param_types = type.param_types;
+        num_locals = type.param_types.size();
+        for (const Local& l : codes[code_index].locals) {
+            num_locals += l.count;
+        }
+        var_types.assign(num_locals, 0);
+        def.assign(num_locals, 0);
+        epoch.assign(num_locals, 0);
+        seen.assign(num_locals, 0);
+        slot.assign(num_locals, 0);
+        cached_loop.assign(num_locals, 0);
+        cached_phi.assign(num_locals, 0);
+        clock = 0;
+        serial = 0;
+        num_phis = 0;
+        phi_uses.clear();
+        phi_conds.clear();
+        log.clear();
+        edges.clear();
+        snapshots.clear();
+        header_phis.clear();
+        loops.clear();
+        stack.clear();
+        saved.clear();
+        frames.clear();
+        dead = false;
+        dead_depth = 0;
+        pending = F::NONE;
+
+        Frame func = {};
+        func.kind = 0x00;
+        func.results = type.result_types.data();
+        func.num_results = type.result_types.size();
+        func.target = F::NONE;
+        frames.push_back(func);
+        start_block(new_block(), F::NONE);
+        uint32_t v = 0;
+        for (; v < type.param_types.size(); v++) {
+            var_types[v] = type.param_types[v];
+            def[v] = add_value(F::PARAM, var_types[v], 0, v);
+        }
+        // a zero of its own for every local, so that lowering can give the
+        // phis of different locals their zero's local
+        for (const Local& l : codes[code_index].locals) {
+            for (uint32_t i = 0; i < l.count; i++, v++) {
+                var_types[v] = l.type;
+                def[v] = add_value(F::ZERO, l.type, 0, 0);
+            }
+        }
+        stack.clear();
+
+        uint32_t end = decode_instructions(codes[code_index].insts_start_index);
+        finish_value(end - 1);
+        if (!dead) {
+            exit_function(F::RETURN);
+        }
+        if (num_phis > 0) {
+            mark_used_phis();
+            remove_trivial_phis();
+            group_phis();
+        }
+    }
+
+    void begin_instruction(uint32_t offset) {
+        finish_value(offset);
+        start = offset;
+        uint8_t byte = wasm_bytes[offset];
+        skip = true;
+        if (dead) {
+            if (byte >= 0x02 && byte <= 0x04) {
+                dead_depth++;
+            } else if (byte == 0x0B && dead_depth > 0) {
+                dead_depth--;
+            } else if (byte == 0x05 || byte == 0x0B) {
+                skip = dead_depth > 0;
+            }
+            return;
+        }
+        if (byte < 0xFC) {
+            if (fixed[byte]) {
+                pending = add_value(byte, fixed_type[byte], fixed_pops[byte]);
+            } else {
+                skip = byte == 0x01;  // nop
+            }
+            return;
+        }
+        offset++;
+        uint32_t op = (byte == 0xFC ? OP_FC_PREFIX : OP_FD_PREFIX) + read_unsigned_num(offset);
+        uint8_t pops, type;
+        if (fixed_signature(op, pops, type)) {
+            pending = add_value(op, type, pops);
+        } else {
+            skip = false;
+        }
+    }
+
+#define X(name, op)                      \
+    template <class... Args>             \
+    void visit_##name(const Args&...) {}
+    WASM_THREADED_OPS(X)
+#undef X
+
+    void visit_Unreachable() {
+        if (!skip) {
+            end_block(F::UNREACHABLE);
+        }
+    }
+
+    void visit_Block(int64_t blocktype) {
+        if (skip) {
+            return;
+        }
+        // the body starts a block of its own, so that it is emitted inside
+        open(0x02, blocktype);
+        frames.back().target = new_block();
+        uint32_t inside = new_block();
+        end_block(F::FALLTHROUGH, F::NONE, {inside});
+        f->nodes.push_back({F::BLOCK, frames.back().target});
+        start_block(inside, cur);
+    }
+
+    void visit_Loop(int64_t blocktype) {
+        if (skip) {
+            return;
+        }
+        open(0x03, blocktype);
+        Frame& loop = frames.back();
+        loop.clock_mark = ++clock;
+        loop.target = new_block();
+        loop.entry = cur;
+        loop.first_header_phi = header_phis.size();
+        loop.first_inner_edge = edges.size();
+        loops.push_back(frames.size() - 1);
+        uint32_t header = loop.target;
+        end_block(F::FALLTHROUGH, F::NONE, {header});
+        f->nodes.push_back({F::LOOP, header});
+        start_block(header, F::NONE);
+        // the params become phis of the header
+        for (uint32_t k = 0; k < loop.num_params; k++) {
+            uint32_t phi = add_phi(header, loop.params[k]);
+            header_phis.push_back({temp(k), phi, stack[loop.height + k]});
+            stack[loop.height + k] = phi;
+        }
+    }
+
+    void visit_If(int64_t blocktype) {
+        if (skip) {
+            return;
+        }
+        uint32_t cond = pop();
+        open(0x04, blocktype);
+        Frame& frame = frames.back();
+        frame.target = new_block();
+        frame.if_block = cur;
+        frame.saved = saved.size();
+        saved.insert(saved.end(), stack.end() - frame.num_params, stack.end());
+        uint32_t then = new_block();
+        end_block(F::IF, cond, {then, F::NONE});
+        f->nodes.push_back({F::IF_, frame.target});
+        start_block(then, frame.if_block);
+    }
+
+    void visit_Else() {
+        if (skip) {
+            return;
+        }
+        Frame& frame = frames.back();
+        if (!dead) {
+            add_edge(frame);
+            end_block(F::FALLTHROUGH, F::NONE, {frame.target});
+        }
+        frame.has_else = true;
+        undo(frame.log_mark);
+        uint32_t branch = new_block();
+        F::Block& b = f->blocks[frame.if_block];
+        f->succs[b.first_succ + 1] = branch;
+        f->nodes.push_back({F::ELSE, branch});
+        stack.resize(frame.height);
+        stack.insert(stack.end(), saved.begin() + frame.saved, saved.begin() + frame.saved + frame.num_params);
+        start_block(branch, frame.if_block);
+    }
+
+    void visit_End() {
+        if (skip) {
+            return;
+        }
+        Frame& frame = frames.back();
+        if (frame.kind == 0x03) {
+            loops.pop_back();
+            close_loop(frame);
+            uint32_t next = F::NONE;
+            if (!dead) {
+                next = new_block();
+                end_block(F::FALLTHROUGH, F::NONE, {next});
+            }
+            f->nodes.push_back({F::END, next});
+            frames.pop_back();
+            if (next != F::NONE) {
+                start_block(next, cur);
+            }
+            return;
+        }
+        if (frame.kind == 0x02 && frame.first_edge == F::NONE && !dead) {
+            // nothing branches to it, so the locals and results stay as they are
+            check_stack(frame.num_results);
+            stack.erase(stack.begin() + frame.height, stack.end() - frame.num_results);
+            uint32_t join = frame.target;
+            end_block(F::FALLTHROUGH, F::NONE, {join});
+            f->nodes.push_back({F::END, join});
+            frames.pop_back();
+            start_block(join, cur);
+            return;
+        }
+        if (!dead) {
+            add_edge(frame);
+            end_block(F::FALLTHROUGH, F::NONE, {frame.target});
+        }
+        if (frame.kind == 0x04 && !frame.has_else) {
+            // the false edge carries the params as the results
+            Edge e = {frame.if_block, (uint32_t)snapshots.size(), frame.num_results, F::NONE,
+                      (uint32_t)frames.size() - 1};
+            for (uint32_t k = 0; k < frame.num_results; k++) {
+                snapshots.push_back({temp(k), saved[frame.saved + k]});
+            }
+            link(frame, e);
+            F::Block& b = f->blocks[frame.if_block];
+            f->succs[b.first_succ + 1] = frame.target;
+        }
+        undo(frame.log_mark);
+        Frame closed = frame;
+        frames.pop_back();
+        if (closed.kind == 0x04) {
+            saved.resize(closed.saved);
+        }
+        if (closed.first_edge == F::NONE) {
+            f->nodes.push_back({F::END, F::NONE});
+            dead = true;
+            return;
+        }
+        f->nodes.push_back({F::END, closed.target});
+        stack.resize(closed.height);
+        merge(closed);
+    }
+
+    void visit_Br(uint32_t labelidx) {
+        if (skip) {
+            return;
+        }
+        Frame& target = label(labelidx);
+        if (target.kind == 0x00) {
+            exit_function(F::RETURN);
+            return;
+        }
+        add_edge(target);
+        end_block(F::BR, F::NONE, {target.target});
+    }
+
+    void visit_BrIf(uint32_t labelidx) {
+        if (skip) {
+            return;
+        }
+        uint32_t cond = pop();
+        Frame& target = label(labelidx);
+        uint32_t next = new_block();
+        if (target.kind == 0x00) {
+            returned(target);
+        } else {
+            add_edge(target);
+        }
+        end_block(F::BR_IF, cond, {target.target, next});
+        start_block(next, cur);
+    }
+
+    void visit_BrTable(const std::vector<uint32_t>& labelidxs, uint32_t default_labelidx) {
+        if (skip) {
+            return;
+        }
+        uint32_t cond = pop();
+        targets.clear();
+        bool to_function = false;
+        for (size_t i = 0; i <= labelidxs.size(); i++) {
+            Frame& target = label(i < labelidxs.size() ? labelidxs[i] : default_labelidx);
+            targets.push_back(target.target);
+            if (target.kind == 0x00) {
+                to_function = true;
+            } else {
+                add_edge(target);
+            }
+        }
+        if (to_function) {
+            returned(frames[0]);
+        }
+        end_block(F::BR_TABLE, cond, targets);
+    }
+
+    void visit_Return() {
+        if (!skip) {
+            exit_function(F::RETURN);
+        }
+    }
+
+    void visit_Call(uint32_t funcidx) {
+        if (!skip) {
+            call(func_types[func_type_index(funcidx)], 0);
+        }
+    }
+
+    void visit_CallIndirect(uint32_t typeidx, uint32_t /*tableidx*/) {
+        if (!skip) {
+            call(func_types[typeidx], 1);
+        }
+    }
+
+    void visit_Drop() {
+        if (!skip) {
+            pop();
+        }
+    }
+
+    void visit_Select() {
+        if (!skip) {
+            check_stack(3);
+            pending = add_value(0x1B, f->values[stack[stack.size() - 3]].type, 3);
+        }
+    }
+
+    void visit_LocalGet(uint32_t localidx) {
+        if (!skip) {
+            check_index(localidx, num_locals, "local.get");
+            stack.push_back(current(localidx));
+        }
+    }
+
+    void visit_LocalSet(uint32_t localidx) {
+        if (!skip) {
+            check_index(localidx, num_locals, "local.set");
+            write(localidx, pop());
+        }
+    }
+
+    void visit_LocalTee(uint32_t localidx) {
+        if (!skip) {
+            check_index(localidx, num_locals, "local.tee");
+            check_stack(1);
+            write(localidx, stack.back());
+        }
+    }
+
+    void visit_GlobalGet(uint32_t globalidx) {
+        if (!skip) {
+            check_index(globalidx, global_types.size(), "global.get");
+            pending = add_value(0x23, global_types[globalidx], 0);
+        }
+    }
+
+    void visit_GlobalSet(uint32_t /*globalidx*/) {
+        if (!skip) {
+            pending = add_value(0x24, F::NO_TYPE, 1);
+        }
+    }
+
+    void visit_TableGet(uint32_t tableidx) {
+        if (!skip) {
+            check_index(tableidx, table_types.size(), "table.get");
+            pending = add_value(0x25, table_types[tableidx], 1);
+        }
+    }
+
+    void visit_TableSet(uint32_t /*tableidx*/) {
+        if (!skip) {
+            pending = add_value(0x26, F::NO_TYPE, 2);
+        }
+    }
+
+    void visit_RefNull(uint8_t reftype) {
+        if (!skip) {
+            pending = add_value(0xD0, reftype, 0);
+        }
+    }
+
+   private:
+    struct Frame {
+        uint8_t kind;  // 0x02 block, 0x03 loop, 0x04 if, 0x00 the function
+        const uint8_t* params;
+        uint32_t num_params;
+        const uint8_t* results;
+        uint32_t num_results;
+        uint32_t height;      // of the stack below the params
+        uint32_t target;      // the block a branch to the label goes to
+        uint32_t if_block;    // the block that ends in the `if`
+        uint32_t saved;       // the if's params, into `saved`
+        uint32_t log_mark;    // the length of `log` when it was opened
+        uint32_t clock_mark;  // the writes after it was opened have a later epoch
+        uint32_t first_edge, last_edge;  // the branches to the label, into `edges`
+        uint32_t entry;                  // of a loop, the block before it
+        uint32_t first_header_phi;       // of a loop
+        uint32_t first_inner_edge;       // of a loop, the edges added while it is open start here
+        bool has_else;
+    };
+
+    // A branch to a label, with the values of the locals written since the
+    // label was opened and of the values it carries
+    struct Edge {
+        uint32_t pred;
+        uint32_t first, count;  // into `snapshots`
+        uint32_t next;          // to the same label
+        uint32_t depth;         // of the label, into `frames`
+    };
+
+    struct Def {
+        uint32_t var;
+        uint32_t value;
+    };
+
+    struct Undo {
+        uint32_t var;
+        uint32_t value;
+        uint32_t epoch;
+    };
+
+    struct HeaderPhi {
+        uint32_t var;
+        uint32_t phi;
+        uint32_t entry;  // the value before the loop
+    };
+
+    SsaFunction* f;
+    std::vector<uint8_t> global_types;  // imported ones first
+    std::vector<uint8_t> table_types;
+    // fixed_signature of the unprefixed opcodes
+    bool fixed[0xFC];
+    uint8_t fixed_pops[0xFC], fixed_type[0xFC];
+    uint32_t num_locals;
+    uint32_t cur;  // the block being lifted
+    // by local, then by position for the values carried to a label
+    std::vector<uint8_t> var_types;
+    std::vector<uint32_t> def;    // the value on the path being lifted
+    std::vector<uint32_t> epoch;  // `clock` at the write of `def`
+    std::vector<uint32_t> seen;   // `serial` once seen by the current scan
+    std::vector<uint32_t> slot;   // scratch of the current scan
+    // the loop whose header got the last phi of the local, and the phi
+    std::vector<uint32_t> cached_loop, cached_phi;
+    uint32_t clock;
+    uint32_t serial;
+    uint32_t num_phis;             // placed, forwarded ones included
+    std::vector<uint32_t> kept;    // the phis that are used, by value
+    // the operands and the blocks whose condition were phis when recorded
+    std::vector<uint32_t> phi_uses, phi_conds;
+    std::vector<Undo> log;
+    std::vector<Edge> edges;
+    std::vector<Def> snapshots;
+    std::vector<HeaderPhi> header_phis;  // of the open loops
+    std::vector<HeaderPhi> closing;
+    std::vector<uint32_t> loops;  // into `frames`, innermost last
+    std::vector<uint32_t> vars;
+    std::vector<uint32_t> matrix;
+    std::vector<uint8_t> used;  // by value, the phis that are kept
+    std::vector<uint32_t> work;
+    std::vector<uint32_t> stack;
+    std::vector<uint32_t> saved;
+    std::vector<uint32_t> targets;
+    std::vector<Frame> frames;
+    bool dead;
+    uint32_t dead_depth;  // blocks opened in unreachable code
+    bool skip;            // whether the visit method ignores the instruction
+    uint32_t start;       // of the instruction being decoded
+    uint32_t pending;     // the value of the last instruction, until its size is known
+
+    static void check_index(uint64_t index, uint64_t size, const char* what) {
+        if (index >= size) {
+            throw LFortranException(std::string("ssa: ") + what + " index out of range");
+        }
+    }
+
+    void check_stack(uint32_t n) {
+        if (stack.size() < frames.back().height + n) {
+            throw LFortranException("ssa: not enough values on the stack");
+        }
+    }
+
+    uint32_t pop() {
+        check_stack(1);
+        uint32_t v = stack.back();
+        stack.pop_back();
+        return v;
+    }
+
+    Frame& label(uint32_t labelidx) {
+        check_index(labelidx, frames.size(), "br: label");
+        return frames[frames.size() - 1 - labelidx];
+    }
+
+    void finish_value(uint32_t end) {
+        if (pending != F::NONE) {
+            f->values[pending].size = end - f->values[pending].start;
+            pending = F::NONE;
+        }
+    }
+
+    uint32_t add_value(uint16_t op, uint8_t type, uint32_t pops, uint32_t imm = 0) {
+        check_stack(pops);
+        uint32_t id = f->values.size();
+        uint32_t first = f->operands.size();
+        for (uint32_t k = pops; k > 0; k--) {
+            note_use(stack[stack.size() - k]);
+            f->operands.push_back(stack[stack.size() - k]);
+        }
+        stack.resize(stack.size() - pops);
+        bool instruction = op < F::PHI;
+        f->values.push_back({op, type, 0, instruction ? start : imm, cur, first, pops});
+        f->body.push_back(id);
+        if (type != F::NO_TYPE && type != F::MULTI) {
+            stack.push_back(id);
+        }
+        return id;
+    }
+
+    // Notes a use of `v` as the next operand, which has to be resolved at
+    // the end if `v` is a phi
+    void note_use(uint32_t v) {
+        if (f->values[v].op == F::PHI || f->values[v].op == F::FORWARD) {
+            phi_uses.push_back(f->operands.size());
+        }
+    }
+
+    // A phi without operands yet
+    uint32_t add_phi(uint32_t block, uint8_t type) {
+        uint32_t id = f->values.size();
+        f->values.push_back({F::PHI, type, 0, 0, block, 0, 0});
+        num_phis++;
+        return id;
+    }
+
+    void call(const FuncType& type, uint32_t extra) {
+        uint32_t pops = type.param_types.size() + extra;
+        size_t n = type.result_types.size();
+        uint8_t result = n == 0 ? F::NO_TYPE : n == 1 ? type.result_types[0] : F::MULTI;
+        pending = add_value(wasm_bytes[start], result, pops);
+        if (n > 1) {
+            uint32_t call_value = pending;
+            for (uint32_t k = 0; k < n; k++) {
+                stack.push_back(call_value);
+                add_value(F::RESULT, type.result_types[k], 1, k);
+            }
+        }
+    }
+
+    void open(uint8_t kind, int64_t blocktype) {
+        Frame frame = {};
+        frame.kind = kind;
+        if (blocktype >= 0) {
+            check_index(blocktype, func_types.size(), "block type");
+            const FuncType& type = func_types[blocktype];
+            frame.params = type.param_types.data();
+            frame.num_params = type.param_types.size();
+            frame.results = type.result_types.data();
+            frame.num_results = type.result_types.size();
+        } else if (blocktype != -64) {
+            frame.results = &wasm_bytes[start + 1];  // the value type itself
+            frame.num_results = 1;
+        }
+        check_stack(frame.num_params);
+        frame.height = stack.size() - frame.num_params;
+        frame.log_mark = log.size();
+        frame.clock_mark = clock;
+        frame.first_edge = F::NONE;
+        frame.last_edge = F::NONE;
+        frames.push_back(frame);
+    }
+
+    uint32_t new_block() {
+        uint32_t id = f->blocks.size();
+        F::Block b = {};
+        b.cond = F::NONE;
+        b.exit = F::UNREACHABLE;
+        f->blocks.push_back(b);
+        return id;
+    }
+
+    // Makes `block` the one being lifted, with `pred` as its only
+    // predecessor unless that is NONE
+    void start_block(uint32_t block, uint32_t pred) {
+        F::Block& b = f->blocks[block];
+        if (pred != F::NONE) {
+            b.first_pred = f->preds.size();
+            b.num_preds = 1;
+            f->preds.push_back(pred);
+        }
+        cur = block;
+        dead = false;
+        b.first_value = f->body.size();
+        f->nodes.push_back({F::BODY, block});
+    }
+
+    void end_block(F::Exit exit, uint32_t cond = F::NONE, std::initializer_list<uint32_t> succs = {}) {
+        end_block(exit, cond, succs.begin(), succs.size());
+    }
+
+    void end_block(F::Exit exit, uint32_t cond, const std::vector<uint32_t>& succs) {
+        end_block(exit, cond, succs.data(), succs.size());
+    }
+
+    void end_block(F::Exit exit, uint32_t cond, const uint32_t* succs, size_t n) {
+        F::Block& b = f->blocks[cur];
+        b.num_values = f->body.size() - b.first_value;
+        b.exit = exit;
+        b.cond = cond;
+        if (cond != F::NONE && (f->values[cond].op == F::PHI || f->values[cond].op == F::FORWARD)) {
+            phi_conds.push_back(cur);
+        }
+        b.first_succ = f->succs.size();
+        b.num_succs = n;
+        f->succs.insert(f->succs.end(), succs, succs + n);
+        dead = true;
+        dead_depth = 0;
+    }
+
+    // Records the function's results at the top of the stack as the
+    // operands of the current block
+    void returned(const Frame& func) {
+        check_stack(func.num_results);
+        F::Block& b = f->blocks[cur];
+        b.first_operand = f->operands.size();
+        b.num_operands = func.num_results;
+        for (uint32_t k = func.num_results; k > 0; k--) {
+            note_use(stack[stack.size() - k]);
+            f->operands.push_back(stack[stack.size() - k]);
+        }
+    }
+
+    void exit_function(F::Exit exit) {
+        returned(frames[0]);
+        end_block(exit);
+    }
+
+    // The variable of the `k`th value carried to a label
+    uint32_t temp(uint32_t k) {
+        uint32_t var = num_locals + k;
+        if (var >= seen.size()) {
+            seen.resize(var + 1);
+            slot.resize(var + 1);
+        }
+        return var;
+    }
+
+    // Logs only the first write of a local since the innermost label was
+    // opened, which is the one `undo` has to restore
+    void write(uint32_t var, uint32_t value) {
+        if (epoch[var] <= frames.back().clock_mark) {
+            log.push_back({var, def[var], epoch[var]});
+        }
+        def[var] = value;
+        epoch[var] = ++clock;
+    }
+
+    void undo(uint32_t mark) {
+        while (log.size() > mark) {
+            const Undo& u = log.back();
+            def[u.var] = u.value;
+            epoch[u.var] = u.epoch;
+            log.pop_back();
+        }
+    }
+
+    // The value of a local on the path being lifted, placing phis in the
+    // headers of the loops entered since it was written
+    uint32_t current(uint32_t var) {
+        if (loops.empty() || epoch[var] >= frames[loops.back()].clock_mark) {
+            return def[var];
+        }
+        uint32_t value = through_loops(var, def[var], epoch[var]);
+        // logged, so that leaving the loop's enclosing blocks forgets it
+        log.push_back({var, def[var], epoch[var]});
+        def[var] = value;
+        epoch[var] = frames[loops.back()].clock_mark;
+        return value;
+    }
+
+    // What a local written as `value` at `when` is inside the open loops: the
+    // phi of the innermost loop entered since, placing the missing ones
+    uint32_t through_loops(uint32_t var, uint32_t value, uint32_t when) {
+        size_t i = loops.size();
+        while (i > 0 && frames[loops[i - 1]].clock_mark > when) {
+            i--;
+        }
+        for (; i < loops.size(); i++) {
+            const Frame& loop = frames[loops[i]];
+            if (cached_loop[var] != loop.clock_mark) {
+                cached_loop[var] = loop.clock_mark;
+                cached_phi[var] = add_phi(loop.target, var_types[var]);
+                header_phis.push_back({var, cached_phi[var], value});
+            }
+            value = cached_phi[var];
+        }
+        return value;
+    }
+
+    void link(Frame& target, const Edge& e) {
+        uint32_t id = edges.size();
+        edges.push_back(e);
+        if (target.last_edge == F::NONE) {
+            target.first_edge = id;
+        } else {
+            edges[target.last_edge].next = id;
+        }
+        target.last_edge = id;
+    }
+
+    // Records a branch from the current block to `target`
+    void add_edge(Frame& target) {
+        if (target.last_edge != F::NONE && edges[target.last_edge].pred == cur) {
+            return;  // a br_table that names the label twice
+        }
+        uint32_t n = target.kind == 0x03 ? target.num_params : target.num_results;
+        check_stack(n);
+        Edge e = {cur, (uint32_t)snapshots.size(), 0, F::NONE, (uint32_t)(&target - frames.data())};
+        for (uint32_t k = 0; k < n; k++) {
+            snapshots.push_back({temp(k), stack[stack.size() - n + k]});
+        }
+        serial++;
+        for (size_t i = target.log_mark; i < log.size(); i++) {
+            uint32_t var = log[i].var;
+            if (seen[var] != serial && epoch[var] > target.clock_mark) {
+                seen[var] = serial;
+                // through the loops entered since the write, which may change it
+                snapshots.push_back({var, current(var)});
+            }
+        }
+        e.count = snapshots.size() - e.first;
+        link(target, e);
+    }
+
+    // Starts the block after the `end` of `frame`, with a phi for every local
+    // or result its branches disagree on. The locals are those of the entry of
+    // `frame` again.
+    void merge(const Frame& frame) {
+        uint32_t join = frame.target;
+        F::Block& b = f->blocks[join];
+        b.first_pred = f->preds.size();
+        uint32_t n = 0;
+        for (uint32_t e = frame.first_edge; e != F::NONE; e = edges[e].next, n++) {
+            f->preds.push_back(edges[e].pred);
+        }
+        b.num_preds = n;
+        start_block(join, F::NONE);
+
+        serial++;
+        vars.clear();
+        for (uint32_t e = frame.first_edge; e != F::NONE; e = edges[e].next) {
+            const Edge& edge = edges[e];
+            for (uint32_t i = edge.first; i < edge.first + edge.count; i++) {
+                uint32_t var = snapshots[i].var;
+                if (seen[var] != serial) {
+                    seen[var] = serial;
+                    slot[var] = vars.size();
+                    vars.push_back(var);
+                }
+            }
+        }
+        matrix.assign(vars.size() * n, F::NONE);
+        uint32_t column = 0;
+        for (uint32_t e = frame.first_edge; e != F::NONE; e = edges[e].next, column++) {
+            const Edge& edge = edges[e];
+            for (uint32_t i = edge.first; i < edge.first + edge.count; i++) {
+                matrix[slot[snapshots[i].var] * n + column] = resolve(snapshots[i].value);
+            }
+        }
+        // the carried values come first, every branch has them
+        for (uint32_t u = 0; u < vars.size(); u++) {
+            uint32_t var = vars[u];
+            uint32_t* row = &matrix[u * n];
+            uint8_t type;
+            if (var < num_locals) {
+                // the branches that did not write it have the value from the entry
+                if (std::find(row, row + n, F::NONE) != row + n) {
+                    std::replace(row, row + n, F::NONE, resolve(current(var)));
+                }
+                type = var_types[var];
+            } else {
+                type = frame.results[var - num_locals];
+            }
+            uint32_t value = row[0];
+            if ((uint32_t)std::count(row, row + n, value) != n) {
+                value = add_phi(join, type);
+                f->values[value].first_operand = f->operands.size();
+                f->values[value].num_operands = n;
+                f->operands.insert(f->operands.end(), row, row + n);
+            }
+            if (var >= num_locals) {
+                stack.push_back(value);
+            } else if (value != resolve(def[var])) {
+                write(var, value);
+            }
+        }
+    }
+
+    // Gives the header of `loop` its predecessors and completes its phis
+    void close_loop(const Frame& loop) {
+        uint32_t header = loop.target;
+        F::Block& b = f->blocks[header];
+        b.first_pred = f->preds.size();
+        f->preds.push_back(loop.entry);
+        uint32_t n = 1;
+        for (uint32_t e = loop.first_edge; e != F::NONE; e = edges[e].next, n++) {
+            f->preds.push_back(edges[e].pred);
+        }
+        b.num_preds = n;
+
+        // the phis of the loops around it stay
+        closing.clear();
+        size_t keep = loop.first_header_phi;
+        for (size_t i = loop.first_header_phi; i < header_phis.size(); i++) {
+            if (f->values[header_phis[i].phi].block == header) {
+                closing.push_back(header_phis[i]);
+            } else {
+                header_phis[keep++] = header_phis[i];
+            }
+        }
+        header_phis.resize(keep);
+        place_written_phis(loop);
+        for (const HeaderPhi& h : closing) {
+            F::Value& phi = f->values[h.phi];
+            phi.first_operand = f->operands.size();
+            phi.num_operands = n;
+            f->operands.push_back(h.entry);
+            f->operands.resize(phi.first_operand + n);
+        }
+        // a local a back edge did not write reaches it as the phi itself
+        uint32_t column = 1;
+        for (uint32_t e = loop.first_edge; e != F::NONE; e = edges[e].next, column++) {
+            const Edge& edge = edges[e];
+            serial++;
+            for (uint32_t i = edge.first; i < edge.first + edge.count; i++) {
+                seen[snapshots[i].var] = serial;
+                slot[snapshots[i].var] = snapshots[i].value;
+            }
+            for (const HeaderPhi& h : closing) {
+                uint32_t value = seen[h.var] == serial ? slot[h.var] : h.phi;
+                f->operands[f->values[h.phi].first_operand + column] = value;
+            }
+        }
+        for (const HeaderPhi& h : closing) {
+            try_forward(h.phi);
+        }
+        complete_exits(loop);
+    }
+
+    // Gives the header of `loop` a phi for every local its back edges carry
+    // that was not read in it, if a branch leaves it: complete_exits() needs
+    // the local's value at the header for the branches taken before the write
+    void place_written_phis(const Frame& loop) {
+        uint32_t depth = frames.size() - 1;
+        bool exits = false;
+        for (uint32_t e = loop.first_inner_edge; e < edges.size() && !exits; e++) {
+            exits = edges[e].depth < depth;
+        }
+        if (!exits) {
+            return;
+        }
+        serial++;
+        for (const HeaderPhi& h : closing) {
+            seen[h.var] = serial;
+        }
+        vars.clear();
+        for (uint32_t e = loop.first_edge; e != F::NONE; e = edges[e].next) {
+            const Edge& edge = edges[e];
+            for (uint32_t i = edge.first; i < edge.first + edge.count; i++) {
+                uint32_t var = snapshots[i].var;
+                if (var < num_locals && seen[var] != serial) {
+                    seen[var] = serial;
+                    vars.push_back(var);
+                }
+            }
+        }
+        if (vars.empty()) {
+            return;
+        }
+        // the value a local entered the loop with is the one its first write
+        // in the loop replaced, seen through the loops around it
+        uint32_t written = serial++;
+        for (size_t i = loop.log_mark; i < log.size(); i++) {
+            const Undo& u = log[i];
+            if (seen[u.var] == written) {
+                seen[u.var] = serial;
+                uint32_t entry = through_loops(u.var, u.value, u.epoch);
+                closing.push_back({u.var, add_phi(loop.target, var_types[u.var]), entry});
+            }
+        }
+    }
+
+    // Adds the header phis of `loop` to the branches out of it that left
+    // before the local was read or written in it: the local leaves with its
+    // value at the header, but the phi was only placed at that first use
+    void complete_exits(const Frame& loop) {
+        uint32_t depth = frames.size() - 1;  // of `loop`, still open
+        for (uint32_t e = loop.first_inner_edge; e < edges.size() && !closing.empty(); e++) {
+            Edge& edge = edges[e];
+            if (edge.depth >= depth) {
+                continue;  // to the loop itself or to a label inside it
+            }
+            serial++;
+            for (uint32_t i = edge.first; i < edge.first + edge.count; i++) {
+                seen[snapshots[i].var] = serial;
+            }
+            uint32_t first = snapshots.size();
+            for (const HeaderPhi& h : closing) {
+                // the loop's params are not carried out of it
+                if (h.var < num_locals && seen[h.var] != serial) {
+                    snapshots.push_back({h.var, h.phi});
+                }
+            }
+            if (snapshots.size() == first) {
+                continue;
+            }
+            // moved behind the others, the carried values first as before
+            uint32_t added = snapshots.size() - first;
+            for (uint32_t i = 0; i < edge.count; i++) {
+                Def d = snapshots[edge.first + i];
+                snapshots.push_back(d);
+            }
+            std::rotate(snapshots.begin() + first, snapshots.begin() + first + added, snapshots.end());
+            edge.first = first;
+            edge.count += added;
+        }
+    }
+
+    uint32_t resolve(uint32_t v) {
+        uint32_t r = v;
+        while (f->values[r].op == F::FORWARD) {
+            r = f->values[r].start;
+        }
+        while (f->values[v].op == F::FORWARD) {
+            uint32_t next = f->values[v].start;
+            f->values[v].start = r;
+            v = next;
+        }
+        return r;
+    }
+
+    // Forwards a phi whose operands are one value and itself to that value
+    uint32_t try_forward(uint32_t phi) {
+        const F::Value& p = f->values[phi];
+        uint32_t same = F::NONE;
+        for (uint32_t i = 0; i < p.num_operands; i++) {
+            uint32_t v = resolve(f->operands[p.first_operand + i]);
+            if (v == same || v == phi) {
+                continue;
+            }
+            if (same != F::NONE) {
+                return phi;
+            }
+            same = v;
+        }
+        if (same == F::NONE) {
+            return phi;
+        }
+        f->values[phi].op = F::FORWARD;
+        f->values[phi].start = same;
+        return same;
+    }
+
+    // Forwards the used phis that became trivial after others were
+    // forwarded, until none is left, and points every operand at what it
+    // stands for
+    void remove_trivial_phis() {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (uint32_t v : kept) {
+                if (f->values[v].op == F::PHI && try_forward(v) != v) {
+                    changed = true;
+                }
+            }
+        }
+        // only what was a phi when recorded may have been forwarded since
+        for (uint32_t i : phi_uses) {
+            f->operands[i] = resolve(f->operands[i]);
+        }
+        for (uint32_t v : kept) {
+            const F::Value& phi = f->values[v];
+            if (phi.op == F::PHI) {
+                for (uint32_t k = 0; k < phi.num_operands; k++) {
+                    f->operands[phi.first_operand + k] = resolve(f->operands[phi.first_operand + k]);
+                }
+            }
+        }
+        for (uint32_t b : phi_conds) {
+            f->blocks[b].cond = resolve(f->blocks[b].cond);
+        }
+    }
+
+    // Collects the phis an instruction, a branch or a return uses, directly
+    // or through other phis, in `kept`; a join places phis for locals that
+    // are never read after it, and those are left alone from here on
+    void mark_used_phis() {
+        used.assign(f->values.size(), 0);
+        work.clear();
+        kept.clear();
+        auto use = [&](uint32_t v) {
+            v = resolve(v);
+            if (f->values[v].op == F::PHI && !used[v]) {
+                used[v] = 1;
+                kept.push_back(v);
+                work.push_back(v);
+            }
+        };
+        for (uint32_t i : phi_uses) {
+            use(f->operands[i]);
+        }
+        for (uint32_t b : phi_conds) {
+            use(f->blocks[b].cond);
+        }
+        while (!work.empty()) {
+            const F::Value& phi = f->values[work.back()];
+            work.pop_back();
+            for (uint32_t k = 0; k < phi.num_operands; k++) {
+                use(f->operands_of(phi)[k]);
+            }
+        }
+    }
+
+    void group_phis() {
+        for (uint32_t v : kept) {
+            if (f->values[v].op == F::PHI) {
+                f->blocks[f->values[v].block].num_phis++;
+            }
+        }
+        uint32_t n = 0;
+        for (F::Block& b : f->blocks) {
+            b.first_phi = n;
+            n += b.num_phis;
+            b.num_phis = 0;
+        }
+        f->phis.resize(n);
+        for (uint32_t v : kept) {
+            if (f->values[v].op == F::PHI) {
+                F::Block& b = f->blocks[f->values[v].block];
+                f->phis[b.first_phi + b.num_phis++] = v;
+            }
+        }
+    }
+};
+
+// Lowers an SsaFunction back to a function body.
+//
+// The nodes give the `block`, `loop` and `if` to emit, all without params or
+// results since every value that crosses a block lives in a local. A phi
+// shares its local with the operands it does not interfere with, the other
+// values used in another block get a local of their own, and the values used
+// only in their block share locals with those of other blocks. A value used
+// once in its block stays on the stack where the stack order allows it, and
+// constants are emitted again where they are used. Phis are local writes on
+// the edges into their block, done as one parallel copy through the operand
+// stack and left out where the phi already shares the local. A `br_if` or
+// `br_table` whose targets need copies goes through a branch of its own per
+// target.
+class SsaLowering {
+   public:
+    typedef SsaFunction F;
+
+    // The body without the final `end`, and the declarations of its locals
+    std::vector<uint8_t> lower(const SsaFunction& function, std::vector<Local>& locals) {
+        f = &function;
+        count_uses();
+        coalesce_phis();
+        assign_locals(locals);
+        out.code.clear();
+        scopes.clear();
+        uint32_t last_body = F::NONE;
+        for (const F::Node& node : f->nodes) {
+            switch (node.kind) {
+                case F::BODY:
+                    at_end = &node == &f->nodes.back();
+                    emit_block(node.block);
+                    last_body = node.block;
+                    break;
+                case F::BLOCK:
+                case F::LOOP:
+                    out.emit_b8(node.kind == F::BLOCK ? 0x02 : 0x03);
+                    out.emit_b8(0x40);
+                    scopes.push_back({node.block, F::NONE, false});
+                    break;
+                case F::IF_:
+                    out.emit_b8(0x04);
+                    out.emit_b8(0x40);
+                    scopes.push_back({node.block, last_body, false});
+                    break;
+                case F::ELSE:
+                    out.emit_b8(0x05);
+                    scopes.back().has_else = true;
+                    break;
+                case F::END: {
+                    Scope s = scopes.back();
+                    if (s.if_block != F::NONE && !s.has_else && needs_copies(s.if_block, s.target)) {
+                        out.emit_b8(0x05);
+                        copy(s.if_block, s.target);
+                    }
+                    out.emit_end();
+                    scopes.pop_back();
+                    if (node.block == F::NONE) {
+                        out.emit_b8(0x00);  // unreachable, the stack may hold anything after
+                    }
+                    break;
+                }
+            }
+        }
+        return out.code;
+    }
+
+   private:
+    struct Scope {
+        uint32_t target;    // the block a branch to it goes to
+        uint32_t if_block;  // of an if, the block ending in it
+        bool has_else;
+    };
+
+    static constexpr uint32_t GLOBAL = ~1U;  // used outside its block
+
+    const SsaFunction* f;
+    WASMAssembler out;
+    std::vector<Scope> scopes;
+    std::vector<uint32_t> uses;
+    std::vector<uint32_t> last_use;  // position in its block, or GLOBAL
+    std::vector<uint32_t> local_of;  // NONE for no local
+    std::vector<bool> on_stack;      // popped from the stack by its use
+    std::vector<uint32_t> targets;
+    // coalesce_phis(): the values that need a local of their own, numbered
+    // in `candidate`, their liveness by block and interference, and the
+    // union-find of the values that share one
+    std::vector<uint32_t> candidate;
+    std::vector<uint32_t> candidates;
+    size_t words;
+    std::vector<uint64_t> gen, kill, edge_uses, live_in, live_out, interference, live;
+    std::vector<uint32_t> parent;
+    std::vector<std::vector<uint32_t>> members;
+    std::vector<uint32_t> group;  // by value, the one whose local it shares
+    // stackify(): by value, the first operand it pushes itself and the
+    // position its instructions start at, the same for the returns, the
+    // values that might stay, and the operands pushed before a run
+    struct Push {
+        uint32_t position;     // in the block
+        uint32_t first, count;  // into `pushed`
+    };
+    std::vector<uint32_t> late, tree_start, exit_late;
+    std::vector<uint32_t> pending;
+    std::vector<Push> pushes;
+    std::vector<uint32_t> pushed;
+    std::vector<uint32_t> first_push;  // by block, into `pushes`
+    bool at_end;                       // emitting the block the body ends with
+
+    static bool is_const(uint16_t op) { return op >= 0x41 && op <= 0x44; }
+
+    void use(uint32_t v, uint32_t block, uint32_t position) {
+        uses[v]++;
+        if (f->values[v].block != block || f->values[v].op >= F::PHI) {
+            last_use[v] = GLOBAL;
+        } else if (last_use[v] != GLOBAL) {
+            last_use[v] = std::max(last_use[v], position);
+        }
+    }
+
+    void count_uses() {
+        uses.assign(f->values.size(), 0);
+        last_use.assign(f->values.size(), 0);
+        for (uint32_t b = 0; b < f->blocks.size(); b++) {
+            const F::Block& block = f->blocks[b];
+            for (uint32_t i = 0; i < block.num_values; i++) {
+                const F::Value& v = f->values[f->body[block.first_value + i]];
+                for (uint32_t k = 0; k < v.num_operands; k++) {
+                    use(f->operands_of(v)[k], b, i);
+                }
+            }
+            if (block.cond != F::NONE) {
+                use(block.cond, b, block.num_values);
+            }
+            for (uint32_t k = 0; k < block.num_operands; k++) {
+                use(f->operands[block.first_operand + k], b, block.num_values);
+            }
+            for (uint32_t i = 0; i < block.num_phis; i++) {
+                const F::Value& phi = f->values[f->phis[block.first_phi + i]];
+                for (uint32_t k = 0; k < phi.num_operands; k++) {
+                    use(f->operands_of(phi)[k], F::NONE, 0);
+                }
+            }
+        }
+    }
+
+    // Whether candidate `c` is in the bitset at `bits`
+    static bool test(const uint64_t* bits, uint32_t c) { return (bits[c / 64] >> (c % 64)) & 1; }
+
+    static void set(uint64_t* bits, uint32_t c) { bits[c / 64] |= 1ULL << (c % 64); }
+
+    uint32_t find(uint32_t c) {
+        while (parent[c] != c) {
+            c = parent[c] = parent[parent[c]];
+        }
+        return c;
+    }
+
+    void interfere(uint32_t a, uint32_t b) {
+        if (a != b) {
+            set(&interference[(size_t)a * words], b);
+            set(&interference[(size_t)b * words], a);
+        }
+    }
+
+    // Gives a phi and its operands one local where they are never live at
+    // the same time, so that the copies on its edges go away. The values
+    // that get a local of their own, those used outside their block or by a
+    // phi, the phis, params and zeros, are the candidates; liveness is solved
+    // over the blocks with a phi's operand live at the end of its
+    // predecessor and the phis defined at the top of their block, where the
+    // edge's copies write them. Two candidates interfere if one is defined
+    // where the other is live. The phis are then merged greedily with their
+    // operands, a group taking the index of the param in it. Functions with
+    // too many candidates for the bit matrix keep a local per phi.
+    void coalesce_phis() {
+        candidate.assign(f->values.size(), F::NONE);
+        candidates.clear();
+        group.resize(f->values.size());
+        for (uint32_t v = 0; v < f->values.size(); v++) {
+            group[v] = v;
+        }
+        for (uint32_t v = 0; v < f->values.size(); v++) {
+            const F::Value& value = f->values[v];
+            if (uses[v] > 0 && last_use[v] == GLOBAL && !is_const(value.op) && value.type != F::NO_TYPE &&
+                value.type != F::MULTI) {
+                candidate[v] = candidates.size();
+                candidates.push_back(v);
+            }
+        }
+        uint64_t n = candidates.size(), num_blocks = f->blocks.size();
+        // the interference and five bitsets per block, up to 16 MiB
+        if (f->phis.empty() || n * (n + 5 * num_blocks) > (1ULL << 27)) {
+            return;
+        }
+        words = (n + 63) / 64;
+        live_in.assign(num_blocks * words, 0);
+        live_out.assign(num_blocks * words, 0);
+        interference.assign(n * words, 0);
+
+        // the uses of a block that the block does not define, the
+        // candidates it defines, and the operands of the phis it is a
+        // predecessor of
+        gen.assign(num_blocks * words, 0);
+        kill.assign(num_blocks * words, 0);
+        edge_uses.assign(num_blocks * words, 0);
+        for (uint32_t b = 0; b < num_blocks; b++) {
+            const F::Block& block = f->blocks[b];
+            uint64_t* g = &gen[b * words];
+            auto use_in_block = [&](uint32_t o) {
+                if (candidate[o] != F::NONE) {
+                    set(g, candidate[o]);
+                }
+            };
+            for (uint32_t i = 0; i < block.num_values; i++) {
+                uint32_t id = f->body[block.first_value + i];
+                const F::Value& v = f->values[id];
+                for (uint32_t k = 0; k < v.num_operands; k++) {
+                    use_in_block(f->operands_of(v)[k]);
+                }
+                if (candidate[id] != F::NONE) {
+                    set(&kill[b * words], candidate[id]);
+                }
+            }
+            if (block.cond != F::NONE) {
+                use_in_block(block.cond);
+            }
+            for (uint32_t k = 0; k < block.num_operands; k++) {
+                use_in_block(f->operands[block.first_operand + k]);
+            }
+            for (uint32_t i = 0; i < block.num_phis; i++) {
+                uint32_t id = f->phis[block.first_phi + i];
+                const F::Value& phi = f->values[id];
+                set(&kill[b * words], candidate[id]);
+                for (uint32_t k = 0; k < phi.num_operands; k++) {
+                    uint32_t o = f->operands_of(phi)[k];
+                    if (candidate[o] != F::NONE) {
+                        set(&edge_uses[f->preds[block.first_pred + k] * words], candidate[o]);
+                    }
+                }
+            }
+        }
+        // a value is defined before its uses in the same block, and the
+        // phis at the top
+        for (size_t w = 0; w < gen.size(); w++) {
+            gen[w] &= ~kill[w];
+        }
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (uint32_t b = num_blocks; b-- > 0;) {
+                const F::Block& block = f->blocks[b];
+                uint64_t* out = &live_out[b * words];
+                uint64_t* in = &live_in[b * words];
+                std::copy(&edge_uses[b * words], &edge_uses[b * words] + words, out);
+                for (uint32_t i = 0; i < block.num_succs; i++) {
+                    uint32_t s = f->succs[block.first_succ + i];
+                    if (s != F::NONE) {
+                        for (size_t w = 0; w < words; w++) {
+                            out[w] |= live_in[s * words + w];
+                        }
+                    }
+                }
+                for (size_t w = 0; w < words; w++) {
+                    uint64_t next = gen[b * words + w] | (out[w] & ~kill[b * words + w]);
+                    changed |= next != in[w];
+                    in[w] = next;
+                }
+            }
+        }
+
+        // walking every block backwards from its live_out, a definition
+        // interferes with what is live after it; the phis are all defined
+        // at the top, on the edges
+        live.resize(words);
+        for (uint32_t b = 0; b < num_blocks; b++) {
+            const F::Block& block = f->blocks[b];
+            std::copy(&live_out[b * words], &live_out[b * words] + words, live.begin());
+            auto use = [&](uint32_t o) {
+                if (candidate[o] != F::NONE) {
+                    set(live.data(), candidate[o]);
+                }
+            };
+            if (block.cond != F::NONE) {
+                use(block.cond);
+            }
+            for (uint32_t k = 0; k < block.num_operands; k++) {
+                use(f->operands[block.first_operand + k]);
+            }
+            for (uint32_t i = block.num_values; i-- > 0;) {
+                uint32_t id = f->body[block.first_value + i];
+                const F::Value& v = f->values[id];
+                if (candidate[id] != F::NONE) {
+                    define(candidate[id]);
+                }
+                for (uint32_t k = 0; k < v.num_operands; k++) {
+                    use(f->operands_of(v)[k]);
+                }
+            }
+            for (uint32_t i = 0; i < block.num_phis; i++) {
+                set(live.data(), candidate[f->phis[block.first_phi + i]]);
+            }
+            for (uint32_t i = 0; i < block.num_phis; i++) {
+                define(candidate[f->phis[block.first_phi + i]]);
+            }
+        }
+
+        parent.resize(n);
+        members.resize(n);
+        for (uint32_t c = 0; c < n; c++) {
+            parent[c] = c;
+            members[c].assign(1, c);
+        }
+        for (uint32_t phi : f->phis) {
+            const F::Value& p = f->values[phi];
+            for (uint32_t k = 0; k < p.num_operands; k++) {
+                uint32_t o = f->operands_of(p)[k];
+                if (candidate[o] != F::NONE && f->values[o].type == p.type) {
+                    join(find(candidate[phi]), find(candidate[o]));
+                }
+            }
+        }
+        for (uint32_t v : candidates) {
+            group[v] = candidates[find(candidate[v])];
+        }
+    }
+
+    // A definition of `c` where `live` is live, after which `c` is not
+    void define(uint32_t c) {
+        for (size_t w = 0; w < words; w++) {
+            for (uint64_t bits = live[w]; bits != 0; bits &= bits - 1) {
+                interfere(c, w * 64 + __builtin_ctzll(bits));
+            }
+        }
+        live[c / 64] &= ~(1ULL << (c % 64));
+    }
+
+    // Merges the groups of `a` and `b` unless they interfere or both hold a
+    // param; the one with the param stays the root
+    void join(uint32_t a, uint32_t b) {
+        if (a == b) {
+            return;
+        }
+        bool param_a = f->values[candidates[a]].op == F::PARAM, param_b = f->values[candidates[b]].op == F::PARAM;
+        if (param_a && param_b) {
+            return;
+        }
+        const uint64_t* row = &interference[(size_t)a * words];
+        for (uint32_t m : members[b]) {
+            if (test(row, m)) {
+                return;
+            }
+        }
+        if (param_b || (!param_a && members[a].size() < members[b].size())) {
+            std::swap(a, b);
+        }
+        parent[b] = a;
+        members[a].insert(members[a].end(), members[b].begin(), members[b].end());
+        members[b].clear();
+        for (size_t w = 0; w < words; w++) {
+            interference[(size_t)a * words + w] |= interference[(size_t)b * words + w];
+        }
+    }
+
+    // Whether value `id`, defined in `b`, can stay on the stack for the one
+    // instruction or exit of `b` that uses it
+    bool stackable(uint32_t id, uint32_t b) const {
+        const F::Value& v = f->values[id];
+        return uses[id] == 1 && last_use[id] != GLOBAL && v.block == b && v.op < F::PHI && !is_const(v.op) &&
+               v.type != F::NO_TYPE && v.type != F::MULTI;
+    }
+
+    // Lets the values that are used once in their block stay on the stack
+    // where that is what the stack holds anyway. Going through a block, the
+    // values that might stay are kept in `pending` as they would be on the
+    // stack; an instruction takes the run of its operands that ends with the
+    // one on top, and pushes the operands after the run itself. The operands
+    // before it are pushed ahead of the first instruction of the run, so
+    // they have to be defined before that, and a value that is not taken
+    // from the top gets a local after all.
+    void stackify() {
+        on_stack.assign(f->values.size(), false);
+        late.assign(f->values.size(), 0);
+        tree_start.resize(f->values.size());
+        exit_late.assign(f->blocks.size(), 0);
+        pushes.clear();
+        pushed.clear();
+        first_push.assign(f->blocks.size() + 1, 0);
+        for (uint32_t b = 0; b < f->blocks.size(); b++) {
+            const F::Block& block = f->blocks[b];
+            first_push[b] = pushes.size();
+            pending.clear();
+            for (uint32_t i = 0; i < block.num_values; i++) {
+                uint32_t id = f->body[block.first_value + i];
+                const F::Value& v = f->values[id];
+                tree_start[id] = i;
+                if (v.op >= F::PHI || is_const(v.op)) {
+                    continue;
+                }
+                late[id] = take_operands(b, f->operands_of(v), v.num_operands, tree_start[id]);
+                if (stackable(id, b)) {
+                    pending.push_back(id);
+                }
+            }
+            // the condition is popped by the branch; the blocks of the
+            // trampolines are opened before it is pushed
+            if (block.cond != F::NONE && (block.exit != F::BR_TABLE || !needs_trampolines(b))) {
+                uint32_t start = block.num_values;
+                take_operands(b, &block.cond, 1, start);
+            } else if (block.exit == F::RETURN) {
+                uint32_t start = block.num_values;
+                exit_late[b] =
+                    take_operands(b, f->operands.data() + block.first_operand, block.num_operands, start);
+            }
+            // by position, where the instruction found last pushes first
+            std::sort(pushes.begin() + first_push[b], pushes.end(), [](const Push& x, const Push& y) {
+                return x.position < y.position || (x.position == y.position && x.first > y.first);
+            });
+        }
+        first_push[f->blocks.size()] = pushes.size();
+    }
+
+    // Takes the run of the `n` operands `ops` that is on top of `pending`,
+    // and returns where it ends: the operands after it are pushed by the
+    // consumer itself, 0 if they all are. `start` becomes the position the
+    // consumer's instructions start at.
+    uint32_t take_operands(uint32_t b, const uint32_t* ops, uint32_t n, uint32_t& start) {
+        uint32_t e = n;
+        while (e > 0 && (pending.empty() || ops[e - 1] != pending.back())) {
+            e--;
+        }
+        uint32_t m = 0;
+        while (m < e && m < pending.size() && pending[pending.size() - 1 - m] == ops[e - 1 - m]) {
+            m++;
+        }
+        uint32_t j = e - m;
+        // the operands pushed before the run have to be defined before it;
+        // the values of a block are numbered in the order of its body
+        while (j < e) {
+            uint32_t first = f->body[f->blocks[b].first_value + tree_start[ops[j]]];
+            bool defined = true;
+            for (uint32_t k = 0; k < j && defined; k++) {
+                const F::Value& o = f->values[ops[k]];
+                defined = o.block != b || o.op == F::PHI || is_const(o.op) || ops[k] < first;
+            }
+            if (defined) {
+                break;
+            }
+            j++;
+        }
+        pending.resize(pending.size() - m);
+        // the operands outside the run are no longer taken from the stack
+        for (uint32_t k = 0; k < n; k++) {
+            if (k >= j && k < e) {
+                on_stack[ops[k]] = true;
+                continue;
+            }
+            auto it = std::find(pending.begin(), pending.end(), ops[k]);
+            if (it != pending.end()) {
+                pending.erase(it);
+            }
+        }
+        if (j == e) {
+            return 0;
+        }
+        start = tree_start[ops[j]];
+        if (j > 0) {
+            // the outer instruction's pushes go before those of its operands
+            uint32_t first = pushed.size();
+            pushed.insert(pushed.end(), ops, ops + j);
+            pushes.push_back({start, first, j});
+        }
+        return e;
+    }
+
+    // Numbers the locals by type, after the params: the values used across
+    // blocks each get one, the others share them by type as they die
+    void assign_locals(std::vector<Local>& locals) {
+        static const uint8_t types[] = {0x7F, 0x7E, 0x7D, 0x7C, 0x7B, 0x70, 0x6F};
+        const size_t num_types = sizeof(types) / sizeof(types[0]);
+        local_of.assign(f->values.size(), F::NONE);
+        stackify();
+        std::vector<uint32_t> slot_type(f->values.size());  // index into `types`
+        std::vector<uint32_t> count(num_types, 0);
+        std::vector<std::vector<uint32_t>> free(num_types);
+        auto type_index = [&](uint8_t t) {
+            size_t k = 0;
+            while (k < num_types && types[k] != t) {
+                k++;
+            }
+            if (k == num_types) {
+                throw LFortranException("ssa: unsupported value type");
+            }
+            return k;
+        };
+        auto take = [&](uint32_t v, bool shared) {
+            if (group[v] != v) {
+                return;  // it shares the local of its group, set below
+            }
+            size_t k = type_index(f->values[v].type);
+            slot_type[v] = k;
+            if (shared && !free[k].empty()) {
+                local_of[v] = free[k].back();
+                free[k].pop_back();
+            } else {
+                local_of[v] = count[k]++;
+            }
+        };
+        for (uint32_t v = 0; v < f->values.size(); v++) {
+            const F::Value& value = f->values[v];
+            if (uses[v] > 0 && (value.op == F::ZERO || value.op == F::PHI)) {
+                take(v, false);  // a zero must stay zero
+            }
+        }
+        for (uint32_t b = 0; b < f->blocks.size(); b++) {
+            const F::Block& block = f->blocks[b];
+            for (uint32_t i = 0; i < block.num_values; i++) {
+                uint32_t id = f->body[block.first_value + i];
+                const F::Value& v = f->values[id];
+                for (uint32_t k = 0; k < v.num_operands; k++) {
+                    uint32_t o = f->operands_of(v)[k];
+                    if (last_use[o] == i && local_of[o] != F::NONE && !freed(o, v, k)) {
+                        free[slot_type[o]].push_back(local_of[o]);
+                    }
+                }
+                if (v.op == F::PARAM || v.op == F::ZERO || v.op == F::PHI || uses[id] == 0 || is_const(v.op) ||
+                    v.type == F::NO_TYPE || v.type == F::MULTI || on_stack[id]) {
+                    continue;
+                }
+                take(id, last_use[id] != GLOBAL);
+            }
+        }
+
+        std::vector<uint32_t> base(num_types);
+        uint32_t next = f->param_types.size();
+        locals.clear();
+        for (size_t k = 0; k < num_types; k++) {
+            base[k] = next;
+            next += count[k];
+            if (count[k] > 0) {
+                locals.push_back({count[k], types[k]});
+            }
+        }
+        for (uint32_t v = 0; v < f->values.size(); v++) {
+            if (f->values[v].op == F::PARAM) {
+                local_of[v] = f->values[v].start;
+            } else if (local_of[v] != F::NONE) {
+                local_of[v] = base[slot_type[v]] + local_of[v];
+            }
+        }
+        for (uint32_t v = 0; v < f->values.size(); v++) {
+            if (group[v] != v) {
+                local_of[v] = local_of[group[v]];
+            }
+        }
+    }
+
+    // Whether operand `k` of `v` repeats an earlier one, which freed it
+    bool freed(uint32_t o, const F::Value& v, uint32_t k) const {
+        for (uint32_t j = 0; j < k; j++) {
+            if (f->operands_of(v)[j] == o) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void push(uint32_t v) {
+        const F::Value& value = f->values[v];
+        if (is_const(value.op)) {
+            out.emit_bytes(wasm_bytes.data() + value.start, value.size);
+        } else {
+            out.emit_get_local(local_of[v]);
+        }
+    }
+
+    // The operands pushed ahead of the instructions at position `i` of `b`
+    void emit_pushes(uint32_t b, uint32_t i, uint32_t& next) {
+        for (; next < first_push[b + 1] && pushes[next].position == i; next++) {
+            for (uint32_t k = 0; k < pushes[next].count; k++) {
+                push(pushed[pushes[next].first + k]);
+            }
+        }
+    }
+
+    void emit_block(uint32_t b) {
+        const F::Block& block = f->blocks[b];
+        uint32_t next = first_push[b];
+        for (uint32_t i = 0; i < block.num_values; i++) {
+            uint32_t id = f->body[block.first_value + i];
+            const F::Value& v = f->values[id];
+            emit_pushes(b, i, next);
+            if (v.op >= F::PHI) {
+                continue;  // params, zeros and the results of a call
+            }
+            if (is_const(v.op)) {
+                continue;  // emitted where it is used
+            }
+            for (uint32_t k = late[id]; k < v.num_operands; k++) {
+                push(f->operands_of(v)[k]);
+            }
+            out.emit_bytes(wasm_bytes.data() + v.start, v.size);
+            if (v.type == F::MULTI) {
+                // the results follow the call
+                uint32_t n = 0;
+                while (i + 1 + n < block.num_values && f->values[f->body[block.first_value + i + 1 + n]].op == F::RESULT) {
+                    n++;
+                }
+                for (uint32_t r = n; r-- > 0;) {
+                    store(f->body[block.first_value + i + 1 + r]);
+                }
+            } else if (v.type != F::NO_TYPE && !on_stack[id]) {
+                store(id);
+            }
+        }
+        emit_pushes(b, block.num_values, next);
+        emit_exit(b);
+    }
+
+    void store(uint32_t v) {
+        if (local_of[v] == F::NONE) {
+            out.emit_b8(0x1A);  // drop
+        } else {
+            out.emit_set_local(local_of[v]);
+        }
+    }
+
+    void push_cond(const F::Block& block) {
+        if (!on_stack[block.cond]) {
+            push(block.cond);
+        }
+    }
+
+    uint32_t depth(uint32_t target) const {
+        for (uint32_t d = 0; d < scopes.size(); d++) {
+            if (scopes[scopes.size() - 1 - d].target == target) {
+                return d;
+            }
+        }
+        throw LFortranException("ssa: branch to a block that is not open");
+    }
+
+    // The position of `from` among the predecessors of `to`
+    uint32_t pred_index(uint32_t from, const F::Block& to) const {
+        uint32_t pred = 0;
+        while (f->preds[to.first_pred + pred] != from) {
+            pred++;
+        }
+        return pred;
+    }
+
+    // Whether phi `phi` needs a write on the edge from its `pred`th
+    // predecessor, which it does not if it shares the local of the operand
+    bool writes(uint32_t phi, uint32_t pred) const {
+        return uses[phi] > 0 && group[phi] != group[f->operands_of(f->values[phi])[pred]];
+    }
+
+    bool needs_copies(uint32_t from, uint32_t to) const {
+        if (to == F::NONE) {
+            return true;  // a return
+        }
+        const F::Block& b = f->blocks[to];
+        uint32_t pred = pred_index(from, b);
+        for (uint32_t i = 0; i < b.num_phis; i++) {
+            if (writes(f->phis[b.first_phi + i], pred)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool needs_trampolines(uint32_t b) const {
+        const F::Block& block = f->blocks[b];
+        for (uint32_t i = 0; i < block.num_succs; i++) {
+            if (needs_copies(b, f->succs[block.first_succ + i])) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The writes of the phis of `to` along the edge from `from`, or the
+    // results of the function if `to` is NONE
+    void copy(uint32_t from, uint32_t to) {
+        if (to == F::NONE) {
+            const F::Block& block = f->blocks[from];
+            for (uint32_t k = exit_late[from]; k < block.num_operands; k++) {
+                push(f->operands[block.first_operand + k]);
+            }
+            if (!at_end || block.exit != F::RETURN) {
+                out.emit_b8(0x0F);  // return, unless the body ends here anyway
+            }
+            return;
+        }
+        const F::Block& b = f->blocks[to];
+        uint32_t pred = pred_index(from, b);
+        for (uint32_t i = 0; i < b.num_phis; i++) {
+            uint32_t phi = f->phis[b.first_phi + i];
+            if (writes(phi, pred)) {
+                push(f->operands_of(f->values[phi])[pred]);
+            }
+        }
+        for (uint32_t i = b.num_phis; i-- > 0;) {
+            uint32_t phi = f->phis[b.first_phi + i];
+            if (writes(phi, pred)) {
+                out.emit_set_local(local_of[phi]);
+            }
+        }
+    }
+
+    // Branches from `from` to `to` with the phis written, from inside
+    // `extra` blocks that are not in `scopes`
+    void branch(uint32_t from, uint32_t to, uint32_t extra) {
+        copy(from, to);
+        if (to != F::NONE) {
+            out.emit_b8(0x0C);
+            out.emit_u32(depth(to) + extra);
+        }
+    }
+
+    void emit_exit(uint32_t b) {
+        const F::Block& block = f->blocks[b];
+        const uint32_t* succs = f->succs.data() + block.first_succ;
+        switch (block.exit) {
+            case F::FALLTHROUGH: copy(b, succs[0]); break;
+            case F::BR: branch(b, succs[0], 0); break;
+            case F::BR_IF:
+                push_cond(block);
+                if (needs_copies(b, succs[0])) {
+                    out.emit_b8(0x04);
+                    out.emit_b8(0x40);
+                    branch(b, succs[0], 1);
+                    out.emit_end();
+                } else {
+                    out.emit_b8(0x0D);
+                    out.emit_u32(depth(succs[0]));
+                }
+                break;
+            case F::BR_TABLE: emit_br_table(b); break;
+            case F::IF: push_cond(block); break;
+            case F::RETURN: copy(b, F::NONE); break;
+            case F::UNREACHABLE: out.emit_b8(0x00); break;
+        }
+    }
+
+    void emit_br_table(uint32_t b) {
+        const F::Block& block = f->blocks[b];
+        const uint32_t* succs = f->succs.data() + block.first_succ;
+        uint32_t n = block.num_succs;
+        if (!needs_trampolines(b)) {
+            push_cond(block);
+            out.emit_b8(0x0E);
+            out.emit_u32(n - 1);
+            for (uint32_t i = 0; i < n; i++) {
+                out.emit_u32(depth(succs[i]));
+            }
+            return;
+        }
+        // one block per distinct target, the innermost for the first
+        targets.clear();
+        for (uint32_t i = 0; i < n; i++) {
+            if (std::find(targets.begin(), targets.end(), succs[i]) == targets.end()) {
+                targets.push_back(succs[i]);
+            }
+        }
+        uint32_t k = targets.size();
+        for (uint32_t i = 0; i < k; i++) {
+            out.emit_b8(0x02);
+            out.emit_b8(0x40);
+        }
+        push_cond(block);
+        out.emit_b8(0x0E);
+        out.emit_u32(n - 1);
+        for (uint32_t i = 0; i < n; i++) {
+            out.emit_u32(std::find(targets.begin(), targets.end(), succs[i]) - targets.begin());
+        }
+        for (uint32_t i = 0; i < k; i++) {
+            out.emit_end();
+            branch(b, targets[i], k - 1 - i);
+        }
+    }
+};
+
+struct SsaStats {
+    uint64_t functions = 0;
+    uint64_t blocks = 0;
+    uint64_t values = 0;  // instructions, phis, params and zeros
+    uint64_t phis = 0;
+    uint64_t code_bytes = 0;  // of the bodies lifted
+    double lift_seconds = 0;
+    size_t bytes_before = 0;
+    size_t bytes_after = 0;
+};
+
+// Lifts every function of the decoded module to SSA form and lowers it back,
+// and returns the rewritten module
+std::vector<uint8_t> ssa_round_trip(SsaStats& stats) {
+    SsaLifter lifter;
+    SsaLowering lowering;
+    SsaFunction function;
+    WASMAssembler section;
+    section.emit_u32(codes.size());
+    for (uint32_t i = 0; i < codes.size(); i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        lifter.lift(i, function);
+        stats.lift_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        stats.functions++;
+        stats.blocks += function.blocks.size();
+        stats.values += function.body.size() + function.phis.size();
+        stats.phis += function.phis.size();
+        stats.code_bytes += codes[i].size;
+        std::vector<Local> locals;
+        std::vector<uint8_t> insts = lowering.lower(function, locals);
+        emit_function_body(section, locals, insts);
+    }
+    stats.bytes_before += section_size(10);
+    stats.bytes_after += section.code.size();
+    return replace_code_section(section.code);
+}
+
+}  // namespace LFortran
+
+#endif  // LFORTRAN_WASM_SSA_H
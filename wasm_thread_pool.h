@@ -0,0 +1,117 @@
+#ifndef LFORTRAN_WASM_THREAD_POOL_H
+#define LFORTRAN_WASM_THREAD_POOL_H
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs loops of independent tasks on a fixed number of threads. Each worker
+// starts with a contiguous slice of the iteration space and takes tasks from
+// its front; a worker that runs dry steals the back half of the largest
+// remaining slice, so uneven task sizes still keep every core busy.
+class WorkStealingPool {
+   public:
+    unsigned num_threads;
+
+    explicit WorkStealingPool(unsigned num_threads = 0)
+        : num_threads(num_threads ? num_threads : std::max(1U, std::thread::hardware_concurrency())) {}
+
+    // Calls fn(i) exactly once for every i in [0, n). The first exception
+    // thrown by any task is rethrown here after all workers have stopped.
+    void parallel_for(uint32_t n, const std::function<void(uint32_t)>& fn) {
+        parallel_for(n, [&fn](uint32_t i, unsigned) { fn(i); });
+    }
+
+    // As above, also passing the worker that runs the task, below
+    // num_threads, so tasks can keep state per worker without locking
+    void parallel_for(uint32_t n, const std::function<void(uint32_t, unsigned)>& fn) {
+        unsigned workers = std::max(1U, std::min<unsigned>(num_threads, n));
+        std::vector<Range> ranges(workers);
+        for (unsigned w = 0; w < workers; w++) {
+            ranges[w].begin = (uint64_t)n * w / workers;
+            ranges[w].end = (uint64_t)n * (w + 1) / workers;
+        }
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        auto work = [&](unsigned w) {
+            uint32_t i;
+            while (take(ranges, w, i) || steal(ranges, w, i)) {
+                try {
+                    fn(i, w);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned w = 1; w < workers; w++) {
+            threads.emplace_back(work, w);
+        }
+        work(0);
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+   private:
+    struct Range {
+        std::mutex mutex;
+        uint32_t begin = 0;
+        uint32_t end = 0;
+    };
+
+    static bool take(std::vector<Range>& ranges, unsigned w, uint32_t& i) {
+        std::lock_guard<std::mutex> lock(ranges[w].mutex);
+        if (ranges[w].begin == ranges[w].end) {
+            return false;
+        }
+        i = ranges[w].begin++;
+        return true;
+    }
+
+    static bool steal(std::vector<Range>& ranges, unsigned w, uint32_t& i) {
+        while (true) {
+            unsigned victim = w;
+            uint32_t largest = 0;
+            for (unsigned v = 0; v < ranges.size(); v++) {
+                std::lock_guard<std::mutex> lock(ranges[v].mutex);
+                if (ranges[v].end - ranges[v].begin > largest) {
+                    largest = ranges[v].end - ranges[v].begin;
+                    victim = v;
+                }
+            }
+            if (largest == 0) {
+                return false;
+            }
+            uint32_t begin, end;
+            {
+                std::lock_guard<std::mutex> lock(ranges[victim].mutex);
+                uint32_t size = ranges[victim].end - ranges[victim].begin;
+                if (size == 0) {
+                    continue;  // drained while we were looking, pick again
+                }
+                end = ranges[victim].end;
+                begin = end - (size + 1) / 2;
+                ranges[victim].end = begin;
+            }
+            std::lock_guard<std::mutex> lock(ranges[w].mutex);
+            ranges[w].begin = begin + 1;
+            ranges[w].end = end;
+            i = begin;
+            return true;
+        }
+    }
+};
+
+#endif  // LFORTRAN_WASM_THREAD_POOL_H
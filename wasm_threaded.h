@@ -0,0 +1,447 @@
+#ifndef LFORTRAN_WASM_THREADED_H
+#define LFORTRAN_WASM_THREADED_H
+
+// Generated by grammar/wasm_instructions_visitor.py
+
+// Every instruction as X(Name, lowered opcode), for defining one handler of
+// the tail call threaded interpreter per instruction. Prefixed instructions
+// are numbered from OP_FC_PREFIX and OP_FD_PREFIX.
+#define WASM_THREADED_OPS(X) \
+    X(Unreachable, 0x00) \
+    X(Nop, 0x01) \
+    X(Block, 0x02) \
+    X(Loop, 0x03) \
+    X(If, 0x04) \
+    X(Else, 0x05) \
+    X(End, 0x0B) \
+    X(Br, 0x0C) \
+    X(BrIf, 0x0D) \
+    X(BrTable, 0x0E) \
+    X(Return, 0x0F) \
+    X(Call, 0x10) \
+    X(CallIndirect, 0x11) \
+    X(RefNull, 0xD0) \
+    X(RefIsNull, 0xD1) \
+    X(RefFunc, 0xD2) \
+    X(Drop, 0x1A) \
+    X(Select, 0x1B) \
+    X(LocalGet, 0x20) \
+    X(LocalSet, 0x21) \
+    X(LocalTee, 0x22) \
+    X(GlobalGet, 0x23) \
+    X(GlobalSet, 0x24) \
+    X(TableGet, 0x25) \
+    X(TableSet, 0x26) \
+    X(TableInit, OP_FC_PREFIX + 12) \
+    X(ElemDrop, OP_FC_PREFIX + 13) \
+    X(TableCopy, OP_FC_PREFIX + 14) \
+    X(TableGrow, OP_FC_PREFIX + 15) \
+    X(TableSize, OP_FC_PREFIX + 16) \
+    X(TableFill, OP_FC_PREFIX + 17) \
+    X(I32Load, 0x28) \
+    X(I64Load, 0x29) \
+    X(F32Load, 0x2A) \
+    X(F64Load, 0x2B) \
+    X(I32Load8S, 0x2C) \
+    X(I32Load8U, 0x2D) \
+    X(I32Load16S, 0x2E) \
+    X(I32Load16U, 0x2F) \
+    X(I64Load8S, 0x30) \
+    X(I64Load8U, 0x31) \
+    X(I64Load16S, 0x32) \
+    X(I64Load16U, 0x33) \
+    X(I64Load32S, 0x34) \
+    X(I64Load32U, 0x35) \
+    X(I32Store, 0x36) \
+    X(I64Store, 0x37) \
+    X(F32Store, 0x38) \
+    X(F64Store, 0x39) \
+    X(I32Store8, 0x3A) \
+    X(I32Store16, 0x3B) \
+    X(I64Store8, 0x3C) \
+    X(I64Store16, 0x3D) \
+    X(I64Store32, 0x3E) \
+    X(MemorySize, 0x3F) \
+    X(MemoryGrow, 0x40) \
+    X(MemoryInit, OP_FC_PREFIX + 8) \
+    X(DataDrop, OP_FC_PREFIX + 9) \
+    X(MemoryCopy, OP_FC_PREFIX + 10) \
+    X(MemoryFill, OP_FC_PREFIX + 11) \
+    X(I32Const, 0x41) \
+    X(I64Const, 0x42) \
+    X(F32Const, 0x43) \
+    X(F64Const, 0x44) \
+    X(I32Eqz, 0x45) \
+    X(I32Eq, 0x46) \
+    X(I32Ne, 0x47) \
+    X(I32LtS, 0x48) \
+    X(I32LtU, 0x49) \
+    X(I32GtS, 0x4A) \
+    X(I32GtU, 0x4B) \
+    X(I32LeS, 0x4C) \
+    X(I32LeU, 0x4D) \
+    X(I32GeS, 0x4E) \
+    X(I32GeU, 0x4F) \
+    X(I64Eqz, 0x50) \
+    X(I64Eq, 0x51) \
+    X(I64Ne, 0x52) \
+    X(I64LtS, 0x53) \
+    X(I64LtU, 0x54) \
+    X(I64GtS, 0x55) \
+    X(I64GtU, 0x56) \
+    X(I64LeS, 0x57) \
+    X(I64LeU, 0x58) \
+    X(I64GeS, 0x59) \
+    X(I64GeU, 0x5A) \
+    X(F32Eq, 0x5B) \
+    X(F32Ne, 0x5C) \
+    X(F32Lt, 0x5D) \
+    X(F32Gt, 0x5E) \
+    X(F32Le, 0x5F) \
+    X(F32Ge, 0x60) \
+    X(F64Eq, 0x61) \
+    X(F64Ne, 0x62) \
+    X(F64Lt, 0x63) \
+    X(F64Gt, 0x64) \
+    X(F64Le, 0x65) \
+    X(F64Ge, 0x66) \
+    X(I32Clz, 0x67) \
+    X(I32Ctz, 0x68) \
+    X(I32Popcnt, 0x69) \
+    X(I32Add, 0x6A) \
+    X(I32Sub, 0x6B) \
+    X(I32Mul, 0x6C) \
+    X(I32DivS, 0x6D) \
+    X(I32DivU, 0x6E) \
+    X(I32RemS, 0x6F) \
+    X(I32RemU, 0x70) \
+    X(I32And, 0x71) \
+    X(I32Or, 0x72) \
+    X(I32Xor, 0x73) \
+    X(I32Shl, 0x74) \
+    X(I32ShrS, 0x75) \
+    X(I32ShrU, 0x76) \
+    X(I32Rotl, 0x77) \
+    X(I32Rotr, 0x78) \
+    X(I64Clz, 0x79) \
+    X(I64Ctz, 0x7A) \
+    X(I64Popcnt, 0x7B) \
+    X(I64Add, 0x7C) \
+    X(I64Sub, 0x7D) \
+    X(I64Mul, 0x7E) \
+    X(I64DivS, 0x7F) \
+    X(I64DivU, 0x80) \
+    X(I64RemS, 0x81) \
+    X(I64RemU, 0x82) \
+    X(I64And, 0x83) \
+    X(I64Or, 0x84) \
+    X(I64Xor, 0x85) \
+    X(I64Shl, 0x86) \
+    X(I64ShrS, 0x87) \
+    X(I64ShrU, 0x88) \
+    X(I64Rotl, 0x89) \
+    X(I64Rotr, 0x8A) \
+    X(F32Abs, 0x8B) \
+    X(F32Neg, 0x8C) \
+    X(F32Ceil, 0x8D) \
+    X(F32Floor, 0x8E) \
+    X(F32Trunc, 0x8F) \
+    X(F32Nearest, 0x90) \
+    X(F32Sqrt, 0x91) \
+    X(F32Add, 0x92) \
+    X(F32Sub, 0x93) \
+    X(F32Mul, 0x94) \
+    X(F32Div, 0x95) \
+    X(F32Min, 0x96) \
+    X(F32Max, 0x97) \
+    X(F32Copysign, 0x98) \
+    X(F64Abs, 0x99) \
+    X(F64Neg, 0x9A) \
+    X(F64Ceil, 0x9B) \
+    X(F64Floor, 0x9C) \
+    X(F64Trunc, 0x9D) \
+    X(F64Nearest, 0x9E) \
+    X(F64Sqrt, 0x9F) \
+    X(F64Add, 0xA0) \
+    X(F64Sub, 0xA1) \
+    X(F64Mul, 0xA2) \
+    X(F64Div, 0xA3) \
+    X(F64Min, 0xA4) \
+    X(F64Max, 0xA5) \
+    X(F64Copysign, 0xA6) \
+    X(I32WrapI64, 0xA7) \
+    X(I32TruncF32S, 0xA8) \
+    X(I32TruncF32U, 0xA9) \
+    X(I32TruncF64S, 0xAA) \
+    X(I32TruncF64U, 0xAB) \
+    X(I64ExtendI32S, 0xAC) \
+    X(I64ExtendI32U, 0xAD) \
+    X(I64TruncF32S, 0xAE) \
+    X(I64TruncF32U, 0xAF) \
+    X(I64TruncF64S, 0xB0) \
+    X(I64TruncF64U, 0xB1) \
+    X(F32ConvertI32S, 0xB2) \
+    X(F32ConvertI32U, 0xB3) \
+    X(F32ConvertI64S, 0xB4) \
+    X(F32ConvertI64U, 0xB5) \
+    X(F32DemoteF64, 0xB6) \
+    X(F64ConvertI32S, 0xB7) \
+    X(F64ConvertI32U, 0xB8) \
+    X(F64ConvertI64S, 0xB9) \
+    X(F64ConvertI64U, 0xBA) \
+    X(F64PromoteF32, 0xBB) \
+    X(I32ReinterpretF32, 0xBC) \
+    X(I64ReinterpretF64, 0xBD) \
+    X(F32ReinterpretI32, 0xBE) \
+    X(F64ReinterpretI64, 0xBF) \
+    X(I32Extend8S, 0xC0) \
+    X(I32Extend16S, 0xC1) \
+    X(I64Extend8S, 0xC2) \
+    X(I64Extend16S, 0xC3) \
+    X(I64Extend32S, 0xC4) \
+    X(I32TruncSatF32S, OP_FC_PREFIX + 0) \
+    X(I32TruncSatF32U, OP_FC_PREFIX + 1) \
+    X(I32TruncSatF64S, OP_FC_PREFIX + 2) \
+    X(I32TruncSatF64U, OP_FC_PREFIX + 3) \
+    X(I64TruncSatF32S, OP_FC_PREFIX + 4) \
+    X(I64TruncSatF32U, OP_FC_PREFIX + 5) \
+    X(I64TruncSatF64S, OP_FC_PREFIX + 6) \
+    X(I64TruncSatF64U, OP_FC_PREFIX + 7) \
+    X(V128Load, OP_FD_PREFIX + 0) \
+    X(V128Load8x8S, OP_FD_PREFIX + 1) \
+    X(V128Load8x8U, OP_FD_PREFIX + 2) \
+    X(V128Load16x4S, OP_FD_PREFIX + 3) \
+    X(V128Load16x4U, OP_FD_PREFIX + 4) \
+    X(V128Load32x2S, OP_FD_PREFIX + 5) \
+    X(V128Load32x2U, OP_FD_PREFIX + 6) \
+    X(V128Load8Splat, OP_FD_PREFIX + 7) \
+    X(V128Load16Splat, OP_FD_PREFIX + 8) \
+    X(V128Load32Splat, OP_FD_PREFIX + 9) \
+    X(V128Load64Splat, OP_FD_PREFIX + 10) \
+    X(V128Load32Zero, OP_FD_PREFIX + 92) \
+    X(V128Load64Zero, OP_FD_PREFIX + 93) \
+    X(V128Store, OP_FD_PREFIX + 11) \
+    X(V128Load8Lane, OP_FD_PREFIX + 84) \
+    X(V128Load16Lane, OP_FD_PREFIX + 85) \
+    X(V128Load32Lane, OP_FD_PREFIX + 86) \
+    X(V128Load64Lane, OP_FD_PREFIX + 87) \
+    X(V128Store8Lane, OP_FD_PREFIX + 88) \
+    X(V128Store16Lane, OP_FD_PREFIX + 89) \
+    X(V128Store32Lane, OP_FD_PREFIX + 90) \
+    X(V128Store64Lane, OP_FD_PREFIX + 91) \
+    X(V128Const, OP_FD_PREFIX + 12) \
+    X(I8x16Shuffle, OP_FD_PREFIX + 13) \
+    X(I8x16ExtractLaneS, OP_FD_PREFIX + 21) \
+    X(I8x16ExtractLaneU, OP_FD_PREFIX + 22) \
+    X(I8x16ReplaceLane, OP_FD_PREFIX + 23) \
+    X(I16x8ExtractLaneS, OP_FD_PREFIX + 24) \
+    X(I16x8ExtractLaneU, OP_FD_PREFIX + 25) \
+    X(I16x8ReplaceLane, OP_FD_PREFIX + 26) \
+    X(I32x4ExtractLane, OP_FD_PREFIX + 27) \
+    X(I32x4ReplaceLane, OP_FD_PREFIX + 28) \
+    X(I64x2ExtractLane, OP_FD_PREFIX + 29) \
+    X(I64x2ReplaceLane, OP_FD_PREFIX + 30) \
+    X(F32x4ExtractLane, OP_FD_PREFIX + 31) \
+    X(F32x4ReplaceLane, OP_FD_PREFIX + 32) \
+    X(F64x2ExtractLane, OP_FD_PREFIX + 33) \
+    X(F64x2ReplaceLane, OP_FD_PREFIX + 34) \
+    X(I8x16Swizzle, OP_FD_PREFIX + 14) \
+    X(I8x16Splat, OP_FD_PREFIX + 15) \
+    X(I16x8Splat, OP_FD_PREFIX + 16) \
+    X(I32x4Splat, OP_FD_PREFIX + 17) \
+    X(I64x2Splat, OP_FD_PREFIX + 18) \
+    X(F32x4Splat, OP_FD_PREFIX + 19) \
+    X(F64x2Splat, OP_FD_PREFIX + 20) \
+    X(I8x16Eq, OP_FD_PREFIX + 35) \
+    X(I8x16Ne, OP_FD_PREFIX + 36) \
+    X(I8x16LtS, OP_FD_PREFIX + 37) \
+    X(I8x16LtU, OP_FD_PREFIX + 38) \
+    X(I8x16GtS, OP_FD_PREFIX + 39) \
+    X(I8x16GtU, OP_FD_PREFIX + 40) \
+    X(I8x16LeS, OP_FD_PREFIX + 41) \
+    X(I8x16LeU, OP_FD_PREFIX + 42) \
+    X(I8x16GeS, OP_FD_PREFIX + 43) \
+    X(I8x16GeU, OP_FD_PREFIX + 44) \
+    X(I16x8Eq, OP_FD_PREFIX + 45) \
+    X(I16x8Ne, OP_FD_PREFIX + 46) \
+    X(I16x8LtS, OP_FD_PREFIX + 47) \
+    X(I16x8LtU, OP_FD_PREFIX + 48) \
+    X(I16x8GtS, OP_FD_PREFIX + 49) \
+    X(I16x8GtU, OP_FD_PREFIX + 50) \
+    X(I16x8LeS, OP_FD_PREFIX + 51) \
+    X(I16x8LeU, OP_FD_PREFIX + 52) \
+    X(I16x8GeS, OP_FD_PREFIX + 53) \
+    X(I16x8GeU, OP_FD_PREFIX + 54) \
+    X(I32x4Eq, OP_FD_PREFIX + 55) \
+    X(I32x4Ne, OP_FD_PREFIX + 56) \
+    X(I32x4LtS, OP_FD_PREFIX + 57) \
+    X(I32x4LtU, OP_FD_PREFIX + 58) \
+    X(I32x4GtS, OP_FD_PREFIX + 59) \
+    X(I32x4GtU, OP_FD_PREFIX + 60) \
+    X(I32x4LeS, OP_FD_PREFIX + 61) \
+    X(I32x4LeU, OP_FD_PREFIX + 62) \
+    X(I32x4GeS, OP_FD_PREFIX + 63) \
+    X(I32x4GeU, OP_FD_PREFIX + 64) \
+    X(I64x2Eq, OP_FD_PREFIX + 214) \
+    X(I64x2Ne, OP_FD_PREFIX + 215) \
+    X(I64x2LtS, OP_FD_PREFIX + 216) \
+    X(I64x2GtS, OP_FD_PREFIX + 217) \
+    X(I64x2LeS, OP_FD_PREFIX + 218) \
+    X(I64x2GeS, OP_FD_PREFIX + 219) \
+    X(F32x4Eq, OP_FD_PREFIX + 65) \
+    X(F32x4Ne, OP_FD_PREFIX + 66) \
+    X(F32x4Lt, OP_FD_PREFIX + 67) \
+    X(F32x4Gt, OP_FD_PREFIX + 68) \
+    X(F32x4Le, OP_FD_PREFIX + 69) \
+    X(F32x4Ge, OP_FD_PREFIX + 70) \
+    X(F64x2Eq, OP_FD_PREFIX + 71) \
+    X(F64x2Ne, OP_FD_PREFIX + 72) \
+    X(F64x2Lt, OP_FD_PREFIX + 73) \
+    X(F64x2Gt, OP_FD_PREFIX + 74) \
+    X(F64x2Le, OP_FD_PREFIX + 75) \
+    X(F64x2Ge, OP_FD_PREFIX + 76) \
+    X(V128Not, OP_FD_PREFIX + 77) \
+    X(V128And, OP_FD_PREFIX + 78) \
+    X(V128Andnot, OP_FD_PREFIX + 79) \
+    X(V128Or, OP_FD_PREFIX + 80) \
+    X(V128Xor, OP_FD_PREFIX + 81) \
+    X(V128Bitselect, OP_FD_PREFIX + 82) \
+    X(V128AnyTrue, OP_FD_PREFIX + 83) \
+    X(I8x16Abs, OP_FD_PREFIX + 96) \
+    X(I8x16Neg, OP_FD_PREFIX + 97) \
+    X(I8x16Popcnt, OP_FD_PREFIX + 98) \
+    X(I8x16AllTrue, OP_FD_PREFIX + 99) \
+    X(I8x16Bitmask, OP_FD_PREFIX + 100) \
+    X(I8x16NarrowI16x8S, OP_FD_PREFIX + 101) \
+    X(I8x16NarrowI16x8U, OP_FD_PREFIX + 102) \
+    X(I8x16Shl, OP_FD_PREFIX + 107) \
+    X(I8x16ShrS, OP_FD_PREFIX + 108) \
+    X(I8x16ShrU, OP_FD_PREFIX + 109) \
+    X(I8x16Add, OP_FD_PREFIX + 110) \
+    X(I8x16AddSatS, OP_FD_PREFIX + 111) \
+    X(I8x16AddSatU, OP_FD_PREFIX + 112) \
+    X(I8x16Sub, OP_FD_PREFIX + 113) \
+    X(I8x16SubSatS, OP_FD_PREFIX + 114) \
+    X(I8x16SubSatU, OP_FD_PREFIX + 115) \
+    X(I8x16MinS, OP_FD_PREFIX + 118) \
+    X(I8x16MinU, OP_FD_PREFIX + 119) \
+    X(I8x16MaxS, OP_FD_PREFIX + 120) \
+    X(I8x16MaxU, OP_FD_PREFIX + 121) \
+    X(I8x16AvgrU, OP_FD_PREFIX + 123) \
+    X(I16x8ExtaddPairwiseI8x16S, OP_FD_PREFIX + 124) \
+    X(I16x8ExtaddPairwiseI8x16U, OP_FD_PREFIX + 125) \
+    X(I16x8Abs, OP_FD_PREFIX + 128) \
+    X(I16x8Neg, OP_FD_PREFIX + 129) \
+    X(I16x8Q15mulrSatS, OP_FD_PREFIX + 130) \
+    X(I16x8AllTrue, OP_FD_PREFIX + 131) \
+    X(I16x8Bitmask, OP_FD_PREFIX + 132) \
+    X(I16x8NarrowI32x4S, OP_FD_PREFIX + 133) \
+    X(I16x8NarrowI32x4U, OP_FD_PREFIX + 134) \
+    X(I16x8ExtendLowI8x16S, OP_FD_PREFIX + 135) \
+    X(I16x8ExtendHighI8x16S, OP_FD_PREFIX + 136) \
+    X(I16x8ExtendLowI8x16U, OP_FD_PREFIX + 137) \
+    X(I16x8ExtendHighI8x16U, OP_FD_PREFIX + 138) \
+    X(I16x8Shl, OP_FD_PREFIX + 139) \
+    X(I16x8ShrS, OP_FD_PREFIX + 140) \
+    X(I16x8ShrU, OP_FD_PREFIX + 141) \
+    X(I16x8Add, OP_FD_PREFIX + 142) \
+    X(I16x8AddSatS, OP_FD_PREFIX + 143) \
+    X(I16x8AddSatU, OP_FD_PREFIX + 144) \
+    X(I16x8Sub, OP_FD_PREFIX + 145) \
+    X(I16x8SubSatS, OP_FD_PREFIX + 146) \
+    X(I16x8SubSatU, OP_FD_PREFIX + 147) \
+    X(I16x8Mul, OP_FD_PREFIX + 149) \
+    X(I16x8MinS, OP_FD_PREFIX + 150) \
+    X(I16x8MinU, OP_FD_PREFIX + 151) \
+    X(I16x8MaxS, OP_FD_PREFIX + 152) \
+    X(I16x8MaxU, OP_FD_PREFIX + 153) \
+    X(I16x8AvgrU, OP_FD_PREFIX + 155) \
+    X(I16x8ExtmulLowI8x16S, OP_FD_PREFIX + 156) \
+    X(I16x8ExtmulHighI8x16S, OP_FD_PREFIX + 157) \
+    X(I16x8ExtmulLowI8x16U, OP_FD_PREFIX + 158) \
+    X(I16x8ExtmulHighI8x16U, OP_FD_PREFIX + 159) \
+    X(I32x4ExtaddPairwiseI16x8S, OP_FD_PREFIX + 126) \
+    X(I32x4ExtaddPairwiseI16x8U, OP_FD_PREFIX + 127) \
+    X(I32x4Abs, OP_FD_PREFIX + 160) \
+    X(I32x4Neg, OP_FD_PREFIX + 161) \
+    X(I32x4AllTrue, OP_FD_PREFIX + 163) \
+    X(I32x4Bitmask, OP_FD_PREFIX + 164) \
+    X(I32x4ExtendLowI16x8S, OP_FD_PREFIX + 167) \
+    X(I32x4ExtendHighI16x8S, OP_FD_PREFIX + 168) \
+    X(I32x4ExtendLowI16x8U, OP_FD_PREFIX + 169) \
+    X(I32x4ExtendHighI16x8U, OP_FD_PREFIX + 170) \
+    X(I32x4Shl, OP_FD_PREFIX + 171) \
+    X(I32x4ShrS, OP_FD_PREFIX + 172) \
+    X(I32x4ShrU, OP_FD_PREFIX + 173) \
+    X(I32x4Add, OP_FD_PREFIX + 174) \
+    X(I32x4Sub, OP_FD_PREFIX + 177) \
+    X(I32x4Mul, OP_FD_PREFIX + 181) \
+    X(I32x4MinS, OP_FD_PREFIX + 182) \
+    X(I32x4MinU, OP_FD_PREFIX + 183) \
+    X(I32x4MaxS, OP_FD_PREFIX + 184) \
+    X(I32x4MaxU, OP_FD_PREFIX + 185) \
+    X(I32x4DotI16x8S, OP_FD_PREFIX + 186) \
+    X(I32x4ExtmulLowI16x8S, OP_FD_PREFIX + 188) \
+    X(I32x4ExtmulHighI16x8S, OP_FD_PREFIX + 189) \
+    X(I32x4ExtmulLowI16x8U, OP_FD_PREFIX + 190) \
+    X(I32x4ExtmulHighI16x8U, OP_FD_PREFIX + 191) \
+    X(I64x2Abs, OP_FD_PREFIX + 192) \
+    X(I64x2Neg, OP_FD_PREFIX + 193) \
+    X(I64x2AllTrue, OP_FD_PREFIX + 195) \
+    X(I64x2Bitmask, OP_FD_PREFIX + 196) \
+    X(I64x2ExtendLowI32x4S, OP_FD_PREFIX + 199) \
+    X(I64x2ExtendHighI32x4S, OP_FD_PREFIX + 200) \
+    X(I64x2ExtendLowI32x4U, OP_FD_PREFIX + 201) \
+    X(I64x2ExtendHighI32x4U, OP_FD_PREFIX + 202) \
+    X(I64x2Shl, OP_FD_PREFIX + 203) \
+    X(I64x2ShrS, OP_FD_PREFIX + 204) \
+    X(I64x2ShrU, OP_FD_PREFIX + 205) \
+    X(I64x2Add, OP_FD_PREFIX + 206) \
+    X(I64x2Sub, OP_FD_PREFIX + 209) \
+    X(I64x2Mul, OP_FD_PREFIX + 213) \
+    X(I64x2ExtmulLowI32x4S, OP_FD_PREFIX + 220) \
+    X(I64x2ExtmulHighI32x4S, OP_FD_PREFIX + 221) \
+    X(I64x2ExtmulLowI32x4U, OP_FD_PREFIX + 222) \
+    X(I64x2ExtmulHighI32x4U, OP_FD_PREFIX + 223) \
+    X(F32x4Ceil, OP_FD_PREFIX + 103) \
+    X(F32x4Floor, OP_FD_PREFIX + 104) \
+    X(F32x4Trunc, OP_FD_PREFIX + 105) \
+    X(F32x4Nearest, OP_FD_PREFIX + 106) \
+    X(F32x4Abs, OP_FD_PREFIX + 224) \
+    X(F32x4Neg, OP_FD_PREFIX + 225) \
+    X(F32x4Sqrt, OP_FD_PREFIX + 227) \
+    X(F32x4Add, OP_FD_PREFIX + 228) \
+    X(F32x4Sub, OP_FD_PREFIX + 229) \
+    X(F32x4Mul, OP_FD_PREFIX + 230) \
+    X(F32x4Div, OP_FD_PREFIX + 231) \
+    X(F32x4Min, OP_FD_PREFIX + 232) \
+    X(F32x4Max, OP_FD_PREFIX + 233) \
+    X(F32x4Pmin, OP_FD_PREFIX + 234) \
+    X(F32x4Pmax, OP_FD_PREFIX + 235) \
+    X(F64x2Ceil, OP_FD_PREFIX + 116) \
+    X(F64x2Floor, OP_FD_PREFIX + 117) \
+    X(F64x2Trunc, OP_FD_PREFIX + 122) \
+    X(F64x2Nearest, OP_FD_PREFIX + 148) \
+    X(F64x2Abs, OP_FD_PREFIX + 236) \
+    X(F64x2Neg, OP_FD_PREFIX + 237) \
+    X(F64x2Sqrt, OP_FD_PREFIX + 239) \
+    X(F64x2Add, OP_FD_PREFIX + 240) \
+    X(F64x2Sub, OP_FD_PREFIX + 241) \
+    X(F64x2Mul, OP_FD_PREFIX + 242) \
+    X(F64x2Div, OP_FD_PREFIX + 243) \
+    X(F64x2Min, OP_FD_PREFIX + 244) \
+    X(F64x2Max, OP_FD_PREFIX + 245) \
+    X(F64x2Pmin, OP_FD_PREFIX + 246) \
+    X(F64x2Pmax, OP_FD_PREFIX + 247) \
+    X(I32x4TruncSatF32x4S, OP_FD_PREFIX + 248) \
+    X(I32x4TruncSatF32x4U, OP_FD_PREFIX + 249) \
+    X(F32x4ConvertI32x4S, OP_FD_PREFIX + 250) \
+    X(F32x4ConvertI32x4U, OP_FD_PREFIX + 251) \
+    X(I32x4TruncSatF64x2SZero, OP_FD_PREFIX + 252) \
+    X(I32x4TruncSatF64x2UZero, OP_FD_PREFIX + 253) \
+    X(F64x2ConvertLowI32x4S, OP_FD_PREFIX + 254) \
+    X(F64x2ConvertLowI32x4U, OP_FD_PREFIX + 255) \
+    X(F32x4DemoteF64x2Zero, OP_FD_PREFIX + 94) \
+    X(F64x2PromoteLowF32x4, OP_FD_PREFIX + 95)
+
+#endif // LFORTRAN_WASM_THREADED_H
@@ -1,12 +1,54 @@
+#ifndef LFORTRAN_WASM_TO_WAT_H
+#define LFORTRAN_WASM_TO_WAT_H
+
 #include "wasm_visitor.h"
 
 namespace LFortran::WASM_INSTS_VISITOR {
 class WATVisitor : public BaseWASMVisitor<WATVisitor> {
    public:
     std::string src, indent;
+    std::vector<uint32_t> line_offsets;  // module byte offset of every line of src
 
     WATVisitor() : src(""), indent("") {}
 
+    // every instruction prints one line
+    void begin_instruction(uint32_t offset) { line_offsets.push_back(offset); }
+
+    void block(const std::string& name, int64_t blocktype) {
+        src += indent + name;
+        if (blocktype >= 0) {
+            src += " (type " + std::to_string(blocktype) + ")";
+        } else if (blocktype != -64) {
+            src += " (result " + type_to_string[blocktype & 0x7F] + ")";
+        }
+        indent += "    ";
+    }
+
+    void visit_Block(int64_t blocktype) { block("block", blocktype); }
+
+    void visit_Loop(int64_t blocktype) { block("loop", blocktype); }
+
+    void visit_If(int64_t blocktype) { block("if", blocktype); }
+
+    void visit_Else() { src += indent.substr(0, indent.size() - 4) + "else"; }
+
+    void visit_End() {
+        indent.resize(indent.size() - 4);
+        src += indent + "end";
+    }
+
+    void visit_Br(uint32_t labelidx) { src += indent + "br " + std::to_string(labelidx); }
+
+    void visit_BrIf(uint32_t labelidx) { src += indent + "br_if " + std::to_string(labelidx); }
+
+    void visit_BrTable(const std::vector<uint32_t>& labelidxs, uint32_t default_labelidx) {
+        src += indent + "br_table";
+        for (uint32_t l : labelidxs) {
+            src += " " + std::to_string(l);
+        }
+        src += " " + std::to_string(default_labelidx);
+    }
+
     void visit_Return() { src += indent + "return"; }
 
     void visit_Call(uint32_t func_index) { src += indent + "call " + std::to_string(func_index); }
@@ -26,3 +68,5 @@ class WATVisitor : public BaseWASMVisitor<WATVisitor> {
     void visit_I32DivS() { src += indent + "i32.div_s"; }
 };
 } // namespace LFortran::WASM_INSTRUCTIONS_VISITOR
+
+#endif  // LFORTRAN_WASM_TO_WAT_H
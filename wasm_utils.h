@@ -4,6 +4,7 @@
 #include <iostream>
 #include <vector>
 #include <fstream>
+#include <cstring>
 #include <unordered_map>
 
 // this is temporary, we may not need this when we integrate with LFortran
@@ -11,15 +12,26 @@ namespace LFortran {
 std::string LFortranException(std::string msg) { return "LFortranException: " + msg; }
 }  // namespace LFortran
 
-std::unordered_map<uint8_t, std::string> type_to_string = {{0x7F, "i32"}, {0x7E, "i64"}, {0x7D, "f32"}, {0x7C, "f64"}};
+std::unordered_map<uint8_t, std::string> type_to_string = {{0x7F, "i32"}, {0x7E, "i64"}, {0x7D, "f32"}, {0x7C, "f64"}, {0x7B, "v128"}};
 
 std::unordered_map<uint8_t, std::string> kind_to_string = {{0x00, "func"}, {0x01, "table"}, {0x02, "mem"}, {0x03, "global"}};
 
+struct v128_t {
+    uint8_t bytes[16];
+};
+
 struct FuncType {
     std::vector<uint8_t> param_types;
     std::vector<uint8_t> result_types;
 };
 
+struct Import {
+    std::string module;
+    std::string name;
+    uint8_t kind;
+    uint32_t type_index;  // of a function import, unused for the other kinds
+};
+
 struct Export {
     std::string name;
     uint8_t kind;
@@ -35,13 +47,90 @@ struct Code {
     int size;
     std::vector<Local> locals;
     uint32_t insts_start_index;
+    // What the body needs at run time, in values. Filled in once, when the
+    // function is first lowered.
+    bool analyzed = false;
+    uint32_t max_stack = 0;   // operand stack depth above the locals
+    uint32_t frame_size = 0;  // the locals, including the params, and max_stack
+    std::vector<uint32_t> callees;         // functions it calls directly
+    std::vector<uint32_t> indirect_types;  // type indices of its call_indirects
+};
+
+struct Limits {
+    uint32_t min;
+    uint32_t max;
+    bool has_max;
+};
+
+struct Global {
+    uint8_t type;
+    uint8_t mut;
+    uint32_t insts_start_index;  // constant initializer expression
+};
+
+struct Table {
+    uint8_t type;
+    Limits limits;
+};
+
+struct Element {
+    uint32_t kind;  // the segment flags, bit 0 set means passive or declarative
+    uint32_t table_index;
+    uint32_t insts_start_index;  // offset expression of an active segment
+    std::vector<uint32_t> func_indices;  // NULL_REF for ref.null entries
+};
+
+struct Data {
+    uint32_t kind;  // 0 and 2 are active, 1 is passive
+    uint32_t insts_start_index;  // offset expression of an active segment
+    uint32_t bytes_start;
+    uint32_t size;
 };
 
 std::vector<uint8_t> wasm_bytes;
 std::vector<FuncType> func_types;
 std::vector<uint32_t> type_indices;
+std::vector<Import> imports;
 std::vector<Export> exports;
 std::vector<Code> codes;
+std::vector<Table> tables;
+std::vector<Limits> memories;
+std::vector<Global> globals;
+std::vector<Element> elements;
+std::vector<Data> datas;
+
+const uint32_t NULL_REF = 0xFFFFFFFFU;
+const uint32_t NO_START = 0xFFFFFFFFU;
+
+// The function the start section names, NO_START if there is none
+uint32_t start_function = NO_START;
+
+// Instructions of the 0xFC and 0xFD prefixes are numbered from these, so that
+// every opcode fits one number
+const uint32_t OP_FC_PREFIX = 0x100;
+const uint32_t OP_FD_PREFIX = 0x200;
+
+// Imported functions come first in the function index space, followed by the
+// functions of the code section.
+uint32_t num_imported_funcs() {
+    uint32_t n = 0;
+    for (const Import& i : imports) {
+        n += i.kind == 0x00;
+    }
+    return n;
+}
+
+uint32_t num_funcs() { return num_imported_funcs() + codes.size(); }
+
+uint32_t func_type_index(uint32_t func_idx) {
+    uint32_t n = 0;
+    for (const Import& i : imports) {
+        if (i.kind == 0x00 && n++ == func_idx) {
+            return i.type_index;
+        }
+    }
+    return type_indices[func_idx - n];
+}
 
 uint32_t decode_unsigned_leb128(uint32_t& offset) {
     uint32_t result = 0U;
@@ -75,8 +164,30 @@ int32_t decode_signed_leb128(uint32_t& offset) {
     return result;
 }
 
+int64_t decode_signed_leb128_64(uint32_t& offset) {
+    int64_t result = 0;
+    uint32_t shift = 0U;
+    uint32_t size = 64U;
+    uint8_t byte;
+
+    do {
+        byte = wasm_bytes[offset++];
+        result |= (int64_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while ((byte & 0x80) != 0);
+
+    if ((shift < size) && (byte & 0x40)) {
+        result |= (int64_t)(~(uint64_t)0 << shift);
+    }
+
+    return result;
+}
+
 void load_file(std::string filename) {
     std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        throw LFortran::LFortranException("cannot read " + filename);
+    }
     file.seekg(0, std::ios::end);
     size_t size = file.tellg();
     file.seekg(0, std::ios::beg);
@@ -85,6 +196,34 @@ void load_file(std::string filename) {
     file.close();
 }
 
+// The name of a function for tools: its export name, or `$<index>` as in the
+// WAT output
+std::string function_name(uint32_t func_idx) {
+    for (const Export& e : exports) {
+        if (e.kind == 0x00 && e.index == func_idx) {
+            return e.name;
+        }
+    }
+    return "$" + std::to_string(func_idx);
+}
+
+// 64-bit FNV-1a taking eight bytes per step, identifies the contents of a
+// module. A byte per step made hashing cost more than the module cache saves.
+uint64_t hash_bytes(const uint8_t* data, size_t size) {
+    uint64_t h = 0xcbf29ce484222325ULL ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        h = (h ^ word) * 0x100000001b3ULL;
+        h ^= h >> 32;
+    }
+    for (; i < size; i++) {
+        h = (h ^ data[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
 uint8_t read_byte(uint32_t& offset) {
     if (offset >= wasm_bytes.size()) {
         throw LFortran::LFortranException("read_byte: offset out of bounds");
@@ -93,17 +232,113 @@ uint8_t read_byte(uint32_t& offset) {
 }
 
 float read_float(uint32_t& offset) {
-    // to implement
-    return 0.00;
+    if (offset + sizeof(float) > wasm_bytes.size()) {
+        throw LFortran::LFortranException("read_float: offset out of bounds");
+    }
+    float f;
+    std::memcpy(&f, &wasm_bytes[offset], sizeof(float));
+    offset += sizeof(float);
+    return f;
 }
 
 double read_double(uint32_t& offset) {
-    // to implement
-    return 0.00;
+    if (offset + sizeof(double) > wasm_bytes.size()) {
+        throw LFortran::LFortranException("read_double: offset out of bounds");
+    }
+    double d;
+    std::memcpy(&d, &wasm_bytes[offset], sizeof(double));
+    offset += sizeof(double);
+    return d;
+}
+
+v128_t read_v128(uint32_t& offset) {
+    if (offset + sizeof(v128_t) > wasm_bytes.size()) {
+        throw LFortran::LFortranException("read_v128: offset out of bounds");
+    }
+    v128_t v;
+    std::memcpy(v.bytes, &wasm_bytes[offset], sizeof(v128_t));
+    offset += sizeof(v128_t);
+    return v;
 }
 
+// Appends plain values, vectors of them and strings to a byte buffer
+struct ByteWriter {
+    std::vector<uint8_t>& out;
+
+    template <typename T>
+    void put(const T& x) {
+        const uint8_t* p = (const uint8_t*)&x;
+        out.insert(out.end(), p, p + sizeof(T));
+    }
+
+    template <typename T>
+    void put_vector(const std::vector<T>& v) {
+        put<uint64_t>(v.size());
+        const uint8_t* p = (const uint8_t*)v.data();
+        out.insert(out.end(), p, p + v.size() * sizeof(T));
+    }
+
+    void put_string(const std::string& s) {
+        put<uint64_t>(s.size());
+        out.insert(out.end(), s.begin(), s.end());
+    }
+};
+
+// Reads back what a ByteWriter wrote, throwing if the buffer is too short
+struct ByteReader {
+    const uint8_t* in;
+    size_t size;
+    size_t pos;
+
+    template <typename T>
+    T get() {
+        T x;
+        take(&x, sizeof(T));
+        return x;
+    }
+
+    template <typename T>
+    std::vector<T> get_vector() {
+        uint64_t n = get<uint64_t>();
+        if (n > (size - pos) / sizeof(T)) {
+            throw LFortran::LFortranException("ByteReader: truncated data");
+        }
+        std::vector<T> v(n);
+        take(v.data(), n * sizeof(T));
+        return v;
+    }
+
+    std::string get_string() {
+        std::vector<char> v = get_vector<char>();
+        return std::string(v.begin(), v.end());
+    }
+
+   private:
+    void take(void* data, size_t n) {
+        if (n > size - pos) {
+            throw LFortran::LFortranException("ByteReader: truncated data");
+        }
+        std::memcpy(data, in + pos, n);
+        pos += n;
+    }
+};
+
 int32_t read_signed_num(uint32_t& offset) { return decode_signed_leb128(offset); }
 
+int64_t read_signed_num64(uint32_t& offset) { return decode_signed_leb128_64(offset); }
+
 uint32_t read_unsigned_num(uint32_t& offset) { return decode_unsigned_leb128(offset); }
 
+std::vector<uint32_t> read_u32_vector(uint32_t& offset) {
+    uint32_t size = read_unsigned_num(offset);
+    if (size > wasm_bytes.size() - offset) {
+        throw LFortran::LFortranException("read_u32_vector: size out of bounds");
+    }
+    std::vector<uint32_t> v(size);
+    for (uint32_t i = 0; i < size; i++) {
+        v[i] = read_unsigned_num(offset);
+    }
+    return v;
+}
+
 #endif  // LFORTRAN_WASM_UTILS_H
@@ -22,10 +22,22 @@ public:
 
     void visit_Nop() {throw LFortran::LFortranException("visit_Nop() not implemented");}
 
+    void visit_Block(int64_t /*blocktype*/) {throw LFortran::LFortranException("visit_Block() not implemented");}
+
+    void visit_Loop(int64_t /*blocktype*/) {throw LFortran::LFortranException("visit_Loop() not implemented");}
+
+    void visit_If(int64_t /*blocktype*/) {throw LFortran::LFortranException("visit_If() not implemented");}
+
+    void visit_Else() {throw LFortran::LFortranException("visit_Else() not implemented");}
+
+    void visit_End() {throw LFortran::LFortranException("visit_End() not implemented");}
+
     void visit_Br(uint32_t /*labelidx*/) {throw LFortran::LFortranException("visit_Br() not implemented");}
 
     void visit_BrIf(uint32_t /*labelidx*/) {throw LFortran::LFortranException("visit_BrIf() not implemented");}
 
+    void visit_BrTable(std::vector<uint32_t> /*labelidxs*/, uint32_t /*default_labelidx*/) {throw LFortran::LFortranException("visit_BrTable() not implemented");}
+
     void visit_Return() {throw LFortran::LFortranException("visit_Return() not implemented");}
 
     void visit_Call(uint32_t /*funcidx*/) {throw LFortran::LFortranException("visit_Call() not implemented");}
@@ -68,51 +80,51 @@ public:
 
     void visit_TableFill(uint32_t /*tableidx*/) {throw LFortran::LFortranException("visit_TableFill() not implemented");}
 
-    void visit_I32Load(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I32Load() not implemented");}
+    void visit_I32Load(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I32Load() not implemented");}
 
-    void visit_I64Load(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I64Load() not implemented");}
+    void visit_I64Load(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I64Load() not implemented");}
 
-    void visit_F32Load(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_F32Load() not implemented");}
+    void visit_F32Load(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_F32Load() not implemented");}
 
-    void visit_F64Load(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_F64Load() not implemented");}
+    void visit_F64Load(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_F64Load() not implemented");}
 
-    void visit_I32Load8S(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I32Load8S() not implemented");}
+    void visit_I32Load8S(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I32Load8S() not implemented");}
 
-    void visit_I32Load8U(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I32Load8U() not implemented");}
+    void visit_I32Load8U(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I32Load8U() not implemented");}
 
-    void visit_I32Load16S(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I32Load16S() not implemented");}
+    void visit_I32Load16S(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I32Load16S() not implemented");}
 
-    void visit_I32Load16U(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I32Load16U() not implemented");}
+    void visit_I32Load16U(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I32Load16U() not implemented");}
 
-    void visit_I64Load8S(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I64Load8S() not implemented");}
+    void visit_I64Load8S(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I64Load8S() not implemented");}
 
-    void visit_I64Load8U(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I64Load8U() not implemented");}
+    void visit_I64Load8U(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I64Load8U() not implemented");}
 
-    void visit_I64Load16S(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I64Load16S() not implemented");}
+    void visit_I64Load16S(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I64Load16S() not implemented");}
 
-    void visit_I64Load16U(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I64Load16U() not implemented");}
+    void visit_I64Load16U(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I64Load16U() not implemented");}
 
-    void visit_I64Load32S(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I64Load32S() not implemented");}
+    void visit_I64Load32S(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I64Load32S() not implemented");}
 
-    void visit_I64Load32U(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I64Load32U() not implemented");}
+    void visit_I64Load32U(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I64Load32U() not implemented");}
 
-    void visit_I32Store(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I32Store() not implemented");}
+    void visit_I32Store(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I32Store() not implemented");}
 
-    void visit_I64Store(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I64Store() not implemented");}
+    void visit_I64Store(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I64Store() not implemented");}
 
-    void visit_F32Store(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_F32Store() not implemented");}
+    void visit_F32Store(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_F32Store() not implemented");}
 
-    void visit_F64Store(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_F64Store() not implemented");}
+    void visit_F64Store(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_F64Store() not implemented");}
 
-    void visit_I32Store8(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I32Store8() not implemented");}
+    void visit_I32Store8(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I32Store8() not implemented");}
 
-    void visit_I32Store16(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I32Store16() not implemented");}
+    void visit_I32Store16(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I32Store16() not implemented");}
 
-    void visit_I64Store8(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I64Store8() not implemented");}
+    void visit_I64Store8(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I64Store8() not implemented");}
 
-    void visit_I64Store16(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I64Store16() not implemented");}
+    void visit_I64Store16(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I64Store16() not implemented");}
 
-    void visit_I64Store32(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_I64Store32() not implemented");}
+    void visit_I64Store32(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_I64Store32() not implemented");}
 
     void visit_MemorySize() {throw LFortran::LFortranException("visit_MemorySize() not implemented");}
 
@@ -406,49 +418,53 @@ public:
 
     void visit_I64TruncSatF64U() {throw LFortran::LFortranException("visit_I64TruncSatF64U() not implemented");}
 
-    void visit_V128Load(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_V128Load() not implemented");}
+    void visit_V128Load(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_V128Load() not implemented");}
+
+    void visit_V128Load8x8S(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_V128Load8x8S() not implemented");}
 
-    void visit_V128Load8x8S(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_V128Load8x8S() not implemented");}
+    void visit_V128Load8x8U(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_V128Load8x8U() not implemented");}
 
-    void visit_V128Load8x8U(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_V128Load8x8U() not implemented");}
+    void visit_V128Load16x4S(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_V128Load16x4S() not implemented");}
 
-    void visit_V128Load16x4S(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_V128Load16x4S() not implemented");}
+    void visit_V128Load16x4U(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_V128Load16x4U() not implemented");}
 
-    void visit_V128Load16x4U(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_V128Load16x4U() not implemented");}
+    void visit_V128Load32x2S(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_V128Load32x2S() not implemented");}
 
-    void visit_V128Load32x2S(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_V128Load32x2S() not implemented");}
+    void visit_V128Load32x2U(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_V128Load32x2U() not implemented");}
 
-    void visit_V128Load32x2U(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_V128Load32x2U() not implemented");}
+    void visit_V128Load8Splat(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_V128Load8Splat() not implemented");}
 
-    void visit_V128Load8Splat(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_V128Load8Splat() not implemented");}
+    void visit_V128Load16Splat(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_V128Load16Splat() not implemented");}
 
-    void visit_V128Load16Splat(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_V128Load16Splat() not implemented");}
+    void visit_V128Load32Splat(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_V128Load32Splat() not implemented");}
 
-    void visit_V128Load32Splat(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_V128Load32Splat() not implemented");}
+    void visit_V128Load64Splat(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_V128Load64Splat() not implemented");}
 
-    void visit_V128Load64Splat(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_V128Load64Splat() not implemented");}
+    void visit_V128Load32Zero(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_V128Load32Zero() not implemented");}
 
-    void visit_V128Load32Zero(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_V128Load32Zero() not implemented");}
+    void visit_V128Load64Zero(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_V128Load64Zero() not implemented");}
 
-    void visit_V128Load64Zero(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_V128Load64Zero() not implemented");}
+    void visit_V128Store(uint32_t /*mem_align*/, uint32_t /*mem_offset*/) {throw LFortran::LFortranException("visit_V128Store() not implemented");}
 
-    void visit_V128Store(uint32_t /*align*/, uint32_t /*offset*/) {throw LFortran::LFortranException("visit_V128Store() not implemented");}
+    void visit_V128Load8Lane(uint32_t /*mem_align*/, uint32_t /*mem_offset*/, uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_V128Load8Lane() not implemented");}
 
-    void visit_V128Load8Lane(uint32_t /*align*/, uint32_t /*offset*/, uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_V128Load8Lane() not implemented");}
+    void visit_V128Load16Lane(uint32_t /*mem_align*/, uint32_t /*mem_offset*/, uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_V128Load16Lane() not implemented");}
 
-    void visit_V128Load16Lane(uint32_t /*align*/, uint32_t /*offset*/, uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_V128Load16Lane() not implemented");}
+    void visit_V128Load32Lane(uint32_t /*mem_align*/, uint32_t /*mem_offset*/, uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_V128Load32Lane() not implemented");}
 
-    void visit_V128Load32Lane(uint32_t /*align*/, uint32_t /*offset*/, uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_V128Load32Lane() not implemented");}
+    void visit_V128Load64Lane(uint32_t /*mem_align*/, uint32_t /*mem_offset*/, uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_V128Load64Lane() not implemented");}
 
-    void visit_V128Load64Lane(uint32_t /*align*/, uint32_t /*offset*/, uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_V128Load64Lane() not implemented");}
+    void visit_V128Store8Lane(uint32_t /*mem_align*/, uint32_t /*mem_offset*/, uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_V128Store8Lane() not implemented");}
 
-    void visit_V128Store8Lane(uint32_t /*align*/, uint32_t /*offset*/, uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_V128Store8Lane() not implemented");}
+    void visit_V128Store16Lane(uint32_t /*mem_align*/, uint32_t /*mem_offset*/, uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_V128Store16Lane() not implemented");}
 
-    void visit_V128Store16Lane(uint32_t /*align*/, uint32_t /*offset*/, uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_V128Store16Lane() not implemented");}
+    void visit_V128Store32Lane(uint32_t /*mem_align*/, uint32_t /*mem_offset*/, uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_V128Store32Lane() not implemented");}
 
-    void visit_V128Store32Lane(uint32_t /*align*/, uint32_t /*offset*/, uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_V128Store32Lane() not implemented");}
+    void visit_V128Store64Lane(uint32_t /*mem_align*/, uint32_t /*mem_offset*/, uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_V128Store64Lane() not implemented");}
 
-    void visit_V128Store64Lane(uint32_t /*align*/, uint32_t /*offset*/, uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_V128Store64Lane() not implemented");}
+    void visit_V128Const(v128_t /*bytes*/) {throw LFortran::LFortranException("visit_V128Const() not implemented");}
+
+    void visit_I8x16Shuffle(v128_t /*laneidxs*/) {throw LFortran::LFortranException("visit_I8x16Shuffle() not implemented");}
 
     void visit_I8x16ExtractLaneS(uint8_t /*laneidx*/) {throw LFortran::LFortranException("visit_I8x16ExtractLaneS() not implemented");}
 
@@ -874,9 +890,13 @@ public:
 
     void visit_F64x2PromoteLowF32x4() {throw LFortran::LFortranException("visit_F64x2PromoteLowF32x4() not implemented");}
 
-    void decode_instructions(uint32_t offset) {
+    void begin_instruction(uint32_t /*offset*/) {}
+
+    uint32_t decode_instructions(uint32_t offset) {
+        uint32_t depth = 0;
         uint8_t cur_byte = read_byte(offset);
-        while (cur_byte != 0x0B) {
+        while (cur_byte != 0x0B || depth > 0) {
+            self().begin_instruction(offset - 1);
             switch (cur_byte) {
                 case 0x00: {
                     self().visit_Unreachable();
@@ -886,6 +906,33 @@ public:
                     self().visit_Nop();
                     break;
                 }
+                case 0x02: {
+                    int64_t blocktype = read_signed_num64(offset);
+                    self().visit_Block(blocktype);
+                    depth++;
+                    break;
+                }
+                case 0x03: {
+                    int64_t blocktype = read_signed_num64(offset);
+                    self().visit_Loop(blocktype);
+                    depth++;
+                    break;
+                }
+                case 0x04: {
+                    int64_t blocktype = read_signed_num64(offset);
+                    self().visit_If(blocktype);
+                    depth++;
+                    break;
+                }
+                case 0x05: {
+                    self().visit_Else();
+                    break;
+                }
+                case 0x0B: {
+                    self().visit_End();
+                    depth--;
+                    break;
+                }
                 case 0x0C: {
                     uint32_t labelidx = read_unsigned_num(offset);
                     self().visit_Br(labelidx);
@@ -896,6 +943,12 @@ public:
                     self().visit_BrIf(labelidx);
                     break;
                 }
+                case 0x0E: {
+                    std::vector<uint32_t> labelidxs = read_u32_vector(offset);
+                    uint32_t default_labelidx = read_unsigned_num(offset);
+                    self().visit_BrTable(labelidxs, default_labelidx);
+                    break;
+                }
                 case 0x0F: {
                     self().visit_Return();
                     break;
@@ -969,141 +1022,141 @@ public:
                     break;
                 }
                 case 0x28: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I32Load(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I32Load(mem_align, mem_offset);
                     break;
                 }
                 case 0x29: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I64Load(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I64Load(mem_align, mem_offset);
                     break;
                 }
                 case 0x2A: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_F32Load(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_F32Load(mem_align, mem_offset);
                     break;
                 }
                 case 0x2B: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_F64Load(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_F64Load(mem_align, mem_offset);
                     break;
                 }
                 case 0x2C: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I32Load8S(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I32Load8S(mem_align, mem_offset);
                     break;
                 }
                 case 0x2D: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I32Load8U(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I32Load8U(mem_align, mem_offset);
                     break;
                 }
                 case 0x2E: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I32Load16S(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I32Load16S(mem_align, mem_offset);
                     break;
                 }
                 case 0x2F: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I32Load16U(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I32Load16U(mem_align, mem_offset);
                     break;
                 }
                 case 0x30: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I64Load8S(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I64Load8S(mem_align, mem_offset);
                     break;
                 }
                 case 0x31: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I64Load8U(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I64Load8U(mem_align, mem_offset);
                     break;
                 }
                 case 0x32: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I64Load16S(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I64Load16S(mem_align, mem_offset);
                     break;
                 }
                 case 0x33: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I64Load16U(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I64Load16U(mem_align, mem_offset);
                     break;
                 }
                 case 0x34: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I64Load32S(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I64Load32S(mem_align, mem_offset);
                     break;
                 }
                 case 0x35: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I64Load32U(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I64Load32U(mem_align, mem_offset);
                     break;
                 }
                 case 0x36: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I32Store(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I32Store(mem_align, mem_offset);
                     break;
                 }
                 case 0x37: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I64Store(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I64Store(mem_align, mem_offset);
                     break;
                 }
                 case 0x38: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_F32Store(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_F32Store(mem_align, mem_offset);
                     break;
                 }
                 case 0x39: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_F64Store(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_F64Store(mem_align, mem_offset);
                     break;
                 }
                 case 0x3A: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I32Store8(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I32Store8(mem_align, mem_offset);
                     break;
                 }
                 case 0x3B: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I32Store16(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I32Store16(mem_align, mem_offset);
                     break;
                 }
                 case 0x3C: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I64Store8(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I64Store8(mem_align, mem_offset);
                     break;
                 }
                 case 0x3D: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I64Store16(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I64Store16(mem_align, mem_offset);
                     break;
                 }
                 case 0x3E: {
-                    uint32_t align = read_unsigned_num(offset);
-                    uint32_t offset = read_unsigned_num(offset);
-                    self().visit_I64Store32(align, offset);
+                    uint32_t mem_align = read_unsigned_num(offset);
+                    uint32_t mem_offset = read_unsigned_num(offset);
+                    self().visit_I64Store32(mem_align, mem_offset);
                     break;
                 }
                 case 0x3F: {
@@ -1122,7 +1175,7 @@ public:
                     break;
                 }
                 case 0x42: {
-                    int64_t n = read_signed_num(offset);
+                    int64_t n = read_signed_num64(offset);
                     self().visit_I64Const(n);
                     break;
                 }
@@ -1744,146 +1797,156 @@ public:
                     break;
                 }
                 case 0xFD: {
-                    uint32_t num = read_signed_num(offset);
+                    uint32_t num = read_unsigned_num(offset);
                     switch(num) {
                         case 0U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
-                            self().visit_V128Load(align, offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
+                            self().visit_V128Load(mem_align, mem_offset);
                             break;
                         }
                         case 1U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
-                            self().visit_V128Load8x8S(align, offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
+                            self().visit_V128Load8x8S(mem_align, mem_offset);
                             break;
                         }
                         case 2U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
-                            self().visit_V128Load8x8U(align, offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
+                            self().visit_V128Load8x8U(mem_align, mem_offset);
                             break;
                         }
                         case 3U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
-                            self().visit_V128Load16x4S(align, offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
+                            self().visit_V128Load16x4S(mem_align, mem_offset);
                             break;
                         }
                         case 4U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
-                            self().visit_V128Load16x4U(align, offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
+                            self().visit_V128Load16x4U(mem_align, mem_offset);
                             break;
                         }
                         case 5U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
-                            self().visit_V128Load32x2S(align, offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
+                            self().visit_V128Load32x2S(mem_align, mem_offset);
                             break;
                         }
                         case 6U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
-                            self().visit_V128Load32x2U(align, offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
+                            self().visit_V128Load32x2U(mem_align, mem_offset);
                             break;
                         }
                         case 7U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
-                            self().visit_V128Load8Splat(align, offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
+                            self().visit_V128Load8Splat(mem_align, mem_offset);
                             break;
                         }
                         case 8U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
-                            self().visit_V128Load16Splat(align, offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
+                            self().visit_V128Load16Splat(mem_align, mem_offset);
                             break;
                         }
                         case 9U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
-                            self().visit_V128Load32Splat(align, offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
+                            self().visit_V128Load32Splat(mem_align, mem_offset);
                             break;
                         }
                         case 10U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
-                            self().visit_V128Load64Splat(align, offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
+                            self().visit_V128Load64Splat(mem_align, mem_offset);
                             break;
                         }
                         case 92U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
-                            self().visit_V128Load32Zero(align, offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
+                            self().visit_V128Load32Zero(mem_align, mem_offset);
                             break;
                         }
                         case 93U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
-                            self().visit_V128Load64Zero(align, offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
+                            self().visit_V128Load64Zero(mem_align, mem_offset);
                             break;
                         }
                         case 11U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
-                            self().visit_V128Store(align, offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
+                            self().visit_V128Store(mem_align, mem_offset);
                             break;
                         }
                         case 84U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
                             uint8_t laneidx = read_byte(offset);
-                            self().visit_V128Load8Lane(align, offset, laneidx);
+                            self().visit_V128Load8Lane(mem_align, mem_offset, laneidx);
                             break;
                         }
                         case 85U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
                             uint8_t laneidx = read_byte(offset);
-                            self().visit_V128Load16Lane(align, offset, laneidx);
+                            self().visit_V128Load16Lane(mem_align, mem_offset, laneidx);
                             break;
                         }
                         case 86U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
                             uint8_t laneidx = read_byte(offset);
-                            self().visit_V128Load32Lane(align, offset, laneidx);
+                            self().visit_V128Load32Lane(mem_align, mem_offset, laneidx);
                             break;
                         }
                         case 87U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
                             uint8_t laneidx = read_byte(offset);
-                            self().visit_V128Load64Lane(align, offset, laneidx);
+                            self().visit_V128Load64Lane(mem_align, mem_offset, laneidx);
                             break;
                         }
                         case 88U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
                             uint8_t laneidx = read_byte(offset);
-                            self().visit_V128Store8Lane(align, offset, laneidx);
+                            self().visit_V128Store8Lane(mem_align, mem_offset, laneidx);
                             break;
                         }
                         case 89U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
                             uint8_t laneidx = read_byte(offset);
-                            self().visit_V128Store16Lane(align, offset, laneidx);
+                            self().visit_V128Store16Lane(mem_align, mem_offset, laneidx);
                             break;
                         }
                         case 90U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
                             uint8_t laneidx = read_byte(offset);
-                            self().visit_V128Store32Lane(align, offset, laneidx);
+                            self().visit_V128Store32Lane(mem_align, mem_offset, laneidx);
                             break;
                         }
                         case 91U: {
-                            uint32_t align = read_unsigned_num(offset);
-                            uint32_t offset = read_unsigned_num(offset);
+                            uint32_t mem_align = read_unsigned_num(offset);
+                            uint32_t mem_offset = read_unsigned_num(offset);
                             uint8_t laneidx = read_byte(offset);
-                            self().visit_V128Store64Lane(align, offset, laneidx);
+                            self().visit_V128Store64Lane(mem_align, mem_offset, laneidx);
+                            break;
+                        }
+                        case 12U: {
+                            v128_t bytes = read_v128(offset);
+                            self().visit_V128Const(bytes);
+                            break;
+                        }
+                        case 13U: {
+                            v128_t laneidxs = read_v128(offset);
+                            self().visit_I8x16Shuffle(laneidxs);
                             break;
                         }
                         case 21U: {
@@ -2760,6 +2823,7 @@ public:
             }
             cur_byte = read_byte(offset);
         }
+        return offset;
     }
 };
 
@@ -0,0 +1,214 @@
+#ifndef LFORTRAN_WASM_WASI_H
+#define LFORTRAN_WASM_WASI_H
+
+#include <cerrno>
+#include <ctime>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "wasm_interpreter.h"
+
+namespace LFortran {
+
+// Thrown by proc_exit, unwinds the interpreter to the embedder
+struct WasiExit {
+    int32_t code;
+};
+
+// A subset of WASI preview 1 on top of the host: fd_write, fd_read,
+// proc_exit, clock_time_get and the args and environ queries. Only the
+// standard streams 0, 1 and 2 are open; every other descriptor is EBADF.
+class Wasi {
+   public:
+    static constexpr const char* MODULE = "wasi_snapshot_preview1";
+
+    // errno values of WASI, which are not the host's
+    static const int32_t ERRNO_SUCCESS = 0;
+    static const int32_t ERRNO_ACCES = 2;
+    static const int32_t ERRNO_AGAIN = 6;
+    static const int32_t ERRNO_BADF = 8;
+    static const int32_t ERRNO_FAULT = 21;
+    static const int32_t ERRNO_INTR = 27;
+    static const int32_t ERRNO_INVAL = 28;
+    static const int32_t ERRNO_IO = 29;
+    static const int32_t ERRNO_NOSPC = 51;
+    static const int32_t ERRNO_PIPE = 64;
+
+    std::vector<std::string> args;
+    std::vector<std::string> env;  // "NAME=value"
+
+    Wasi(const std::vector<std::string>& args, const std::vector<std::string>& env) : args(args), env(env) {}
+
+    // Binds every import of MODULE that is implemented here. Other imports
+    // stay unresolved and trap when called. The bound functions refer to
+    // `args` and `env`, so this object has to outlive the calls.
+    void bind(Interpreter& interp) {
+        const uint8_t I32 = 0x7F, I64 = 0x7E;
+        uint32_t func_idx = 0;
+        for (const Import& import : imports) {
+            if (import.kind != 0x00) {
+                continue;
+            }
+            uint32_t i = func_idx++;
+            if (import.module != MODULE) {
+                continue;
+            }
+            const std::string& name = import.name;
+            if (name == "fd_write") {
+                check_type(i, {I32, I32, I32, I32}, {I32});
+                interp.bind_import(i, [](Interpreter& in, Value* a) { a[0].i32 = fd_io(in, a, false); });
+            } else if (name == "fd_read") {
+                check_type(i, {I32, I32, I32, I32}, {I32});
+                interp.bind_import(i, [](Interpreter& in, Value* a) { a[0].i32 = fd_io(in, a, true); });
+            } else if (name == "proc_exit") {
+                check_type(i, {I32}, {});
+                interp.bind_import(i, [](Interpreter&, Value* a) { throw WasiExit{a[0].i32}; });
+            } else if (name == "clock_time_get") {
+                check_type(i, {I32, I64, I32}, {I32});
+                interp.bind_import(i, [](Interpreter& in, Value* a) { a[0].i32 = clock_time_get(in, a); });
+            } else if (name == "args_sizes_get" || name == "environ_sizes_get") {
+                check_type(i, {I32, I32}, {I32});
+                const std::vector<std::string>* strings = name == "args_sizes_get" ? &args : &env;
+                interp.bind_import(i, [strings](Interpreter& in, Value* a) { a[0].i32 = sizes_get(in, *strings, a); });
+            } else if (name == "args_get" || name == "environ_get") {
+                check_type(i, {I32, I32}, {I32});
+                const std::vector<std::string>* strings = name == "args_get" ? &args : &env;
+                interp.bind_import(i, [strings](Interpreter& in, Value* a) { a[0].i32 = strings_get(in, *strings, a); });
+            }
+        }
+    }
+
+   private:
+    static void check_type(uint32_t func_idx, const std::vector<uint8_t>& params, const std::vector<uint8_t>& results) {
+        const FuncType& type = func_types[func_type_index(func_idx)];
+        if (type.param_types != params || type.result_types != results) {
+            throw LFortranException("Wasi: " + function_name(func_idx) + " is imported with the wrong type");
+        }
+    }
+
+    // The host address of the guest range, nullptr if it is out of bounds
+    static uint8_t* guest(Interpreter& in, uint32_t ptr, uint64_t size) {
+        if (!in.memory || ptr + size > in.memory->size()) {
+            return nullptr;
+        }
+        return in.memory->base + ptr;
+    }
+
+    static bool store_u32(Interpreter& in, uint32_t ptr, uint32_t x) {
+        uint8_t* p = guest(in, ptr, sizeof(x));
+        if (p) {
+            std::memcpy(p, &x, sizeof(x));
+        }
+        return p;
+    }
+
+    static int32_t from_host_errno(int e) {
+        switch (e) {
+            case EACCES: return ERRNO_ACCES;
+            case EAGAIN: return ERRNO_AGAIN;
+            case EBADF: return ERRNO_BADF;
+            case EFAULT: return ERRNO_FAULT;
+            case EINTR: return ERRNO_INTR;
+            case EINVAL: return ERRNO_INVAL;
+            case ENOSPC: return ERRNO_NOSPC;
+            case EPIPE: return ERRNO_PIPE;
+            default: return ERRNO_IO;
+        }
+    }
+
+    // fd_write(fd, iovs, iovs_len, nwritten_ptr) and the same for fd_read.
+    // The guest iovecs are translated into host ones pointing into the linear
+    // memory, so the data goes straight between the memory and the kernel.
+    static int32_t fd_io(Interpreter& in, const Value* a, bool read) {
+        int fd = a[0].i32;
+        uint32_t iovs = a[1].i32, iovs_len = a[2].i32, result_ptr = a[3].i32;
+        if (read ? fd != 0 : fd != 1 && fd != 2) {
+            return ERRNO_BADF;
+        }
+        const uint8_t* guest_iovs = guest(in, iovs, (uint64_t)iovs_len * 8);
+        if (!guest_iovs || !guest(in, result_ptr, 4)) {
+            return ERRNO_FAULT;
+        }
+        const uint32_t BATCH = 64;
+        struct iovec iov[BATCH];
+        uint64_t total = 0;
+        for (uint32_t start = 0; start < iovs_len; start += BATCH) {
+            uint32_t n = std::min(BATCH, iovs_len - start);
+            uint64_t wanted = 0;
+            for (uint32_t i = 0; i < n; i++) {
+                uint32_t buf_len[2];
+                std::memcpy(buf_len, guest_iovs + (uint64_t)(start + i) * 8, 8);
+                iov[i].iov_base = guest(in, buf_len[0], buf_len[1]);
+                iov[i].iov_len = buf_len[1];
+                if (!iov[i].iov_base) {
+                    return ERRNO_FAULT;
+                }
+                wanted += buf_len[1];
+            }
+            ssize_t done = read ? readv(fd, iov, n) : writev(fd, iov, n);
+            if (done < 0) {
+                if (total > 0) {
+                    break;  // reports what was transferred before the error
+                }
+                return from_host_errno(errno);
+            }
+            total += done;
+            if ((uint64_t)done < wanted) {
+                break;
+            }
+        }
+        store_u32(in, result_ptr, total);
+        return ERRNO_SUCCESS;
+    }
+
+    // clock_time_get(id, precision, time_ptr), in nanoseconds
+    static int32_t clock_time_get(Interpreter& in, const Value* a) {
+        const clockid_t clocks[] = {CLOCK_REALTIME, CLOCK_MONOTONIC, CLOCK_PROCESS_CPUTIME_ID, CLOCK_THREAD_CPUTIME_ID};
+        uint32_t id = a[0].i32;
+        uint8_t* p = guest(in, a[2].i32, 8);
+        if (id >= 4) {
+            return ERRNO_INVAL;
+        }
+        if (!p) {
+            return ERRNO_FAULT;
+        }
+        struct timespec ts;
+        if (clock_gettime(clocks[id], &ts) != 0) {
+            return from_host_errno(errno);
+        }
+        uint64_t t = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        std::memcpy(p, &t, 8);
+        return ERRNO_SUCCESS;
+    }
+
+    // args_sizes_get(count_ptr, buf_size_ptr) and environ_sizes_get
+    static int32_t sizes_get(Interpreter& in, const std::vector<std::string>& strings, const Value* a) {
+        uint32_t buf_size = 0;
+        for (const std::string& s : strings) {
+            buf_size += s.size() + 1;
+        }
+        if (!store_u32(in, a[0].i32, strings.size()) || !store_u32(in, a[1].i32, buf_size)) {
+            return ERRNO_FAULT;
+        }
+        return ERRNO_SUCCESS;
+    }
+
+    // args_get(ptrs, buf) and environ_get: the strings go zero terminated
+    // into `buf` and their addresses into `ptrs`
+    static int32_t strings_get(Interpreter& in, const std::vector<std::string>& strings, const Value* a) {
+        uint32_t ptrs = a[0].i32, buf = a[1].i32;
+        for (const std::string& s : strings) {
+            uint8_t* p = guest(in, buf, s.size() + 1);
+            if (!p || !store_u32(in, ptrs, buf)) {
+                return ERRNO_FAULT;
+            }
+            std::memcpy(p, s.c_str(), s.size() + 1);
+            ptrs += 4;
+            buf += s.size() + 1;
+        }
+        return ERRNO_SUCCESS;
+    }
+};
+
+}  // namespace LFortran
+
+#endif  // LFORTRAN_WASM_WASI_H
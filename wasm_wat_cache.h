@@ -0,0 +1,260 @@
+#ifndef LFORTRAN_WASM_WAT_CACHE_H
+#define LFORTRAN_WASM_WAT_CACHE_H
+
+#include <fcntl.h>
+#include <functional>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include "wasm_decoder.h"
+
+namespace LFortran {
+
+// The WAT of the function bodies of the last runs, keyed by the hash of each
+// code entry (its locals and instructions), in two files of the cache
+// directory: `functions.txt` holds the text, `functions.idx` where in it the
+// body of each hash is:
+//
+//     functions.idx: header | entries
+//     functions.txt: generation | text
+//
+// A rebuilt module renders only the bodies whose bytes changed, appends them
+// to the text and rewrites the small index, so the cost of a run beyond
+// hashing and printing follows the size of the change. Once the text is more
+// than twice what the current module uses it is written anew.
+class WatCache {
+   public:
+    static const uint32_t VERSION = 1;  // bump when the WAT printer changes
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t num_entries;
+        uint64_t generation;  // of the text file the entries point into
+        uint64_t text_bytes;  // of it that is in use, after the generation
+    };
+
+    struct Entry {
+        uint64_t hash;
+        uint64_t size;  // of the code entry, checked along with the hash
+        uint64_t text_offset;
+        uint64_t text_size;
+    };
+
+    std::string dir;
+    uint32_t reused = 0;
+    uint32_t rendered = 0;
+
+    explicit WatCache(const std::string& dir) : dir(dir) {
+        mkdir(dir.c_str(), 0755);
+        load();
+    }
+
+    ~WatCache() {
+        if (text) {
+            munmap((void*)text, text_map_size);
+        }
+    }
+
+    // Hashes the code entries of the decoded module, after decode_wasm()
+    void hash_functions() {
+        keys.clear();
+        uint32_t offset = 8U;
+        while (offset < wasm_bytes.size()) {
+            uint32_t id = read_unsigned_num(offset);
+            uint32_t size = read_unsigned_num(offset);
+            if (id == 10U) {
+                uint32_t entry = offset;
+                uint32_t n = read_unsigned_num(entry);
+                for (uint32_t i = 0; i < n; i++) {
+                    uint32_t entry_size = read_unsigned_num(entry);
+                    keys.push_back({hash_bytes(&wasm_bytes[entry], entry_size), entry_size});
+                    entry += entry_size;
+                }
+            }
+            offset += size;
+        }
+    }
+
+    // The text of codes[i]: from an earlier run if its code entry is
+    // unchanged, otherwise render(i), kept for the next run
+    std::string body(uint32_t i, const std::function<std::string(uint32_t)>& render) {
+        auto used = entries.find(keys[i].first);
+        if (used != entries.end() && used->second.size == keys[i].second) {
+            reused++;
+            return text_of(used->second);
+        }
+        auto old = old_entries.find(keys[i].first);
+        if (old != old_entries.end() && old->second.size == keys[i].second) {
+            entries[keys[i].first] = old->second;
+            reused++;
+            return text_of(old->second);
+        }
+        std::string result = render(i);
+        entries[keys[i].first] = {keys[i].first, keys[i].second, header.text_bytes + appended.size(), result.size()};
+        appended += result;
+        rendered++;
+        return result;
+    }
+
+    // Saves the bodies asked for since hash_functions(), leaving the files
+    // alone if they hold exactly these already
+    void store() {
+        if (rendered == 0 && entries.size() == old_entries.size()) {
+            return;
+        }
+        uint64_t live = 0;
+        for (const auto& e : entries) {
+            live += e.second.text_size;
+        }
+        if (!text || header.text_bytes + appended.size() > 2 * live) {
+            rewrite_text();
+        } else {
+            append_text();
+        }
+        std::vector<Entry> list;
+        for (const auto& e : entries) {
+            list.push_back(e.second);
+        }
+        header.num_entries = list.size();
+        std::vector<uint8_t> out;
+        ByteWriter w{out};
+        w.put(header);
+        w.put_vector(list);
+        replace_file(dir + "/functions.idx", out.data(), out.size());
+    }
+
+   private:
+    Header header = {};
+    const char* text = nullptr;  // functions.txt of the last run, mapped
+    size_t text_map_size = 0;
+    std::unordered_map<uint64_t, Entry> old_entries;
+    std::unordered_map<uint64_t, Entry> entries;  // of this run
+    std::string appended;  // text of the bodies rendered by this run
+    std::vector<std::pair<uint64_t, uint64_t>> keys;  // hash and size of every code entry
+
+    std::string text_of(const Entry& e) const {
+        if (e.text_offset >= header.text_bytes) {
+            return appended.substr(e.text_offset - header.text_bytes, e.text_size);
+        }
+        return std::string(text + sizeof(uint64_t) + e.text_offset, e.text_size);
+    }
+
+    // Reads the index of the last run and maps its text; a missing, stale or
+    // damaged cache is started over
+    void load() {
+        std::ifstream in(dir + "/functions.idx", std::ios::binary | std::ios::ate);
+        std::vector<uint8_t> index(in ? (size_t)in.tellg() : 0);
+        in.seekg(0);
+        in.read((char*)index.data(), index.size());
+        std::vector<Entry> list;
+        try {
+            ByteReader r{index.data(), index.size(), 0};
+            header = r.get<Header>();
+            list = r.get_vector<Entry>();
+        } catch (const std::string&) {
+            header = {};
+            return;
+        }
+        int fd = open((dir + "/functions.txt").c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        uint64_t generation = 0;
+        if (fd < 0 || fstat(fd, &st) != 0 || std::memcmp(header.magic, "WASMWAT\0", 8) != 0 ||
+            header.version != VERSION || list.size() != header.num_entries ||
+            (uint64_t)st.st_size < sizeof(uint64_t) + header.text_bytes ||
+            pread(fd, &generation, sizeof(generation), 0) != sizeof(generation) || generation != header.generation) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            header = {};
+            return;
+        }
+        text_map_size = sizeof(uint64_t) + header.text_bytes;
+        void* p = mmap(nullptr, text_map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            header = {};
+            return;
+        }
+        text = (const char*)p;
+        for (const Entry& e : list) {
+            if (e.text_offset > header.text_bytes || e.text_size > header.text_bytes - e.text_offset) {
+                old_entries.clear();
+                return;
+            }
+            old_entries[e.hash] = e;
+        }
+    }
+
+    // Adds the new bodies after the text in use; whatever a failed run left
+    // beyond it is cut off first
+    void append_text() {
+        std::string path = dir + "/functions.txt";
+        int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fd < 0 || ftruncate(fd, sizeof(uint64_t) + header.text_bytes) != 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            throw LFortranException("WatCache: cannot write " + path);
+        }
+        write_all(fd, path, appended.data(), appended.size(), sizeof(uint64_t) + header.text_bytes);
+        close(fd);
+        header.text_bytes += appended.size();
+    }
+
+    // Writes a new text file with only the bodies of this run, under a new
+    // generation so that the old index can never point into it
+    void rewrite_text() {
+        std::vector<uint8_t> out(sizeof(uint64_t));
+        uint64_t generation = header.generation + 1;
+        std::memcpy(out.data(), &generation, sizeof(generation));
+        for (auto& e : entries) {
+            std::string t = text_of(e.second);
+            e.second.text_offset = out.size() - sizeof(uint64_t);
+            out.insert(out.end(), t.begin(), t.end());
+        }
+        replace_file(dir + "/functions.txt", out.data(), out.size());
+        std::memcpy(header.magic, "WASMWAT\0", 8);
+        header.version = VERSION;
+        header.generation = generation;
+        header.text_bytes = out.size() - sizeof(uint64_t);
+    }
+
+    static void write_all(int fd, const std::string& path, const void* data, size_t size, uint64_t offset) {
+        size_t done = 0;
+        while (done < size) {
+            ssize_t n = pwrite(fd, (const char*)data + done, size - done, offset + done);
+            if (n <= 0) {
+                close(fd);
+                throw LFortranException("WatCache: cannot write " + path);
+            }
+            done += n;
+        }
+    }
+
+    // Written next to the file and renamed over it, so a reader never sees a
+    // partial one
+    static void replace_file(const std::string& path, const void* data, size_t size) {
+        std::string tmp = path + ".tmp" + std::to_string(getpid());
+        int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw LFortranException("WatCache: cannot create " + tmp);
+        }
+        try {
+            write_all(fd, tmp, data, size, 0);
+        } catch (const std::string&) {
+            unlink(tmp.c_str());
+            throw;
+        }
+        close(fd);
+        if (rename(tmp.c_str(), path.c_str()) != 0) {
+            unlink(tmp.c_str());
+            throw LFortranException("WatCache: cannot write " + path);
+        }
+    }
+};
+
+}  // namespace LFortran
+
+#endif  // LFORTRAN_WASM_WAT_CACHE_H